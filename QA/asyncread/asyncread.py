@@ -0,0 +1,62 @@
+#
+# asyncread.py - Performance testing of reading piped input ahead of the pipeline.
+# Licensed under Academic Free License 3.0
+#
+# Runs icgrep over a generated text file, once memory mapped and twice
+# through a pipe from cat: with and without -async-read.  Reports the best
+# wall-clock time and throughput of each.  The piped runs read through
+# the read source kernel, which with -async-read refills its buffer on a
+# separate I/O thread; the mmap run gives the throughput to aim for.  The
+# outputs of all configurations must be identical.
+#
+# Usage: python asyncread.py [options] <path to icgrep>
+#
+
+import sys, optparse, os
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+from perfutil import generate_sized_text, run_tool, best_run
+
+regexps = [r"(echo|kilo) [a-z]+ (lima|oscar)",
+           r"\p{L}+ \p{Nd}{6}$"]
+
+def run_icgrep(icgrep, flags, regexp, datafile, piped):
+    if piped:
+        return run_tool([icgrep] + flags + [regexp, "-"], datafile)
+    return run_tool([icgrep] + flags + [regexp, datafile])
+
+def best_icgrep(icgrep, flags, regexp, datafile, piped, repetitions):
+    ((elapsed, _), outputs) = best_run(lambda: run_icgrep(icgrep, flags, regexp, datafile, piped), repetitions)
+    return (elapsed, outputs)
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <grep_executable>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated text file.')
+    option_parser.add_option('-m', '--megabytes', dest = 'megabytes', type='int', default=1024,
+                             help = 'size of the generated text file in MiB.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=3,
+                             help = 'number of timed runs of each configuration; the fastest is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the text generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    icgrep = args[0]
+    datafile = os.path.join(options.datafile_dir, "asyncread.txt")
+    generate_sized_text(datafile, options.megabytes, options.seed)
+    size = os.path.getsize(datafile)
+    print("%s: %d bytes" % (datafile, size))
+    failures = 0
+    for regexp in regexps:
+        (mmap, mmapOutputs) = best_icgrep(icgrep, ["-c"], regexp, datafile, False, options.repetitions)
+        (blocking, blockingOutputs) = best_icgrep(icgrep, ["-c", "-async-read=0"], regexp, datafile, True, options.repetitions)
+        (readAhead, readAheadOutputs) = best_icgrep(icgrep, ["-c", "-async-read=1"], regexp, datafile, True, options.repetitions)
+        status = "ok"
+        if len(mmapOutputs | blockingOutputs | readAheadOutputs) != 1:
+            status = "FAIL (outputs differ)"
+            failures += 1
+        print("%-40s mmap %7.3fs %6.0f MB/s   pipe %7.3fs %6.0f MB/s   async pipe %7.3fs %6.0f MB/s  %s" %
+              (regexp, mmap, size / mmap / 1e6, blocking, size / blocking / 1e6, readAhead, size / readAhead / 1e6, status))
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
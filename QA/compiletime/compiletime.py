@@ -0,0 +1,61 @@
+#
+# compiletime.py - Performance testing of parallel kernel compilation.
+# Licensed under Academic Free License 3.0
+#
+# Runs icgrep with the object cache disabled, so that every kernel of the
+# pipeline must be generated and compiled, for a set of regular expressions
+# of increasing size.   Each expression is run with 1, 4 and 16 compilation
+# threads (-compile-threads) and the best wall-clock time of each is
+# reported; the match counts of every run are checked against each other.
+#
+# Usage: python compiletime.py [options] <path to icgrep>
+#
+
+import sys, optparse, os
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+from perfutil import generate_text, run_tool, best_run
+
+regexps = [r"(echo|kilo) [a-z]+ (lima|oscar)",
+           r"\p{Greek}|\p{Cyrillic}|[0-9]{3,}$",
+           r"\p{L}+ \p{Nd}+$|\p{Lu}\p{Ll}+|(golf|hotel).*\p{Nd}{4}",
+           r"\b(alpha|bravo)\b.*\b(juliet|mike)\b|\p{Han}+|\p{script=Arabic}\p{M}*"]
+
+def run_icgrep(icgrep, flags, regexp, datafile):
+    (elapsed, output) = run_tool([icgrep, "-c", "-enable-object-cache=0"] + flags + [regexp, datafile])
+    return (elapsed, int(output.decode().strip()))
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <grep_executable>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated text file.')
+    option_parser.add_option('-n', '--lines', dest = 'lines', type='int', default=1000,
+                             help = 'number of lines to generate.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=3,
+                             help = 'number of timed runs of each configuration; the fastest is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the text generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    icgrep = args[0]
+    datafile = os.path.join(options.datafile_dir, "compiletime.txt")
+    generate_text(datafile, options.lines, options.seed)
+    print("%s: %d lines, %d bytes, %d cores" % (datafile, options.lines, os.path.getsize(datafile), os.sysconf('SC_NPROCESSORS_ONLN')))
+    failures = 0
+    threads = [1, 4, 16]
+    for regexp in regexps:
+        times = []
+        counts = set()
+        for n in threads:
+            # every run compiles the whole pipeline, so there is no untimed warm-up run
+            (best, c) = best_run(lambda: run_icgrep(icgrep, ["-compile-threads=%d" % n], regexp, datafile), options.repetitions, warmup=False)
+            times.append(best[0])
+            counts |= c
+        status = "ok"
+        if len(counts) != 1:
+            status = "FAIL (inconsistent match counts %s)" % sorted(counts)
+            failures += 1
+        print("%-72s %s   %5.2fx  %s" % (regexp, "   ".join("%2d threads %7.3fs" % (n, t) for (n, t) in zip(threads, times)), times[0] / min(times[1:]), status))
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
@@ -16,6 +16,14 @@
 # <grepcase regexp="[A-Z]" datafile="simple1" greplines="1"/>
 #
 # </greptest>
+#
+# Instead of greplines or grepcount, a grepcase may give the exact output
+# expected (with &#10; for each line break), and the exit status expected
+# with status.  A regexp containing &#10; is given as one -e per line.  Such
+# a grepcase may name several datafiles, separated by spaces.
+#
+# <grepcase regexp="few&#10;fodder" datafile="simple1" flags="--pattern-ids" output="1:A few lines of input&#10;2:provide fodder for some simple"/>
+# <grepcase regexp="in" datafile="simple1" flags="--pattern-ids -v" output="" status="3"/>
 
 
 import sys, subprocess, os, optparse, re, codecs, stat
@@ -128,26 +136,37 @@ colorizationRE = re.compile("\x1B\[01;31m\x1B\[K|\x1B\[m")
 def filter_colorization(grep_output):
     return colorizationRE.sub("", grep_output)
 
-def execute_grep_test(flags, regexp, datafile, expected_result):
+def execute_grep_test(flags, regexp, datafile, expected_result, expected_status=None):
     global failure_count
     flag_string = ""
     for f in flags:
         if flag_string != "": flag_string += u" "
         if flags[f] == True: flag_string += f
         else: flag_string += f + "=" + flags[f]
-    grep_cmd = u"%s %s '%s' %s" % (grep_program_under_test, flag_string, escape_quotes(regexp), os.path.join(options.datafile_dir, datafile))
+    if "\n" in regexp:
+        regexp_string = u" ".join(u"-e '%s'" % escape_quotes(r) for r in regexp.split("\n"))
+    else:
+        regexp_string = u"'%s'" % escape_quotes(regexp)
+    datafile_string = u" ".join(os.path.join(options.datafile_dir, f) for f in datafile.split(' '))
+    grep_cmd = u"%s %s %s %s" % (grep_program_under_test, flag_string, regexp_string, datafile_string)
     if options.verbose:
         print("Doing: " + grep_cmd)
+    status = 0
     try:
         grep_out = codecs.decode(subprocess.check_output(grep_cmd.encode('utf-8'), cwd=options.exec_dir, shell=True), 'utf-8')
     except subprocess.CalledProcessError as e:
         grep_out = codecs.decode(e.output, 'utf-8')
+        status = e.returncode
     if len(grep_out) > 0 and grep_out[-1] == '\n': grep_out = grep_out[:-1]
     filtered_out = filter_colorization(grep_out)
     if filtered_out != expected_result:
         msg = u"Test failure: {%s} expecting {%s} got {%s}" % (grep_cmd, expected_result, grep_out)
         print(msg.encode('utf-8'))
         failure_count += 1
+    elif expected_status is not None and status != expected_status:
+        msg = u"Test failure: {%s} expecting exit status %i got %i" % (grep_cmd, expected_status, status)
+        print(msg.encode('utf-8'))
+        failure_count += 1
     else:
         if options.verbose:
             msg = u"Test success: regexp {%s} on datafile {%s} expecting {%s} got {%s}" % (regexp, datafile, expected_result, grep_out)
@@ -197,7 +216,12 @@ def start_element_do_test(name, attrs):
                 if len(flag_and_value) == 1:
                     flags[flag] = True
                 else: flags[flag] = flag_and_value[1]
-        if 'grepcount' in attrs:
+        if 'output' in attrs:
+            expected_result = attrs['output']
+            if len(expected_result) > 0 and expected_result[-1] == u'\n': expected_result = expected_result[:-1]
+            expected_status = int(attrs['status']) if 'status' in attrs else None
+            execute_grep_test(flags, attrs['regexp'], attrs['datafile'], expected_result, expected_status)
+        elif 'grepcount' in attrs:
             flags["-c"] = True
             expected_result = attrs['grepcount']
             if "-m" in flags:
@@ -206,7 +230,7 @@ def start_element_do_test(name, attrs):
             execute_grep_test(flags, attrs['regexp'], attrs['datafile'], expected_result)
         else:
             if not 'greplines' in attrs:
-                raise Exception('Expecting grepcount or greplines in grepcase')
+                raise Exception('Expecting grepcount, greplines or output in grepcase')
             fileLength = len(getFileContents(attrs['datafile']))
             lines = []
             if attrs['greplines'] != '':
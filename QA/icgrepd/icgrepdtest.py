@@ -0,0 +1,51 @@
+#
+# icgrepdtest.py - Functional correctness testing of the icgrep search server.
+# Licensed under Academic Free License 3.0
+#
+# Starts icgrepd on a private socket and runs the grep test cases of
+# icgrepdtest.xml through icgrepc, checking the exact output and exit status
+# of each query.  The cases include bad queries, after which the server must
+# still be serving; the server must also still be running once all of the
+# cases are done.
+#
+# Usage: python icgrepdtest.py [options] <directory of icgrepd and icgrepc>
+#
+
+import sys, subprocess, optparse, os, time, tempfile
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <tool_directory>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='testfiles',
+                             help = 'directory for the test files.')
+    option_parser.add_option('-v', '--verbose', dest = 'verbose', action='store_true', default=False,
+                             help = 'verbose output: show successful tests')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    tooldir = args[0]
+    QA_dir = os.path.dirname(os.path.abspath(sys.argv[0]))
+    socket = os.path.join(tempfile.mkdtemp(), "icgrepd.sock")
+    server = subprocess.Popen([os.path.join(tooldir, "icgrepd"), "--socket=" + socket])
+    for i in range(100):
+        if os.path.exists(socket) or server.poll() is not None:
+            break
+        time.sleep(0.1)
+    if not os.path.exists(socket):
+        print("icgrepd did not start")
+        server.kill()
+        sys.exit(1)
+    client = "%s --socket=%s" % (os.path.join(tooldir, "icgrepc"), socket)
+    command = [sys.executable, os.path.join(QA_dir, "..", "greptest.py"), "-d", options.datafile_dir,
+               "-t", os.path.join(QA_dir, "icgrepdtest.xml"), client]
+    if options.verbose:
+        command.insert(2, "-v")
+    status = subprocess.call(command)
+    if server.poll() is not None:
+        print("icgrepd exited with status %d" % server.returncode)
+        status = 1
+    else:
+        server.terminate()
+        server.wait()
+    os.rmdir(os.path.dirname(socket))
+    sys.exit(1 if status != 0 else 0)
@@ -0,0 +1,56 @@
+#
+# kernelfusion.py - Performance testing of Pablo kernel fusion.
+# Licensed under Academic Free License 3.0
+#
+# Runs icgrep over a generated text file for a set of regular expressions,
+# and u8u16 and wc over the same file, with and without -kernel-fusion, and
+# reports the best wall-clock time of each.  Each configuration is run once
+# beforehand so that its kernels are in the object cache and the timed runs
+# measure the pipeline rather than kernel compilation.  The outputs of both
+# configurations must be identical.
+#
+# Usage: python kernelfusion.py [options] <directory of icgrep, u8u16 and wc>
+#
+
+import sys, optparse, os
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+from perfutil import words, unicode_words, generate_text, run_tool, best_run
+
+regexps = [r"(echo|kilo) [a-z]+ (lima|oscar)",
+           r"\p{Greek}+|\p{Cyrillic}+|[0-9]{3,}$",
+           r"\p{L}+ \p{Nd}+$|\p{Lu}\p{Ll}+|(golf|hotel).*\p{Nd}{4}",
+           r"\b(alpha|bravo)\b.*\b(juliet|mike)\b|\p{Han}+|\p{script=Arabic}\p{M}*"]
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <tool_directory>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated text file.')
+    option_parser.add_option('-n', '--lines', dest = 'lines', type='int', default=2000000,
+                             help = 'number of lines to generate.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=5,
+                             help = 'number of timed runs of each configuration; the fastest is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the text generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    tooldir = args[0]
+    datafile = os.path.join(options.datafile_dir, "kernelfusion.txt")
+    generate_text(datafile, options.lines, options.seed, words + unicode_words)
+    print("%s: %d lines, %d bytes" % (datafile, options.lines, os.path.getsize(datafile)))
+    configurations = [("icgrep " + regexp, [os.path.join(tooldir, "icgrep"), regexp, datafile]) for regexp in regexps]
+    configurations += [("u8u16", [os.path.join(tooldir, "u8u16"), datafile]),
+                       ("wc -lwm", [os.path.join(tooldir, "wc"), "-lwm", datafile])]
+    failures = 0
+    for (name, command) in configurations:
+        fusedCommand = command[:1] + ["-kernel-fusion"] + command[1:]
+        ((unfused, _), unfusedOutputs) = best_run(lambda: run_tool(command), options.repetitions)
+        ((fused, _), fusedOutputs) = best_run(lambda: run_tool(fusedCommand), options.repetitions)
+        status = "ok"
+        if len(unfusedOutputs | fusedOutputs) != 1:
+            status = "FAIL (outputs differ)"
+            failures += 1
+        print("%-67s unfused %7.3fs   fused %7.3fs   %5.2fx  %s" % (name, unfused, fused, unfused / fused, status))
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
@@ -0,0 +1,95 @@
+#
+# literalsets.py - Testing of icgrep -f with large sets of literal patterns.
+# Licensed under Academic Free License 3.0
+#
+# Generates a set of indicator strings (host names and hex digests) and a log
+# in which a small fraction of the lines contain one of them, then times
+# icgrep -c -f for pattern files of increasing size.   With the literal set
+# engine the search time should grow much more slowly than the number of
+# patterns.   Counts are checked against the number of matching lines written
+# by the generator; for the smaller sets, the regular expression engine
+# (-literal-set-threshold=0) is timed and checked as well.
+#
+# Usage: python literalsets.py [options] <path to icgrep>
+#
+
+import sys, subprocess, optparse, os, random, time
+
+def make_indicator(r, domain = "example"):
+    if r.random() < 0.5:
+        return "%s.%s.%s" % ("".join(r.choice("abcdefghijklmnopqrstuvwxyz") for i in range(r.randint(4, 12))), r.choice(["cdn", "api", "mail", "dl"]), domain)
+    return "%032x" % r.getrandbits(128)
+
+def generate(dir, count, lines, density, seed):
+    r = random.Random(seed)
+    indicators = set()
+    while len(indicators) < count:
+        indicators.add(make_indicator(r))
+    indicators = sorted(indicators)
+    patfile = os.path.join(dir, "indicators%d.txt" % count)
+    with open(patfile, 'w') as f:
+        for s in indicators:
+            f.write(s + "\n")
+    logfile = os.path.join(dir, "indicators%d.log" % count)
+    expected = 0
+    with open(logfile, 'w') as f:
+        for i in range(lines):
+            stamp = "2019-03-%02d %02d:%02d:%02d " % (1 + i % 28, r.randint(0, 23), r.randint(0, 59), r.randint(0, 59))
+            if r.random() < density:
+                expected += 1
+                f.write(stamp + "connect to %s from 10.0.%d.%d\n" % (r.choice(indicators), r.randint(0, 255), r.randint(0, 255)))
+            else:
+                # Near misses: host names in another domain and fresh digests.
+                f.write(stamp + "connect to %s from 10.0.%d.%d\n" % (make_indicator(r, "invalid"), r.randint(0, 255), r.randint(0, 255)))
+    return (patfile, logfile, expected)
+
+def time_icgrep(icgrep, flags, patfile, datafile, repetitions):
+    best = None
+    count = None
+    for i in range(repetitions):
+        start = time.time()
+        out = subprocess.check_output([icgrep, "-c"] + flags + ["-f", patfile, datafile])
+        elapsed = time.time() - start
+        count = int(out.decode().strip())
+        if best is None or elapsed < best:
+            best = elapsed
+    return (best, count)
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <grep_executable>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated files.')
+    option_parser.add_option('-n', '--lines', dest = 'lines', type='int', default=1000000,
+                             help = 'number of log lines to generate.')
+    option_parser.add_option('--density', dest = 'density', type='float', default=0.001,
+                             help = 'fraction of lines containing an indicator.')
+    option_parser.add_option('--sizes', dest = 'sizes', type='string', default='100,1000,10000,100000',
+                             help = 'comma-separated numbers of patterns to test.')
+    option_parser.add_option('--regex-limit', dest = 'regex_limit', type='int', default=1000,
+                             help = 'largest pattern set also searched with the regular expression engine.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=3,
+                             help = 'number of timed runs of each search; the best is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    icgrep = args[0]
+    failures = 0
+    for count in [int(n) for n in options.sizes.split(',')]:
+        (patfile, logfile, expected) = generate(options.datafile_dir, count, options.lines, options.density, options.seed)
+        (t, c) = time_icgrep(icgrep, ["-literal-set-threshold=1"], patfile, logfile, options.repetitions)
+        status = "ok" if c == expected else "FAIL (expected %d, got %d)" % (expected, c)
+        failures += 0 if c == expected else 1
+        regex = ""
+        if count <= options.regex_limit:
+            (rt, rc) = time_icgrep(icgrep, ["-literal-set-threshold=0"], patfile, logfile, options.repetitions)
+            regex = "  %8.3fs regex" % rt
+            if rc != expected:
+                status += "  FAIL regex (got %d)" % rc
+                failures += 1
+        print("%7d patterns %7d matches  %8.3fs literal set%s  %s" % (count, expected, t, regex, status))
+        os.remove(patfile)
+        os.remove(logfile)
+    sys.exit(1 if failures > 0 else 0)
@@ -0,0 +1,90 @@
+#
+# logperf.py - Performance testing of icgrep on log files with sparse matches.
+# Licensed under Academic Free License 3.0
+#
+# Generates a synthetic server log in which only a small fraction of the
+# lines match each test pattern, then times icgrep on every pattern with and
+# without the required-literal prefilter (-enable-literal-prefilter).   The
+# match counts of both runs are checked against the number of matching lines
+# written by the generator.
+#
+# Usage: python logperf.py [options] <path to icgrep>
+#
+
+import sys, subprocess, optparse, os, random, time
+
+# Each pattern is paired with a function producing a matching log message.
+patterns = [
+    (r"ERROR.*timeout=\d+", lambda r: "ERROR upstream request failed: timeout=%d ms" % r.randint(1, 99999)),
+    (r"connection reset by peer \(errno=\d+\)", lambda r: "worker %d: connection reset by peer (errno=%d)" % (r.randint(1, 64), r.randint(1, 200))),
+    (r"[Uu]ser [a-z]+ failed authentication from \d+\.\d+\.\d+\.\d+", lambda r: "user %s failed authentication from 10.%d.%d.%d" % (r.choice(["alice", "bob", "carol"]), r.randint(0, 255), r.randint(0, 255), r.randint(0, 255))),
+    (r"[Dd]isk [Qq]uota [Ee]xceeded for volume vol\d+", lambda r: "Disk Quota Exceeded for volume vol%d" % r.randint(0, 999)),
+]
+
+fillers = [
+    "GET /index.html HTTP/1.1 200 %d",
+    "POST /api/v1/items HTTP/1.1 201 %d",
+    "cache hit ratio %d percent",
+    "INFO scheduled job completed in %d ms",
+    "DEBUG session renewed, ttl=%d",
+    "WARN slow query took %d ms",
+]
+
+def generate_log(path, lines, density, seed):
+    r = random.Random(seed)
+    expected = [0] * len(patterns)
+    with open(path, 'w') as f:
+        for i in range(lines):
+            stamp = "2019-03-%02d %02d:%02d:%02d host%02d " % (1 + i % 28, r.randint(0, 23), r.randint(0, 59), r.randint(0, 59), r.randint(0, 16))
+            if r.random() < density:
+                k = r.randrange(len(patterns))
+                expected[k] += 1
+                f.write(stamp + patterns[k][1](r) + "\n")
+            else:
+                f.write(stamp + (r.choice(fillers) % r.randint(0, 100000)) + "\n")
+    return expected
+
+def time_icgrep(icgrep, flags, regexp, datafile, repetitions):
+    best = None
+    count = None
+    for i in range(repetitions):
+        start = time.time()
+        out = subprocess.check_output([icgrep, "-c"] + flags + [regexp, datafile])
+        elapsed = time.time() - start
+        count = int(out.decode().strip())
+        if best is None or elapsed < best:
+            best = elapsed
+    return (best, count)
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <grep_executable>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated log file.')
+    option_parser.add_option('-n', '--lines', dest = 'lines', type='int', default=2000000,
+                             help = 'number of log lines to generate.')
+    option_parser.add_option('--density', dest = 'density', type='float', default=0.0005,
+                             help = 'fraction of lines matching one of the patterns.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=3,
+                             help = 'number of timed runs of each search; the best is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the log generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    icgrep = args[0]
+    datafile = os.path.join(options.datafile_dir, "logperf.log")
+    expected = generate_log(datafile, options.lines, options.density, options.seed)
+    print("%s: %d lines, %d bytes" % (datafile, options.lines, os.path.getsize(datafile)))
+    failures = 0
+    for k in range(len(patterns)):
+        regexp = patterns[k][0]
+        (without, c1) = time_icgrep(icgrep, ["-enable-literal-prefilter=false"], regexp, datafile, options.repetitions)
+        (with_pf, c2) = time_icgrep(icgrep, ["-enable-literal-prefilter=true"], regexp, datafile, options.repetitions)
+        status = "ok"
+        if c1 != expected[k] or c2 != expected[k]:
+            status = "FAIL (expected %d, got %d without and %d with prefilter)" % (expected[k], c1, c2)
+            failures += 1
+        print("%-60s %7d matches  %8.3fs  %8.3fs prefiltered  %5.2fx  %s" % (regexp, expected[k], without, with_pf, without / with_pf, status))
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
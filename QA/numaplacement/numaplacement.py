@@ -0,0 +1,70 @@
+#
+# numaplacement.py - Performance testing of pipeline thread placement policies.
+# Licensed under Academic Free License 3.0
+#
+# Reports the NUMA topology read from sysfs and runs icgrep over a generated text
+# file with each -thread-placement policy for a range of -thread-num values,
+# reporting the best wall-clock time of each.  Each configuration is run once
+# beforehand so that its kernels are in the object cache.  The outputs of every
+# configuration must be identical.  On a machine with a single NUMA node the
+# compact, scatter and node policies differ from linear only in which CPUs are used.
+#
+# Usage: python numaplacement.py [options] <path to icgrep>
+#
+
+import sys, optparse, os, glob
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+from perfutil import generate_text, run_tool, best_run
+
+policies = ["linear", "compact", "scatter", "node"]
+
+regexps = [r"(echo|kilo) [a-z]+ (lima|oscar)",
+           r"\b(alpha|bravo)\b.*\b(juliet|mike)\b|[0-9]{6}$"]
+
+def numa_nodes():
+    nodes = []
+    for path in sorted(glob.glob("/sys/devices/system/node/node[0-9]*")):
+        with open(os.path.join(path, "cpulist")) as f:
+            nodes.append((os.path.basename(path), f.read().strip()))
+    return nodes
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <grep_executable>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated text file.')
+    option_parser.add_option('-n', '--lines', dest = 'lines', type='int', default=4000000,
+                             help = 'number of lines to generate.')
+    option_parser.add_option('-t', '--threads', dest = 'threads', type='string', default='2,4,8',
+                             help = 'comma separated list of -thread-num values to test.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=5,
+                             help = 'number of timed runs of each configuration; the fastest is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the text generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    icgrep = args[0]
+    for (node, cpus) in numa_nodes():
+        print("%s: cpus %s" % (node, cpus))
+    datafile = os.path.join(options.datafile_dir, "numaplacement.txt")
+    generate_text(datafile, options.lines, options.seed)
+    print("%s: %d lines, %d bytes" % (datafile, options.lines, os.path.getsize(datafile)))
+    failures = 0
+    for regexp in regexps:
+        print(regexp)
+        for threads in [int(t) for t in options.threads.split(',')]:
+            times = []
+            outputs = set()
+            for policy in policies:
+                command = [icgrep, "-thread-num=%d" % threads, "-thread-placement=" + policy, regexp, datafile]
+                ((elapsed, _), output) = best_run(lambda: run_tool(command), options.repetitions)
+                times.append(elapsed)
+                outputs |= output
+            status = "ok"
+            if len(outputs) != 1:
+                status = "FAIL (outputs differ)"
+                failures += 1
+            print("  %2d threads  " % threads + "  ".join("%s %7.3fs" % (p, t) for (p, t) in zip(policies, times)) + "  " + status)
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
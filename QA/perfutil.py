@@ -0,0 +1,68 @@
+#
+# perfutil.py - Shared support for the performance test scripts.
+# Licensed under Academic Free License 3.0
+#
+# The scripts in the QA subdirectories generate a text file, run the tools
+# over it in several configurations and report the fastest run of each.
+# They import this module through the parent directory:
+#
+#   sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+#   from perfutil import generate_text, run_tool, best_run
+#
+
+import subprocess, random, time
+
+words = ["alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+         "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa"]
+
+# Greek, Cyrillic, Han and Arabic words, for text that exercises the Unicode properties
+unicode_words = [u"\u03b1\u03bb\u03c6\u03b1", u"\u0431\u0440\u0430\u0432\u043e", u"\u6f22\u5b57", u"\u0627\u0644\u0641"]
+
+def random_line(r, vocabulary):
+    return u" ".join(r.choice(vocabulary) for k in range(r.randint(4, 16))) + u" %d\n" % r.randint(0, 1000000)
+
+def generate_text(path, lines, seed, vocabulary=words):
+    """Write the given number of lines of 4 to 16 random words, each followed by a number, to path as UTF-8."""
+    r = random.Random(seed)
+    with open(path, 'wb') as f:
+        for i in range(lines):
+            f.write(random_line(r, vocabulary).encode("utf-8"))
+
+def generate_sized_text(path, megabytes, seed, vocabulary=words):
+    """Write a block of 100000 lines like those of generate_text to path as many times as needed to fill the
+    given number of MiB; this is much faster than generating a large file line by line."""
+    r = random.Random(seed)
+    block = u"".join(random_line(r, vocabulary) for i in range(100000)).encode("utf-8")
+    with open(path, 'wb') as f:
+        written = 0
+        while written < megabytes * 1024 * 1024:
+            f.write(block)
+            written += len(block)
+
+def run_tool(command, input_file=None):
+    """Run command and return its wall-clock time and output.  If input_file is given, it is piped to the
+    standard input of command by cat."""
+    start = time.time()
+    if input_file is None:
+        output = subprocess.check_output(command)
+    else:
+        cat = subprocess.Popen(["cat", input_file], stdout=subprocess.PIPE)
+        output = subprocess.check_output(command, stdin=cat.stdout)
+        cat.stdout.close()
+        cat.wait()
+    return (time.time() - start, output)
+
+def best_run(run, repetitions, warmup=True):
+    """Call run, which must return a tuple whose first two items are the elapsed time and the output of a run,
+    the given number of times (after one untimed call, if warmup is set, so that the kernels of the program
+    are in the object cache.)  Return the result of the fastest call and the set of outputs of every call."""
+    if warmup:
+        run()
+    best = None
+    outputs = set()
+    for i in range(repetitions):
+        result = run()
+        outputs.add(result[1])
+        if best is None or result[0] < best[0]:
+            best = result
+    return (best, outputs)
@@ -0,0 +1,73 @@
+#
+# threadwait.py - Performance testing of segment lock waiting under oversubscription.
+# Licensed under Academic Free License 3.0
+#
+# Generates a text file and runs several icgrep processes on it at once, so
+# that the pipeline threads of all processes outnumber the available cores
+# by a factor of 1, 2 and 4.   Each configuration is run with threads that
+# spin on segment locks (the default) and with threads that sleep on them
+# after a short spin (-blocking-sync).   The wall-clock time of the batch
+# and the CPU time used by all of its processes are reported; the match
+# counts of every process are checked against each other.
+#
+# Usage: python threadwait.py [options] <path to icgrep>
+#
+
+import sys, subprocess, optparse, os, time
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+from perfutil import generate_text, best_run
+
+def cpu_time():
+    t = os.times()
+    return t[2] + t[3]
+
+def run_batch(icgrep, flags, regexp, datafile, processes):
+    cpu_before = cpu_time()
+    start = time.time()
+    procs = [subprocess.Popen([icgrep, "-c"] + flags + [regexp, datafile], stdout=subprocess.PIPE) for i in range(processes)]
+    counts = tuple(int(p.communicate()[0].decode().strip()) for p in procs)
+    elapsed = time.time() - start
+    return (elapsed, counts, cpu_time() - cpu_before)
+
+def best_batch(icgrep, flags, regexp, datafile, processes, repetitions):
+    (best, counts) = best_run(lambda: run_batch(icgrep, flags, regexp, datafile, processes), repetitions, warmup=False)
+    return (best[0], best[2], set(c for batch in counts for c in batch))
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <grep_executable>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated text file.')
+    option_parser.add_option('-n', '--lines', dest = 'lines', type='int', default=2000000,
+                             help = 'number of lines to generate.')
+    option_parser.add_option('-t', '--threads', dest = 'threads', type='int', default=4,
+                             help = 'number of segment threads of each icgrep process.')
+    option_parser.add_option('-c', '--cores', dest = 'cores', type='int', default=0,
+                             help = 'number of available cores (defaults to the number of online cores).')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=3,
+                             help = 'number of timed runs of each batch; the fastest is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the text generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    icgrep = args[0]
+    cores = options.cores if options.cores > 0 else os.sysconf('SC_NPROCESSORS_ONLN')
+    datafile = os.path.join(options.datafile_dir, "threadwait.txt")
+    generate_text(datafile, options.lines, options.seed)
+    print("%s: %d lines, %d bytes, %d cores, %d threads per process" % (datafile, options.lines, os.path.getsize(datafile), cores, options.threads))
+    regexp = r"(echo|kilo) [a-z]+ (lima|oscar) [0-9]+$"
+    failures = 0
+    threads = ["-thread-num=%d" % options.threads]
+    for factor in [1, 2, 4]:
+        processes = max(1, (factor * cores) // options.threads)
+        (spin_wall, spin_cpu, c1) = best_batch(icgrep, threads + ["-blocking-sync=false"], regexp, datafile, processes, options.repetitions)
+        (wait_wall, wait_cpu, c2) = best_batch(icgrep, threads + ["-blocking-sync=true"], regexp, datafile, processes, options.repetitions)
+        status = "ok"
+        if len(c1 | c2) != 1:
+            status = "FAIL (inconsistent match counts %s)" % sorted(c1 | c2)
+            failures += 1
+        print("%dx oversubscribed (%2d processes): spin %8.3fs wall %8.3fs cpu   blocking %8.3fs wall %8.3fs cpu   %5.2fx  %s"
+              % (factor, processes, spin_wall, spin_cpu, wait_wall, wait_cpu, spin_wall / wait_wall, status))
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
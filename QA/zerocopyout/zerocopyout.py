@@ -0,0 +1,81 @@
+#
+# zerocopyout.py - Performance testing of the zero-copy output path.
+# Licensed under Academic Free License 3.0
+#
+# Runs u8u16 and base64 over a generated UTF-8 text file, writing to a
+# pipe and to a file, with and without -zero-copy-output.  Reports the
+# best wall-clock time and output throughput of each.  With
+# -zero-copy-output, output is written to the file in page-aligned
+# batches and, since this script reads the pipe with read, bulk output
+# is spliced into the pipe (vmsplice, -splice-pipe-output).  The outputs of both
+# configurations must be identical.
+#
+# Usage: python zerocopyout.py [options] <directory of u8u16 and base64>
+#
+
+import sys, subprocess, optparse, os, time
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+from perfutil import words, unicode_words, generate_sized_text, best_run
+
+def run_output(tool, flags, datafile, outfile):
+    start = time.time()
+    if outfile is None:
+        # read the pipe in large chunks so that the reader is not the bottleneck
+        p = subprocess.Popen([tool] + flags + [datafile], stdout=subprocess.PIPE, bufsize=1024 * 1024)
+        chunks = []
+        while True:
+            chunk = p.stdout.read(1024 * 1024)
+            if not chunk:
+                break
+            chunks.append(chunk)
+        p.wait()
+        output = b"".join(chunks)
+        elapsed = time.time() - start
+    else:
+        subprocess.check_call([tool] + flags + [datafile, outfile])
+        elapsed = time.time() - start
+        with open(outfile, 'rb') as f:
+            output = f.read()
+        os.remove(outfile)
+    return (elapsed, output)
+
+def best_output(tool, flags, datafile, outfile, repetitions):
+    ((elapsed, output), outputs) = best_run(lambda: run_output(tool, flags, datafile, outfile), repetitions)
+    return (elapsed, outputs, len(output))
+
+if __name__ == '__main__':
+    option_parser = optparse.OptionParser(usage='python %prog [options] <tool_directory>', version='1.0')
+    option_parser.add_option('-d', '--datafile_dir', dest = 'datafile_dir', type='string', default='.',
+                             help = 'directory for the generated text and output files.')
+    option_parser.add_option('-m', '--megabytes', dest = 'megabytes', type='int', default=512,
+                             help = 'size of the generated text file in MiB.')
+    option_parser.add_option('-r', '--repetitions', dest = 'repetitions', type='int', default=3,
+                             help = 'number of timed runs of each configuration; the fastest is reported.')
+    option_parser.add_option('-s', '--seed', dest = 'seed', type='int', default=275,
+                             help = 'random seed for the text generator.')
+    options, args = option_parser.parse_args(sys.argv[1:])
+    if len(args) != 1:
+        option_parser.print_usage()
+        sys.exit(1)
+    tooldir = args[0]
+    datafile = os.path.join(options.datafile_dir, "zerocopyout.txt")
+    outfile = os.path.join(options.datafile_dir, "zerocopyout.out")
+    generate_sized_text(datafile, options.megabytes, options.seed, words[:8] + unicode_words)
+    print("%s: %d bytes" % (datafile, os.path.getsize(datafile)))
+    configurations = [("u8u16 | pipe", "u8u16", None),
+                      ("u8u16 > file", "u8u16", outfile),
+                      ("base64 | pipe", "base64", None)]
+    failures = 0
+    for (name, tool, out) in configurations:
+        tool = os.path.join(tooldir, tool)
+        (copied, copiedOutputs, size) = best_output(tool, ["-zero-copy-output=0"], datafile, out, options.repetitions)
+        zeroCopyFlags = ["-zero-copy-output=1"] + (["-splice-pipe-output=1"] if out is None else [])
+        (zeroCopy, zeroCopyOutputs, size) = best_output(tool, zeroCopyFlags, datafile, out, options.repetitions)
+        status = "ok"
+        if len(copiedOutputs | zeroCopyOutputs) != 1:
+            status = "FAIL (outputs differ)"
+            failures += 1
+        print("%-16s write %7.3fs %6.0f MB/s   zero-copy %7.3fs %6.0f MB/s   %5.2fx  %s" %
+              (name, copied, size / copied / 1e6, zeroCopy, size / zeroCopy / 1e6, copied / zeroCopy, status))
+    os.remove(datafile)
+    sys.exit(1 if failures > 0 else 0)
@@ -12,6 +12,10 @@
 #include <vector>
 #include <sstream>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <boost/filesystem.hpp>
 #include <re/cc/multiplex_CCs.h>
@@ -19,13 +23,18 @@
 #include <kernel/core/callback.h>
 #include <kernel/util/linebreak_kernel.h>
 #include <grep/grep_kernel.h>
+#include <grep/literal_set.h>
+#include <grep/match_spans.h>
 
 namespace re { class CC; }
 namespace re { class RE; }
 namespace llvm { namespace cl { class OptionCategory; } }
+namespace llvm { class raw_ostream; }
 namespace kernel { class ProgramBuilder; }
+namespace kernel { class PipelineBuilder; }
 namespace kernel { class StreamSet; }
 class BaseDriver;
+struct iovec;
 
 
 namespace grep {
@@ -42,12 +51,28 @@ enum GrepSignal : unsigned {BinaryFile};
 
 class GrepCallBackObject : public kernel::SignallingObject {
 public:
-    GrepCallBackObject() : SignallingObject(), mBinaryFile(false) {}
+    GrepCallBackObject() : SignallingObject(), mBinaryFile(false), mLiteralSet(nullptr), mRecordPatternIds(false) {}
     virtual ~GrepCallBackObject() {}
     virtual void handle_signal(unsigned signal);
     bool binaryFileSignalled() {return mBinaryFile;}
+    // The literals searched for by a LiteralSetKernel, if any.
+    void setLiteralSet(const LiteralSet * literals) {mLiteralSet = literals;}
+    const LiteralSet * getLiteralSet() const {return mLiteralSet;}
+    // Pattern ids: the matched lines of each of patternCount regular expressions are
+    // counted and, if recordIds is set, the ids of the regular expressions matching
+    // each matched line are queued in line order, for retrieval by nextPatternIds.
+    void setPatternCount(const unsigned patternCount, const bool recordIds);
+    bool recordsPatternIds() const {return mRecordPatternIds;}
+    const std::vector<uint64_t> & getPatternCounts() const {return mPatternCounts;}
+    void accumulate_pattern_ids(const uint64_t * lineEnds, const uint64_t * patternLines, const size_t count, const unsigned wordsPerBlock, const unsigned patternCount);
+    bool nextPatternIds(std::vector<unsigned> & ids);
 private:
     bool mBinaryFile;
+    const LiteralSet * mLiteralSet;
+    bool mRecordPatternIds;
+    std::vector<uint64_t> mPatternCounts;
+    std::mutex mPatternIdsLock;
+    std::deque<std::vector<unsigned>> mPatternIds;
 };
 
 class MatchAccumulator : public GrepCallBackObject {
@@ -59,6 +84,14 @@ public:
     virtual unsigned getFileCount() {return 1;}  // default: return 1 for single file
     virtual size_t getFileStartPos(unsigned fileNo) {return 0;}
     virtual void setBatchLineNumber(unsigned fileNo, size_t batchLine) {}  // default: no op
+    // With byte offsets, the offset of the line start is set before each match is reported.
+    virtual void setLineOffset(const size_t offset) {}  // default: no op
+    // Matches reported in batches (for -o) are written as records of line number,
+    // line start, match end and line offset to the array returned by getSpanBatch.
+    virtual size_t * getSpanBatch(const size_t count);
+    virtual void accumulate_spans(const size_t count, char * buffer_limit) {}  // default: no op
+protected:
+    std::vector<size_t> mSpanBatch;
 };
 
 extern "C" void accumulate_match_wrapper(intptr_t accum_addr, const size_t lineNum, char * line_start, char * line_end);
@@ -71,9 +104,40 @@ extern "C" size_t get_file_start_pos_wrapper(intptr_t accum_addr, unsigned fileN
 
 extern "C" void set_batch_line_number_wrapper(intptr_t accum_addr, unsigned fileNo, size_t batchLine);
 
+extern "C" void set_line_offset_wrapper(intptr_t accum_addr, size_t offset);
+
+extern "C" size_t * get_span_batch_wrapper(intptr_t accum_addr, size_t count);
+
+extern "C" void accumulate_spans_wrapper(intptr_t accum_addr, size_t count, char * buffer_limit);
+
+extern "C" void accumulate_pattern_ids_wrapper(intptr_t callback_addr, const uint64_t * lineEnds, const uint64_t * patternLines, size_t count, unsigned wordsPerBlock, unsigned patternCount, uint64_t * reported);
+
+extern "C" void mark_literals_wrapper(intptr_t callback_addr, const char * bytes, const uint16_t * hashes, size_t count, size_t avail, uint64_t * marks);
+
+
+//
+// A ResultBuffer collects the output of one group of files.   Output is kept in
+// fixed size chunks that are written out in place (see GrepEngine::writeResults),
+// so the buffer never needs to be reallocated or copied into a string.
+class ResultBuffer : public std::streambuf {
+public:
+    ResultBuffer() : mCurrent(0) {}
+    size_t size() const;
+    // Discard any output after the first n bytes.
+    void truncate(size_t n);
+    // Discard all output, retaining at most one chunk for reuse.
+    void clear();
+    void appendTo(std::vector<struct iovec> & iov) const;
+protected:
+    int_type overflow(int_type c) override;
+private:
+    static const size_t ChunkSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> mChunks;
+    unsigned mCurrent;
+};
 
 class GrepEngine {
-    enum class FileStatus {Pending, GrepComplete, PrintComplete};
+    enum class FileStatus {Pending, Claimed, GrepComplete, PrintComplete};
     friend class InternalSearchEngine;
     friend class InternalMultiSearchEngine;
 public:
@@ -96,10 +160,16 @@ public:
     void setMaxCount(int m) {mMaxCount = m;}
     void setGrepStdIn(bool b = true) {mGrepStdIn = b;}
     void setInvertMatches(bool b = true) {mInvertMatches = b;}
+    void setOnlyMatching(bool b = true) {mOnlyMatching = b;}
+    void setByteOffsets(bool b = true) {mByteOffsets = b;}
+    void setUnixByteOffsets(bool b = true) {mUnixByteOffsets = b;}
     void setCaseInsensitive(bool b = true)  {mCaseInsensitive = b;}
+    // Report the regular expressions matching each line (or the matched line counts of each).
+    void setPatternIds(bool b = true) {mPatternIds = b;}
 
     void suppressFileMessages(bool b = true) {mSuppressFileMessages = b;}
     void setBinaryFilesOption(argv::BinaryFilesMode mode) {mBinaryFilesMode = mode;}
+    void setOutputStream(llvm::raw_ostream & out);
     void setRecordBreak(GrepRecordBreakKind b);
     void initFileResult(const std::vector<boost::filesystem::path> & filenames);
     bool haveFileBatch();
@@ -107,7 +177,7 @@ public:
     virtual void grepCodeGen();
     bool searchAllFiles();
     void * DoGrepThreadMethod();
-    virtual void showResult(uint64_t grepResult, const std::string & fileName, std::ostringstream & strm);
+    virtual void showResult(uint64_t grepResult, const std::string & fileName, std::ostream & strm);
 
 protected:
     // Functional components that may be required for grep searches,
@@ -128,7 +198,7 @@ protected:
     bool matchesToEOLrequired();
 
     // Transpose to basis bit streams, if required otherwise return the source byte stream.
-    kernel::StreamSet * getBasis(const std::unique_ptr<kernel::ProgramBuilder> &P, kernel::StreamSet * ByteStream);
+    kernel::StreamSet * getBasis(kernel::PipelineBuilder & P, kernel::StreamSet * ByteStream);
 
     // Initial grep set-up.
     // Implement any required checking/processing of null characters, determine the
@@ -136,12 +206,41 @@ protected:
     void grepPrologue(const std::unique_ptr<kernel::ProgramBuilder> &P, kernel::StreamSet * SourceStream);
     // Prepare external property and GCB streams, if required.
     void prepareExternalStreams(const std::unique_ptr<kernel::ProgramBuilder> & P, kernel::StreamSet * SourceStream);
-    void addExternalStreams(const std::unique_ptr<kernel::ProgramBuilder> & P, std::unique_ptr<kernel::GrepKernelOptions> & options, re::RE * regexp, kernel::StreamSet * indexMask = nullptr);
-    void U8indexedGrep(const std::unique_ptr<kernel::ProgramBuilder> &P, re::RE * re, kernel::StreamSet * Source, kernel::StreamSet * Results);
+    void preparePropertyStreams(kernel::PipelineBuilder & P, kernel::StreamSet * SourceStream);
+    // Compute the property streams and the U8 index in an optimization branch, using
+    // their ASCII subsets for segments of pure ASCII text.
+    void prepareASCIIBranchedStreams(const std::unique_ptr<kernel::ProgramBuilder> & P, kernel::StreamSet * SourceStream);
+    void propertyKernelCall(kernel::PipelineBuilder & P, re::Name * name, kernel::StreamSet * SourceStream, kernel::StreamSet * property);
+    void addExternalStreams(kernel::PipelineBuilder & P, std::unique_ptr<kernel::GrepKernelOptions> & options, re::RE * regexp, kernel::StreamSet * indexMask = nullptr);
+    void U8indexedGrep(kernel::PipelineBuilder & P, re::RE * re, kernel::StreamSet * Source, kernel::StreamSet * Results);
     void UnicodeIndexedGrep(const std::unique_ptr<kernel::ProgramBuilder> &P, re::RE * re, kernel::StreamSet * Source, kernel::StreamSet * Results);
+    // Search only the lines containing the required literal, bypassing transposition and the
+    // regular expression search for segments without any.   Requires the grep prologue on bytes.
+    kernel::StreamSet * requiredLiteralGrep(const std::unique_ptr<kernel::ProgramBuilder> &P, kernel::StreamSet * ByteStream, const unsigned resultStreamCount);
+    // Mark the start of each occurrence of a literal of mLiteralSet.
+    kernel::StreamSet * literalSetGrep(const std::unique_ptr<kernel::ProgramBuilder> &P, kernel::StreamSet * ByteStream, kernel::StreamSet * BasisBits);
+    // Report the pattern ids of the matched lines, given the match results of each regular
+    // expression; returns the matched line ends, to be consumed after the report.
+    kernel::StreamSet * patternIdsReport(const std::unique_ptr<kernel::ProgramBuilder> &P, const std::vector<kernel::StreamSet *> & MatchResultsBufs, kernel::StreamSet * MatchedLineEnds);
     kernel::StreamSet * grepPipeline(const std::unique_ptr<kernel::ProgramBuilder> &P, kernel::StreamSet * ByteStream);
-    virtual uint64_t doGrep(const std::vector<std::string> & fileNames, std::ostringstream & strm);
-    int32_t openFile(const std::string & fileName, std::ostringstream & msgstrm);
+    virtual uint64_t doGrep(const std::vector<std::string> & fileNames, ResultBuffer & results, const bool largeFile = false);
+    // Compile the main method for single files, with a pipeline of numOfThreads segment threads.
+    virtual void * compileMainMethod(const unsigned numOfThreads);
+    // With -autotune, choose the segment size and buffer segments by timing the count pipeline
+    // on a prefix of the first regular input file, unless a choice for this host is cached.
+    void tuneSegmentSize();
+    bool haveLargeFile();
+    // Key identifying a compiled grep program in the object cache: the canonical form of the
+    // regular expressions plus every engine and grep option that affects code generation.
+    std::string makeProgramCacheKey(const std::string & programName);
+    int32_t openFile(const std::string & fileName, std::ostream & msgstrm);
+
+    // Size-ordered, work-stealing scheduling of file groups with in-order output.
+    void scheduleFileGroups(const std::vector<uintmax_t> & groupSizes);
+    unsigned claimFileGroup(const unsigned worker);
+    void completeFileGroup(const unsigned fileIdx);
+    unsigned segmentThreadsOf(const unsigned fileIdx) const;
+    void writeResults(const std::vector<const ResultBuffer *> & results);
 
     std::string linePrefix(std::string fileName);
 
@@ -160,19 +259,43 @@ protected:
     bool mInitialTab;
     bool mCaseInsensitive;
     bool mInvertMatches;
+    bool mOnlyMatching;
+    bool mByteOffsets;
+    bool mUnixByteOffsets;
+    bool mPatternIds;
     int mMaxCount;
     bool mGrepStdIn;
     NullCharMode mNullMode;
     BaseDriver & mGrepDriver;
     void * mMainMethod;
     void * mBatchMethod;
+    void * mLargeFileMethod;
+    unsigned mLargeFileThreads;
+    llvm::raw_ostream * mOutputStream;
+    int mOutputFD;
 
-    std::atomic<unsigned> mNextFileToGrep;
+    std::atomic<unsigned> mNextWorker;
     std::atomic<unsigned> mNextFileToPrint;
     std::vector<boost::filesystem::path> mInputPaths;
     std::vector<std::vector<std::string>> mFileGroups;
-    std::vector<std::ostringstream> mResultStrs;
+    std::vector<bool> mLargeFileGroup;
+    // Results of file groups that have not yet been written, indexed by group number.
+    std::vector<std::unique_ptr<ResultBuffer>> mResults;
     std::vector<FileStatus> mFileStatus;
+    // The task thread each file group was dealt to, in decreasing order of size, and
+    // the size of each group.   Threads claim groups only within the reorder window
+    // of mOutputWindow groups starting at mNextFileToPrint.
+    std::vector<unsigned> mGroupOwner;
+    std::vector<uintmax_t> mGroupSizes;
+    unsigned mOutputWindow;
+    unsigned mGroupsClaimed;
+    // The segment threads of the pipelines being run by the task threads, which may
+    // not exceed mThreadBudget.   Guarded by mScheduleLock.
+    unsigned mThreadsInUse;
+    unsigned mThreadBudget;
+    std::mutex mScheduleLock;
+    std::condition_variable mScheduleCV;
+    bool mPrinting;
     bool grepMatchFound;
     GrepRecordBreakKind mGrepRecordBreak;
 
@@ -181,6 +304,13 @@ protected:
     re::CC * mBreakCC;
     re::RE * mPrefixRE;
     re::RE * mSuffixRE;
+    // A byte sequence (as UTF-8 byte classes) that every match must contain, if the
+    // required literal prefilter applies; empty otherwise.
+    std::vector<re::CC *> mRequiredLiteral;
+    // Whether property streams and the U8 index are computed in an ASCII fast path branch.
+    bool mASCIIBranch;
+    // The literals searched for, if all regular expressions are literals and there are many.
+    std::unique_ptr<LiteralSet> mLiteralSet;
     std::string mFileSuffix;
     Component mExternalComponents;
     Component mInternalComponents;
@@ -209,12 +339,24 @@ public:
         mCurrentFile(0),
         mLineCount(0),
         mLineNum(0),
-        mTerminated(true) {}
+        mTerminated(true),
+        mShowByteOffsets(false),
+        mLineOffset(0),
+        mColorSpans(false),
+        mMaxLineCount(0),
+        mPendingLineNum(0),
+        mPendingLineStart(nullptr),
+        mPendingLineOffset(0) {}
     void prepareBatch (const std::vector<std::string> & fileNames);
+    // Write each match span on a line of its own (-o), rather than the matched lines.
+    void setOnlyMatching(const std::vector<re::RE *> & REs, const re::CC * breakCC, bool coloring, int maxCount);
+    void showByteOffsets(bool b = true) {mShowByteOffsets = b;}
+    void setLineOffset(const size_t offset) override;
     void accumulate_match(const size_t lineNum, char * line_start, char * line_end) override;
+    void accumulate_spans(const size_t count, char * buffer_limit) override;
     void finalize_match(char * buffer_end) override;
     void setFileLabel(std::string fileLabel);
-    void setStringStream(std::ostringstream * s);
+    void setStringStream(std::ostream * s);
     unsigned getFileCount() override;
     size_t getFileStartPos(unsigned fileNo) override;
     void setBatchLineNumber(unsigned fileNo, size_t batchLine) override;
@@ -235,8 +377,22 @@ protected:
     std::vector<size_t> mFileStartPositions;
     std::vector<size_t> mFileStartLineNumbers;
     std::string mLinePrefix;
-    std::ostringstream * mResultStr;
+    std::ostream * mResultStr;
     char * mBatchBuffer;
+private:
+    void emitPendingSpans(char * buffer_limit);
+    bool mShowByteOffsets;
+    size_t mLineOffset;
+    std::unique_ptr<MatchSpanFinder> mSpanFinder;
+    bool mColorSpans;
+    size_t mMaxLineCount;
+    // The match ends of the most recent line reported.   Its remaining matches may
+    // be reported with the next batch.
+    size_t mPendingLineNum;
+    char * mPendingLineStart;
+    size_t mPendingLineOffset;
+    std::vector<char *> mPendingEnds;
+    std::vector<MatchSpanFinder::Span> mSpans;
 };
 
 class EmitMatchesEngine final : public GrepEngine {
@@ -245,21 +401,22 @@ public:
     void grepPipeline(const std::unique_ptr<kernel::ProgramBuilder> &P, kernel::StreamSet * ByteStream, bool BatchMode = false);
     void grepCodeGen() override;
 private:
-    uint64_t doGrep(const std::vector<std::string> & fileNames, std::ostringstream & strm) override;
+    void * compileMainMethod(const unsigned numOfThreads) override;
+    uint64_t doGrep(const std::vector<std::string> & fileNames, ResultBuffer & results, const bool largeFile) override;
 };
 
 class CountOnlyEngine final : public GrepEngine {
 public:
     CountOnlyEngine(BaseDriver & driver);
 private:
-    void showResult(uint64_t grepResult, const std::string & fileName, std::ostringstream & strm) override;
+    void showResult(uint64_t grepResult, const std::string & fileName, std::ostream & strm) override;
 };
 
 class MatchOnlyEngine final : public GrepEngine {
 public:
     MatchOnlyEngine(BaseDriver & driver, bool showFilesWithoutMatch, bool useNullSeparators);
 private:
-    void showResult(uint64_t grepResult, const std::string & fileName, std::ostringstream & strm) override;
+    void showResult(uint64_t grepResult, const std::string & fileName, std::ostream & strm) override;
     unsigned mRequiredCount;
 };
 
@@ -134,6 +134,82 @@ private:
     const unsigned          mAfterContext;
 };
 
+/* Given the end positions of the occurrences of a literal that every match of a
+   regular expression must contain, mark the positions that a search for the
+   expression must examine: each line containing the literal, including its line
+   break and the line break that precedes it.   Positions up to window positions
+   before an occurrence are found by lookahead; further back, every position from
+   which no line break is found within the window is marked as well, so that long
+   lines are searched in full.   Segments with no marks need not be searched. */
+
+class RequiredLiteralLinesKernel final : public pablo::PabloKernel {
+public:
+    RequiredLiteralLinesKernel(BuilderRef b, StreamSet * const LiteralEnds, StreamSet * const LineBreakStream, StreamSet * const CandidateLines, unsigned window);
+protected:
+    void generatePabloMethod() override;
+private:
+    const unsigned          mWindow;
+};
+
+/* Produce empty match results, for the portions of the input that need not be searched. */
+
+class NoMatchesKernel final : public pablo::PabloKernel {
+public:
+    NoMatchesKernel(BuilderRef b, StreamSet * const LineBreakStream, StreamSet * const Matches);
+protected:
+    void generatePabloMethod() override;
+};
+
+/* Mark the non-ASCII bytes of UTF-8 text, together with the three positions
+   following each.   A UTF-8 sequence spans at most four bytes, so the kernels
+   that compute Unicode properties and the UTF-8 index carry no state from a
+   non-ASCII byte past the marked positions: segments without marks may be
+   processed with the ASCII subsets of those computations. */
+
+class NonASCIIRegionKernel final : public pablo::PabloKernel {
+public:
+    NonASCIIRegionKernel(BuilderRef b, StreamSet * const Source, StreamSet * const NonASCIIRegion);
+protected:
+    void generatePabloMethod() override;
+};
+
+/* Mark the start of each occurrence of a literal of the grep::LiteralSet of the
+   callback object, by passing the bytes and window hashes of each segment to
+   mark_literals_wrapper.   The window hashes are those of a WindowHash kernel,
+   as 16-bit values; lookahead covers the longest literal. */
+
+class LiteralSetKernel final : public MultiBlockKernel {
+public:
+    LiteralSetKernel(BuilderRef b, StreamSet * const ByteStream, StreamSet * const WindowHashes, StreamSet * const Marks,
+                     Scalar * const callbackObject, unsigned windowLength, unsigned maxLength);
+private:
+    void generateMultiBlockLogic(BuilderRef b, llvm::Value * const numOfStrides) override;
+};
+
+/* For each of a set of match streams (one per regular expression), mark the line
+   ends of the lines with matches: stream i of PatternLines marks the lines matched
+   by the i-th regular expression. */
+
+class PatternLinesKernel final : public pablo::PabloKernel {
+public:
+    PatternLinesKernel(BuilderRef b, const std::vector<StreamSet *> & PatternMatches, StreamSet * LineBreakStream, StreamSet * PatternLines);
+protected:
+    void generatePabloMethod() override;
+};
+
+/* Report the regular expressions matching each of the matched lines, by passing
+   the matched line ends and the PatternLines streams of each segment to
+   accumulate_pattern_ids_wrapper.   The matched line ends are copied to
+   ReportedLineEnds, so that kernels consuming them run after the report. */
+
+class PatternIdsKernel final : public MultiBlockKernel {
+public:
+    PatternIdsKernel(BuilderRef b, StreamSet * const MatchedLineEnds, StreamSet * const PatternLines, StreamSet * const ReportedLineEnds,
+                     Scalar * const callbackObject);
+private:
+    void generateMultiBlockLogic(BuilderRef b, llvm::Value * const numOfStrides) override;
+};
+
 void GraphemeClusterLogic(const std::unique_ptr<ProgramBuilder> & P,
                           re::UTF8_Transformer * t,
                           StreamSet * Source, StreamSet * U8index, StreamSet * GCBstream);
@@ -12,6 +12,9 @@ extern bool MultithreadedSimpleRE;
 extern int ScanMatchBlocks;
 extern int MatchCoordinateBlocks;
 extern unsigned ByteCClimit;
+extern bool RequiredLiteralPrefilter;
+extern bool ASCIIFastPath;
+extern unsigned LiteralSetThreshold;
 extern bool TraceFiles;
 
 }
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ */
+#ifndef LITERAL_SET_H
+#define LITERAL_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace grep {
+
+//
+// A LiteralSet supports searching for any of a large set of literal strings,
+// such as the fixed strings of a -f file with many thousands of entries.
+//
+// Candidate positions are found by hashing the window of bytes that begins
+// at each position.   The window hashes are computed for the whole input by a
+// bitstream kernel (kernel::WindowHash); a table of the hash values of the
+// literals' initial windows filters the positions, and a second, independent
+// hash of the window filters them again.   Only the literals with the same
+// window hash as a remaining position are compared with the input.   The
+// cost per position thus depends on the fraction of hash values in use
+// rather than on the number of literals.
+//
+class LiteralSet {
+public:
+    static const unsigned HashBits = 16;
+
+    // The literals are UTF-8 strings, none of which may be empty.
+    LiteralSet(std::vector<std::string> literals);
+
+    // The window is the power of 2 number of bytes (at most 8, and at most the
+    // length of the shortest literal) hashed at each position.
+    unsigned getWindowSteps() const {return mWindowSteps;}
+    unsigned getWindowLength() const {return 1 << mWindowSteps;}
+    unsigned getMaxLength() const {return mMaxLength;}
+    size_t size() const {return mLiterals.size();}
+
+    // Mark the start position of each occurrence of a literal among the count positions
+    // beginning at bytes.   The hash of the window ending at bytes[i] is hashes[i];
+    // avail bytes and hashes may be accessed.   The marks are written as a bit stream
+    // of 64-bit words, covering count positions rounded up to a whole word.
+    void markOccurrences(const char * bytes, const uint16_t * hashes, const size_t count, const size_t avail, uint64_t * marks) const;
+
+private:
+    static uint64_t windowBits(const char * window, const unsigned lgth);
+    unsigned secondaryHash(const char * window) const;
+
+    std::vector<std::string> mLiterals;
+    unsigned mWindowSteps;
+    unsigned mMaxLength;
+    // One bit for each window hash value of a literal.
+    std::vector<uint64_t> mHashFilter;
+    // One bit for each secondary hash value of a literal window.
+    std::vector<uint64_t> mSecondaryFilter;
+    // The literals in order of window hash; those with window hash h are
+    // mOrder[mBucketStart[h]] to mOrder[mBucketStart[h + 1] - 1].
+    std::vector<uint32_t> mBucketStart;
+    std::vector<uint32_t> mOrder;
+};
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ */
+#ifndef MATCH_SPANS_H
+#define MATCH_SPANS_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <unicode/core/UCD_Config.h>
+
+namespace re { class RE; class CC; }
+
+namespace grep {
+
+//
+// The grep kernels find the end position of every match of the regular
+// expressions.   A MatchSpanFinder determines, from the ends found within a
+// line, the spans of the matches to be reported by -o: the leftmost-longest
+// matches that do not overlap one another.   Empty matches are not reported.
+//
+// If all expressions match strings of one fixed length, each span is found by
+// stepping back that many code points from a match end.   Otherwise, a single
+// reverse pass of the expressions from the match ends finds, for every position
+// of the line, the furthest match end of a match starting there; the spans are
+// then taken from left to right.   No position other than a match end is ever
+// taken as the end of a match.   The pass interprets the expressions over the
+// code points of the line in time linear in its length, except that a repetition
+// of anything other than a character class takes one scan of the line for each
+// iteration needed to reach its longest match.
+//
+// Variable length expressions outside the subset the pass can follow
+// (back-references and grapheme cluster modes) are not supported.
+//
+class MatchSpanFinder {
+public:
+    using Span = std::pair<char *, char *>;
+
+    MatchSpanFinder(const std::vector<re::RE *> & REs, const re::CC * breakCC);
+
+    // Whether the spans of the regular expressions can be found: they either all
+    // have the same fixed length or are within the subset the reverse pass can
+    // follow (back-references and grapheme cluster modes are not).
+    bool isSupported() const;
+
+    // Append the spans of the matches within the line beginning at lineStart to spans.
+    // The match ends must lie within the line, in increasing order, and the line
+    // must not extend past bufferLimit.
+    void findSpans(char * lineStart, char * bufferLimit, const std::vector<char *> & matchEnds, std::vector<Span> & spans);
+
+private:
+    using Markers = std::vector<int>;
+    static constexpr int NotReached = -1;
+    static bool anyReached(const Markers & markers);
+    bool supported(const re::RE * re) const;
+    bool isCharacterClass(const re::RE * re) const;
+    bool matchesCodepoint(const re::RE * re, const UCD::codepoint_t cp) const;
+    UCD::codepoint_t codepointAt(const int pos) const;
+    Markers advance(const re::RE * re, const Markers & markers, const bool reverse = false) const;
+    Markers filterAssertion(const re::RE * re, const Markers & markers) const;
+    void findFixedLengthSpans(char * lineStart, const std::vector<char *> & matchEnds, std::vector<Span> & spans) const;
+    void findVariableLengthSpans(char * lineStart, char * bufferLimit, const std::vector<char *> & matchEnds, std::vector<Span> & spans);
+    void decodeLine(char * lineStart, char * limit);
+
+    const std::vector<re::RE *> mREs;
+    const re::CC * const mBreakCC;
+    UCD::codepoint_t mBreakCodepoint;
+    // The length every match has; -1 if the reverse pass finds the spans.
+    int mFixedLength;
+    // The code points of the current line and the byte offset of each within the line.
+    std::vector<UCD::codepoint_t> mText;
+    std::vector<size_t> mOffsets;
+};
+
+}
+
+#endif
@@ -21,9 +21,9 @@ public:
     : IDISA_Builder(C, AVX_width, vectorWidth, laneWidth)
     , IDISA_SSE2_Builder(C, vectorWidth, laneWidth)
     {
-        llvm::StringMap<bool> features;
-        hasBMI1 = llvm::sys::getHostCPUFeatures(features) && features.lookup("bmi");
-        hasBMI2 = llvm::sys::getHostCPUFeatures(features) && features.lookup("bmi2");
+        const auto & features = codegen::getTargetCPUFeatures();
+        hasBMI1 = features.lookup("bmi");
+        hasBMI2 = features.lookup("bmi2");
     }
 
     virtual std::string getBuilderUniqueName() override;
@@ -15,6 +15,7 @@ namespace llvm { class Value; }
 
 namespace kernel {
 
+class PipelineBuilder;
     
 class S2PKernel final : public MultiBlockKernel {
 public:
@@ -37,6 +38,10 @@ void Staged_S2P(const std::unique_ptr<ProgramBuilder> & P,
                 StreamSet * codeUnitStream, StreamSet * BasisBits,
                 bool completionFromQuads = false);
 
+void Staged_S2P(PipelineBuilder & P,
+                StreamSet * codeUnitStream, StreamSet * BasisBits,
+                bool completionFromQuads = false);
+
 
 class S2P_21Kernel final : public MultiBlockKernel {
 public:
@@ -267,6 +267,14 @@ struct Attribute {
 
         // This kernel is infrequently used and should be compiled with O1 instead of O3.
 
+        BlockingSynchronization,
+
+        // Marks that the threads of this pipeline kernel, when waiting to acquire the
+        // segment lock of an inner kernel, should spin for a short (adaptive) period
+        // and then sleep until the lock is released rather than spinning indefinitely.
+        // This costs a little latency per wait but frees the core when the threads
+        // outnumber the available cores.
+
         /** COUNT **/
 
         __Count
@@ -487,6 +495,10 @@ inline Attribute InfrequentlyUsed() {
     return Attribute(Attribute::KindId::InfrequentlyUsed, 0);
 }
 
+inline Attribute BlockingSynchronization() {
+    return Attribute(Attribute::KindId::BlockingSynchronization, 0);
+}
+
 inline Attribute RequiresPopCountArray() {
     return Attribute(Attribute::KindId::RequiresPopCountArray, 0);
 }
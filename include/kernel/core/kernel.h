@@ -24,6 +24,7 @@ namespace llvm { class IndirectBrInst; }
 namespace llvm { class PHINode; }
 
 class BaseDriver;
+class CPUDriver;
 
 namespace kernel {
 
@@ -40,6 +41,7 @@ class Kernel : public AttributeSet {
     friend class OptimizationBranchCompiler;
     friend class OptimizationBranch;
     friend class BaseDriver;
+    friend class ::CPUDriver;
 public:
 
     using BuilderRef = const std::unique_ptr<KernelBuilder> &;
@@ -214,6 +216,22 @@ public:
         return mThreadLocalStateType  != nullptr;
     }
 
+    // Whether this kernel has Rearm, FinalizeRun and Release methods that permit one instance to
+    // process several inputs without releasing its internal stream sets between them. A family
+    // kernel has them so that a reusable pipeline can keep its instance between runs.
+    LLVM_READNONE virtual bool hasReusableInstance() const {
+        return hasFamilyName() && isStateful();
+    }
+
+    // Whether the pipeline may replace this kernel and any adjacent kernels of the same kind by a single
+    // kernel made with makeFusedKernel (see -kernel-fusion). A fusable kernel must only have FixedRate(1)
+    // stream set inputs and outputs without attributes.
+    LLVM_READNONE virtual bool isFusable() const {
+        return false;
+    }
+
+    virtual Kernel * makeFusedKernel(BuilderRef b, std::vector<Kernel *> && kernels, Bindings && inputs, Bindings && outputs) const;
+
     virtual bool requiresExplicitPartialFinalStride() const;
 
     unsigned getStride() const { return mStride; }
@@ -404,14 +422,30 @@ protected:
 
     llvm::Function * addFinalizeDeclaration(BuilderRef b) const;
 
+    llvm::Function * getRearmFunction(BuilderRef b, const bool alwayReturnDeclaration = true) const;
+
+    llvm::Function * addRearmDeclaration(BuilderRef b) const;
+
+    llvm::Function * getFinalizeRunFunction(BuilderRef b, const bool alwayReturnDeclaration = true) const;
+
+    llvm::Function * addFinalizeRunDeclaration(BuilderRef b) const;
+
+    llvm::Function * getReleaseFunction(BuilderRef b, const bool alwayReturnDeclaration = true) const;
+
+    llvm::Function * addReleaseDeclaration(BuilderRef b) const;
+
     virtual void runOptimizationPasses(BuilderRef b) const;
 
 public:
 
     llvm::Function * addOrDeclareMainFunction(BuilderRef b, const MainMethodGenerationType method) const;
 
+    void addInstanceFunctions(BuilderRef b, const MainMethodGenerationType method) const;
+
 protected:
 
+    void callDoSegmentOnce(BuilderRef b, llvm::Function * const caller, llvm::Value * const sharedHandle, llvm::Value * const threadLocalHandle, llvm::ArrayRef<llvm::Value *> segmentArgs) const;
+
     llvm::Value * constructFamilyKernels(BuilderRef b, InitArgs & hostArgs, const ParamMap & params) const;
 
     virtual void addFamilyInitializationArgTypes(BuilderRef b, InitArgTypes & argTypes) const;
@@ -462,6 +496,12 @@ protected:
 
     virtual void generateFinalizeMethod(BuilderRef) { }
 
+    virtual void generateRearmMethod(BuilderRef b) { generateInitializeMethod(b); }
+
+    virtual void generateFinalizeRunMethod(BuilderRef b) { generateFinalizeMethod(b); }
+
+    virtual void generateReleaseMethod(BuilderRef) { }
+
 protected:
 
     // Constructor
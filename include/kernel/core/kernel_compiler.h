@@ -359,7 +359,7 @@ protected:
 
 public:
 
-    void callGenerateInitializeMethod(BuilderRef b);
+    void callGenerateInitializeMethod(BuilderRef b, const bool rearm = false);
 
     virtual void bindFamilyInitializationArguments(BuilderRef b, ArgIterator & arg, const ArgIterator & arg_end) const;
 
@@ -377,7 +377,9 @@ public:
 
     void callGenerateFinalizeThreadLocalMethod(BuilderRef b);
 
-    void callGenerateFinalizeMethod(BuilderRef b);
+    void callGenerateFinalizeMethod(BuilderRef b, const bool retainInstance = false);
+
+    void callGenerateReleaseMethod(BuilderRef b);
 
 protected:
 
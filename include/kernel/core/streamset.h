@@ -27,6 +27,7 @@ public:
         ExternalBuffer
         , StaticBuffer
         , DynamicBuffer
+        , MirroredBuffer
     };
 
     using BuilderPtr = PtrWrapper<kernel::KernelBuilder>;
@@ -97,6 +98,9 @@ public:
 
     virtual void releaseBuffer(BuilderPtr b) const = 0;
 
+    // Rewind an allocated buffer so that it can be written from item 0 again without reallocating it.
+    virtual void resetBuffer(BuilderPtr b) const = 0;
+
     // The number of items that cam be linearly accessed from a given logical stream position.
     virtual llvm::Value * getLinearlyAccessibleItems(BuilderPtr b, llvm::Value * fromPosition, llvm::Value * totalItems, llvm::Value * overflowItems = nullptr) const = 0;
 
@@ -179,6 +183,8 @@ public:
 
     void releaseBuffer(BuilderPtr b) const override;
 
+    void resetBuffer(BuilderPtr b) const override;
+
     llvm::Value * getStreamLogicalBasePtr(BuilderPtr b, llvm::Value * baseAddress, llvm::Value * const streamIndex, llvm::Value * blockIndex) const override;
 
     llvm::Value * getLinearlyAccessibleItems(BuilderPtr b, llvm::Value * fromPosition, llvm::Value * totalItems, llvm::Value * overflowItems = nullptr) const override;
@@ -228,9 +234,9 @@ public:
 
     llvm::Value * getRawItemPointer(BuilderPtr b, llvm::Value * streamIndex, llvm::Value * absolutePosition) const final;
 
-    llvm::Value * getLinearlyAccessibleItems(BuilderPtr b, llvm::Value * fromPosition, llvm::Value * const totalItems, llvm::Value * overflowItems = nullptr) const final;
+    llvm::Value * getLinearlyAccessibleItems(BuilderPtr b, llvm::Value * fromPosition, llvm::Value * const totalItems, llvm::Value * overflowItems = nullptr) const override;
 
-    llvm::Value * getLinearlyWritableItems(BuilderPtr b, llvm::Value * const fromPosition, llvm::Value * const consumedItems, llvm::Value * overflowItems = nullptr) const final;
+    llvm::Value * getLinearlyWritableItems(BuilderPtr b, llvm::Value * const fromPosition, llvm::Value * const consumedItems, llvm::Value * overflowItems = nullptr) const override;
 
 protected:
 
@@ -257,6 +263,8 @@ public:
 
     void releaseBuffer(BuilderPtr b) const override;
 
+    void resetBuffer(BuilderPtr b) const override;
+
     llvm::Type * getHandleType(BuilderPtr b) const override;
 
     llvm::Value * getBaseAddress(BuilderPtr b) const override;
@@ -289,9 +297,13 @@ private:
 
 };
 
+// A DynamicBuffer is allocated with an anonymous mmap so that, when it must be expanded, it can usually be
+// extended in place with mremap instead of being copied into a new allocation.
+
 class DynamicBuffer final : public InternalBuffer {
 
-    enum Field { BaseAddress, EffectiveCapacity, MallocedAddress, InternalCapacity, PriorAddress };
+    enum Field { BaseAddress, EffectiveCapacity, MallocedAddress, InternalCapacity, PriorAddress, PriorCapacity,
+                 ExpansionCopiedBytes, ExpansionSavedBytes };
 
 public:
 
@@ -307,6 +319,81 @@ public:
 
     void releaseBuffer(BuilderPtr b) const override;
 
+    void resetBuffer(BuilderPtr b) const override;
+
+    llvm::Value * getMallocAddress(BuilderPtr b) const override;
+
+    llvm::Value * getCapacity(BuilderPtr b) const override;
+
+    llvm::Value * getInternalCapacity(BuilderPtr b) const override;
+
+    void setCapacity(BuilderPtr b, llvm::Value * capacity) const override;
+
+    llvm::Value * modByCapacity(BuilderPtr b, llvm::Value * const offset) const final;
+
+    void copyBackLinearOutputBuffer(BuilderPtr b, llvm::Value * consumed) const override;
+
+    void reserveCapacity(BuilderPtr b, llvm::Value * produced, llvm::Value * consumed, llvm::Value * required, llvm::Value * overflowItems = nullptr) const override;
+
+    size_t getInitialCapacity() const {
+        return mInitialCapacity;
+    }
+
+    llvm::Type * getHandleType(BuilderPtr b) const override;
+
+    llvm::Value * getBaseAddress(BuilderPtr b) const override;
+
+    void setBaseAddress(BuilderPtr b, llvm::Value * addr) const override;
+
+    llvm::Value * getOverflowAddress(BuilderPtr b) const override;
+
+    // number of bytes copied (and the number of bytes that did not need to be copied) by the last expansion;
+    // only recorded when tracing dynamic buffers.
+    llvm::Value * getExpansionCopiedBytes(BuilderPtr b) const;
+
+    llvm::Value * getExpansionSavedBytes(BuilderPtr b) const;
+
+    static void linkFunctions(BuilderPtr b);
+
+private:
+
+    llvm::Value * getAllocationSize(BuilderPtr b, llvm::Value * const capacity, llvm::Value * const additionalCapacity) const;
+
+    void recordExpansion(BuilderPtr b, llvm::Value * const handle, llvm::Value * const copied, llvm::Value * const saved) const;
+
+    const size_t    mInitialCapacity;
+
+};
+
+// A MirroredBuffer is a circular buffer whose memory is mapped into the address space several times in a row:
+// once before its base address and twice after it. Since every mapping refers to the same pages, any window
+// of up to its capacity in items is contiguous regardless of where it starts (and the underflow and overflow
+// items preceding and following it are too) so the pipeline never needs to copy data into or out of the
+// under/overflow regions of the buffer. Expanding it maps a larger buffer and copies the unconsumed data once.
+
+class MirroredBuffer final : public InternalBuffer {
+
+    enum Field { BaseAddress, InternalCapacity, PriorAddress, PriorCapacity };
+
+public:
+
+    static inline bool classof(const StreamSetBuffer * b) {
+        return b->getBufferKind() == BufferKind::MirroredBuffer;
+    }
+
+    MirroredBuffer(const unsigned id, BuilderPtr b, llvm::Type * type, const size_t initialCapacity,
+                   const size_t overflowSize, const size_t underflowSize, const unsigned AddressSpace);
+
+    void allocateBuffer(BuilderPtr b, llvm::Value * const capacityMultiplier) override;
+
+    void releaseBuffer(BuilderPtr b) const override;
+
+    void resetBuffer(BuilderPtr b) const override;
+
+    llvm::Value * getLinearlyAccessibleItems(BuilderPtr b, llvm::Value * fromPosition, llvm::Value * const totalItems, llvm::Value * overflowItems = nullptr) const final;
+
+    llvm::Value * getLinearlyWritableItems(BuilderPtr b, llvm::Value * const fromPosition, llvm::Value * const consumedItems, llvm::Value * overflowItems = nullptr) const final;
+
     llvm::Value * getMallocAddress(BuilderPtr b) const override;
 
     llvm::Value * getCapacity(BuilderPtr b) const override;
@@ -333,6 +420,14 @@ public:
 
     llvm::Value * getOverflowAddress(BuilderPtr b) const override;
 
+    static void linkFunctions(BuilderPtr b);
+
+private:
+
+    llvm::Value * mapBuffer(BuilderPtr b, llvm::Value * const capacity) const;
+
+    void unmapBuffer(BuilderPtr b, llvm::Value * const baseAddress, llvm::Value * const capacity) const;
+
 private:
 
     const size_t    mInitialCapacity;
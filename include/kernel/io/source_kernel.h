@@ -46,7 +46,9 @@ public:
     void generateFinalizeMethod(BuilderRef b) override {
         freeBuffer(b);
     }
+    void linkExternalMethods(BuilderRef b) override;
 protected:
+    static void generatLinkExternalFunctions(BuilderRef b);
     static void generateInitializeMethod(const unsigned codeUnitWidth, const unsigned stride, BuilderRef b);
     static void generateDoSegmentMethod(const unsigned codeUnitWidth, const unsigned stride, BuilderRef b);
     static void freeBuffer(BuilderRef b);
@@ -14,8 +14,11 @@ namespace kernel {
 class StdOutKernel final : public SegmentOrientedKernel {
 public:
     StdOutKernel(BuilderRef iBuilder, StreamSet * codeUnitBuffer);
+    void linkExternalMethods(BuilderRef b) override;
 private:
+    void generateInitializeMethod(BuilderRef b) override;
     void generateDoSegmentMethod(BuilderRef b) override;
+    void generateFinalizeMethod(BuilderRef b) override;
 private:
     const unsigned mCodeUnitWidth;
 
@@ -24,6 +27,7 @@ private:
 class FileSink final : public SegmentOrientedKernel {
 public:
     FileSink(BuilderRef iBuilder, Scalar * outputFileName, StreamSet * codeUnitBuffer);
+    void linkExternalMethods(BuilderRef b) override;
 protected:
     void generateInitializeMethod(BuilderRef iBuilder) override;
     void generateDoSegmentMethod(BuilderRef b) override;
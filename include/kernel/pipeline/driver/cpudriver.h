@@ -6,9 +6,14 @@ namespace llvm { class ExecutionEngine; }
 namespace llvm { class TargetMachine; }
 namespace llvm { class raw_fd_ostream; }
 namespace llvm { class ModulePass; }
+namespace llvm { class MemoryBuffer; }
 namespace kernel { class KernelBuilder; }
 
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <mutex>
 
 class CPUDriver final : public BaseDriver {
 public:
@@ -21,14 +26,36 @@ public:
 
     void * finalizeObject(kernel::Kernel * const pipeline) override;
 
+    void * loadCachedProgram(const llvm::StringRef programKey) override;
+
     bool hasExternalFunction(const llvm::StringRef functionName) const override;
 
     llvm::ModulePass * createTracePass(kernel::KernelBuilder * kb, llvm::StringRef to_trace);
 
+    static void linkTieredCompilationLibrary(BuilderRef b);
+
+    struct TieredKernelSlots;
+
 private:
 
+    struct TieredCompilation;
+
     void preparePassManager();
 
+    bool canCompileKernelsInParallel() const;
+
+    void compileKernelObjects(const std::vector<llvm::Module *> & modules, const std::vector<llvm::CodeGenOpt::Level> & levels);
+
+    bool addCompiledKernelObject(llvm::Module * const module);
+
+    bool isTieredKernel(const kernel::Kernel * const kernel) const;
+
+    void compileTierZeroKernel(const kernel::Kernel * const kernel, llvm::Module * const module);
+
+    void mapTieredKernelSlots();
+
+    void recordInstanceMethods(const llvm::StringRef mainName, void * const mainMethod);
+
     llvm::Function * addLinkFunction(llvm::Module * mod, llvm::StringRef name, llvm::FunctionType * type, void * functionPtr) const override;
 
 private:
@@ -39,6 +66,13 @@ private:
     std::unique_ptr<llvm::raw_fd_ostream>                   mASMOutputStream;
     std::unique_ptr<llvm::legacy::PassManager>              mPassManager;
     std::vector<std::pair<llvm::Function *, void *>>        mCachedFunctionMappings;
+    mutable llvm::StringMap<void *>                         mLinkedFunctions;
+    llvm::StringSet<>                                       mLoadedProgramObjects;
+    llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>>    mCompiledKernelObjects;
+    std::unique_ptr<TieredKernelSlots>                      mTieredKernelSlots;
+    std::unique_ptr<TieredCompilation>                      mTieredCompilation;
+    llvm::SmallPtrSet<const kernel::Kernel *, 4>            mDirectlyCalledKernels;
+    std::mutex                                              mEngineLock;
 };
 
 #endif // CPUDRIVER_H
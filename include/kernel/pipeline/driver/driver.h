@@ -7,6 +7,7 @@
 #include <kernel/core/kernel.h>
 #include <kernel/core/relationship.h>
 #include <util/slab_allocator.h>
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
@@ -47,12 +48,36 @@ public:
 
     void addKernel(not_null<Kernel *> kernel);
 
+    // Withdraw a kernel that was replaced before it was generated (e.g., by a fused kernel) so that it is not
+    // compiled. It is destroyed once the program is finalized.
+    void removeKernel(not_null<Kernel *> kernel);
+
     virtual bool hasExternalFunction(const llvm::StringRef functionName) const = 0;
 
     virtual void generateUncachedKernels() = 0;
 
     virtual void * finalizeObject(kernel::Kernel * pipeline) = 0;
 
+    virtual void * loadCachedProgram(const llvm::StringRef programKey);
+
+    // The host entry points of a reusable instance of a compiled program (see Kernel::addInstanceFunctions);
+    // each is null if the program does not provide them and must be run through its main method instead.
+    struct InstanceMethods {
+        void * Create = nullptr;
+        void * Reset = nullptr;
+        void * Run = nullptr;
+        void * Destroy = nullptr;
+    };
+
+    InstanceMethods getInstanceMethods(const void * const mainMethod) const;
+
+    // Set codegen::SegmentSize and codegen::BufferSegments to the values that ran the program with the given key
+    // fastest on this host. Unless a prior choice is recorded in the object cache, each candidate setting is
+    // timed by calling calibrate, which must compile and run the program on a sample of sampleSize bytes of its
+    // input and return the elapsed seconds (or a negative value if it cannot.) A sample too small to fill several
+    // segments of each candidate size is not timed. Returns false if the settings were left unchanged.
+    bool tuneSegmentSize(const llvm::StringRef programKey, const size_t sampleSize, const std::function<double ()> & calibrate);
+
     virtual ~BaseDriver();
 
     llvm::LLVMContext & getContext() const {
@@ -80,6 +105,8 @@ protected:
 
     virtual llvm::Function * addLinkFunction(llvm::Module * mod, llvm::StringRef name, llvm::FunctionType * type, void * functionPtr) const = 0;
 
+    std::string makeProgramCacheKey(const llvm::StringRef programKey) const;
+
 protected:
 
     std::unique_ptr<llvm::LLVMContext>                      mContext;
@@ -88,11 +115,53 @@ protected:
     std::unique_ptr<ParabixObjectCache>                     mObjectCache;
 
     bool                                                    mPreservesKernels = false;
+    std::string                                             mProgramCacheKey;
     KernelSet                                               mUncachedKernel;
     KernelSet                                               mCachedKernel;
     KernelSet                                               mCompiledKernel;
     KernelSet                                               mPreservedKernel;    
     SlabAllocator<>                                         mAllocator;
+    llvm::DenseMap<const void *, InstanceMethods>           mInstanceMethods;
+};
+
+// Runs a compiled program on a sequence of inputs, one call per input. If the program provides instance methods,
+// a single instance is created for the first input and reset for each one after it, so that its kernels and
+// stream sets are constructed once rather than once per input; the instance is destroyed with this object.
+// Otherwise (or if reuse is false) each call goes through the main method of the program.
+template <typename Result, typename... Args>
+class ProgramInstance {
+public:
+
+    using MainMethod = Result (*)(Args...);
+
+    ProgramInstance(const BaseDriver & driver, MainMethod mainMethod, const bool reuse = true)
+    : mMainMethod(mainMethod)
+    , mMethods(reuse ? driver.getInstanceMethods(reinterpret_cast<const void *>(mainMethod)) : BaseDriver::InstanceMethods{}) {
+
+    }
+
+    Result operator()(Args... args) {
+        if (mMethods.Create == nullptr) {
+            return mMainMethod(args...);
+        }
+        if (mInstance == nullptr) {
+            mInstance = reinterpret_cast<void * (*)(Args...)>(mMethods.Create)(args...);
+        } else {
+            reinterpret_cast<void (*)(void *, Args...)>(mMethods.Reset)(mInstance, args...);
+        }
+        return reinterpret_cast<Result (*)(void *)>(mMethods.Run)(mInstance);
+    }
+
+    ~ProgramInstance() {
+        if (mInstance) {
+            reinterpret_cast<void (*)(void *)>(mMethods.Destroy)(mInstance);
+        }
+    }
+
+private:
+    const MainMethod                    mMainMethod;
+    const BaseDriver::InstanceMethods   mMethods;
+    void *                              mInstance = nullptr;
 };
 
 template <typename ExternalFunctionType>
@@ -87,6 +87,12 @@ public:
         mExternallySynchronized = value;
     }
 
+    // Threads waiting on a segment lock sleep after a short spin instead of spinning until
+    // the lock is released; defaults to the -blocking-sync option.
+    void setBlockingSynchronization(const bool value = true) {
+        mBlockingSynchronization = value;
+    }
+
 protected:
 
 
@@ -105,6 +111,7 @@ protected:
     // eventual pipeline configuration
     unsigned            mNumOfThreads;
     bool                mExternallySynchronized = false;
+    bool                mBlockingSynchronization;
     Bindings            mInputStreamSets;
     Bindings            mOutputStreamSets;
     Bindings            mInputScalars;
@@ -129,6 +136,12 @@ public:
         mNumOfThreads = threads;
     }
 
+    // Cache the compiled program under the given key (which must uniquely identify it) so that a later
+    // BaseDriver::loadCachedProgram with the same key can return its main method without rebuilding it.
+    void setProgramCacheKey(std::string key) {
+        mProgramCacheKey = std::move(key);
+    }
+
     ProgramBuilder(BaseDriver & driver,
                    Bindings && stream_inputs, Bindings && stream_outputs,
                    Bindings && scalar_inputs, Bindings && scalar_outputs);
@@ -136,6 +149,10 @@ public:
 private:
 
     void * compileKernel(Kernel * const kernel);
+
+private:
+
+    std::string mProgramCacheKey;
 };
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -18,6 +18,9 @@ const static std::string ALLOCATE_THREAD_LOCAL_INTERNAL_STREAMSETS_FUNCTION_POIN
 const static std::string DO_SEGMENT_FUNCTION_POINTER_SUFFIX = "_SFP";
 const static std::string FINALIZE_THREAD_LOCAL_FUNCTION_POINTER_SUFFIX = "_FTIP";
 const static std::string FINALIZE_FUNCTION_POINTER_SUFFIX = "_FIP";
+const static std::string REARM_FUNCTION_POINTER_SUFFIX = "_RAFP";
+const static std::string FINALIZE_RUN_FUNCTION_POINTER_SUFFIX = "_FRFP";
+const static std::string RELEASE_FUNCTION_POINTER_SUFFIX = "_RLFP";
 
 class PipelineCompiler;
 
@@ -90,6 +93,8 @@ public:
 
     void addKernelDeclarations(BuilderRef b) final;
 
+    LLVM_READNONE bool hasReusableInstance() const final;
+
     std::unique_ptr<KernelCompiler> instantiateKernelCompiler(BuilderRef b) const final;
 
     virtual ~PipelineKernel();
@@ -130,6 +135,12 @@ protected:
 
     void generateFinalizeMethod(BuilderRef b) final;
 
+    void generateRearmMethod(BuilderRef b) final;
+
+    void generateFinalizeRunMethod(BuilderRef b) final;
+
+    void generateReleaseMethod(BuilderRef b) final;
+
     void runOptimizationPasses(BuilderRef b) const final;
 
 protected:
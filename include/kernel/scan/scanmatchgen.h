@@ -27,13 +27,19 @@ private:
     void generateMultiBlockLogic(BuilderRef iBuilder, llvm::Value * const numOfStrides) override;
 };
 
+// The coordinates of each match are its line start, match end and line number.
+// Given four coordinate streams, the byte offset of the line start is added.   If
+// the LFs of CRLF line ends are also given, those CRs are not counted in the offset.
 class MatchCoordinatesKernel : public MultiBlockKernel {
 public:
     MatchCoordinatesKernel(BuilderRef b,
                            StreamSet * const Matches, StreamSet * const LineBreakStream,
-                           StreamSet * const Coordinates, unsigned strideBlocks = 1);
+                           StreamSet * const Coordinates, unsigned strideBlocks = 1,
+                           StreamSet * const CRLF_LineFeeds = nullptr);
 private:
     void generateMultiBlockLogic(BuilderRef iBuilder, llvm::Value * const numOfStrides) override;
+    const bool mLineOffsets;
+    const bool mAdjustCRLF;
 };
 
 class BatchCoordinatesKernel : public MultiBlockKernel {
@@ -49,6 +55,18 @@ class MatchReporter : public SegmentOrientedKernel {
 public:
     MatchReporter(BuilderRef b,
                   StreamSet * ByteStream, StreamSet * const Coordinates, Scalar * const callbackObject);
+private:
+    void generateDoSegmentMethod(BuilderRef iBuilder) override;
+    const bool mLineOffsets;
+};
+
+// Reports the coordinates of a segment's worth of matches with one call.   The
+// coordinates, including line offsets, are written to the array returned by
+// get_span_batch_wrapper and then passed on by accumulate_spans_wrapper.
+class MatchSpanReporter : public SegmentOrientedKernel {
+public:
+    MatchSpanReporter(BuilderRef b,
+                      StreamSet * ByteStream, StreamSet * const Coordinates, Scalar * const callbackObject);
 private:
     void generateDoSegmentMethod(BuilderRef iBuilder) override;
 };
@@ -69,6 +87,7 @@ public:
 private:
     void generateDoSegmentMethod(BuilderRef iBuilder) override;
     unsigned mColorizedLineNumberIndex;
+    const bool mLineOffsets;
 };
 
 }
@@ -14,6 +14,8 @@ namespace IDISA { class IDISA_Builder; }
 
 namespace kernel {
 
+class PipelineBuilder;
+
 /*  FilterByMask - extract selected bits of input streams according to a mask.
 
     One output bit is produced for every 1 bit in the mask stream.
@@ -28,6 +30,9 @@ namespace kernel {
     The input streams to process are selected sequentially from the stream set,
     starting from the position indicated by the streamOffset value.
 
+    The filtering kernels may also be added to a nested pipeline, such as a
+    branch of an optimization branch.
+
 */
     
 void FilterByMask(const std::unique_ptr<ProgramBuilder> & P,
@@ -35,6 +40,11 @@ void FilterByMask(const std::unique_ptr<ProgramBuilder> & P,
                   unsigned streamOffset = 0,
                   unsigned extractionFieldWidth = 64);
 
+void FilterByMask(PipelineBuilder & P,
+                  StreamSet * mask, StreamSet * inputs, StreamSet * outputs,
+                  unsigned streamOffset = 0,
+                  unsigned extractionFieldWidth = 64);
+
 //
 // Parallel Prefix Deletion Kernel
 // see Parallel Prefix Compress in Henry S. Warren, Hacker's Delight, Chapter 7
@@ -38,5 +38,35 @@ private:
     unsigned mSeed;
 };
 
+/*  The WindowHash kernel computes, at every position, a hash value of the
+    window of (1<<steps) bytes ending at that position.
+    Inputs: basis: source stream represented as a set of 8 basis bits.
+            steps: the number of steps to apply, which determines the
+                   window length.
+    Outputs:   hashes: hash values represented as n-bit bixnums, n <= 16.
+
+    Note:   the hash is linear in the basis bits of the window.   The same
+            value is computed for a string by windowHash, so that hash values
+            of the strings being searched for may be determined in advance.
+ */
+
+class WindowHash final: public pablo::PabloKernel {
+public:
+    WindowHash(BuilderRef b,
+               StreamSet * basis, StreamSet * hashes, unsigned steps)
+    : PabloKernel(b, "WindowHash" + std::to_string(hashes->getNumElements()) + "_" + std::to_string(steps),
+                  {Binding{"basis", basis}},
+                  {Binding{"hashes", hashes}}),
+    mHashBits(hashes->getNumElements()), mHashSteps(steps) {}
+protected:
+    void generatePabloMethod() override;
+private:
+    unsigned mHashBits;
+    unsigned mHashSteps;
+};
+
+// The hash value computed by a WindowHash kernel at the last byte of the given window.
+unsigned windowHash(const unsigned char * window, unsigned hashBits, unsigned steps);
+
 }
 #endif
@@ -72,6 +72,16 @@ protected:
     UnterminatedLineAtEOF mEOFmode;
 };
 
+/*  The LF of each CR+LF pair, marked so that positions within a file may be
+    adjusted to those of the file with its CR+LF line terminators replaced by LF. */
+
+class CRLFKernel final : public pablo::PabloKernel {
+public:
+    CRLFKernel(BuilderRef b, kernel::StreamSet * Source, kernel::StreamSet * CRLF_LineFeeds);
+protected:
+    void generatePabloMethod() override;
+};
+
 class LineStartsKernel final : public pablo::PabloKernel {
 public:
     LineStartsKernel(BuilderRef b, kernel::StreamSet * LineEnds, kernel::StreamSet * LineStarts);
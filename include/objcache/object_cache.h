@@ -15,11 +15,13 @@
 #include <util/not_null.h>
 #include <kernel/core/kernel.h>
 #include <string>
+#include <vector>
 
 namespace llvm { class Module; }
 namespace llvm { class MemoryBuffer; }
 namespace llvm { class MemoryBufferRef; }
 namespace llvm { class LLVMContext; }
+class ObjectCacheStore;
 
 // The ParabixObjectCache is a two-level cache compatible with the requirements
 // of the LLVM ExecutionEngine as well as the Parabix Kernel builder infrastructure.
@@ -32,6 +34,18 @@ namespace llvm { class LLVMContext; }
 // apply the necessary kernel builder to build the full module IR before passing
 // it to the ExecutionEngine.
 //
+// Above the kernel level, a whole program (the fully linked pipeline produced by
+// ProgramBuilder::compile and its main method) may be recorded under a client chosen
+// key as a manifest of the kernel objects it requires, the object of its main module
+// and the external functions each of them links against.  A later process can load
+// such a program (loadCachedProgram) without rebuilding or analyzing the pipeline.
+//
+// The segment size and number of buffer segments chosen by autotuning a program on this
+// host are recorded under a key naming the program and host (loadSegmentTuning).
+//
+// All entries are kept in a single ObjectCacheStore in the cache directory, whose objects are
+// loaded directly from its memory mapping and whose size is bounded by -object-cache-size.
+//
 
 enum class CacheObjectResult {
     CACHED
@@ -54,8 +68,28 @@ public:
 
     using Path = llvm::SmallString<128>;
 
+    using LinkedFunctions = std::vector<std::pair<std::string, void *>>;
+
+    struct CachedProgram {
+        std::vector<std::string> ObjectIds;
+        std::vector<std::unique_ptr<llvm::MemoryBuffer>> Objects;
+        LinkedFunctions Functions;
+        std::string MainFunctionName;
+    };
+
     CacheObjectResult loadCachedObjectFile(BuilderRef b, kernel::Kernel * const kernel) noexcept;
 
+    bool loadCachedProgram(llvm::StringRef programKey, CachedProgram & program) noexcept;
+
+    void prepareProgramModule(llvm::Module * const main, llvm::StringRef programKey) noexcept;
+
+    void saveCachedProgram(llvm::StringRef programKey, const std::vector<std::string> & objectIds,
+                           const LinkedFunctions & functions, llvm::StringRef mainFunctionName) noexcept;
+
+    bool loadSegmentTuning(llvm::StringRef tuningKey, unsigned & segmentSize, unsigned & bufferSegments) noexcept;
+
+    void saveSegmentTuning(llvm::StringRef tuningKey, const unsigned segmentSize, const unsigned bufferSegments) noexcept;
+
     void notifyObjectCompiled(const llvm::Module * M, llvm::MemoryBufferRef Obj) override;
 
     std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module * M) override;
@@ -76,6 +110,9 @@ private:
     KnownSignatures     mKnownSignatures;
     ModuleCache         mCachedObject;
     Path                mCachePath;
+    std::unique_ptr<ObjectCacheStore> mStore;
+    unsigned            mNumOfCacheHits = 0;
+    std::vector<std::string> mCacheMisses;
 };
 
 #endif
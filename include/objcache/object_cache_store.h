@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2020 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ */
+
+#ifndef OBJECT_CACHE_STORE_H
+#define OBJECT_CACHE_STORE_H
+
+#include <llvm/ADT/StringRef.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The ObjectCacheStore keeps every entry of the object cache in two files rather than one or more files per
+// entry: an append-only data file holding the key, object and stub of each entry and an index file holding an
+// open addressing hash table of the entries. Both are memory mapped and shared by every process using the cache.
+//
+// Lookups are lock-free: an index slot is published by storing its hash last, after its record is written and
+// the data size is advanced, so a reader that sees the hash also sees a complete record. Each lookup stamps the
+// entry with the value of a shared clock, which orders the entries for LRU eviction.
+//
+// Insertions are serialized within a process by a mutex and between processes by an advisory lock on a separate
+// lock file. Once the live entries would exceed the capacity of the store, the least recently used entries are
+// marked as deleted. Their records are reclaimed by compaction, which copies the live records into the data file
+// of the next generation and atomically replaces the index. Processes that mapped the prior generation keep their
+// (now unlinked) files, so entries they have already returned stay valid for the life of the store object.
+//
+// Every key is prefixed with the given key prefix. As the files are shared by every version of the program, the
+// entries of another version are never looked up and eventually evicted rather than left in a store of their own.
+
+class ObjectCacheStore {
+public:
+
+    struct Entry {
+        llvm::StringRef Object;
+        llvm::StringRef Stub;
+    };
+
+    ObjectCacheStore(llvm::StringRef directory, llvm::StringRef keyPrefix, const uint64_t capacity) noexcept;
+
+    bool lookup(llvm::StringRef id, Entry & entry) noexcept;
+
+    bool insert(llvm::StringRef id, llvm::StringRef object, llvm::StringRef stub = llvm::StringRef()) noexcept;
+
+    bool isOpen() const noexcept {
+        return mMapping.load(std::memory_order_acquire) != nullptr;
+    }
+
+    uint64_t getNumOfEntries() const noexcept;
+
+    uint64_t getLiveBytes() const noexcept;
+
+    ~ObjectCacheStore();
+
+private:
+
+    struct Header;
+    struct Slot;
+
+    struct Mapping {
+        Header * Index = nullptr;
+        Slot * Slots = nullptr;
+        const char * Data = nullptr;
+        size_t DataMapSize = 0;
+        int IndexFd = -1;
+        int DataFd = -1;
+    };
+
+    Mapping * openMapping() const noexcept;
+    bool createIndex(const uint64_t generation) const noexcept;
+    bool isCurrent(const Mapping * const mapping) const noexcept;
+    void retire(Mapping * const mapping) noexcept;
+    std::string getDataPath(const uint64_t generation) const;
+    Slot * find(const Mapping * const mapping, llvm::StringRef key, const uint64_t hash) const noexcept;
+    void remove(Mapping * const mapping, Slot * const slot) noexcept;
+    void evict(Mapping * const mapping, const uint64_t required) noexcept;
+    Mapping * compact(Mapping * const mapping) noexcept;
+
+private:
+
+    const std::string                   mIndexPath;
+    const std::string                   mLockPath;
+    const std::string                   mDataPrefix;
+    const std::string                   mKeyPrefix;
+    const uint64_t                      mCapacity;
+    const uint64_t                      mDataReserve;
+    std::atomic<Mapping *>              mMapping;
+    std::mutex                          mWriteLock;
+    std::vector<Mapping *>              mRetired;
+};
+
+#endif // OBJECT_CACHE_STORE_H
@@ -13,6 +13,8 @@
 
 #define OBJECT_FILE_EXTENSION ".o"
 #define KERNEL_FILE_EXTENSION ".kernel"
+#define PROGRAM_FILE_EXTENSION ".program"
+#define TUNING_FILE_EXTENSION ".tuning"
 #define CACHE_JANITOR_FILE_NAME "cachejanitord"
 
 #define DAEMON_FILE "cachejanitor.pid"
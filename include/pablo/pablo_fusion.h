@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2020 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ */
+
+#ifndef PABLO_FUSION_H
+#define PABLO_FUSION_H
+
+#include <pablo/pablo_kernel.h>
+
+namespace pablo {
+
+struct FusedPabloKernelSignature {
+    FusedPabloKernelSignature(const std::vector<PabloKernel *> & kernels, const kernel::Bindings & inputs, const kernel::Bindings & outputs);
+protected:
+    const std::string mSignature;
+};
+
+// A FusedPabloKernel computes a chain of Pablo kernels in a single kernel body. Each of its kernels generates
+// its Pablo code in the entry scope of the fused kernel in pipeline order; any stream set produced by one of
+// them is kept in local Vars rather than a buffer and is only written out if it is one of the fused outputs.
+// The fused kernels must outlive the generation of this kernel.
+
+class FusedPabloKernel final : public FusedPabloKernelSignature, public PabloKernel {
+public:
+    FusedPabloKernel(BuilderRef b, std::vector<PabloKernel *> && kernels, kernel::Bindings && inputs, kernel::Bindings && outputs);
+    bool isCachable() const override;
+    bool hasSignature() const override { return true; }
+    llvm::StringRef getSignature() const override { return mSignature; }
+    bool isFusable() const override { return false; }
+protected:
+    void generatePabloMethod() override;
+private:
+    const std::vector<PabloKernel *> mKernels;
+};
+
+}
+
+#endif // PABLO_FUSION_H
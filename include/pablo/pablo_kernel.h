@@ -32,6 +32,7 @@ class PabloKernel : public kernel::BlockOrientedKernel, public PabloAST {
     friend class PabloBlock;
     friend class CarryManager;
     friend class CarryPackManager;
+    friend class FusedPabloKernel;
 
 public:
 
@@ -140,6 +141,11 @@ public:
 
     bool requiresExplicitPartialFinalStride() const override;
 
+    bool isFusable() const override;
+
+    kernel::Kernel * makeFusedKernel(BuilderRef b, std::vector<kernel::Kernel *> && kernels,
+                                     kernel::Bindings && inputs, kernel::Bindings && outputs) const override;
+
 protected:
 
     PabloKernel(BuilderRef builder,
@@ -178,6 +184,8 @@ protected:
 
 private:
 
+    StreamSetPort getStreamPort(const std::string & name) const;
+
     void generateDoBlockMethod(BuilderRef b) final;
 
     // The default method for Pablo final block processing sets the
@@ -0,0 +1,22 @@
+#ifndef REQUIRED_LITERAL_H
+#define REQUIRED_LITERAL_H
+
+#include <vector>
+
+namespace re {
+
+class CC;
+class RE;
+
+//  Determine a literal that must occur within every string matched by
+//  a given RE.   The literal is returned as a sequence of character classes,
+//  each matching a single Unicode codepoint: every match of the RE contains,
+//  as a substring, some string formed by concatenating one character each
+//  from these classes.   An empty sequence is returned if the analysis finds
+//  no such literal.
+//
+
+std::vector<CC *> requiredLiteral(RE * re);
+
+}
+#endif
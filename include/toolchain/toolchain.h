@@ -7,6 +7,7 @@
 #ifndef TOOLCHAIN_H
 #define TOOLCHAIN_H
 
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Target/TargetOptions.h>
@@ -45,17 +46,38 @@ enum DebugFlags {
     EnableBlockingIOCounter,
     DisableIndirectBranch,
     PrintPipelineGraph,
+    DisableMirroredBuffers,
     DebugFlagSentinel
 };
 
 bool LLVM_READONLY DebugOptionIsSet(const DebugFlags flag);
 
+// How the threads of a segment-parallel pipeline are placed on the CPUs and NUMA nodes of the machine
+enum ThreadPlacementPolicy {
+    LinearPlacement,
+    CompactPlacement,
+    ScatterPlacement,
+    NodePlacement
+};
+
+// The instruction set tier that kernels are generated and compiled for. Every tier other than NativeTier fixes the
+// CPU features that code may use so that all hosts of a tier compile identical objects and can share them through
+// the object cache. AutoTier selects the widest tier the host supports.
+enum ISATierLevel {
+    AutoTier,
+    SSE2Tier,
+    AVX2Tier,
+    AVX512Tier,
+    NativeTier
+};
+
 // Options for generating IR or ASM to files
 const std::string OmittedOption = ".";
 extern std::string ShowUnoptimizedIROption;
 extern std::string ShowIROption;
 extern std::string TraceOption;
 extern std::string CCCOption;
+extern std::string KernelTimelineOption;
 #ifdef ENABLE_PAPI
 extern std::string PapiCounterOptions;
 #endif
@@ -63,6 +85,7 @@ extern std::string PapiCounterOptions;
 extern std::string ShowASMOption;
 #endif
 extern const char * ObjectCacheDir;
+extern unsigned ObjectCacheSize; // in MiB
 extern unsigned CacheDaysLimit;  // set from command line
 extern int FreeCallBisectLimit;  // set from command line
 extern llvm::CodeGenOpt::Level OptLevel;  // set from command line
@@ -71,11 +94,25 @@ const unsigned LaneWidth = 64;
 extern unsigned BlockSize;  // set from command line
 extern unsigned SegmentSize; // set from command line
 extern unsigned BufferSegments;
+extern bool Autotune;
+extern unsigned MaxRetainedBufferSize; // in KiB
 extern unsigned TaskThreads;
 extern unsigned SegmentThreads;
+extern ThreadPlacementPolicy ThreadPlacement;
+extern ISATierLevel ISATier;
+extern unsigned CompileThreads;
+extern bool TieredCompilation;
+extern unsigned TieredCompilationThreshold;
+extern bool KernelFusion;
+extern bool BlockingSynchronization;
+extern bool AsyncRead;
+extern bool ZeroCopyOutput;
+extern bool SplicePipeOutput;
 extern unsigned ScanBlocks;
 extern bool EnableObjectCache;
+extern bool EnableProgramCache;
 extern bool TraceObjectCache;
+extern bool ReportObjectCacheMisses;
 extern unsigned GroupNum;
 extern std::string ProgramName;
 extern llvm::TargetOptions target_Options;
@@ -86,6 +123,16 @@ void ParseCommandLineOptions(int argc, const char *const *argv, std::initializer
 void AddParabixVersionPrinter();
 
 void setTaskThreads(unsigned taskThreads);
+
+bool LLVM_READONLY isISATierSupported(const ISATierLevel tier);
+
+llvm::StringRef LLVM_READONLY getISATierName(const ISATierLevel tier);
+
+// the CPU features that generated code may use, i.e., those of the selected ISA tier or the host
+const llvm::StringMap<bool> & LLVM_READONLY getTargetCPUFeatures();
+
+// names the selected ISA tier (or host CPU for NativeTier) in cache keys
+const std::string & LLVM_READONLY getISATargetName();
 }
 
 #endif
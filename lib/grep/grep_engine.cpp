@@ -7,10 +7,16 @@
 #include <grep/grep_engine.h>
 
 #include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <errno.h>
 #include <fcntl.h>
 #include <iostream>
-#include <sched.h>
+#include <limits.h>
+#include <limits>
+#include <numeric>
+#include <sys/uio.h>
 #include <boost/filesystem.hpp>
 #include <toolchain/toolchain.h>
 #include <llvm/IR/Module.h>
@@ -53,9 +59,11 @@
 #include <re/transforms/to_utf8.h>
 #include <re/analysis/re_analysis.h>
 #include <re/analysis/re_name_gather.h>
+#include <re/analysis/required_literal.h>
 #include <re/analysis/collect_ccs.h>
 #include <re/transforms/replaceCC.h>
 #include <re/transforms/re_multiplex.h>
+#include <unicode/utf/utf8_encoder.h>
 #include <re/transforms/name_intro.h>
 #include <re/unicode/casing.h>
 #include <re/unicode/boundaries.h>
@@ -64,6 +72,7 @@
 #include <kernel/pipeline/driver/cpudriver.h>
 #include <grep/grep_toolchain.h>
 #include <toolchain/toolchain.h>
+#include <kernel/util/bixhash.h>
 #include <kernel/util/debug_display.h>
 #include <util/aligned_allocator.h>
 
@@ -75,6 +84,12 @@ namespace grep {
 
 const auto ENCODING_BITS = 8;
 
+// The required literal prefilter is used for literals of at least this many bytes.
+const unsigned MinRequiredLiteralBytes = 3;
+// Lines are recognized as candidates up to this many bytes before an occurrence of the
+// literal; longer lines are searched in full.
+const unsigned RequiredLiteralWindow = 512;
+
 void GrepCallBackObject::handle_signal(unsigned s) {
     if (static_cast<GrepSignal>(s) == GrepSignal::BinaryFile) {
         mBinaryFile = true;
@@ -108,6 +123,88 @@ extern "C" void set_batch_line_number_wrapper(intptr_t accum_addr, unsigned file
     reinterpret_cast<MatchAccumulator *>(accum_addr)->setBatchLineNumber(fileNo, batchLine);
 }
 
+extern "C" void set_line_offset_wrapper(intptr_t accum_addr, size_t offset) {
+    assert ("passed a null accumulator" && accum_addr);
+    reinterpret_cast<MatchAccumulator *>(accum_addr)->setLineOffset(offset);
+}
+
+extern "C" size_t * get_span_batch_wrapper(intptr_t accum_addr, size_t count) {
+    assert ("passed a null accumulator" && accum_addr);
+    return reinterpret_cast<MatchAccumulator *>(accum_addr)->getSpanBatch(count);
+}
+
+extern "C" void accumulate_spans_wrapper(intptr_t accum_addr, size_t count, char * buffer_limit) {
+    assert ("passed a null accumulator" && accum_addr);
+    reinterpret_cast<MatchAccumulator *>(accum_addr)->accumulate_spans(count, buffer_limit);
+}
+
+extern "C" void mark_literals_wrapper(intptr_t callback_addr, const char * bytes, const uint16_t * hashes, size_t count, size_t avail, uint64_t * marks) {
+    assert ("passed a null callback object" && callback_addr);
+    const LiteralSet * const literals = reinterpret_cast<GrepCallBackObject *>(callback_addr)->getLiteralSet();
+    assert ("no literal set for the callback object" && literals);
+    literals->markOccurrences(bytes, hashes, count, avail, marks);
+}
+
+extern "C" void accumulate_pattern_ids_wrapper(intptr_t callback_addr, const uint64_t * lineEnds, const uint64_t * patternLines, size_t count,
+                                               unsigned wordsPerBlock, unsigned patternCount, uint64_t * reported) {
+    assert ("passed a null callback object" && callback_addr);
+    reinterpret_cast<GrepCallBackObject *>(callback_addr)->accumulate_pattern_ids(lineEnds, patternLines, count, wordsPerBlock, patternCount);
+    std::memcpy(reported, lineEnds, ((count + 63) / 64) * sizeof(uint64_t));
+}
+
+void GrepCallBackObject::setPatternCount(const unsigned patternCount, const bool recordIds) {
+    mPatternCounts.assign(patternCount, 0);
+    mRecordPatternIds = recordIds;
+    mPatternIds.clear();
+}
+
+void GrepCallBackObject::accumulate_pattern_ids(const uint64_t * lineEnds, const uint64_t * patternLines, const size_t count,
+                                                const unsigned wordsPerBlock, const unsigned patternCount) {
+    assert (patternCount == mPatternCounts.size());
+    std::vector<unsigned> ids;
+    const size_t words = (count + 63) / 64;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t lines = lineEnds[w];
+        if ((w == words - 1) && (count % 64)) {
+            lines &= (static_cast<uint64_t>(1) << (count % 64)) - 1;
+        }
+        // Stream i of block b is at words ((b * patternCount) + i) * wordsPerBlock.
+        const uint64_t * const patternWords = patternLines + (w / wordsPerBlock) * patternCount * wordsPerBlock + (w % wordsPerBlock);
+        while (lines) {
+            const uint64_t line = lines & -lines;
+            ids.clear();
+            for (unsigned i = 0; i < patternCount; i++) {
+                if (patternWords[i * wordsPerBlock] & line) {
+                    ids.push_back(i);
+                    mPatternCounts[i]++;
+                }
+            }
+            if (mRecordPatternIds) {
+                std::lock_guard<std::mutex> lock(mPatternIdsLock);
+                mPatternIds.push_back(ids);
+            }
+            lines ^= line;
+        }
+    }
+}
+
+bool GrepCallBackObject::nextPatternIds(std::vector<unsigned> & ids) {
+    std::lock_guard<std::mutex> lock(mPatternIdsLock);
+    if (mPatternIds.empty()) {
+        return false;
+    }
+    ids = std::move(mPatternIds.front());
+    mPatternIds.pop_front();
+    return true;
+}
+
+size_t * MatchAccumulator::getSpanBatch(const size_t count) {
+    if (mSpanBatch.size() < 4 * count) {
+        mSpanBatch.resize(4 * count);
+    }
+    return mSpanBatch.data();
+}
+
 // Grep Engine construction and initialization.
 
 GrepEngine::GrepEngine(BaseDriver &driver) :
@@ -123,15 +220,30 @@ GrepEngine::GrepEngine(BaseDriver &driver) :
     mInitialTab(false),
     mCaseInsensitive(false),
     mInvertMatches(false),
+    mOnlyMatching(false),
+    mByteOffsets(false),
+    mUnixByteOffsets(false),
+    mPatternIds(false),
     mMaxCount(0),
     mGrepStdIn(false),
     mNullMode(NullCharMode::Data),
     mGrepDriver(driver),
     mMainMethod(nullptr),
-    mNextFileToGrep(0),
+    mBatchMethod(nullptr),
+    mLargeFileMethod(nullptr),
+    mLargeFileThreads(0),
+    mOutputStream(&llvm::outs()),
+    mOutputFD(STDOUT_FILENO),
+    mNextWorker(0),
     mNextFileToPrint(0),
+    mOutputWindow(0),
+    mGroupsClaimed(0),
+    mThreadsInUse(0),
+    mThreadBudget(0),
+    mPrinting(false),
     grepMatchFound(false),
     mGrepRecordBreak(GrepRecordBreakKind::LF),
+    mASCIIBranch(false),
     mExternalComponents(static_cast<Component>(0)),
     mInternalComponents(static_cast<Component>(0)),
     mLineBreakStream(nullptr),
@@ -181,32 +293,36 @@ void GrepEngine::setRecordBreak(GrepRecordBreakKind b) {
 
 namespace fs = boost::filesystem;
 
-std::vector<std::vector<std::string>> formFileGroups(std::vector<fs::path> paths) {
-    const unsigned maxFilesPerGroup = 32;
+std::vector<std::vector<std::string>> formFileGroups(std::vector<fs::path> paths, const unsigned maxFilesPerGroup, std::vector<uintmax_t> & groupSizes) {
     const uintmax_t FileBatchThreshold = 4 * codegen::SegmentSize;
     std::vector<std::vector<std::string>> groups;
+    groupSizes.clear();
     // The total size of files in the current group, or 0 if the
     // the next file should start a new group.
     uintmax_t groupTotalSize = 0;
     for (auto p : paths) {
         boost::system::error_code errc;
         auto s = fs::file_size(p, errc);
+        if (errc) s = 0;
         if ((s > 0) && (s < FileBatchThreshold)) {
             if (groupTotalSize == 0) {
                 groups.push_back({p.string()});
+                groupSizes.push_back(s);
                 groupTotalSize = s;
             } else {
                 groups.back().push_back(p.string());
+                groupSizes.back() += s;
                 groupTotalSize += s;
-                if ((groupTotalSize > FileBatchThreshold) || (groups.back().size() == maxFilesPerGroup)) {
-                    // Signal to start a new group
-                    groupTotalSize = 0;
-                }
+            }
+            if ((groupTotalSize > FileBatchThreshold) || (groups.back().size() == maxFilesPerGroup)) {
+                // Signal to start a new group
+                groupTotalSize = 0;
             }
         } else {
             // For large files, or in the case of non-regular file or other error,
             // the path is saved in its own group.
             groups.push_back({p.string()});
+            groupSizes.push_back(s);
             // This group is done, signal to start a new group.
             groupTotalSize = 0;
         }
@@ -221,15 +337,78 @@ bool GrepEngine::haveFileBatch() {
     return false;
 }
 
+bool GrepEngine::haveLargeFile() {
+    if (mLargeFileThreads <= codegen::SegmentThreads) return false;
+    for (const bool large : mLargeFileGroup) {
+        if (large) return true;
+    }
+    return false;
+}
+
+// Files at least this large are searched with a pipeline using all of the
+// segment threads available, rather than the share of one task thread.
+const uintmax_t LargeFileSegments = 4096;
+
+// The number of file groups per task thread whose results may be held awaiting
+// output.   A worker that gets this far ahead of the output waits for it.
+const unsigned OutputWindowGroupsPerThread = 4;
+
 void GrepEngine::initFileResult(const std::vector<boost::filesystem::path> & paths) {
-    const unsigned n = paths.size();
-    mResultStrs.resize(n);
-    mFileStatus.resize(n, FileStatus::Pending);
+    // An engine may be reused for several searches once its code has been
+    // generated; reset any state left over from a prior search.
+    mNextWorker = 0;
+    mNextFileToPrint = 0;
+    mGroupsClaimed = 0;
+    mPrinting = false;
+    grepMatchFound = false;
     mInputPaths = paths;
-    mFileGroups = formFileGroups(paths);
+    // Files may only be batched together if a batch method either exists
+    // or will be compiled by a subsequent call to grepCodeGen.   Matches are
+    // reported individually for -o, which the batch method does not support.
+    // Byte offsets are computed from the start of each file's own pipeline.
+    const bool batchingPossible = !mOnlyMatching && !mByteOffsets && ((mMainMethod == nullptr) || (mBatchMethod != nullptr));
+    std::vector<uintmax_t> groupSizes;
+    mFileGroups = formFileGroups(paths, batchingPossible ? 32 : 1, groupSizes);
+    mFileStatus.assign(mFileGroups.size(), FileStatus::Pending);
+    mResults.clear();
+    mResults.resize(mFileGroups.size());
+    const uintmax_t largeFileThreshold = LargeFileSegments * codegen::SegmentSize;
+    mLargeFileGroup.resize(mFileGroups.size());
+    for (unsigned i = 0; i < mFileGroups.size(); ++i) {
+        mLargeFileGroup[i] = (mFileGroups[i].size() == 1) && (groupSizes[i] >= largeFileThreshold);
+    }
     const unsigned numOfThreads = std::min(static_cast<unsigned>(codegen::TaskThreads),
                                            std::max(static_cast<unsigned>(mFileGroups.size()), 1u));
+    // Large files keep all of the segment threads requested, whereas the
+    // main method divides them among the task threads.
+    if (mMainMethod == nullptr) {
+        mLargeFileThreads = codegen::SegmentThreads;
+    }
     codegen::setTaskThreads(numOfThreads);
+    mOutputWindow = std::max(codegen::TaskThreads * OutputWindowGroupsPerThread, 1u);
+    scheduleFileGroups(groupSizes);
+}
+
+// Deal out the file groups, in decreasing order of size, to the task threads.
+// Within the reorder window, each thread starts on the largest work it was dealt,
+// so a large file does not wait behind the small files that precede it.
+void GrepEngine::scheduleFileGroups(const std::vector<uintmax_t> & groupSizes) {
+    std::vector<unsigned> order(mFileGroups.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](const unsigned a, const unsigned b) {
+        return groupSizes[a] > groupSizes[b];
+    });
+    mGroupSizes = groupSizes;
+    mGroupOwner.resize(order.size());
+    for (unsigned i = 0; i < order.size(); ++i) {
+        mGroupOwner[order[i]] = i % codegen::TaskThreads;
+    }
+}
+
+void GrepEngine::setOutputStream(llvm::raw_ostream & out) {
+    mOutputStream = &out;
+    // Results are written to stdout directly, unless output is redirected to another stream.
+    mOutputFD = (&out == &llvm::outs()) ? STDOUT_FILENO : -1;
 }
 
 //
@@ -240,6 +419,8 @@ bool GrepEngine::matchesToEOLrequired () {
     // Moving matches is required for UnicodeLines mode, because matches
     // may be on the CR of a CRLF.
     if (mGrepRecordBreak == GrepRecordBreakKind::Unicode) return true;
+    // Pattern ids are reported for matched lines, identified by their line ends.
+    if (mPatternIds) return true;
     // If all REs are anchored to EOL already, then we can avoid moving them.
     bool allAnchored = true;
     for (unsigned i = 0; i < mREs.size(); ++i) {
@@ -252,8 +433,107 @@ bool GrepEngine::matchesToEOLrequired () {
     return (mEngineKind == EngineKind::EmitMatches) || (mMaxCount != 1) || mInvertMatches;
 }
 
+// The longest run of the required literal of an RE whose classes each translate to a
+// sequence of UTF-8 byte classes: ASCII classes and single non-ASCII codepoints.
+static std::vector<re::CC *> requiredByteLiteral(re::RE * re) {
+    std::vector<re::CC *> longest;
+    std::vector<re::CC *> run;
+    for (re::CC * cc : re::requiredLiteral(re)) {
+        re::RE * const u8 = toUTF8(cc);
+        if (re::CC * const b = dyn_cast<re::CC>(u8)) {
+            run.push_back(b);
+            continue;
+        }
+        if (re::Seq * const seq = dyn_cast<re::Seq>(u8)) {
+            if (std::all_of(seq->begin(), seq->end(), [](re::RE * e) {return isa<re::CC>(e);})) {
+                for (re::RE * e : *seq) {
+                    run.push_back(cast<re::CC>(e));
+                }
+                continue;
+            }
+        }
+        if (run.size() > longest.size()) {
+            longest.swap(run);
+        }
+        run.clear();
+    }
+    if (run.size() > longest.size()) {
+        longest.swap(run);
+    }
+    return longest;
+}
+
+static void appendUTF8(std::string & s, const UCD::codepoint_t cp) {
+    for (unsigned n = 1; n <= UTF8_Encoder::length(cp); n++) {
+        s.push_back(static_cast<char>(UTF8_Encoder::encodingByte(cp, n)));
+    }
+}
+
+// Collect the UTF-8 strings matched by an RE that is a literal or an alternation of
+// literals, omitting those that include a line break.   Returns false for any other RE.
+static bool collectLiterals(re::RE * re, const re::CC * breakCC, std::vector<std::string> & literals) {
+    if (re::Alt * alt = dyn_cast<re::Alt>(re)) {
+        for (re::RE * a : *alt) {
+            if (!collectLiterals(a, breakCC, literals)) {
+                return false;
+            }
+        }
+        return true;
+    } else if (re::CC * cc = dyn_cast<re::CC>(re)) {
+        // A class of single characters, as formed by an alternation of one character literals.
+        if ((cc->getAlphabet() != &cc::Unicode) || cc->empty() || (cc->count() > 256)) {
+            return false;
+        }
+        for (const auto & i : *cc) {
+            for (auto cp = re::lo_codepoint(i); cp <= re::hi_codepoint(i); cp++) {
+                if (!breakCC->contains(cp)) {
+                    std::string literal;
+                    appendUTF8(literal, cp);
+                    literals.push_back(std::move(literal));
+                }
+            }
+        }
+        return true;
+    } else if (re::Seq * seq = dyn_cast<re::Seq>(re)) {
+        std::string literal;
+        bool hasBreak = false;
+        for (re::RE * e : *seq) {
+            re::CC * cc = dyn_cast<re::CC>(e);
+            if ((cc == nullptr) || (cc->getAlphabet() != &cc::Unicode) || (cc->count() != 1)) {
+                return false;
+            }
+            const auto cp = re::lo_codepoint(cc->front());
+            hasBreak |= breakCC->contains(cp);
+            appendUTF8(literal, cp);
+        }
+        if (literal.empty()) {
+            return false;
+        }
+        if (!hasBreak) {
+            literals.push_back(std::move(literal));
+        }
+        return true;
+    }
+    return false;
+}
+
 void GrepEngine::initREs(std::vector<re::RE *> & REs) {
-    if (mEngineKind != EngineKind::EmitMatches) mColoring = false;
+    if (mEngineKind != EngineKind::EmitMatches) {
+        mColoring = false;
+        mOnlyMatching = false;
+        mByteOffsets = false;
+    }
+    // Pattern ids are reported by the CountOnly and EmitMatches engines, for matched lines.
+    // icgrep rejects the unsupported combinations as usage errors while handling its options;
+    // any other front end reaches this check.
+    if (mPatternIds) {
+        if ((mEngineKind == EngineKind::QuietMode) || (mEngineKind == EngineKind::MatchOnly)) {
+            mPatternIds = false;
+        } else if (mInvertMatches || mOnlyMatching || (mBeforeContext != 0) || (mAfterContext != 0)) {
+            llvm::report_fatal_error("Sorry, --pattern-ids is not supported with -v, -o or context lines.\n");
+        }
+        mColoring = false;
+    }
     if (mGrepRecordBreak == GrepRecordBreakKind::Unicode) {
         mBreakCC = re::makeCC(re::makeCC(0x0A, 0x0D), re::makeCC(re::makeCC(0x85), re::makeCC(0x2028, 0x2029)));
         for (unsigned i = 0; i < REs.size(); ++i) {
@@ -276,6 +556,29 @@ void GrepEngine::initREs(std::vector<re::RE *> & REs) {
         mExternalNames.insert(anchorName);
     }
 
+    // Large sets of literals are found by hashing, rather than by compiling them into
+    // regular expression kernels.   Only the lines containing matches are identified.
+    mLiteralSet.reset();
+    if ((LiteralSetThreshold > 0) && (mGrepRecordBreak != GrepRecordBreakKind::Unicode) &&
+        !mCaseInsensitive && !mColoring && !mOnlyMatching && !mPatternIds) {
+        std::vector<std::string> literals;
+        bool allLiterals = true;
+        for (re::RE * re : REs) {
+            allLiterals &= collectLiterals(re, mBreakCC, literals);
+        }
+        if (allLiterals && (literals.size() >= LiteralSetThreshold)) {
+            mLiteralSet = make_unique<LiteralSet>(std::move(literals));
+            mREs = REs;
+            mPrefixRE = nullptr;
+            mSuffixRE = nullptr;
+            mRequiredLiteral.clear();
+            mASCIIBranch = false;
+            setComponent(mExternalComponents, Component::S2P);
+            setComponent(mExternalComponents, Component::MoveMatchesToEOL);
+            return;
+        }
+    }
+
     mREs = REs;
     for (unsigned i = 0; i < mREs.size(); ++i) {
         mREs[i] = resolveModesAndExternalSymbols(mREs[i], mCaseInsensitive);
@@ -301,7 +604,7 @@ void GrepEngine::initREs(std::vector<re::RE *> & REs) {
     for (unsigned i = 0; i < mREs.size(); ++i) {
         if (!validateFixedUTF8(mREs[i])) {
             setComponent(mExternalComponents, Component::UTF8index);
-            if (mColoring) {
+            if (mColoring && !mOnlyMatching) {
                 UnicodeIndexing = true;
             }
             break;
@@ -311,15 +614,18 @@ void GrepEngine::initREs(std::vector<re::RE *> & REs) {
         setComponent(mExternalComponents, Component::S2P);
         setComponent(mExternalComponents, Component::UTF8index);
     }
-    if ((mEngineKind == EngineKind::EmitMatches) && mColoring && !mInvertMatches) {
+    if ((mEngineKind == EngineKind::EmitMatches) && mColoring && !mInvertMatches && !mOnlyMatching) {
         setComponent(mExternalComponents, Component::MatchStarts);
     }
+    if (mOnlyMatching && !mInvertMatches && !MatchSpanFinder(mREs, mBreakCC).isSupported()) {
+        llvm::report_fatal_error("Sorry, -o is not supported for this regular expression.\n");
+    }
     if (matchesToEOLrequired()) {
         // Move matches to EOL.   This may be achieved internally by modifying
         // the regular expression or externally.   The internal approach is more
         // generally more efficient, but cannot be used if colorization is needed
         // or in UnicodeLines mode.
-        if ((mGrepRecordBreak == GrepRecordBreakKind::Unicode) || (mEngineKind == EngineKind::EmitMatches) || mInvertMatches || UnicodeIndexing) {
+        if ((mGrepRecordBreak == GrepRecordBreakKind::Unicode) || (mEngineKind == EngineKind::EmitMatches) || mInvertMatches || UnicodeIndexing || mPatternIds) {
             setComponent(mExternalComponents, Component::MoveMatchesToEOL);
         } else {
             setComponent(mInternalComponents, Component::MoveMatchesToEOL);
@@ -356,17 +662,35 @@ void GrepEngine::initREs(std::vector<re::RE *> & REs) {
     if (!mExternalNames.empty()) {
         setComponent(mExternalComponents, Component::UTF8index);
     }
+    // If every match must contain a literal, a cheap byte-level search for the literal
+    // determines the lines that need the transposed, full regular expression search.
+    // Boundary and Unicode line break streams are computed from the basis bits of the
+    // whole input, so the prefilter does not apply to those cases.
+    mRequiredLiteral.clear();
+    if (RequiredLiteralPrefilter && (mREs.size() == 1) && !UnicodeIndexing && !mPatternIds &&
+        (mGrepRecordBreak != GrepRecordBreakKind::Unicode)) {
+        mRequiredLiteral = requiredByteLiteral(mREs[0]);
+        if (mRequiredLiteral.size() < MinRequiredLiteralBytes) {
+            mRequiredLiteral.clear();
+        }
+    }
+    // Unicode property streams and the U8 index are computed per segment, with the
+    // ASCII subsets of the properties for segments without non-ASCII bytes.   The
+    // prefilter computes these streams only for candidate segments, and boundary
+    // and Unicode line break streams rely on the U8 index of the whole input.
+    mASCIIBranch = ASCIIFastPath && mRequiredLiteral.empty() && !mExternalNames.empty() && !UnicodeIndexing &&
+                   (mGrepRecordBreak != GrepRecordBreakKind::Unicode);
 }
 
-StreamSet * GrepEngine::getBasis(const std::unique_ptr<ProgramBuilder> & P, StreamSet * ByteStream) {
+StreamSet * GrepEngine::getBasis(PipelineBuilder & P, StreamSet * ByteStream) {
     if (hasComponent(mExternalComponents, Component::S2P)) {
-        StreamSet * BasisBits = P->CreateStreamSet(ENCODING_BITS, 1);
+        StreamSet * BasisBits = P.CreateStreamSet(ENCODING_BITS, 1);
         if (PabloTransposition) {
-            P->CreateKernelCall<S2P_PabloKernel>(ByteStream, BasisBits);
+            P.CreateKernelCall<S2P_PabloKernel>(ByteStream, BasisBits);
         } else if (SplitTransposition) {
             Staged_S2P(P, ByteStream, BasisBits);
         } else {
-            P->CreateKernelCall<S2PKernel>(ByteStream, BasisBits);
+            P.CreateKernelCall<S2PKernel>(ByteStream, BasisBits);
         }
         return BasisBits;
     }
@@ -395,7 +719,7 @@ void GrepEngine::grepPrologue(const std::unique_ptr<ProgramBuilder> & P, StreamS
         UnicodeLinesLogic(P, SourceStream, mLineBreakStream, mU8index, UnterminatedLineAtEOF::Add1, mNullMode, callbackObject);
     }
     else {
-        if (hasComponent(mExternalComponents, Component::UTF8index)) {
+        if (hasComponent(mExternalComponents, Component::UTF8index) && !mASCIIBranch) {
             P->CreateKernelCall<UTF8_index>(SourceStream, mU8index);
         }
         if (mGrepRecordBreak == GrepRecordBreakKind::LF) {
@@ -418,28 +742,89 @@ void GrepEngine::prepareExternalStreams(const std::unique_ptr<ProgramBuilder> &
         mWordBoundary_stream = P->CreateStreamSet(1, 1);
         WordBoundaryLogic(P, &mUTF8_Transformer, SourceStream, mU8index, mWordBoundary_stream);
     }
+    if (mASCIIBranch) {
+        prepareASCIIBranchedStreams(P, SourceStream);
+    } else {
+        preparePropertyStreams(*P, SourceStream);
+    }
+}
+
+static bool hasPropertyStream(re::Name * name) {
+    re::RE * def = name->getDefinition();
+    return isa<re::PropertyExpression>(def) || isa<re::CC>(def);
+}
+
+void GrepEngine::propertyKernelCall(PipelineBuilder & P, re::Name * name, StreamSet * SourceStream, StreamSet * property) {
+    re::RE * def = name->getDefinition();
+    if (isa<re::PropertyExpression>(def)) {
+        P.CreateKernelCall<UnicodePropertyKernelBuilder>(name, SourceStream, property);
+    } else {
+        std::vector<re::CC *> ccs = {cast<re::CC>(def)};
+        P.CreateKernelCall<CharClassesKernel>(ccs, SourceStream, property);
+    }
+}
+
+void GrepEngine::preparePropertyStreams(PipelineBuilder & P, StreamSet * SourceStream) {
     for (auto e : mExternalNames) {
-        re::RE * def = e->getDefinition();
         auto name = e->getFullName();
         auto f = mPropertyStreamMap.find(name);
-        if (f == mPropertyStreamMap.end()) {
-            if (isa<re::PropertyExpression>(def)) {
-                //errs() << "preparing external: " << name << "\n";
-                StreamSet * property = P->CreateStreamSet(1, 1);
-                mPropertyStreamMap.emplace(name, property);
-                P->CreateKernelCall<UnicodePropertyKernelBuilder>(e, SourceStream, property);
-            } else if (re::CC * cc = dyn_cast<re::CC>(def)) {
-                StreamSet * ccStrm = P->CreateStreamSet(1, 1);
-                mPropertyStreamMap.emplace(name, ccStrm);
-                std::vector<re::CC *> ccs = {cc};
-                P->CreateKernelCall<CharClassesKernel>(ccs, SourceStream, ccStrm);
-            }
+        if ((f == mPropertyStreamMap.end()) && hasPropertyStream(e)) {
+            //errs() << "preparing external: " << name << "\n";
+            StreamSet * property = P.CreateStreamSet(1, 1);
+            mPropertyStreamMap.emplace(name, property);
+            propertyKernelCall(P, e, SourceStream, property);
+        }
+    }
+}
+
+// The ASCII subset of the code points of a property, or of a character class.
+static re::CC * asciiSubset(re::RE * def) {
+    re::CC * cc = dyn_cast<re::CC>(def);
+    if (re::PropertyExpression * pe = dyn_cast<re::PropertyExpression>(def)) {
+        if (pe->getKind() == re::PropertyExpression::Kind::Codepoint) {
+            cc = cast<re::CC>(pe->getResolvedRE());
+        }
+    }
+    if (cc == nullptr) {
+        return re::makeCC();
+    }
+    return re::intersectCC(cc, re::makeCC(0, 0x7F));
+}
+
+void GrepEngine::prepareASCIIBranchedStreams(const std::unique_ptr<ProgramBuilder> & P, StreamSet * SourceStream) {
+    std::vector<re::Name *> names;
+    Bindings outputs = {Binding{"u8index", mU8index}};
+    for (auto e : mExternalNames) {
+        auto name = e->getFullName();
+        if ((mPropertyStreamMap.count(name) == 0) && hasPropertyStream(e)) {
+            StreamSet * property = P->CreateStreamSet(1, 1);
+            mPropertyStreamMap.emplace(name, property);
+            outputs.emplace_back("property" + std::to_string(names.size()), property);
+            names.push_back(e);
         }
     }
+    StreamSet * const NonASCII = P->CreateStreamSet(1, 1);
+    P->CreateKernelCall<NonASCIIRegionKernel>(SourceStream, NonASCII);
+    auto B = P->CreateOptimizationBranch(NonASCII,
+        {Binding{"SourceStream", SourceStream}, Binding{"condition", NonASCII}}, std::move(outputs));
+
+    // In ASCII text, every byte is a complete UTF-8 sequence and each property
+    // holds for the code points of its ASCII subset.
+    const auto & A = B->getAllZeroBranch();
+    A->CreateKernelCall<CharClassesKernel>(std::vector<re::CC *>{re::makeCC(0, 0x7F)}, SourceStream, mU8index);
+    for (re::Name * e : names) {
+        A->CreateKernelCall<CharClassesKernel>(std::vector<re::CC *>{asciiSubset(e->getDefinition())}, SourceStream, mPropertyStreamMap[e->getFullName()]);
+    }
+
+    const auto & U = B->getNonZeroBranch();
+    U->CreateKernelCall<UTF8_index>(SourceStream, mU8index);
+    for (re::Name * e : names) {
+        propertyKernelCall(*U, e, SourceStream, mPropertyStreamMap[e->getFullName()]);
+    }
 }
 
 
-void GrepEngine::addExternalStreams(const std::unique_ptr<ProgramBuilder> & P, std::unique_ptr<GrepKernelOptions> & options, re::RE * regexp, StreamSet * indexMask) {
+void GrepEngine::addExternalStreams(PipelineBuilder & P, std::unique_ptr<GrepKernelOptions> & options, re::RE * regexp, StreamSet * indexMask) {
     std::set<re::Name *> externals;
     re::gatherNames(regexp, externals);
     for (const auto & e : externals) {
@@ -450,7 +835,7 @@ void GrepEngine::addExternalStreams(const std::unique_ptr<ProgramBuilder> & P, s
             if (indexMask == nullptr) {
                 options->addExternal(name, f->second);
             } else {
-                StreamSet * iExternal_stream = P->CreateStreamSet(1, 1);
+                StreamSet * iExternal_stream = P.CreateStreamSet(1, 1);
                 FilterByMask(P, indexMask, f->second, iExternal_stream);
                 options->addExternal(name, iExternal_stream);
             }
@@ -462,7 +847,7 @@ void GrepEngine::addExternalStreams(const std::unique_ptr<ProgramBuilder> & P, s
             options->addExternal("\\b{g}", mGCB_stream);
             //P->CreateKernelCall<DebugDisplayKernel>("\\b{g}[U8indexed]", mGCB_stream);
         } else {
-            StreamSet * iGCB_stream = P->CreateStreamSet(1, 1);
+            StreamSet * iGCB_stream = P.CreateStreamSet(1, 1);
             FilterByMask(P, indexMask, mGCB_stream, iGCB_stream);
             options->addExternal("\\b{g}", iGCB_stream, 1);
             //P->CreateKernelCall<DebugDisplayKernel>("\\b{g}", iGCB_stream);
@@ -474,7 +859,7 @@ void GrepEngine::addExternalStreams(const std::unique_ptr<ProgramBuilder> & P, s
             options->addExternal("\\b", mWordBoundary_stream);
             //P->CreateKernelCall<DebugDisplayKernel>("\\b[U8indexed]", mWordBoundary_stream);
         } else {
-            StreamSet * iWordBoundary_stream = P->CreateStreamSet(1, 1);
+            StreamSet * iWordBoundary_stream = P.CreateStreamSet(1, 1);
             FilterByMask(P, indexMask, mWordBoundary_stream, iWordBoundary_stream);
             options->addExternal("\\b", iWordBoundary_stream, 1);
             //P->CreateKernelCall<DebugDisplayKernel>("\\b", iWordBoundary_stream);
@@ -489,7 +874,7 @@ void GrepEngine::addExternalStreams(const std::unique_ptr<ProgramBuilder> & P, s
         if (indexMask == nullptr) {
             options->addExternal("UTF8_LB", mLineBreakStream);
         } else {
-            StreamSet * iU8_LB = P->CreateStreamSet(1, 1);
+            StreamSet * iU8_LB = P.CreateStreamSet(1, 1);
             FilterByMask(P, indexMask, mLineBreakStream, iU8_LB);
             options->addExternal("UTF8_LB", iU8_LB);
         }
@@ -517,7 +902,7 @@ void GrepEngine::UnicodeIndexedGrep(const std::unique_ptr<ProgramBuilder> & P, r
     }
     StreamSet * const MatchResults = P->CreateStreamSet(1, 1);
     options->setResults(MatchResults);
-    addExternalStreams(P, options, re, mU8index);
+    addExternalStreams(*P, options, re, mU8index);
     P->CreateKernelCall<ICGrepKernel>(std::move(options));
     StreamSet * u8index1 = P->CreateStreamSet(1, 1);
     P->CreateKernelCall<AddSentinel>(mU8index, u8index1);
@@ -532,13 +917,13 @@ void GrepEngine::UnicodeIndexedGrep(const std::unique_ptr<ProgramBuilder> & P, r
     }
 }
 
-void GrepEngine::U8indexedGrep(const std::unique_ptr<ProgramBuilder> & P, re::RE * re, StreamSet * Source, StreamSet * Results) {
+void GrepEngine::U8indexedGrep(PipelineBuilder & P, re::RE * re, StreamSet * Source, StreamSet * Results) {
     std::unique_ptr<GrepKernelOptions> options = make_unique<GrepKernelOptions>(&cc::UTF8);
     auto lengths = getLengthRange(re, &cc::UTF8);
     options->setSource(Source);
     StreamSet * MatchResults = nullptr;
     if (hasComponent(mExternalComponents, Component::MatchStarts)) {
-        MatchResults = P->CreateStreamSet(1, 1);
+        MatchResults = P.CreateStreamSet(1, 1);
         options->setResults(MatchResults);
     } else {
         options->setResults(Results);
@@ -560,37 +945,91 @@ void GrepEngine::U8indexedGrep(const std::unique_ptr<ProgramBuilder> & P, re::RE
         }
     }
     addExternalStreams(P, options, re);
-    P->CreateKernelCall<ICGrepKernel>(std::move(options));
+    P.CreateKernelCall<ICGrepKernel>(std::move(options));
     if (hasComponent(mExternalComponents, Component::MatchStarts)) {
-        P->CreateKernelCall<FixedMatchPairsKernel>(lengths.first, MatchResults, Results);
+        P.CreateKernelCall<FixedMatchPairsKernel>(lengths.first, MatchResults, Results);
+    }
+}
+
+StreamSet * GrepEngine::requiredLiteralGrep(const std::unique_ptr<ProgramBuilder> & P, StreamSet * ByteStream, const unsigned resultStreamCount) {
+    // A byte-level search for the literal, using the Direct CC compiler.
+    StreamSet * const LiteralEnds = P->CreateStreamSet(1, 1);
+    std::unique_ptr<GrepKernelOptions> options = make_unique<GrepKernelOptions>(&cc::UTF8);
+    options->setSource(ByteStream);
+    options->setRE(re::makeSeq(mRequiredLiteral.begin(), mRequiredLiteral.end()));
+    options->setResults(LiteralEnds);
+    P->CreateKernelCall<ICGrepKernel>(std::move(options));
+    StreamSet * const CandidateLines = P->CreateStreamSet(1, 1);
+    P->CreateKernelCall<RequiredLiteralLinesKernel>(LiteralEnds, mLineBreakStream, CandidateLines, RequiredLiteralWindow);
+
+    StreamSet * const MatchResults = P->CreateStreamSet(resultStreamCount, 1);
+    Bindings inputs = {Binding{"ByteStream", ByteStream}, Binding{"lineBreaks", mLineBreakStream}, Binding{"condition", CandidateLines}};
+    if (hasComponent(mExternalComponents, Component::UTF8index)) {
+        inputs.emplace_back("u8index", mU8index);
     }
+    auto B = P->CreateOptimizationBranch(CandidateLines, std::move(inputs), {Binding{"MatchResults", MatchResults}});
+
+    B->getAllZeroBranch()->CreateKernelCall<NoMatchesKernel>(mLineBreakStream, MatchResults);
+
+    // Segments with candidate lines are transposed and searched as usual.   A skipped
+    // run of segments always ends at a line break, so the line-local regular expression
+    // search resumes in a consistent state.
+    PipelineBuilder & S = *B->getNonZeroBranch();
+    StreamSet * const SourceStream = getBasis(S, ByteStream);
+    preparePropertyStreams(S, SourceStream);
+    U8indexedGrep(S, mREs[0], SourceStream, MatchResults);
+    return MatchResults;
+}
+
+StreamSet * GrepEngine::literalSetGrep(const std::unique_ptr<ProgramBuilder> & P, StreamSet * ByteStream, StreamSet * BasisBits) {
+    StreamSet * const HashBits = P->CreateStreamSet(LiteralSet::HashBits, 1);
+    P->CreateKernelCall<WindowHash>(BasisBits, HashBits, mLiteralSet->getWindowSteps());
+    StreamSet * const Hashes = P->CreateStreamSet(1, LiteralSet::HashBits);
+    P->CreateKernelCall<P2S16Kernel>(HashBits, Hashes);
+    StreamSet * const LiteralStarts = P->CreateStreamSet(1, 1);
+    Scalar * const callbackObject = P->getInputScalar("callbackObject");
+    Kernel * const k = P->CreateKernelCall<LiteralSetKernel>(ByteStream, Hashes, LiteralStarts, callbackObject,
+                                                             mLiteralSet->getWindowLength(), mLiteralSet->getMaxLength());
+    k->link("mark_literals_wrapper", mark_literals_wrapper);
+    return LiteralStarts;
 }
 
 StreamSet * GrepEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & P, StreamSet * InputStream) {
-    StreamSet * SourceStream = getBasis(P, InputStream);
+    StreamSet * Matches = nullptr;
+    std::vector<StreamSet *> MatchResultsBufs;
+    if (mLiteralSet) {
+        StreamSet * const SourceStream = getBasis(*P, InputStream);
+        grepPrologue(P, SourceStream);
+        Matches = literalSetGrep(P, InputStream, SourceStream);
+    } else if (!mRequiredLiteral.empty()) {
+        grepPrologue(P, InputStream);
+        Matches = requiredLiteralGrep(P, InputStream, 1);
+    } else {
+        StreamSet * SourceStream = getBasis(*P, InputStream);
 
-    grepPrologue(P, SourceStream);
+        grepPrologue(P, SourceStream);
 
-    prepareExternalStreams(P, SourceStream);
+        prepareExternalStreams(P, SourceStream);
 
-    const auto numOfREs = mREs.size();
-    std::vector<StreamSet *> MatchResultsBufs(numOfREs);
+        const auto numOfREs = mREs.size();
+        MatchResultsBufs.resize(numOfREs);
 
-    for(unsigned i = 0; i < numOfREs; ++i) {
-        StreamSet * const MatchResults = P->CreateStreamSet(1, 1);
-        MatchResultsBufs[i] = MatchResults;
-        if (UnicodeIndexing) {
-            UnicodeIndexedGrep(P, mREs[i], SourceStream, MatchResults);
-        } else {
-            U8indexedGrep(P, mREs[i], SourceStream, MatchResults);
+        for(unsigned i = 0; i < numOfREs; ++i) {
+            StreamSet * const MatchResults = P->CreateStreamSet(1, 1);
+            MatchResultsBufs[i] = MatchResults;
+            if (UnicodeIndexing) {
+                UnicodeIndexedGrep(P, mREs[i], SourceStream, MatchResults);
+            } else {
+                U8indexedGrep(*P, mREs[i], SourceStream, MatchResults);
+            }
         }
-    }
 
-    StreamSet * Matches = MatchResultsBufs[0];
-    if (MatchResultsBufs.size() > 1) {
-        StreamSet * const MergedMatches = P->CreateStreamSet();
-        P->CreateKernelCall<StreamsMerge>(MatchResultsBufs, MergedMatches);
-        Matches = MergedMatches;
+        Matches = MatchResultsBufs[0];
+        if (MatchResultsBufs.size() > 1) {
+            StreamSet * const MergedMatches = P->CreateStreamSet();
+            P->CreateKernelCall<StreamsMerge>(MatchResultsBufs, MergedMatches);
+            Matches = MergedMatches;
+        }
     }
     if (hasComponent(mExternalComponents, Component::MoveMatchesToEOL)) {
         StreamSet * const MovedMatches = P->CreateStreamSet();
@@ -608,16 +1047,84 @@ StreamSet * GrepEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & P,
         P->CreateKernelCall<UntilNkernel>(maxCount, Matches, TruncatedMatches);
         Matches = TruncatedMatches;
     }
+    if (mPatternIds) {
+        Matches = patternIdsReport(P, MatchResultsBufs, Matches);
+    }
     return Matches;
 }
 
+StreamSet * GrepEngine::patternIdsReport(const std::unique_ptr<ProgramBuilder> & P, const std::vector<StreamSet *> & MatchResultsBufs, StreamSet * MatchedLineEnds) {
+    StreamSet * const PatternLines = P->CreateStreamSet(MatchResultsBufs.size(), 1);
+    P->CreateKernelCall<PatternLinesKernel>(MatchResultsBufs, mLineBreakStream, PatternLines);
+    StreamSet * const ReportedLineEnds = P->CreateStreamSet(1, 1);
+    Scalar * const callbackObject = P->getInputScalar("callbackObject");
+    Kernel * const k = P->CreateKernelCall<PatternIdsKernel>(MatchedLineEnds, PatternLines, ReportedLineEnds, callbackObject);
+    k->link("accumulate_pattern_ids_wrapper", accumulate_pattern_ids_wrapper);
+    return ReportedLineEnds;
+}
+
+
 
+std::string GrepEngine::makeProgramCacheKey(const std::string & programName) {
+    std::string key;
+    llvm::raw_string_ostream out(key);
+    out << "grep:" << programName
+        << "|K" << static_cast<unsigned>(mEngineKind)
+        << "|L" << static_cast<unsigned>(mGrepRecordBreak)
+        << "|B" << static_cast<unsigned>(mBinaryFilesMode)
+        << "|E" << static_cast<component_t>(mExternalComponents)
+        << "|I" << static_cast<component_t>(mInternalComponents)
+        << "|v" << mInvertMatches
+        << "|o" << mOnlyMatching
+        << "|b" << mByteOffsets << (mByteOffsets && mUnixByteOffsets)
+        << "|m" << (mMaxCount > 0)
+        << "|c" << mColoring
+        << "|C" << mBeforeContext << "," << mAfterContext
+        << "|p" << mPatternIds
+        << "|G" << PabloTransposition << SplitTransposition << UnicodeIndexing << PropertyKernels << MultithreadedSimpleRE << RequiredLiteralPrefilter << mASCIIBranch << (mLiteralSet != nullptr)
+        << "|" << ScanMatchBlocks << "," << MatchCoordinateBlocks << "," << ByteCClimit;
+    if (mSuffixRE) {
+        out << "|P" << Printer_RE::PrintRE(mPrefixRE) << "|S" << Printer_RE::PrintRE(mSuffixRE);
+    }
+    for (const re::RE * re : mREs) {
+        out << "|R" << Printer_RE::PrintRE(re);
+    }
+    // Names are printed without their definitions; record those of the external names in a stable order.
+    std::vector<std::string> names;
+    for (const re::Name * name : mExternalNames) {
+        std::string definition = Printer_RE::PrintRE(name);
+        if (name->getDefinition()) {
+            definition += "=" + Printer_RE::PrintRE(name->getDefinition());
+        }
+        names.emplace_back(std::move(definition));
+    }
+    std::sort(names.begin(), names.end());
+    for (const auto & name : names) {
+        out << "|N" << name;
+    }
+    out.flush();
+    return key;
+}
 
 // The QuietMode, MatchOnly and CountOnly engines share a common code generation main function,
 // which returns a count of the matches found (possibly subject to a MaxCount).
 //
 
 void GrepEngine::grepCodeGen() {
+    tuneSegmentSize();
+    mMainMethod = compileMainMethod(codegen::SegmentThreads);
+    if (haveLargeFile()) {
+        mLargeFileMethod = compileMainMethod(mLargeFileThreads);
+    }
+}
+
+void * GrepEngine::compileMainMethod(const unsigned numOfThreads) {
+    const auto programKey = makeProgramCacheKey("count/" + std::to_string(numOfThreads));
+    void * const cachedMethod = mGrepDriver.loadCachedProgram(programKey);
+    if (cachedMethod) {
+        return cachedMethod;
+    }
+
     auto & idb = mGrepDriver.getBuilder();
 
     auto P = mGrepDriver.makePipeline(
@@ -637,7 +1144,84 @@ void GrepEngine::grepCodeGen() {
     StreamSet * const Matches = grepPipeline(P, ByteStream);
     P->CreateKernelCall<PopcountKernel>(Matches, P->getOutputScalar("countResult"));
 
-    mMainMethod = P->compile();
+    P->setNumOfThreads(numOfThreads);
+    P->setProgramCacheKey(programKey);
+    return P->compile();
+}
+
+bool canMMap(const std::string & fileName);
+
+// The amount of the first input file used to calibrate the pipeline and the number
+// of timed runs at each setting, the fastest of which is taken.
+const size_t CalibrationBytes = 16 * 1024 * 1024;
+const unsigned CalibrationRuns = 3;
+
+// The engines that report matches share grepPipeline with the count pipeline, which
+// has no output to discard, so the count pipeline is timed for every engine kind.
+void GrepEngine::tuneSegmentSize() {
+    if (!codegen::Autotune) {
+        return;
+    }
+    std::string sampleFile;
+    for (const auto & path : mInputPaths) {
+        if (canMMap(path.string())) {
+            sampleFile = path.string();
+            break;
+        }
+    }
+    if (sampleFile.empty()) {
+        return;
+    }
+    FILE * const sample = std::tmpfile();
+    FILE * const source = std::fopen(sampleFile.c_str(), "rb");
+    if (sample == nullptr || source == nullptr) {
+        if (sample) std::fclose(sample);
+        if (source) std::fclose(source);
+        return;
+    }
+    std::vector<char> buffer(1024 * 1024);
+    size_t copied = 0;
+    while (copied < CalibrationBytes) {
+        const auto n = std::fread(buffer.data(), 1, std::min(buffer.size(), CalibrationBytes - copied), source);
+        if (n == 0 || std::fwrite(buffer.data(), 1, n, sample) != n) {
+            break;
+        }
+        copied += n;
+    }
+    std::fclose(source);
+    std::fflush(sample);
+    const int32_t sampleFD = fileno(sample);
+
+    typedef uint64_t (*GrepFunctionType)(bool useMMap, int32_t fileDescriptor, GrepCallBackObject *, size_t maxCount);
+    const auto initialSegmentSize = codegen::SegmentSize;
+    const auto programKey = makeProgramCacheKey("count/" + std::to_string(codegen::SegmentThreads));
+    const bool tuned = mGrepDriver.tuneSegmentSize(programKey, copied, [&]() -> double {
+        auto f = reinterpret_cast<GrepFunctionType>(GrepEngine::compileMainMethod(codegen::SegmentThreads));
+        double best = -1.0;
+        // the first run pages in the sample and the code of the pipeline and is not timed
+        for (unsigned i = 0; i <= CalibrationRuns; ++i) {
+            GrepCallBackObject handler;
+            handler.setLiteralSet(mLiteralSet.get());
+            if (mPatternIds) {
+                handler.setPatternCount(mREs.size(), false);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            f(true, sampleFD, &handler, std::numeric_limits<size_t>::max());
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (i > 0 && (best < 0 || elapsed.count() < best)) {
+                best = elapsed.count();
+            }
+        }
+        return best;
+    });
+    std::fclose(sample);
+    // the size thresholds for batching files and for large files are measured in segments
+    if (tuned && codegen::SegmentSize != initialSegmentSize) {
+        const auto paths = mInputPaths;
+        const auto largeFileThreads = mLargeFileThreads;
+        initFileResult(paths);
+        mLargeFileThreads = largeFileThreads;
+    }
 }
 
 //
@@ -652,7 +1236,7 @@ void EmitMatch::setFileLabel(std::string fileLabel) {
     } else mLinePrefix = "";
 }
 
-void EmitMatch::setStringStream(std::ostringstream * s) {
+void EmitMatch::setStringStream(std::ostream * s) {
     mResultStr = s;
 }
 
@@ -678,7 +1262,22 @@ void EmitMatch::setBatchLineNumber(unsigned fileNo, size_t batchLine) {
     mTerminated = true;
 }
 
+void EmitMatch::setOnlyMatching(const std::vector<re::RE *> & REs, const re::CC * breakCC, bool coloring, int maxCount) {
+    mSpanFinder = make_unique<MatchSpanFinder>(REs, breakCC);
+    mColorSpans = coloring;
+    mMaxLineCount = (maxCount > 0) ? maxCount : 0;
+}
+
+void EmitMatch::setLineOffset(const size_t offset) {
+    mLineOffset = offset;
+}
+
 void EmitMatch::accumulate_match (const size_t lineNum, char * line_start, char * line_end) {
+    if (LLVM_UNLIKELY(mSpanFinder != nullptr)) {
+        // Only lines without matches are reported with -o -v; nothing of them is written.
+        mLineCount++;
+        return;
+    }
     //llvm::errs() << "lineNum = " << lineNum << "\n";
     while ((mCurrentFile + 1 < mFileStartPositions.size()) && (mFileStartLineNumbers[mCurrentFile + 1] <= lineNum)) {
         mCurrentFile++;
@@ -700,6 +1299,17 @@ void EmitMatch::accumulate_match (const size_t lineNum, char * line_start, char
             *mResultStr << relLineNum+1 << ":";
         }
     }
+    if (mShowByteOffsets) {
+        *mResultStr << mLineOffset << (mInitialTab ? "\t:" : ":");
+    }
+    std::vector<unsigned> ids;
+    if (recordsPatternIds() && nextPatternIds(ids)) {
+        // Pattern ids are displayed from 1, in the order of the patterns.
+        for (unsigned i = 0; i < ids.size(); i++) {
+            *mResultStr << (i ? "," : "") << ids[i] + 1;
+        }
+        *mResultStr << (mInitialTab ? "\t:" : ":");
+    }
 
     const auto bytes = line_end - line_start + 1;
     mResultStr->write(line_start, bytes);
@@ -720,35 +1330,111 @@ void EmitMatch::accumulate_match (const size_t lineNum, char * line_start, char
     }
 }
 
+void EmitMatch::accumulate_spans(const size_t count, char * buffer_limit) {
+    for (size_t i = 0; i < count; ++i) {
+        const size_t * const record = &mSpanBatch[4 * i];
+        const size_t lineNum = record[0];
+        if (!mPendingEnds.empty() && (lineNum != mPendingLineNum)) {
+            emitPendingSpans(buffer_limit);
+        }
+        mPendingLineNum = lineNum;
+        mPendingLineStart = reinterpret_cast<char *>(record[1]);
+        mPendingEnds.push_back(reinterpret_cast<char *>(record[2]));
+        mPendingLineOffset = record[3];
+    }
+}
+
+void EmitMatch::emitPendingSpans(char * buffer_limit) {
+    if ((mMaxLineCount == 0) || (mLineCount < mMaxLineCount)) {
+        mSpans.clear();
+        mSpanFinder->findSpans(mPendingLineStart, buffer_limit, mPendingEnds, mSpans);
+        for (const auto & span : mSpans) {
+            *mResultStr << mLinePrefix;
+            if (mShowLineNumbers) {
+                *mResultStr << mPendingLineNum + 1 << (mInitialTab ? "\t:" : ":");
+            }
+            if (mShowByteOffsets) {
+                // With -o, the offset reported is that of the match itself.
+                *mResultStr << mPendingLineOffset + (span.first - mPendingLineStart) << (mInitialTab ? "\t:" : ":");
+            }
+            if (mColorSpans) {
+                *mResultStr << "\x1B[01;31m\x1B[K";
+                mResultStr->write(span.first, span.second - span.first);
+                *mResultStr << "\x1B[m\n";
+            } else {
+                mResultStr->write(span.first, span.second - span.first);
+                *mResultStr << "\n";
+            }
+        }
+        mLineCount++;
+    }
+    mPendingEnds.clear();
+}
+
 void EmitMatch::finalize_match(char * buffer_end) {
+    if (!mPendingEnds.empty()) {
+        emitPendingSpans(buffer_end);
+    }
     if (!mTerminated) *mResultStr << "\n";
 }
 
 void EmitMatchesEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & E, StreamSet * ByteStream, bool BatchMode) {
-    StreamSet * SourceStream = getBasis(E, ByteStream);
+    unsigned matchResultStreamCount = hasComponent(mExternalComponents, Component::MatchStarts) ? 2 : 1;
+    StreamSet * SourceStream = ByteStream;
+    StreamSet * Matches = nullptr;
+    std::vector<StreamSet *> MatchResultsBufs;
+    if (mLiteralSet) {
+        SourceStream = getBasis(*E, ByteStream);
+        grepPrologue(E, SourceStream);
+        Matches = literalSetGrep(E, ByteStream, SourceStream);
+    } else if (!mRequiredLiteral.empty()) {
+        grepPrologue(E, ByteStream);
+        Matches = requiredLiteralGrep(E, ByteStream, matchResultStreamCount);
+    } else {
+        SourceStream = getBasis(*E, ByteStream);
 
-    grepPrologue(E, SourceStream);
+        grepPrologue(E, SourceStream);
 
-    prepareExternalStreams(E, SourceStream);
+        prepareExternalStreams(E, SourceStream);
 
-    const auto numOfREs = mREs.size();
-    std::vector<StreamSet *> MatchResultsBufs(numOfREs);
+        const auto numOfREs = mREs.size();
+        MatchResultsBufs.resize(numOfREs);
 
-    unsigned matchResultStreamCount = (mColoring && !mInvertMatches) ? 2 : 1;
-    for(unsigned i = 0; i < numOfREs; ++i) {
-        StreamSet * const MatchResults = E->CreateStreamSet(matchResultStreamCount, 1);
-        MatchResultsBufs[i] = MatchResults;
-        if (UnicodeIndexing) {
-            UnicodeIndexedGrep(E, mREs[i], SourceStream, MatchResults);
-        } else {
-            U8indexedGrep(E, mREs[i], SourceStream, MatchResults);
+        for(unsigned i = 0; i < numOfREs; ++i) {
+            StreamSet * const MatchResults = E->CreateStreamSet(matchResultStreamCount, 1);
+            MatchResultsBufs[i] = MatchResults;
+            if (UnicodeIndexing) {
+                UnicodeIndexedGrep(E, mREs[i], SourceStream, MatchResults);
+            } else {
+                U8indexedGrep(*E, mREs[i], SourceStream, MatchResults);
+            }
+        }
+        Matches = MatchResultsBufs[0];
+        if (MatchResultsBufs.size() > 1) {
+            StreamSet * const MergedMatches = E->CreateStreamSet(matchResultStreamCount);
+            E->CreateKernelCall<StreamsMerge>(MatchResultsBufs, MergedMatches);
+            Matches = MergedMatches;
         }
     }
-    StreamSet * Matches = MatchResultsBufs[0];
-    if (MatchResultsBufs.size() > 1) {
-        StreamSet * const MergedMatches = E->CreateStreamSet(matchResultStreamCount);
-        E->CreateKernelCall<StreamsMerge>(MatchResultsBufs, MergedMatches);
-        Matches = MergedMatches;
+    // With -b, the coordinates of each match include the byte offset of its line.
+    // For -u, the LFs of CRLF line ends are marked so that their CRs are not counted.
+    const unsigned coordinateCount = mByteOffsets ? 4 : 3;
+    StreamSet * CRLF_LineFeeds = nullptr;
+    if (mByteOffsets && mUnixByteOffsets) {
+        CRLF_LineFeeds = E->CreateStreamSet(1, 1);
+        E->CreateKernelCall<CRLFKernel>(SourceStream, CRLF_LineFeeds);
+    }
+    if (mOnlyMatching && !mInvertMatches) {
+        // For -o, the end of every match is reported, a segment of matches at a time.
+        // The spans of the matches are then determined from their ends (see MatchSpanFinder).
+        StreamSet * MatchCoords = E->CreateStreamSet(4, sizeof(size_t) * 8);
+        E->CreateKernelCall<MatchCoordinatesKernel>(Matches, mLineBreakStream, MatchCoords, std::max(MatchCoordinateBlocks, 1), CRLF_LineFeeds);
+        Scalar * const callbackObject = E->getInputScalar("callbackObject");
+        Kernel * const spanK = E->CreateKernelCall<MatchSpanReporter>(ByteStream, MatchCoords, callbackObject);
+        spanK->link("get_span_batch_wrapper", get_span_batch_wrapper);
+        spanK->link("accumulate_spans_wrapper", accumulate_spans_wrapper);
+        spanK->link("finalize_match_wrapper", finalize_match_wrapper);
+        return;
     }
     StreamSet * MatchedLineEnds;
     if (hasComponent(mExternalComponents, Component::MatchStarts)) {
@@ -775,6 +1461,9 @@ void EmitMatchesEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & E,
         E->CreateKernelCall<UntilNkernel>(maxCount, MatchedLineEnds, TruncatedMatches);
         MatchedLineEnds = TruncatedMatches;
     }
+    if (mPatternIds) {
+        MatchedLineEnds = patternIdsReport(E, MatchResultsBufs, MatchedLineEnds);
+    }
 
     if (mColoring && !mInvertMatches) {
 
@@ -801,8 +1490,8 @@ void EmitMatchesEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & E,
             batchK->link("set_batch_line_number_wrapper", set_batch_line_number_wrapper);
             //E->CreateKernelCall<DebugDisplayKernel>("SourceCoords", SourceCoords);
         } else {
-            SourceCoords = E->CreateStreamSet(3, sizeof(size_t) * 8);
-            E->CreateKernelCall<MatchCoordinatesKernel>(MatchedLineEnds, mLineBreakStream, SourceCoords, 1);
+            SourceCoords = E->CreateStreamSet(coordinateCount, sizeof(size_t) * 8);
+            E->CreateKernelCall<MatchCoordinatesKernel>(MatchedLineEnds, mLineBreakStream, SourceCoords, 1, CRLF_LineFeeds);
         }
 
         StreamSet * LineStarts = E->CreateStreamSet(1, 1);
@@ -871,6 +1560,9 @@ void EmitMatchesEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & E,
 
         Scalar * const callbackObject = E->getInputScalar("callbackObject");
         Kernel * const matchK = E->CreateKernelCall<ColorizedReporter>(ColorizedBytes, SourceCoords, ColorizedCoords, callbackObject);
+        if (mByteOffsets && !BatchMode) {
+            matchK->link("set_line_offset_wrapper", set_line_offset_wrapper);
+        }
         matchK->link("accumulate_match_wrapper", accumulate_match_wrapper);
         matchK->link("finalize_match_wrapper", finalize_match_wrapper);
     } else { // Non colorized output
@@ -883,11 +1575,14 @@ void EmitMatchesEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & E,
             SpreadByMask(E, mLineBreakStream, ContextByLine, SelectedLines);
             MatchedLineEnds = SelectedLines;
         }
-        if (MatchCoordinateBlocks > 0) {
-            StreamSet * MatchCoords = E->CreateStreamSet(3, sizeof(size_t) * 8);
-            E->CreateKernelCall<MatchCoordinatesKernel>(MatchedLineEnds, mLineBreakStream, MatchCoords, MatchCoordinateBlocks);
+        if ((MatchCoordinateBlocks > 0) || (mByteOffsets && !BatchMode)) {
+            StreamSet * MatchCoords = E->CreateStreamSet(coordinateCount, sizeof(size_t) * 8);
+            E->CreateKernelCall<MatchCoordinatesKernel>(MatchedLineEnds, mLineBreakStream, MatchCoords, std::max(MatchCoordinateBlocks, 1), CRLF_LineFeeds);
             Scalar * const callbackObject = E->getInputScalar("callbackObject");
             Kernel * const matchK = E->CreateKernelCall<MatchReporter>(ByteStream, MatchCoords, callbackObject);
+            if (mByteOffsets) {
+                matchK->link("set_line_offset_wrapper", set_line_offset_wrapper);
+            }
             matchK->link("accumulate_match_wrapper", accumulate_match_wrapper);
             matchK->link("finalize_match_wrapper", finalize_match_wrapper);
         } else {
@@ -910,7 +1605,13 @@ void EmitMatchesEngine::grepPipeline(const std::unique_ptr<ProgramBuilder> & E,
     //E->CreateKernelCall<StdOutKernel>(ColorizedBytes);
 }
 
-void EmitMatchesEngine::grepCodeGen() {
+void * EmitMatchesEngine::compileMainMethod(const unsigned numOfThreads) {
+    const auto programKey = makeProgramCacheKey("emit/" + std::to_string(numOfThreads));
+    void * const cachedMethod = mGrepDriver.loadCachedProgram(programKey);
+    if (cachedMethod) {
+        return cachedMethod;
+    }
+
     auto & idb = mGrepDriver.getBuilder();
 
     auto E1 = mGrepDriver.makePipeline(
@@ -928,9 +1629,27 @@ void EmitMatchesEngine::grepCodeGen() {
     E1->CreateKernelCall<FDSourceKernel>(useMMap, fileDescriptor, ByteStream);
     grepPipeline(E1, ByteStream);
     E1->setOutputScalar("countResult", E1->CreateConstant(idb->getInt64(0)));
-    mMainMethod = E1->compile();
+    E1->setNumOfThreads(numOfThreads);
+    E1->setProgramCacheKey(programKey);
+    return E1->compile();
+}
+
+void EmitMatchesEngine::grepCodeGen() {
+    auto & idb = mGrepDriver.getBuilder();
+
+    tuneSegmentSize();
+
+    mMainMethod = compileMainMethod(codegen::SegmentThreads);
+    if (haveLargeFile()) {
+        mLargeFileMethod = compileMainMethod(mLargeFileThreads);
+    }
 
     if (haveFileBatch()) {
+        const auto batchKey = makeProgramCacheKey("emit-batch");
+        mBatchMethod = mGrepDriver.loadCachedProgram(batchKey);
+        if (mBatchMethod) {
+            return;
+        }
         auto E2 = mGrepDriver.makePipeline(
                     // inputs
                     {Binding{idb->getInt8PtrTy(), "buffer"},
@@ -946,6 +1665,7 @@ void EmitMatchesEngine::grepCodeGen() {
         E2->CreateKernelCall<MemorySourceKernel>(buffer, length, InternalBytes);
         grepPipeline(E2, InternalBytes, /* BatchMode = */ true);
         E2->setOutputScalar("countResult", E2->CreateConstant(idb->getInt64(0)));
+        E2->setProgramCacheKey(batchKey);
         mBatchMethod = E2->compile();
     }
 }
@@ -964,22 +1684,38 @@ bool canMMap(const std::string & fileName) {
 }
 
 
-uint64_t GrepEngine::doGrep(const std::vector<std::string> & fileNames, std::ostringstream & strm) {
-    typedef uint64_t (*GrepFunctionType)(bool useMMap, int32_t fileDescriptor, GrepCallBackObject *, size_t maxCount);
-    auto f = reinterpret_cast<GrepFunctionType>(mMainMethod);
+uint64_t GrepEngine::doGrep(const std::vector<std::string> & fileNames, ResultBuffer & results, const bool largeFile) {
+    std::ostream strm(&results);
+    void * const mainMethod = (largeFile && mLargeFileMethod) ? mLargeFileMethod : mMainMethod;
+    typedef uint64_t (*GrepFunctionType)(size_t useMMap, int32_t fileDescriptor, GrepCallBackObject *, size_t maxCount);
+    ProgramInstance<uint64_t, size_t, int32_t, GrepCallBackObject *, size_t> search(mGrepDriver, reinterpret_cast<GrepFunctionType>(mainMethod), fileNames.size() > 1);
     uint64_t resultTotal = 0;
 
     for (auto fileName : fileNames) {
         GrepCallBackObject handler;
+        handler.setLiteralSet(mLiteralSet.get());
+        if (mPatternIds) {
+            handler.setPatternCount(mREs.size(), false);
+        }
         bool useMMap = mPreferMMap && canMMap(fileName);
         int32_t fileDescriptor = openFile(fileName, strm);
-        if (fileDescriptor == -1) return 0;
-        uint64_t grepResult = f(useMMap, fileDescriptor, &handler, mMaxCount);
+        if (fileDescriptor == -1) {
+            return 0;
+        }
+        const uint64_t grepResult = search(useMMap, fileDescriptor, &handler, mMaxCount);
 
         close(fileDescriptor);
         if (handler.binaryFileSignalled()) {
             llvm::errs() << "Binary file " << fileName << "\n";
         }
+        else if (mPatternIds) {
+            // The matched line count of each pattern, numbered from 1.
+            const auto & counts = handler.getPatternCounts();
+            for (unsigned i = 0; i < counts.size(); i++) {
+                strm << linePrefix(fileName) << (i + 1) << ":" << counts[i] << "\n";
+            }
+            resultTotal += grepResult;
+        }
         else {
             showResult(grepResult, fileName, strm);
             resultTotal += grepResult;
@@ -999,26 +1735,36 @@ std::string GrepEngine::linePrefix(std::string fileName) {
 }
 
 // Default: do not show anything
-void GrepEngine::showResult(uint64_t grepResult, const std::string & fileName, std::ostringstream & strm) {
+void GrepEngine::showResult(uint64_t grepResult, const std::string & fileName, std::ostream & strm) {
 }
 
-void CountOnlyEngine::showResult(uint64_t grepResult, const std::string & fileName, std::ostringstream & strm) {
+void CountOnlyEngine::showResult(uint64_t grepResult, const std::string & fileName, std::ostream & strm) {
     if (mShowFileNames) strm << linePrefix(fileName);
     strm << grepResult << "\n";
 }
 
-void MatchOnlyEngine::showResult(uint64_t grepResult, const std::string & fileName, std::ostringstream & strm) {
+void MatchOnlyEngine::showResult(uint64_t grepResult, const std::string & fileName, std::ostream & strm) {
     if (grepResult == mRequiredCount) {
        strm << linePrefix(fileName);
     }
 }
 
-uint64_t EmitMatchesEngine::doGrep(const std::vector<std::string> & fileNames, std::ostringstream & strm) {
+uint64_t EmitMatchesEngine::doGrep(const std::vector<std::string> & fileNames, ResultBuffer & results, const bool largeFile) {
+    std::ostream strm(&results);
     if (fileNames.size() == 1) {
+        const auto initialSize = results.size();
         typedef uint64_t (*GrepFunctionType)(bool useMMap, int32_t fileDescriptor, EmitMatch *, size_t maxCount);
-        auto f = reinterpret_cast<GrepFunctionType>(mMainMethod);
+        auto f = reinterpret_cast<GrepFunctionType>((largeFile && mLargeFileMethod) ? mLargeFileMethod : mMainMethod);
         EmitMatch accum(mShowFileNames, mShowLineNumbers, ((mBeforeContext > 0) || (mAfterContext > 0)), mInitialTab);
         accum.setStringStream(&strm);
+        accum.setLiteralSet(mLiteralSet.get());
+        if (mPatternIds) {
+            accum.setPatternCount(mREs.size(), true);
+        }
+        if (mOnlyMatching) {
+            accum.setOnlyMatching(mREs, mBreakCC, mColoring, mMaxCount);
+        }
+        accum.showByteOffsets(mByteOffsets);
         bool useMMap;
         int32_t fileDescriptor;
         if (fileNames[0] == "-") {
@@ -1034,8 +1780,7 @@ uint64_t EmitMatchesEngine::doGrep(const std::vector<std::string> & fileNames, s
         f(useMMap, fileDescriptor, &accum, mMaxCount);
         close(fileDescriptor);
         if (accum.binaryFileSignalled()) {
-            accum.mResultStr->clear();
-            accum.mResultStr->str("");
+            results.truncate(initialSize);
         }
         if (accum.mLineCount > 0) grepMatchFound = true;
         return accum.mLineCount;
@@ -1046,6 +1791,10 @@ uint64_t EmitMatchesEngine::doGrep(const std::vector<std::string> & fileNames, s
         auto f = reinterpret_cast<GrepBatchFunctionType>(mBatchMethod);
         EmitMatch accum(mShowFileNames, mShowLineNumbers, ((mBeforeContext > 0) || (mAfterContext > 0)), mInitialTab);
         accum.setStringStream(&strm);
+        accum.setLiteralSet(mLiteralSet.get());
+        if (mPatternIds) {
+            accum.setPatternCount(mREs.size(), true);
+        }
         std::vector<int32_t> fileDescriptor(fileNames.size());
         std::vector<size_t> fileSize(fileNames.size(), 0);
         size_t cumulativeSize = 0;
@@ -1113,7 +1862,7 @@ uint64_t EmitMatchesEngine::doGrep(const std::vector<std::string> & fileNames, s
 }
 
 // Open a file and return its file desciptor.
-int32_t GrepEngine::openFile(const std::string & fileName, std::ostringstream & msgstrm) {
+int32_t GrepEngine::openFile(const std::string & fileName, std::ostream & msgstrm) {
     if (fileName == "-") {
         return STDIN_FILENO;
     }
@@ -1158,6 +1907,10 @@ void * DoGrepThreadFunction(void *args) {
 
 bool GrepEngine::searchAllFiles() {
     std::vector<pthread_t> threads(codegen::TaskThreads);
+    // A large file runs on as many segment threads as all of the task threads
+    // together; it waits for them to finish rather than running on top of them.
+    mThreadsInUse = 0;
+    mThreadBudget = std::max(codegen::TaskThreads * codegen::SegmentThreads, mLargeFileThreads);
 
     for(unsigned long i = 1; i < codegen::TaskThreads; ++i) {
         const int rc = pthread_create(&threads[i], nullptr, DoGrepThreadFunction, (void *)this);
@@ -1177,59 +1930,206 @@ bool GrepEngine::searchAllFiles() {
     return grepMatchFound;
 }
 
+// The number of segment threads of the pipeline that searches a file group.
+unsigned GrepEngine::segmentThreadsOf(const unsigned fileIdx) const {
+    if (mLargeFileGroup[fileIdx] && mLargeFileMethod) {
+        return mLargeFileThreads;
+    }
+    return codegen::SegmentThreads;
+}
+
+// Claim the next file group for a task thread.   Only groups within the reorder
+// window may be claimed, which bounds the results held awaiting output.   Within
+// the window, a thread takes the largest group dealt to it or else steals the
+// smallest group dealt to another thread, provided that the segment threads of
+// its pipeline fit in the thread budget.   A thread only waits while the window
+// holds no pending group, or while other pipelines use the threads a pending one
+// needs; either way some claimed group is being searched, and the budget admits
+// any one pipeline on its own, so this cannot deadlock.
+unsigned GrepEngine::claimFileGroup(const unsigned worker) {
+    const unsigned n = mFileGroups.size();
+    std::unique_lock<std::mutex> lock(mScheduleLock);
+    for (;;) {
+        if (mGroupsClaimed == n) {
+            return n;
+        }
+        const unsigned windowEnd = std::min(n, mNextFileToPrint + mOutputWindow);
+        unsigned own = n;
+        unsigned stolen = n;
+        for (unsigned i = mNextFileToPrint; i < windowEnd; ++i) {
+            if ((mFileStatus[i] != FileStatus::Pending) || (mThreadsInUse + segmentThreadsOf(i) > mThreadBudget)) {
+                continue;
+            }
+            if (mGroupOwner[i] == worker) {
+                if ((own == n) || (mGroupSizes[i] > mGroupSizes[own])) own = i;
+            } else {
+                if ((stolen == n) || (mGroupSizes[i] < mGroupSizes[stolen])) stolen = i;
+            }
+        }
+        const unsigned fileIdx = (own < n) ? own : stolen;
+        if (fileIdx < n) {
+            mFileStatus[fileIdx] = FileStatus::Claimed;
+            mGroupsClaimed++;
+            mThreadsInUse += segmentThreadsOf(fileIdx);
+            return fileIdx;
+        }
+        mScheduleCV.wait(lock);
+    }
+}
+
+// Mark a file group as searched.   Whichever thread completes the group at the
+// head of the output order writes out all consecutive completed results, outside
+// of the lock.
+void GrepEngine::completeFileGroup(const unsigned fileIdx) {
+    std::unique_lock<std::mutex> lock(mScheduleLock);
+    mFileStatus[fileIdx] = FileStatus::GrepComplete;
+    mThreadsInUse -= segmentThreadsOf(fileIdx);
+    if (mPrinting) {
+        // The active printer will pick up this result.
+        mScheduleCV.notify_all();
+        return;
+    }
+    mPrinting = true;
+    const unsigned n = mFileGroups.size();
+    while ((mNextFileToPrint < n) && (mFileStatus[mNextFileToPrint] == FileStatus::GrepComplete)) {
+        const unsigned first = mNextFileToPrint;
+        unsigned last = first;
+        std::vector<const ResultBuffer *> results;
+        while ((last < n) && (mFileStatus[last] == FileStatus::GrepComplete)) {
+            results.push_back(mResults[last].get());
+            last++;
+        }
+        lock.unlock();
+        writeResults(results);
+        lock.lock();
+        for (unsigned i = first; i < last; ++i) {
+            mResults[i].reset();
+            mFileStatus[i] = FileStatus::PrintComplete;
+        }
+        mNextFileToPrint = last;
+        mScheduleCV.notify_all();
+    }
+    mPrinting = false;
+    mScheduleCV.notify_all();
+}
+
+// Write out a sequence of results in order.
+void GrepEngine::writeResults(const std::vector<const ResultBuffer *> & results) {
+    std::vector<struct iovec> iov;
+    for (const ResultBuffer * r : results) {
+        r->appendTo(iov);
+    }
+    if (mOutputFD < 0) {
+        for (const auto & v : iov) {
+            mOutputStream->write(static_cast<const char *>(v.iov_base), v.iov_len);
+        }
+        return;
+    }
+    // Anything written through the output stream must precede these results.
+    mOutputStream->flush();
+    size_t k = 0;
+    while (k < iov.size()) {
+        const int count = static_cast<int>(std::min<size_t>(iov.size() - k, IOV_MAX));
+        const ssize_t written = writev(mOutputFD, &iov[k], count);
+        if (LLVM_UNLIKELY(written < 0)) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        size_t remaining = written;
+        while ((k < iov.size()) && (remaining >= iov[k].iov_len)) {
+            remaining -= iov[k].iov_len;
+            k++;
+        }
+        if (remaining > 0) {
+            iov[k].iov_base = static_cast<char *>(iov[k].iov_base) + remaining;
+            iov[k].iov_len -= remaining;
+        }
+    }
+}
+
 // DoGrep thread function.
 void * GrepEngine::DoGrepThreadMethod() {
 
-    unsigned fileIdx = mNextFileToGrep++;
+    const unsigned worker = mNextWorker++ % codegen::TaskThreads;
+    unsigned fileIdx = claimFileGroup(worker);
     while (fileIdx < mFileGroups.size()) {
-        const auto grepResult = doGrep(mFileGroups[fileIdx], mResultStrs[fileIdx]);
-        mFileStatus[fileIdx] = FileStatus::GrepComplete;
+        mResults[fileIdx].reset(new ResultBuffer());
+        const auto grepResult = doGrep(mFileGroups[fileIdx], *mResults[fileIdx], mLargeFileGroup[fileIdx]);
         if (grepResult > 0) {
             grepMatchFound = true;
         }
+        completeFileGroup(fileIdx);
         if ((mEngineKind == EngineKind::QuietMode) && grepMatchFound) {
             if (pthread_self() != mEngineThread) {
                 pthread_exit(nullptr);
             }
             return nullptr;
         }
-        fileIdx = mNextFileToGrep++;
-        if (pthread_self() == mEngineThread) {
-            while ((mNextFileToPrint < mFileGroups.size()) && (mFileStatus[mNextFileToPrint] == FileStatus::GrepComplete)) {
-                const auto output = mResultStrs[mNextFileToPrint].str();
-                if (!output.empty()) {
-                    llvm::outs() << output;
-                }
-                mFileStatus[mNextFileToPrint] = FileStatus::PrintComplete;
-                mNextFileToPrint++;
-            }
-        }
+        fileIdx = claimFileGroup(worker);
     }
     if (pthread_self() != mEngineThread) {
         pthread_exit(nullptr);
     }
-    while (mNextFileToPrint < mFileGroups.size()) {
-        const bool readyToPrint = (mFileStatus[mNextFileToPrint] == FileStatus::GrepComplete);
-        if (readyToPrint) {
-            const auto output = mResultStrs[mNextFileToPrint].str();
-            if (!output.empty()) {
-                llvm::outs() << output;
-            }
-            mFileStatus[mNextFileToPrint] = FileStatus::PrintComplete;
-            mNextFileToPrint++;
-        } else {
-            sched_yield();
-        }
+    {
+        std::unique_lock<std::mutex> lock(mScheduleLock);
+        mScheduleCV.wait(lock, [&]{return (mNextFileToPrint == mFileGroups.size()) && !mPrinting;});
     }
     if (mGrepStdIn) {
-        std::ostringstream s;
-        const auto grepResult = doGrep({"-"}, s);
-        llvm::outs() << s.str();
+        ResultBuffer results;
+        const auto grepResult = doGrep({"-"}, results);
+        writeResults({&results});
         if (grepResult) grepMatchFound = true;
     }
     return nullptr;
 }
 
+size_t ResultBuffer::size() const {
+    if (mChunks.empty()) return 0;
+    return (mCurrent * ChunkSize) + (pptr() - pbase());
+}
+
+void ResultBuffer::truncate(const size_t n) {
+    if (n >= size()) return;
+    mCurrent = n / ChunkSize;
+    char * const chunk = mChunks[mCurrent].get();
+    setp(chunk, chunk + ChunkSize);
+    pbump(static_cast<int>(n % ChunkSize));
+}
+
+void ResultBuffer::clear() {
+    if (mChunks.empty()) return;
+    mChunks.resize(1);
+    mCurrent = 0;
+    setp(mChunks[0].get(), mChunks[0].get() + ChunkSize);
+}
+
+void ResultBuffer::appendTo(std::vector<struct iovec> & iov) const {
+    if (mChunks.empty()) return;
+    for (unsigned i = 0; i < mCurrent; ++i) {
+        iov.push_back({mChunks[i].get(), ChunkSize});
+    }
+    if (pptr() != pbase()) {
+        iov.push_back({pbase(), static_cast<size_t>(pptr() - pbase())});
+    }
+}
+
+ResultBuffer::int_type ResultBuffer::overflow(int_type c) {
+    if (!mChunks.empty()) {
+        mCurrent++;
+    }
+    if (mCurrent == mChunks.size()) {
+        mChunks.emplace_back(new char[ChunkSize]);
+    }
+    char * const chunk = mChunks[mCurrent].get();
+    setp(chunk, chunk + ChunkSize);
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
 InternalSearchEngine::InternalSearchEngine(BaseDriver &driver) :
     mGrepRecordBreak(GrepRecordBreakKind::LF),
     mCaseInsensitive(false),
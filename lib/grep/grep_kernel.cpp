@@ -592,6 +592,189 @@ void ContextSpan::generatePabloMethod() {
     pb.createAssign(pb.createExtract(getOutputStreamVar("contextStream"), pb.getInteger(0)), pb.createInFile(consecutive));
 }
 
+// Extend each mark to cover lgth consecutive positions, beginning at the mark.
+static PabloAST * spanFrom(PabloBuilder & pb, PabloAST * marks, const unsigned lgth, const std::string & prefix) {
+    PabloAST * consecutive = marks;
+    unsigned consecutiveCount = 1;
+    for (unsigned i = 1; i <= lgth/2; i *= 2) {
+        consecutiveCount += i;
+        consecutive = pb.createOr(consecutive, pb.createAdvance(consecutive, i), prefix + std::to_string(consecutiveCount));
+    }
+    if (consecutiveCount < lgth) {
+        consecutive = pb.createOr(consecutive, pb.createAdvance(consecutive, lgth - consecutiveCount), prefix + std::to_string(lgth));
+    }
+    return consecutive;
+}
+
+RequiredLiteralLinesKernel::RequiredLiteralLinesKernel(BuilderRef b, StreamSet * const LiteralEnds, StreamSet * const LineBreakStream, StreamSet * const CandidateLines, unsigned window)
+: PabloKernel(b, "RequiredLiteralLines" + std::to_string(round_up_to_blocksize(window)),
+// inputs
+{Binding{"literalEnds", LiteralEnds, FixedRate(1), {ZeroExtended(), LookAhead(round_up_to_blocksize(window))}},
+ Binding{"lineBreaks", LineBreakStream, FixedRate(1), {ZeroExtended(), LookAhead(round_up_to_blocksize(window))}}},
+// output
+{Binding{"candidateLines", CandidateLines}}),
+mWindow(round_up_to_blocksize(window)) {
+}
+
+void RequiredLiteralLinesKernel::generatePabloMethod() {
+    PabloBuilder pb(getEntryScope());
+    Var * const literalEnds = pb.createExtract(getInputStreamVar("literalEnds"), pb.getInteger(0));
+    Var * const lineBreaks = pb.createExtract(getInputStreamVar("lineBreaks"), pb.getInteger(0));
+    // From each occurrence to the end of its line, including the line break.
+    PabloAST * const toLineEnd = pb.createMatchStar(literalEnds, pb.createNot(lineBreaks), "toLineEnd");
+    // Positions within the window preceding an occurrence.
+    PabloAST * const literalAhead = pb.createLookahead(literalEnds, pb.getInteger(mWindow));
+    PabloAST * const beforeLiteral = spanFrom(pb, literalAhead, mWindow + 1, "beforeLiteral");
+    // Positions from which no line break occurs within the window.   Any line
+    // start more than the window before an occurrence is marked in this way,
+    // together with the line break preceding the line.
+    PabloAST * const breakAhead = pb.createLookahead(lineBreaks, pb.getInteger(mWindow));
+    PabloAST * const breakWithinWindow = spanFrom(pb, breakAhead, mWindow, "breakWithinWindow");
+    PabloAST * const longLine = pb.createNot(breakWithinWindow, "longLine");
+    PabloAST * const candidates = pb.createOr3(toLineEnd, beforeLiteral, longLine);
+    pb.createAssign(pb.createExtract(getOutputStreamVar("candidateLines"), pb.getInteger(0)), pb.createInFile(candidates));
+}
+
+NoMatchesKernel::NoMatchesKernel(BuilderRef b, StreamSet * const LineBreakStream, StreamSet * const Matches)
+: PabloKernel(b, "NoMatches" + std::to_string(Matches->getNumElements()),
+// inputs
+{Binding{"lineBreaks", LineBreakStream}},
+// output
+{Binding{"matches", Matches}}) {
+}
+
+void NoMatchesKernel::generatePabloMethod() {
+    PabloBuilder pb(getEntryScope());
+    Var * const matches = getOutputStreamVar("matches");
+    for (unsigned i = 0; i < getOutputStreamSet(0)->getNumElements(); ++i) {
+        pb.createAssign(pb.createExtract(matches, pb.getInteger(i)), pb.createZeroes());
+    }
+}
+
+NonASCIIRegionKernel::NonASCIIRegionKernel(BuilderRef b, StreamSet * const Source, StreamSet * const NonASCIIRegion)
+: PabloKernel(b, "NonASCIIRegion" + std::to_string(Source->getNumElements()) + "x" + std::to_string(Source->getFieldWidth()),
+// input
+{Binding{"source", Source}},
+// output
+{Binding{"nonASCIIRegion", NonASCIIRegion}}) {
+}
+
+void NonASCIIRegionKernel::generatePabloMethod() {
+    PabloBuilder pb(getEntryScope());
+    std::unique_ptr<cc::CC_Compiler> ccc;
+    bool useDirectCC = getInput(0)->getType()->getArrayNumElements() == 1;
+    if (useDirectCC) {
+        ccc = std::make_unique<cc::Direct_CC_Compiler>(getEntryScope(), pb.createExtract(getInput(0), pb.getInteger(0)));
+    } else {
+        ccc = std::make_unique<cc::Parabix_CC_Compiler_Builder>(getEntryScope(), getInputStreamSet("source"));
+    }
+    PabloAST * const nonASCII = ccc->compileCC(makeByte(0x80, 0xFF));
+    PabloAST * const region = spanFrom(pb, nonASCII, 4, "nonASCIIRegion");
+    pb.createAssign(pb.createExtract(getOutputStreamVar("nonASCIIRegion"), pb.getInteger(0)), pb.createInFile(region));
+}
+
+LiteralSetKernel::LiteralSetKernel(BuilderRef b, StreamSet * const ByteStream, StreamSet * const WindowHashes, StreamSet * const Marks,
+                                   Scalar * const callbackObject, unsigned windowLength, unsigned maxLength)
+: MultiBlockKernel(b, "LiteralSet" + std::to_string(windowLength) + "_" + std::to_string(maxLength),
+// inputs
+{Binding{"bytes", ByteStream, FixedRate(1), LookAhead(maxLength)},
+ Binding{"hashes", WindowHashes, FixedRate(1), LookAhead(windowLength)}},
+// output
+{Binding{"marks", Marks}},
+// input scalars
+{Binding{"callbackObject", callbackObject}},
+// output scalars
+{},
+// kernel state
+{}) {
+    assert (WindowHashes->getFieldWidth() == 16);
+}
+
+void LiteralSetKernel::generateMultiBlockLogic(BuilderRef b, Value * const numOfStrides) {
+    Module * const m = b->getModule();
+    Value * const processed = b->getProcessedItemCount("bytes");
+    Value * const avail = b->CreateSub(b->getAvailableItemCount("bytes"), processed);
+    Value * const count = b->CreateUMin(b->CreateMul(numOfStrides, b->getSize(getStride())), avail);
+    Value * const bytes = b->getRawInputPointer("bytes", processed);
+    Value * const hashes = b->getRawInputPointer("hashes", processed);
+    Value * const marks = b->getOutputStreamBlockPtr("marks", b->getInt32(0));
+    Function * const markLiterals = m->getFunction("mark_literals_wrapper"); assert (markLiterals);
+    FunctionType * const fTy = markLiterals->getFunctionType();
+    b->CreateCall(fTy, markLiterals, {b->getScalarField("callbackObject"),
+                                      b->CreatePointerCast(bytes, fTy->getParamType(1)),
+                                      b->CreatePointerCast(hashes, fTy->getParamType(2)),
+                                      count, avail,
+                                      b->CreatePointerCast(marks, fTy->getParamType(5))});
+}
+
+static Bindings makePatternMatchBindings(const std::vector<StreamSet *> & PatternMatches, StreamSet * LineBreakStream) {
+    Bindings inputs;
+    for (unsigned i = 0; i < PatternMatches.size(); i++) {
+        inputs.emplace_back("matches" + std::to_string(i), PatternMatches[i]);
+    }
+    inputs.emplace_back("lineBreaks", LineBreakStream, FixedRate());
+    return inputs;
+}
+
+PatternLinesKernel::PatternLinesKernel(BuilderRef b, const std::vector<StreamSet *> & PatternMatches, StreamSet * LineBreakStream, StreamSet * PatternLines)
+: PabloKernel(b, "PatternLines" + std::to_string(PatternMatches.size()),
+// inputs
+makePatternMatchBindings(PatternMatches, LineBreakStream),
+// output
+{Binding{"patternLines", PatternLines}}) {
+    assert (PatternLines->getNumElements() == PatternMatches.size());
+}
+
+void PatternLinesKernel::generatePabloMethod() {
+    PabloBuilder pb(getEntryScope());
+    PabloAST * lineBreaks = pb.createExtract(getInputStreamVar("lineBreaks"), pb.getInteger(0));
+    PabloAST * notLB = pb.createNot(lineBreaks);
+    Var * const patternLines = getOutputStreamVar("patternLines");
+    const unsigned n = getOutputStreamSet(0)->getNumElements();
+    for (unsigned i = 0; i < n; i++) {
+        auto matches = getInputStreamSet("matches" + std::to_string(i));
+        PabloAST * match_follow = pb.createMatchStar(matches.back(), notLB);
+        pb.createAssign(pb.createExtract(patternLines, pb.getInteger(i)), pb.createAnd(match_follow, lineBreaks));
+    }
+}
+
+PatternIdsKernel::PatternIdsKernel(BuilderRef b, StreamSet * const MatchedLineEnds, StreamSet * const PatternLines, StreamSet * const ReportedLineEnds, Scalar * const callbackObject)
+: MultiBlockKernel(b, "PatternIds" + std::to_string(PatternLines->getNumElements()),
+// inputs
+{Binding{"matchedLineEnds", MatchedLineEnds},
+ Binding{"patternLines", PatternLines}},
+// output
+{Binding{"reportedLineEnds", ReportedLineEnds}},
+// input scalars
+{Binding{"callbackObject", callbackObject}},
+// output scalars
+{},
+// kernel state
+{}) {
+
+}
+
+void PatternIdsKernel::generateMultiBlockLogic(BuilderRef b, Value * const numOfStrides) {
+    Module * const m = b->getModule();
+    Value * const processed = b->getProcessedItemCount("matchedLineEnds");
+    Value * const avail = b->CreateSub(b->getAvailableItemCount("matchedLineEnds"), processed);
+    Value * const count = b->CreateUMin(b->CreateMul(numOfStrides, b->getSize(getStride())), avail);
+    // The patternLines streams of a block follow one another, so that the words of
+    // pattern i of a block are at offset i * wordsPerBlock from those of pattern 0.
+    Value * const lineEnds = b->getInputStreamBlockPtr("matchedLineEnds", b->getInt32(0));
+    Value * const patternLines = b->getInputStreamBlockPtr("patternLines", b->getInt32(0));
+    Value * const reported = b->getOutputStreamBlockPtr("reportedLineEnds", b->getInt32(0));
+    const unsigned wordsPerBlock = b->getBitBlockWidth() / 64;
+    const unsigned patternCount = getInputStreamSet(1)->getNumElements();
+    Function * const accumulate = m->getFunction("accumulate_pattern_ids_wrapper"); assert (accumulate);
+    FunctionType * const fTy = accumulate->getFunctionType();
+    b->CreateCall(fTy, accumulate, {b->getScalarField("callbackObject"),
+                                    b->CreatePointerCast(lineEnds, fTy->getParamType(1)),
+                                    b->CreatePointerCast(patternLines, fTy->getParamType(2)),
+                                    count, b->getInt32(wordsPerBlock), b->getInt32(patternCount),
+                                    b->CreatePointerCast(reported, fTy->getParamType(6))});
+}
+
 void kernel::GraphemeClusterLogic(const std::unique_ptr<ProgramBuilder> & P, UTF8_Transformer * t,
                                   StreamSet * Source, StreamSet * U8index, StreamSet * GCBstream) {
     
@@ -42,6 +42,18 @@ static cl::opt<int, true> OptMatchCoordinateBlocks("match-coordinates", cl::loca
 unsigned ByteCClimit;
 static cl::opt<unsigned, true> OptByteCClimit("byte-CC-limit", cl::location(ByteCClimit),
                                               cl::desc("Max number of CCs for byte CC pipeline."), cl::init(DefaultByteCClimit));
+bool RequiredLiteralPrefilter;
+static cl::opt<bool, true> OptRequiredLiteralPrefilter("enable-literal-prefilter", cl::location(RequiredLiteralPrefilter),
+                                                       cl::desc("Skip segments without an occurrence of a literal required by the regular expression."), cl::init(true));
+
+bool ASCIIFastPath;
+static cl::opt<bool, true> OptASCIIFastPath("enable-ascii-fast-path", cl::location(ASCIIFastPath),
+                                            cl::desc("Compute Unicode properties of pure ASCII segments from their ASCII subsets."), cl::init(true));
+
+unsigned LiteralSetThreshold;
+static cl::opt<unsigned, true> OptLiteralSetThreshold("literal-set-threshold", cl::location(LiteralSetThreshold),
+                                                      cl::desc("Search for sets of at least this many literals by hashing (0 to disable)."), cl::init(64));
+
 bool TraceFiles;
 static cl::opt<bool, true> OptTraceFiles("TraceFiles", cl::location(TraceFiles),
                                          cl::desc("Report files as they are opened."), cl::init(false));
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ */
+
+#include <grep/literal_set.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <kernel/util/bixhash.h>
+
+namespace grep {
+
+const unsigned MaxWindowSteps = 3;
+const unsigned SecondaryHashBits = 20;
+
+LiteralSet::LiteralSet(std::vector<std::string> literals)
+: mLiterals(std::move(literals))
+, mWindowSteps(MaxWindowSteps)
+, mMaxLength(0)
+, mHashFilter((1 << HashBits) / 64, 0)
+, mSecondaryFilter((1 << SecondaryHashBits) / 64, 0)
+, mBucketStart((1 << HashBits) + 1, 0) {
+    std::sort(mLiterals.begin(), mLiterals.end());
+    mLiterals.erase(std::unique(mLiterals.begin(), mLiterals.end()), mLiterals.end());
+    for (const std::string & lit : mLiterals) {
+        assert (!lit.empty());
+        while (lit.size() < getWindowLength()) {
+            mWindowSteps--;
+        }
+        mMaxLength = std::max<unsigned>(mMaxLength, lit.size());
+    }
+    std::vector<unsigned> hashes;
+    hashes.reserve(mLiterals.size());
+    for (const std::string & lit : mLiterals) {
+        const unsigned h = kernel::windowHash(reinterpret_cast<const unsigned char *>(lit.data()), HashBits, mWindowSteps);
+        mHashFilter[h / 64] |= static_cast<uint64_t>(1) << (h % 64);
+        const unsigned s = secondaryHash(lit.data());
+        mSecondaryFilter[s / 64] |= static_cast<uint64_t>(1) << (s % 64);
+        mBucketStart[h + 1]++;
+        hashes.push_back(h);
+    }
+    for (unsigned h = 0; h < (1 << HashBits); h++) {
+        mBucketStart[h + 1] += mBucketStart[h];
+    }
+    mOrder.resize(mLiterals.size());
+    std::vector<uint32_t> next(mBucketStart.begin(), mBucketStart.end() - 1);
+    for (unsigned i = 0; i < mLiterals.size(); i++) {
+        mOrder[next[hashes[i]]++] = i;
+    }
+}
+
+uint64_t LiteralSet::windowBits(const char * window, const unsigned lgth) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, window, lgth);
+    return bits;
+}
+
+// A multiplicative hash of the window bytes, independent of the window hash.
+unsigned LiteralSet::secondaryHash(const char * window) const {
+    return (windowBits(window, getWindowLength()) * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - SecondaryHashBits);
+}
+
+void LiteralSet::markOccurrences(const char * bytes, const uint16_t * hashes, const size_t count, const size_t avail, uint64_t * marks) const {
+    const unsigned lgth = getWindowLength();
+    std::fill(marks, marks + (count + 63) / 64, 0);
+    const size_t limit = (avail < lgth) ? 0 : std::min(count, avail - lgth + 1);
+    for (size_t pos = 0; pos < limit; pos++) {
+        const unsigned h = hashes[pos + lgth - 1];
+        if ((mHashFilter[h / 64] & (static_cast<uint64_t>(1) << (h % 64))) == 0) {
+            continue;
+        }
+        const unsigned s = secondaryHash(bytes + pos);
+        if ((mSecondaryFilter[s / 64] & (static_cast<uint64_t>(1) << (s % 64))) == 0) {
+            continue;
+        }
+        for (uint32_t i = mBucketStart[h]; i < mBucketStart[h + 1]; i++) {
+            const std::string & lit = mLiterals[mOrder[i]];
+            if ((lit.size() <= avail - pos) && (std::memcmp(bytes + pos, lit.data(), lit.size()) == 0)) {
+                marks[pos / 64] |= static_cast<uint64_t>(1) << (pos % 64);
+                break;
+            }
+        }
+    }
+}
+
+}
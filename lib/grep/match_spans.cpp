@@ -0,0 +1,329 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ */
+
+#include <grep/match_spans.h>
+
+#include <algorithm>
+#include <llvm/Support/Casting.h>
+#include <re/adt/adt.h>
+#include <re/alphabet/alphabet.h>
+#include <re/analysis/re_analysis.h>
+
+using namespace llvm;
+using namespace re;
+
+namespace grep {
+
+inline bool isContinuationByte(const char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+constexpr int MatchSpanFinder::NotReached;
+
+MatchSpanFinder::MatchSpanFinder(const std::vector<RE *> & REs, const CC * breakCC)
+: mREs(REs)
+, mBreakCC(breakCC)
+, mBreakCodepoint(lo_codepoint(breakCC->front()))
+, mFixedLength(-1) {
+    for (unsigned i = 0; i < mREs.size(); ++i) {
+        const auto range = getLengthRange(mREs[i], &cc::Unicode);
+        if ((range.first != range.second) || ((i > 0) && (range.first != mFixedLength))) {
+            mFixedLength = -1;
+            break;
+        }
+        mFixedLength = range.first;
+    }
+}
+
+bool MatchSpanFinder::isSupported() const {
+    if (mFixedLength >= 0) {
+        return true;
+    }
+    for (const RE * re : mREs) {
+        if (!supported(re)) return false;
+    }
+    return true;
+}
+
+bool MatchSpanFinder::supported(const RE * re) const {
+    if (const CC * cc = dyn_cast<CC>(re)) {
+        return cc->getAlphabet() == &cc::Unicode;
+    } else if (isa<Any>(re) || isa<Start>(re) || isa<End>(re)) {
+        return true;
+    } else if (const Name * n = dyn_cast<Name>(re)) {
+        return n->getDefinition() && supported(n->getDefinition());
+    } else if (const Seq * seq = dyn_cast<Seq>(re)) {
+        return std::all_of(seq->begin(), seq->end(), [this](const RE * e) {return supported(e);});
+    } else if (const Alt * alt = dyn_cast<Alt>(re)) {
+        return std::all_of(alt->begin(), alt->end(), [this](const RE * e) {return supported(e);});
+    } else if (const Rep * rep = dyn_cast<Rep>(re)) {
+        return supported(rep->getRE());
+    } else if (const Assertion * a = dyn_cast<Assertion>(re)) {
+        if (a->getKind() == Assertion::Kind::Boundary) {
+            return isCharacterClass(a->getAsserted());
+        }
+        return supported(a->getAsserted());
+    } else if (isa<Diff>(re) || isa<Intersect>(re)) {
+        return isCharacterClass(re);
+    }
+    return false;
+}
+
+// Whether re matches exactly one code point from a set that matchesCodepoint can test.
+bool MatchSpanFinder::isCharacterClass(const RE * re) const {
+    if (const CC * cc = dyn_cast<CC>(re)) {
+        return cc->getAlphabet() == &cc::Unicode;
+    } else if (isa<Any>(re)) {
+        return true;
+    } else if (const Name * n = dyn_cast<Name>(re)) {
+        return n->getDefinition() && isCharacterClass(n->getDefinition());
+    } else if (const Alt * alt = dyn_cast<Alt>(re)) {
+        return !alt->empty() && std::all_of(alt->begin(), alt->end(), [this](const RE * e) {return isCharacterClass(e);});
+    } else if (const Diff * d = dyn_cast<Diff>(re)) {
+        return isCharacterClass(d->getLH()) && isCharacterClass(d->getRH());
+    } else if (const Intersect * x = dyn_cast<Intersect>(re)) {
+        return isCharacterClass(x->getLH()) && isCharacterClass(x->getRH());
+    }
+    return false;
+}
+
+bool MatchSpanFinder::matchesCodepoint(const RE * re, const UCD::codepoint_t cp) const {
+    if (const CC * cc = dyn_cast<CC>(re)) {
+        return cc->contains(cp);
+    } else if (isa<Any>(re)) {
+        return !mBreakCC->contains(cp);
+    } else if (const Name * n = dyn_cast<Name>(re)) {
+        return matchesCodepoint(n->getDefinition(), cp);
+    } else if (const Alt * alt = dyn_cast<Alt>(re)) {
+        return std::any_of(alt->begin(), alt->end(), [&](const RE * e) {return matchesCodepoint(e, cp);});
+    } else if (const Diff * d = dyn_cast<Diff>(re)) {
+        return matchesCodepoint(d->getLH(), cp) && !matchesCodepoint(d->getRH(), cp);
+    } else if (const Intersect * x = dyn_cast<Intersect>(re)) {
+        return matchesCodepoint(x->getLH(), cp) && matchesCodepoint(x->getRH(), cp);
+    }
+    return false;
+}
+
+// Positions outside of the line see the line break.
+UCD::codepoint_t MatchSpanFinder::codepointAt(const int pos) const {
+    if ((pos < 0) || (pos >= static_cast<int>(mText.size()))) {
+        return mBreakCodepoint;
+    }
+    return mText[pos];
+}
+
+// Given the positions from which matching proceeds, return the positions at
+// which re may end.   Positions lie between code points, so a line of n code
+// points has n + 1 positions.   In reverse, matching proceeds from the positions
+// at which re ends and returns those at which it may start.   Each marker carries
+// a value and the value of a position reached is the greatest of the markers it
+// is reached from; a position that is not reached is NotReached.
+MatchSpanFinder::Markers MatchSpanFinder::advance(const RE * re, const Markers & markers, const bool reverse) const {
+    const auto n = mText.size();
+    if (isCharacterClass(re)) {
+        Markers result(n + 1, NotReached);
+        for (unsigned p = 0; p < n; ++p) {
+            if (matchesCodepoint(re, mText[p])) {
+                result[reverse ? p : p + 1] = markers[reverse ? p + 1 : p];
+            }
+        }
+        return result;
+    } else if (const Name * name = dyn_cast<Name>(re)) {
+        return advance(name->getDefinition(), markers, reverse);
+    } else if (const Seq * seq = dyn_cast<Seq>(re)) {
+        Markers result = markers;
+        const auto step = [&](const RE * e) {
+            result = advance(e, result, reverse);
+            return anyReached(result);
+        };
+        if (reverse) {
+            for (auto i = seq->rbegin(); (i != seq->rend()) && step(*i); ++i);
+        } else {
+            for (auto i = seq->begin(); (i != seq->end()) && step(*i); ++i);
+        }
+        return result;
+    } else if (const Alt * alt = dyn_cast<Alt>(re)) {
+        Markers result(n + 1, NotReached);
+        for (const RE * e : *alt) {
+            const Markers m = advance(e, markers, reverse);
+            for (unsigned p = 0; p <= n; ++p) {
+                result[p] = std::max(result[p], m[p]);
+            }
+        }
+        return result;
+    } else if (const Rep * rep = dyn_cast<Rep>(re)) {
+        Markers result = markers;
+        for (int i = 0; i < rep->getLB(); ++i) {
+            result = advance(rep->getRE(), result, reverse);
+        }
+        if ((rep->getUB() == Rep::UNBOUNDED_REP) && isCharacterClass(rep->getRE())) {
+            // A run of the class is followed in a single scan of the line.
+            for (unsigned i = 0; i < n; ++i) {
+                const auto p = reverse ? n - 1 - i : i;
+                if (matchesCodepoint(rep->getRE(), mText[p])) {
+                    const auto from = reverse ? p + 1 : p;
+                    const auto to = reverse ? p : p + 1;
+                    result[to] = std::max(result[to], result[from]);
+                }
+            }
+            return result;
+        }
+        // Each further repetition only needs to proceed from the positions whose value increased.
+        Markers frontier = result;
+        for (int i = rep->getLB(); (rep->getUB() == Rep::UNBOUNDED_REP) || (i < rep->getUB()); ++i) {
+            frontier = advance(rep->getRE(), frontier, reverse);
+            bool extended = false;
+            for (unsigned p = 0; p <= n; ++p) {
+                if (frontier[p] > result[p]) {
+                    result[p] = frontier[p];
+                    extended = true;
+                } else {
+                    frontier[p] = NotReached;
+                }
+            }
+            if (!extended) break;
+        }
+        return result;
+    }
+    // Anchors and assertions hold at a position regardless of the direction of matching.
+    return filterAssertion(re, markers);
+}
+
+bool MatchSpanFinder::anyReached(const Markers & markers) {
+    return std::any_of(markers.begin(), markers.end(), [](const int v) {return v != NotReached;});
+}
+
+MatchSpanFinder::Markers MatchSpanFinder::filterAssertion(const RE * re, const Markers & markers) const {
+    const auto n = mText.size();
+    Markers result(n + 1, NotReached);
+    if (isa<Start>(re)) {
+        result[0] = markers[0];
+    } else if (isa<End>(re)) {
+        result[n] = markers[n];
+    } else if (const Assertion * a = dyn_cast<Assertion>(re)) {
+        const RE * const asserted = a->getAsserted();
+        const bool negated = a->getSense() == Assertion::Sense::Negative;
+        const bool unitLength = isCharacterClass(asserted);
+        for (unsigned p = 0; p <= n; ++p) {
+            if (markers[p] == NotReached) continue;
+            bool holds = false;
+            if (a->getKind() == Assertion::Kind::Boundary) {
+                holds = matchesCodepoint(asserted, codepointAt(static_cast<int>(p) - 1)) != matchesCodepoint(asserted, codepointAt(p));
+            } else if (unitLength) {
+                const int q = (a->getKind() == Assertion::Kind::LookBehind) ? static_cast<int>(p) - 1 : static_cast<int>(p);
+                holds = matchesCodepoint(asserted, codepointAt(q));
+            } else {
+                // A lookbehind holds if the asserted expression, matched in reverse from p, starts anywhere.
+                Markers from(n + 1, NotReached);
+                from[p] = 0;
+                holds = anyReached(advance(asserted, from, a->getKind() == Assertion::Kind::LookBehind));
+            }
+            if (holds != negated) {
+                result[p] = markers[p];
+            }
+        }
+    }
+    return result;
+}
+
+void MatchSpanFinder::decodeLine(char * lineStart, char * limit) {
+    mText.clear();
+    mOffsets.clear();
+    const unsigned char * const base = reinterpret_cast<unsigned char *>(lineStart);
+    const size_t length = limit - lineStart;
+    size_t pos = 0;
+    while (pos < length) {
+        const unsigned lead = base[pos];
+        unsigned count = 0;
+        UCD::codepoint_t cp = lead;
+        if (lead >= 0xF0) {
+            count = 3; cp = lead & 0x07;
+        } else if (lead >= 0xE0) {
+            count = 2; cp = lead & 0x0F;
+        } else if (lead >= 0xC0) {
+            count = 1; cp = lead & 0x1F;
+        }
+        size_t next = pos + 1;
+        for (unsigned i = 0; (i < count) && (next < length) && isContinuationByte(lineStart[next]); ++i, ++next) {
+            cp = (cp << 6) | (base[next] & 0x3F);
+        }
+        if (next - pos != count + 1) {
+            // Invalid UTF-8 matches no character class.
+            cp = 0xFFFFFFFF;
+        }
+        if (mBreakCC->contains(cp)) break;
+        mText.push_back(cp);
+        mOffsets.push_back(pos);
+        pos = next;
+    }
+    mOffsets.push_back(pos);
+}
+
+void MatchSpanFinder::findFixedLengthSpans(char * lineStart, const std::vector<char *> & matchEnds, std::vector<Span> & spans) const {
+    char * priorEnd = lineStart;
+    for (char * const end : matchEnds) {
+        char * start = end;
+        for (int i = 0; (i < mFixedLength) && (start > lineStart); ++i) {
+            --start;
+            while ((start > lineStart) && isContinuationByte(*start)) --start;
+        }
+        if ((start >= priorEnd) && (start < end)) {
+            spans.emplace_back(start, end);
+            priorEnd = end;
+        }
+    }
+}
+
+void MatchSpanFinder::findVariableLengthSpans(char * lineStart, char * bufferLimit, const std::vector<char *> & matchEnds, std::vector<Span> & spans) {
+    decodeLine(lineStart, bufferLimit);
+    const auto n = mText.size();
+    // Each match end is marked with its own position; a reverse pass from them marks every
+    // position at which a match starts with the furthest end of a match from there.
+    Markers ends(n + 1, NotReached);
+    for (char * const end : matchEnds) {
+        const size_t offset = end - lineStart;
+        const size_t pos = std::lower_bound(mOffsets.begin(), mOffsets.end(), offset) - mOffsets.begin();
+        if (pos <= n) ends[pos] = static_cast<int>(pos);
+    }
+    Markers longest(n + 1, NotReached);
+    for (const RE * re : mREs) {
+        const Markers m = advance(re, ends, true);
+        for (unsigned p = 0; p <= n; ++p) {
+            longest[p] = std::max(longest[p], m[p]);
+        }
+    }
+    // The leftmost start that follows the prior span begins the next one.
+    size_t start = 0;
+    while (start < n) {
+        if (longest[start] > static_cast<int>(start)) {
+            const size_t end = longest[start];
+            spans.emplace_back(lineStart + mOffsets[start], lineStart + mOffsets[end]);
+            start = end;
+        } else {
+            // no match, or only an empty match, starts here
+            ++start;
+        }
+    }
+}
+
+void MatchSpanFinder::findSpans(char * lineStart, char * bufferLimit, const std::vector<char *> & matchEnds, std::vector<Span> & spans) {
+    // A match end may be marked at any byte of the code point that follows the match.
+    std::vector<char *> ends;
+    ends.reserve(matchEnds.size());
+    for (char * end : matchEnds) {
+        if (end < bufferLimit) {
+            while ((end > lineStart) && isContinuationByte(*end)) --end;
+        }
+        ends.push_back(end);
+    }
+    if (mFixedLength >= 0) {
+        findFixedLengthSpans(lineStart, ends, spans);
+    } else {
+        findVariableLengthSpans(lineStart, bufferLimit, ends, spans);
+    }
+}
+
+}
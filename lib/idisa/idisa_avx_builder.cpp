@@ -1009,21 +1009,19 @@ std::pair<Value *, Value *> IDISA_AVX512F_Builder::bitblock_advance(Value * a, V
 }
 
 void IDISA_AVX512F_Builder::getAVX512Features() {
-    llvm::StringMap<bool> features;
-    if (llvm::sys::getHostCPUFeatures(features)) {
-        hostCPUFeatures.hasAVX512CD = features.lookup("avx512cd");
-        hostCPUFeatures.hasAVX512BW = features.lookup("avx512bw");
-        hostCPUFeatures.hasAVX512DQ = features.lookup("avx512dq");
-        hostCPUFeatures.hasAVX512VL = features.lookup("avx512vl");
-
-        //hostCPUFeatures.hasAVX512VBMI, hostCPUFeatures.hasAVX512VBMI2,
-        //hostCPUFeatures.hasAVX512VPOPCNTDQ have not been tested as we
-        //did not have hardware support. It should work in theory (tm)
-
-        hostCPUFeatures.hasAVX512VBMI = features.lookup("avx512_vbmi");
-        hostCPUFeatures.hasAVX512VBMI2 = features.lookup("avx512_vbmi2");
-        hostCPUFeatures.hasAVX512VPOPCNTDQ = features.lookup("avx512_vpopcntdq");
-    }
+    const auto & features = codegen::getTargetCPUFeatures();
+    hostCPUFeatures.hasAVX512CD = features.lookup("avx512cd");
+    hostCPUFeatures.hasAVX512BW = features.lookup("avx512bw");
+    hostCPUFeatures.hasAVX512DQ = features.lookup("avx512dq");
+    hostCPUFeatures.hasAVX512VL = features.lookup("avx512vl");
+
+    //hostCPUFeatures.hasAVX512VBMI, hostCPUFeatures.hasAVX512VBMI2,
+    //hostCPUFeatures.hasAVX512VPOPCNTDQ have not been tested as we
+    //did not have hardware support. It should work in theory (tm)
+
+    hostCPUFeatures.hasAVX512VBMI = features.lookup("avx512_vbmi");
+    hostCPUFeatures.hasAVX512VBMI2 = features.lookup("avx512_vbmi2");
+    hostCPUFeatures.hasAVX512VPOPCNTDQ = features.lookup("avx512_vpopcntdq");
 }
 #endif
 
@@ -396,16 +396,22 @@ S2P_CompletionKernel::S2P_CompletionKernel(BuilderRef b,
 void Staged_S2P(const std::unique_ptr<ProgramBuilder> & P,
                 StreamSet * ByteStream, StreamSet * BasisBits,
                 bool completionFromQuads) {
-    StreamSet * BitPairs = P->CreateStreamSet(8, 1);
-    P->CreateKernelCall<BitPairsKernel>(ByteStream, BitPairs);
+    Staged_S2P(*P, ByteStream, BasisBits, completionFromQuads);
+}
+
+void Staged_S2P(PipelineBuilder & P,
+                StreamSet * ByteStream, StreamSet * BasisBits,
+                bool completionFromQuads) {
+    StreamSet * BitPairs = P.CreateStreamSet(8, 1);
+    P.CreateKernelCall<BitPairsKernel>(ByteStream, BitPairs);
     if (completionFromQuads) {
-        StreamSet * BitQuads = P->CreateStreamSet(8, 1);
-        P->CreateKernelCall<BitQuadsKernel>(BitPairs, BitQuads);
-        P->CreateKernelCall<S2P_CompletionKernel>(BitQuads, BasisBits, completionFromQuads);
+        StreamSet * BitQuads = P.CreateStreamSet(8, 1);
+        P.CreateKernelCall<BitQuadsKernel>(BitPairs, BitQuads);
+        P.CreateKernelCall<S2P_CompletionKernel>(BitQuads, BasisBits, completionFromQuads);
     } else {
-        P->CreateKernelCall<S2P_CompletionKernel>(BitPairs, BasisBits, completionFromQuads);
+        P.CreateKernelCall<S2P_CompletionKernel>(BitPairs, BasisBits, completionFromQuads);
     }
-    P->AssertEqualLength(BasisBits, ByteStream);
+    P.AssertEqualLength(BasisBits, ByteStream);
 }
 
 S2P_21Kernel::S2P_21Kernel(BuilderRef b, StreamSet * const codeUnitStream, StreamSet * const BasisBits)
@@ -43,6 +43,7 @@ void Attribute::print(llvm::raw_ostream & out) const noexcept {
         NAME(InternallySynchronized);
         NAME(IsolateOnHybridThread);
         NAME(InfrequentlyUsed);
+        NAME(BlockingSynchronization);
         NAME(Linear);
         NAME(None);
         case KindId::__Count: llvm_unreachable("__Count should not be used.");
@@ -28,45 +28,27 @@ struct Features {
 
 Features getHostCPUFeatures() {
     Features hostCPUFeatures;
-    StringMap<bool> features;
-    if (sys::getHostCPUFeatures(features)) {
-        hostCPUFeatures.hasAVX = features.lookup("avx");
-        hostCPUFeatures.hasAVX2 = features.lookup("avx2");
-        hostCPUFeatures.hasAVX512F = features.lookup("avx512f");
-    }
+    const auto & features = codegen::getTargetCPUFeatures();
+    hostCPUFeatures.hasAVX = features.lookup("avx");
+    hostCPUFeatures.hasAVX2 = features.lookup("avx2");
+    hostCPUFeatures.hasAVX512F = features.lookup("avx512f");
     return hostCPUFeatures;
 }
 
 bool SSSE3_available() {
-    StringMap<bool> features;
-    if (sys::getHostCPUFeatures(features)) {
-        return features.lookup("ssse3");
-    }
-    return false;
+    return codegen::getTargetCPUFeatures().lookup("ssse3");
 }
 
 bool BMI2_available() {
-    StringMap<bool> features;
-    if (sys::getHostCPUFeatures(features)) {
-        return features.lookup("bmi2");
-    }
-    return false;
+    return codegen::getTargetCPUFeatures().lookup("bmi2");
 }
 
 bool AVX2_available() {
-    StringMap<bool> features;
-    if (sys::getHostCPUFeatures(features)) {
-        return features.lookup("avx2");
-    }
-    return false;
+    return codegen::getTargetCPUFeatures().lookup("avx2");
 }
 
 bool AVX512BW_available() {
-    StringMap<bool> features;
-    if (sys::getHostCPUFeatures(features)) {
-        return features.lookup("avx512bw");
-    }
-    return false;
+    return codegen::getTargetCPUFeatures().lookup("avx512bw");
 }
 
 namespace IDISA {
@@ -5,6 +5,7 @@
 
 #include <kernel/core/kernel.h>
 #include <kernel/core/kernel_compiler.h>
+#include <toolchain/toolchain.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
 #include <boost/container/flat_set.hpp>
@@ -35,6 +36,9 @@ const static auto ALLOCATE_THREAD_LOCAL_INTERNAL_STREAMSETS_SUFFIX = "_AllocateT
 const static auto DO_SEGMENT_SUFFIX = "_DoSegment";
 const static auto FINALIZE_THREAD_LOCAL_SUFFIX = "_FinalizeThreadLocal";
 const static auto FINALIZE_SUFFIX = "_Finalize";
+const static auto REARM_SUFFIX = "_Rearm";
+const static auto FINALIZE_RUN_SUFFIX = "_FinalizeRun";
+const static auto RELEASE_SUFFIX = "_Release";
 
 const static auto SHARED_SUFFIX = "_shared_state";
 const static auto THREAD_LOCAL_SUFFIX = "_thread_local";
@@ -56,6 +60,13 @@ const static auto THREAD_LOCAL_SUFFIX = "_thread_local";
     return false;
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief makeFusedKernel
+ ** ------------------------------------------------------------------------------------------------------------- */
+Kernel * Kernel::makeFusedKernel(BuilderRef /* b */, std::vector<Kernel *> && /* kernels */, Bindings && /* inputs */, Bindings && /* outputs */) const {
+    report_fatal_error(getName() + " cannot be fused with other kernels");
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief requiresExplicitPartialFinalStride
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -141,7 +152,7 @@ std::unique_ptr<KernelCompiler> Kernel::instantiateKernelCompiler(BuilderRef /*
 std::string Kernel::makeCacheName(BuilderRef b) {
     std::string cacheName;
     raw_string_ostream out(cacheName);
-    out << getName() << '_' << b->getBuilderUniqueName();
+    out << getName() << '_' << b->getBuilderUniqueName() << '_' << codegen::getISATargetName();
     out.flush();
     return cacheName;
 }
@@ -393,6 +404,11 @@ void Kernel::addKernelDeclarations(BuilderRef b) {
     addDoSegmentDeclaration(b);
     addFinalizeThreadLocalDeclaration(b);
     addFinalizeDeclaration(b);
+    if (hasReusableInstance()) {
+        addRearmDeclaration(b);
+        addFinalizeRunDeclaration(b);
+        addReleaseDeclaration(b);
+    }
     linkExternalMethods(b);
 }
 
@@ -953,6 +969,125 @@ Function * Kernel::addFinalizeDeclaration(BuilderRef b) const {
     return terminateFunc;
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getRearmFunction
+ ** ------------------------------------------------------------------------------------------------------------- */
+Function * Kernel::getRearmFunction(BuilderRef b, const bool alwayReturnDeclaration) const {
+    const Module * const module = b->getModule();
+    SmallVector<char, 256> tmp;
+    Function * f = module->getFunction(concat(getName(), REARM_SUFFIX, tmp));
+    if (LLVM_UNLIKELY(f == nullptr && alwayReturnDeclaration)) {
+        f = addRearmDeclaration(b);
+    }
+    return f;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addRearmDeclaration
+ *
+ * The Rearm method takes the same input scalars as the Initialize method but is called on an instance that has
+ * already completed a run; it must not reallocate anything still owned by the instance. Any family kernels of
+ * the instance were retained when the run was finalized, so none are passed in.
+ ** ------------------------------------------------------------------------------------------------------------- */
+Function * Kernel::addRearmDeclaration(BuilderRef b) const {
+    SmallVector<char, 256> tmp;
+    const auto funcName = concat(getName(), REARM_SUFFIX, tmp);
+    Module * const m = b->getModule();
+    Function * rearmFunc = m->getFunction(funcName);
+    if (LLVM_LIKELY(rearmFunc == nullptr)) {
+        InitArgTypes params;
+        if (LLVM_LIKELY(isStateful())) {
+            params.push_back(getSharedStateType()->getPointerTo());
+        }
+        for (const Binding & binding : mInputScalars) {
+            params.push_back(binding.getType());
+        }
+        FunctionType * const rearmType = FunctionType::get(b->getSizeTy(), params, false);
+        rearmFunc = Function::Create(rearmType, GlobalValue::ExternalLinkage, funcName, m);
+        rearmFunc->setCallingConv(CallingConv::C);
+        rearmFunc->setDoesNotRecurse();
+        if (LLVM_LIKELY(isStateful())) {
+            auto arg = rearmFunc->arg_begin();
+            arg->addAttr(llvm::Attribute::AttrKind::NoCapture);
+            arg->setName("shared");
+        }
+    }
+    return rearmFunc;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getFinalizeRunFunction
+ ** ------------------------------------------------------------------------------------------------------------- */
+Function * Kernel::getFinalizeRunFunction(BuilderRef b, const bool alwayReturnDeclaration) const {
+    const Module * const module = b->getModule();
+    SmallVector<char, 256> tmp;
+    Function * f = module->getFunction(concat(getName(), FINALIZE_RUN_SUFFIX, tmp));
+    if (LLVM_UNLIKELY(f == nullptr && alwayReturnDeclaration)) {
+        f = addFinalizeRunDeclaration(b);
+    }
+    return f;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addFinalizeRunDeclaration
+ *
+ * The FinalizeRun method returns the same output scalars as the Finalize method but leaves the instance and
+ * its internal stream sets allocated.
+ ** ------------------------------------------------------------------------------------------------------------- */
+Function * Kernel::addFinalizeRunDeclaration(BuilderRef b) const {
+    SmallVector<char, 256> tmp;
+    const auto funcName = concat(getName(), FINALIZE_RUN_SUFFIX, tmp);
+    Module * const m = b->getModule();
+    Function * finalizeRunFunc = m->getFunction(funcName);
+    if (LLVM_LIKELY(finalizeRunFunc == nullptr)) {
+        Function * const terminateFunc = getFinalizeFunction(b);
+        finalizeRunFunc = Function::Create(terminateFunc->getFunctionType(), GlobalValue::ExternalLinkage, funcName, m);
+        finalizeRunFunc->setCallingConv(CallingConv::C);
+        finalizeRunFunc->setDoesNotRecurse();
+        if (LLVM_LIKELY(isStateful())) {
+            finalizeRunFunc->arg_begin()->setName("handle");
+        }
+    }
+    return finalizeRunFunc;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getReleaseFunction
+ ** ------------------------------------------------------------------------------------------------------------- */
+Function * Kernel::getReleaseFunction(BuilderRef b, const bool alwayReturnDeclaration) const {
+    const Module * const module = b->getModule();
+    SmallVector<char, 256> tmp;
+    Function * f = module->getFunction(concat(getName(), RELEASE_SUFFIX, tmp));
+    if (LLVM_UNLIKELY(f == nullptr && alwayReturnDeclaration)) {
+        f = addReleaseDeclaration(b);
+    }
+    return f;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addReleaseDeclaration
+ ** ------------------------------------------------------------------------------------------------------------- */
+Function * Kernel::addReleaseDeclaration(BuilderRef b) const {
+    SmallVector<char, 256> tmp;
+    const auto funcName = concat(getName(), RELEASE_SUFFIX, tmp);
+    Module * const m = b->getModule();
+    Function * releaseFunc = m->getFunction(funcName);
+    if (LLVM_LIKELY(releaseFunc == nullptr)) {
+        std::vector<Type *> params;
+        if (LLVM_LIKELY(isStateful())) {
+            params.push_back(getSharedStateType()->getPointerTo());
+        }
+        FunctionType * const releaseType = FunctionType::get(b->getVoidTy(), params, false);
+        releaseFunc = Function::Create(releaseType, GlobalValue::ExternalLinkage, funcName, m);
+        releaseFunc->setCallingConv(CallingConv::C);
+        releaseFunc->setDoesNotRecurse();
+        if (LLVM_LIKELY(isStateful())) {
+            releaseFunc->arg_begin()->setName("handle");
+        }
+    }
+    return releaseFunc;
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief addOrDeclareMainFunction
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -1077,6 +1212,28 @@ Function * Kernel::addOrDeclareMainFunction(BuilderRef b, const MainMethodGenera
         }
     }
 
+    callDoSegmentOnce(b, main, sharedHandle, threadLocalHandle, segmentArgs);
+    if (isStateful()) {
+        // call and return the final output value(s)
+        Value * const retVal = finalizeInstance(b, sharedHandle);
+        b->CreateRet(retVal);
+    } else {
+        b->CreateRetVoid();
+    }
+    return main;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief callDoSegmentOnce
+ *
+ * Call the doSegment method of this kernel as the sole segment of a program run then finalize the thread local
+ * instance. Under asserts, any exception thrown by the run terminates the program.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void Kernel::callDoSegmentOnce(BuilderRef b, Function * const caller, Value * const sharedHandle, Value * const threadLocalHandle,
+                               ArrayRef<Value *> segmentArgs) const {
+
+    Function * const doSegment = getDoSegmentFunction(b, false); assert (doSegment);
+
     #ifdef NDEBUG
     const bool ea = true;
     #else
@@ -1093,7 +1250,7 @@ Function * Kernel::addOrDeclareMainFunction(BuilderRef b, const MainMethodGenera
         LLVMContext & C = b->getContext();
         StructType * const caughtResultType = StructType::get(C, { int8PtrTy, int32Ty });
         Function * const personalityFn = b->getDefaultPersonalityFunction();
-        main->setPersonalityFn(personalityFn);
+        caller->setPersonalityFn(personalityFn);
 
         BasicBlock * const beforeInvoke = b->GetInsertBlock();
         b->CreateInvoke(doSegment, handleDeallocation, handleCatch, segmentArgs);
@@ -1133,14 +1290,138 @@ Function * Kernel::addOrDeclareMainFunction(BuilderRef b, const MainMethodGenera
         b->CreateBr(resumeProgram);
         b->SetInsertPoint(resumeProgram);
     }
-    if (isStateful()) {
-        // call and return the final output value(s)
-        Value * const retVal = finalizeInstance(b, sharedHandle);
-        b->CreateRet(retVal);
-    } else {
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addInstanceFunctions
+ *
+ * Add the host entry points of a reusable program instance:
+ *
+ *   handle <name>_create(scalars...)         construct and initialize an instance and allocate its stream sets
+ *   void   <name>_reset(handle, scalars...)  rearm an instance that has completed a run with new input scalars
+ *   result <name>_run(handle, streams...)    process one input and return the output scalars of that run
+ *   void   <name>_destroy(handle)            release the instance
+ *
+ * Calling create, run and destroy is equivalent to calling the "main" method once.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void Kernel::addInstanceFunctions(BuilderRef b, const MainMethodGenerationType method) const {
+    assert (hasReusableInstance() && isStateful());
+    assert (method != DeclareExternal);
+
+    Module * const m = b->getModule();
+    SmallVector<char, 256> tmp;
+    if (LLVM_UNLIKELY(m->getFunction(concat(getName(), "_create", tmp)) != nullptr)) {
+        return;
+    }
+
+    LLVMContext & C = b->getContext();
+    const auto linkageType = (method == AddInternal) ? Function::InternalLinkage : Function::ExternalLinkage;
+    PointerType * const handleTy = getSharedStateType()->getPointerTo();
+    Value * const ONE = b->getSize(1);
+
+    auto makeFunction = [&](const StringRef suffix, Type * const resultTy, ArrayRef<Type *> params) {
+        FunctionType * const funcTy = FunctionType::get(resultTy, params, false);
+        Function * const f = Function::Create(funcTy, linkageType, concat(getName(), suffix, tmp), m);
+        f->setCallingConv(CallingConv::C);
+        b->SetInsertPoint(BasicBlock::Create(C, "entry", f));
+        return f;
+    };
+
+    SmallVector<Type *, 16> scalarTypes;
+    for (const auto & input : getInputScalarBindings()) {
+        scalarTypes.push_back(input.getType());
+    }
+
+    auto bindScalars = [&](Function::arg_iterator arg, ParamMap & paramMap) {
+        for (const auto & input : getInputScalarBindings()) {
+            const Scalar * const scalar = cast<Scalar>(input.getRelationship());
+            paramMap.insert(std::make_pair(scalar, &*arg));
+            std::advance(arg, 1);
+        }
+    };
+
+    BEGIN_SCOPED_REGION
+    Function * const create = makeFunction("_create", handleTy, scalarTypes);
+    ParamMap paramMap;
+    bindScalars(create->arg_begin(), paramMap);
+    InitArgs args;
+    Value * const handle = constructFamilyKernels(b, args, paramMap);
+    if (LLVM_LIKELY(allocatesInternalStreamSets())) {
+        Function * const allocShared = getAllocateSharedInternalStreamSetsFunction(b);
+        FixedArray<Value *, 2> allocArgs;
+        allocArgs[0] = handle;
+        allocArgs[1] = b->getSize(codegen::BufferSegments);
+        b->CreateCall(allocShared->getFunctionType(), allocShared, allocArgs);
+    }
+    b->CreateRet(handle);
+    END_SCOPED_REGION
+
+    BEGIN_SCOPED_REGION
+    SmallVector<Type *, 16> params;
+    params.push_back(handleTy);
+    params.append(scalarTypes.begin(), scalarTypes.end());
+    Function * const reset = makeFunction("_reset", b->getVoidTy(), params);
+    SmallVector<Value *, 16> args;
+    for (auto & arg : reset->args()) {
+        args.push_back(&arg);
+    }
+    Function * const rearm = getRearmFunction(b);
+    b->CreateCall(rearm->getFunctionType(), rearm, args);
+    b->CreateRetVoid();
+    END_SCOPED_REGION
+
+    BEGIN_SCOPED_REGION
+    const auto suppliedArgs = hasThreadLocal() ? 3U : 2U;
+    Function * const doSegment = getDoSegmentFunction(b, false); assert (doSegment);
+    assert (doSegment->arg_size() >= suppliedArgs);
+    const auto numOfDoSegArgs = doSegment->arg_size() - suppliedArgs;
+    SmallVector<Type *, 16> params;
+    params.push_back(handleTy);
+    auto doSegParam = doSegment->arg_begin();
+    std::advance(doSegParam, suppliedArgs);
+    for (; doSegParam != doSegment->arg_end(); ++doSegParam) {
+        params.push_back(doSegParam->getType());
+    }
+    Function * const finalizeRun = getFinalizeRunFunction(b);
+    Function * const run = makeFunction("_run", finalizeRun->getReturnType(), params);
+    auto arg = run->arg_begin();
+    Value * const handle = &*arg;
+    SmallVector<Value *, 16> segmentArgs(doSegment->arg_size());
+    for (unsigned i = 0; i < numOfDoSegArgs; ++i) {
+        std::advance(arg, 1);
+        segmentArgs[suppliedArgs + i] = &*arg;
+    }
+    segmentArgs[0] = handle;
+    Value * threadLocalHandle = nullptr;
+    if (hasThreadLocal()) {
+        threadLocalHandle = initializeThreadLocalInstance(b, handle);
+        segmentArgs[1] = threadLocalHandle;
+        if (LLVM_LIKELY(allocatesInternalStreamSets())) {
+            Function * const allocThreadLocal = getAllocateThreadLocalInternalStreamSetsFunction(b);
+            FixedArray<Value *, 3> allocArgs;
+            allocArgs[0] = handle;
+            allocArgs[1] = threadLocalHandle;
+            allocArgs[2] = ONE;
+            b->CreateCall(allocThreadLocal->getFunctionType(), allocThreadLocal, allocArgs);
+        }
+    }
+    segmentArgs[suppliedArgs - 1] = ONE; // numOfStrides
+    callDoSegmentOnce(b, run, handle, threadLocalHandle, segmentArgs);
+    Value * const result = b->CreateCall(finalizeRun->getFunctionType(), finalizeRun, { handle });
+    if (mOutputScalars.empty()) {
         b->CreateRetVoid();
+    } else {
+        b->CreateRet(result);
     }
-    return main;
+    END_SCOPED_REGION
+
+    BEGIN_SCOPED_REGION
+    Function * const release = getReleaseFunction(b);
+    Function * const destroy = makeFunction("_destroy", b->getVoidTy(), { handleTy });
+    Value * const handle = &*destroy->arg_begin();
+    b->CreateCall(release->getFunctionType(), release, { handle });
+    b->CreateRetVoid();
+    END_SCOPED_REGION
 }
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -1266,6 +1547,12 @@ Value * Kernel::constructFamilyKernels(BuilderRef b, InitArgs & hostArgs, const
             addHostArg(getFinalizeThreadLocalFunction(b));
         }
         addHostArg(getFinalizeFunction(b));
+        // a reusable pipeline keeps this instance from one run to the next
+        if (hasReusableInstance()) {
+            addHostArg(getRearmFunction(b));
+            addHostArg(getFinalizeRunFunction(b));
+            addHostArg(getReleaseFunction(b));
+        }
     }
     return handle;
 }
@@ -40,11 +40,6 @@ const static std::string TERMINATION_SIGNAL = "__termination_signal";
 
 // #define CHECK_IO_ADDRESS_RANGE
 
-// TODO: split the init/final into two methods each, one to do allocation/init, and the
-// other final/deallocate? Would potentially allow us to reuse the kernel/stream set
-// memory in the nested engine if each init method memzero'ed them. Would need to change
-// the "main" method.
-
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief generateKernel
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -74,6 +69,13 @@ void KernelCompiler::generateKernel(BuilderRef b) {
     callGenerateDoSegmentMethod(b);
     callGenerateFinalizeThreadLocalMethod(b);
     callGenerateFinalizeMethod(b);
+    // A reusable instance splits its init/final methods so that the same instance (and its
+    // stream set memory) can be rearmed for another run.
+    if (mTarget->hasReusableInstance()) {
+        callGenerateInitializeMethod(b, true);
+        callGenerateFinalizeMethod(b, true);
+        callGenerateReleaseMethod(b);
+    }
     mTarget->addAdditionalFunctions(b);
 
     // TODO: we could create a LLVM optimization pass manager here and execute it on this kernel;
@@ -153,10 +155,12 @@ inline void reset(Vec & vec, const size_t n) {
 
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief callGenerateInitializeMethod
+ *
+ * Generates the Initialize method or, if rearm is set, the Rearm method of a reusable instance.
  ** ------------------------------------------------------------------------------------------------------------- */
-inline void KernelCompiler::callGenerateInitializeMethod(BuilderRef b) {
+inline void KernelCompiler::callGenerateInitializeMethod(BuilderRef b, const bool rearm) {
     b->setCompiler(this);
-    mCurrentMethod = mTarget->getInitializeFunction(b);
+    mCurrentMethod = rearm ? mTarget->getRearmFunction(b) : mTarget->getInitializeFunction(b);
     mEntryPoint = BasicBlock::Create(b->getContext(), "entry", mCurrentMethod);
     b->SetInsertPoint(mEntryPoint);
     auto arg = mCurrentMethod->arg_begin();
@@ -179,7 +183,9 @@ inline void KernelCompiler::callGenerateInitializeMethod(BuilderRef b) {
     for (const auto & binding : mInputScalars) {
         b->setScalarField(binding.getName(), nextArg());
     }
-    bindFamilyInitializationArguments(b, arg, arg_end);
+    if (!rearm) {
+        bindFamilyInitializationArguments(b, arg, arg_end);
+    }
     assert (arg == arg_end);    
     // TODO: we could permit shared managed buffers here if we passed in the buffer
     // into the init method. However, since there are no uses of this in any written
@@ -188,7 +194,11 @@ inline void KernelCompiler::callGenerateInitializeMethod(BuilderRef b) {
     // any kernel can set termination on initialization
     mTerminationSignalPtr = b->getScalarFieldPtr(TERMINATION_SIGNAL);
     b->CreateStore(b->getSize(KernelBuilder::TerminationCode::None), mTerminationSignalPtr);
-    mTarget->generateInitializeMethod(b);
+    if (rearm) {
+        mTarget->generateRearmMethod(b);
+    } else {
+        mTarget->generateInitializeMethod(b);
+    }
     if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableMProtect) && mTarget->isStateful())) {
         b->CreateMProtect(mSharedHandle, CBuilder::Protect::READ);
     }
@@ -947,11 +957,13 @@ inline void KernelCompiler::callGenerateFinalizeThreadLocalMethod(BuilderRef b)
 
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief callGenerateFinalizeMethod
+ *
+ * Generates the Finalize method or, if retainInstance is set, the FinalizeRun method of a reusable instance.
  ** ------------------------------------------------------------------------------------------------------------- */
-inline void KernelCompiler::callGenerateFinalizeMethod(BuilderRef b) {
+inline void KernelCompiler::callGenerateFinalizeMethod(BuilderRef b, const bool retainInstance) {
 
     b->setCompiler(this);
-    mCurrentMethod = mTarget->getFinalizeFunction(b);
+    mCurrentMethod = retainInstance ? mTarget->getFinalizeRunFunction(b) : mTarget->getFinalizeFunction(b);
     mEntryPoint = BasicBlock::Create(b->getContext(), "entry", mCurrentMethod);
     b->SetInsertPoint(mEntryPoint);
     if (LLVM_LIKELY(mTarget->isStateful())) {
@@ -964,10 +976,20 @@ inline void KernelCompiler::callGenerateFinalizeMethod(BuilderRef b) {
         b->CreateMProtect(mSharedHandle,CBuilder::Protect::WRITE);
     }
     initializeOwnedBufferHandles(b, InitializeOptions::SkipThreadLocal);
-    mTarget->generateFinalizeMethod(b); // may be overridden by the Kernel subtype
+    if (retainInstance) {
+        mTarget->generateFinalizeRunMethod(b);
+    } else {
+        mTarget->generateFinalizeMethod(b); // may be overridden by the Kernel subtype
+    }
     const auto outputs = getFinalOutputScalars(b);
     if (LLVM_LIKELY(mTarget->isStateful())) {
-        b->CreateFree(mSharedHandle);
+        if (retainInstance) {
+            if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableMProtect))) {
+                b->CreateMProtect(mSharedHandle, CBuilder::Protect::READ);
+            }
+        } else {
+            b->CreateFree(mSharedHandle);
+        }
     }
 
     if (outputs.empty()) {
@@ -986,6 +1008,29 @@ inline void KernelCompiler::callGenerateFinalizeMethod(BuilderRef b) {
 
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief callGenerateReleaseMethod
+ ** ------------------------------------------------------------------------------------------------------------- */
+inline void KernelCompiler::callGenerateReleaseMethod(BuilderRef b) {
+    b->setCompiler(this);
+    mCurrentMethod = mTarget->getReleaseFunction(b);
+    mEntryPoint = BasicBlock::Create(b->getContext(), "entry", mCurrentMethod);
+    b->SetInsertPoint(mEntryPoint);
+    if (LLVM_LIKELY(mTarget->isStateful())) {
+        auto args = mCurrentMethod->arg_begin();
+        setHandle(&*(args++));
+        assert (args == mCurrentMethod->arg_end());
+    }
+    initializeScalarMap(b, InitializeOptions::SkipThreadLocal);
+    initializeOwnedBufferHandles(b, InitializeOptions::SkipThreadLocal);
+    mTarget->generateReleaseMethod(b);
+    if (LLVM_LIKELY(mTarget->isStateful())) {
+        b->CreateFree(mSharedHandle);
+    }
+    b->CreateRetVoid();
+    clearInternalStateAfterCodeGen();
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief getFinalOutputScalars
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -14,6 +14,12 @@
 #include <llvm/Support/Format.h>
 #include <boost/intrusive/detail/math.hpp>
 #include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace llvm { class Constant; }
 namespace llvm { class Function; }
@@ -237,6 +243,10 @@ void ExternalBuffer::releaseBuffer(BuilderPtr /* b */) const {
     // this buffer is not responsible for free-ing th data associated with it
 }
 
+void ExternalBuffer::resetBuffer(BuilderPtr /* b */) const {
+    unsupported("resetBuffer", "External");
+}
+
 void ExternalBuffer::setBaseAddress(BuilderPtr b, Value * const addr) const {
     assert (mHandle && "has not been set prior to calling setBaseAddress");
     Value * const p = b->CreateInBoundsGEP(mHandle, {b->getInt32(0), b->getInt32(BaseAddress)});
@@ -459,6 +469,23 @@ void StaticBuffer::releaseBuffer(BuilderPtr b) const {
     b->CreateStore(nullPointerFor(b, buffer, mUnderflow), addressField);
 }
 
+void StaticBuffer::resetBuffer(BuilderPtr b) const {
+    // a linear buffer moves its base address back by the consumed items on each copy back
+    if (mLinear) {
+        Value * const handle = getHandle();
+        FixedArray<Value *, 2> indices;
+        indices[0] = b->getInt32(0);
+        indices[1] = b->getInt32(MallocedAddress);
+        Value * const mallocAddress = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+        indices[1] = b->getInt32(BaseAddress);
+        b->CreateStore(mallocAddress, b->CreateInBoundsGEP(handle, indices));
+        indices[1] = b->getInt32(InternalCapacity);
+        Value * const capacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+        indices[1] = b->getInt32(EffectiveCapacity);
+        b->CreateStore(capacity, b->CreateInBoundsGEP(handle, indices));
+    }
+}
+
 inline bool isCapacityGuaranteed(const Value * const index, const size_t capacity) {
     return isa<ConstantInt>(index) ? cast<ConstantInt>(index)->getLimitedValue() < capacity : false;
 }
@@ -700,15 +727,34 @@ void StaticBuffer::reserveCapacity(BuilderPtr b, Value * produced, Value * consu
 
 // Dynamic Buffer
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __dynamic_buffer_grow_in_place
+ *
+ * Try to extend the mapping at address without moving it. Returns 0 if the adjacent address space is in use
+ * (or the OS cannot remap memory) and the caller must copy the data into a new mapping instead.
+ ** ------------------------------------------------------------------------------------------------------------- */
+int __dynamic_buffer_grow_in_place(void * const address, const size_t oldSize, const size_t newSize) {
+    #ifdef __linux__
+    return mremap(address, oldSize, newSize, 0) != MAP_FAILED;
+    #else
+    return 0;
+    #endif
+}
+
+void DynamicBuffer::linkFunctions(BuilderPtr b) {
+    b->LinkFunction("__dynamic_buffer_grow_in_place", __dynamic_buffer_grow_in_place);
+}
+
 Type * DynamicBuffer::getHandleType(BuilderPtr b) const {
     auto & C = b->getContext();
     PointerType * const typePtr = getPointerType();
     IntegerType * const sizeTy = b->getSizeTy();
     Type * const emptyTy = StructType::get(C);
-    FixedArray<Type *, 5> types;
+    FixedArray<Type *, 8> types;
     types[BaseAddress] = typePtr;
     types[InternalCapacity] = sizeTy;
     types[PriorAddress] = typePtr;
+    types[PriorCapacity] = sizeTy;
     if (mLinear) {
         types[MallocedAddress] = typePtr;
         types[EffectiveCapacity] = sizeTy;
@@ -716,9 +762,22 @@ Type * DynamicBuffer::getHandleType(BuilderPtr b) const {
         types[MallocedAddress] = emptyTy;
         types[EffectiveCapacity] = emptyTy;
     }
+    if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::TraceDynamicBuffers))) {
+        types[ExpansionCopiedBytes] = sizeTy;
+        types[ExpansionSavedBytes] = sizeTy;
+    } else {
+        types[ExpansionCopiedBytes] = emptyTy;
+        types[ExpansionSavedBytes] = emptyTy;
+    }
     return StructType::get(C, types);
 }
 
+Value * DynamicBuffer::getAllocationSize(BuilderPtr b, Value * const capacity, Value * const additionalCapacity) const {
+    Constant * const CHUNK_SIZE = ConstantExpr::getSizeOf(mType);
+    Value * const size = b->CreateMul(b->CreateAdd(capacity, additionalCapacity), CHUNK_SIZE);
+    return b->CreateRoundUp(size, b->getSize(b->getPageSize()));
+}
+
 void DynamicBuffer::allocateBuffer(BuilderPtr b, Value * const capacityMultiplier) {
     assert (mHandle && "has not been set prior to calling allocateBuffer");
     // note: when adding extensible stream sets, make sure to set the initial count here.
@@ -739,14 +798,16 @@ void DynamicBuffer::allocateBuffer(BuilderPtr b, Value * const capacityMultiplie
     indices[1] = b->getInt32(BaseAddress);
     Value * const baseAddressField = b->CreateInBoundsGEP(handle, indices);
 
-    Value * const size = b->CreateAdd(capacity, b->getSize(mUnderflow + mOverflow));
-    Value * const baseAddress = b->CreatePageAlignedMalloc(mType, size, mAddressSpace);
+    Value * const size = getAllocationSize(b, capacity, b->getSize(mUnderflow + mOverflow));
+    Value * const baseAddress = b->CreatePointerCast(b->CreateAnonymousMMap(size), getPointerType());
     Value * const adjBaseAddress = addUnderflow(b, baseAddress, mUnderflow);
     b->CreateStore(adjBaseAddress, baseAddressField);
 
     indices[1] = b->getInt32(PriorAddress);
     Value * const priorAddressField = b->CreateInBoundsGEP(handle, indices);
     b->CreateStore(nullPointerFor(b, baseAddress, mUnderflow), priorAddressField);
+    indices[1] = b->getInt32(PriorCapacity);
+    b->CreateStore(b->getSize(0), b->CreateInBoundsGEP(handle, indices));
 
     if (mLinear) {
         indices[1] = b->getInt32(MallocedAddress);
@@ -759,23 +820,98 @@ void DynamicBuffer::allocateBuffer(BuilderPtr b, Value * const capacityMultiplie
 }
 
 void DynamicBuffer::releaseBuffer(BuilderPtr b) const {
-    /* Free the dynamically allocated buffer(s). */
+    /* Unmap the dynamically allocated buffer(s). */
     Value * const handle = getHandle();
     FixedArray<Value *, 2> indices;
     indices[0] = b->getInt32(0);
+    Constant * const additionalCapacity = b->getSize(mUnderflow + mOverflow);
+
+    BasicBlock * const releasePrior = b->CreateBasicBlock("releasePriorDynamicBuffer");
+    BasicBlock * const releaseCurrent = b->CreateBasicBlock("releaseDynamicBuffer");
+
     indices[1] = b->getInt32(PriorAddress);
     Value * const priorAddressField = b->CreateInBoundsGEP(handle, indices);
     Value * const priorAddress = b->CreateLoad(priorAddressField);
-    b->CreateFree(subtractUnderflow(b, priorAddress, mUnderflow));
     Constant * const nullPtr = nullPointerFor(b, priorAddress, mUnderflow);
+    b->CreateCondBr(b->CreateICmpNE(priorAddress, nullPtr), releasePrior, releaseCurrent);
+
+    b->SetInsertPoint(releasePrior);
+    indices[1] = b->getInt32(PriorCapacity);
+    Value * const priorCapacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    b->CreateMUnmap(subtractUnderflow(b, priorAddress, mUnderflow), getAllocationSize(b, priorCapacity, additionalCapacity));
     b->CreateStore(nullPtr, priorAddressField);
+    b->CreateBr(releaseCurrent);
+
+    b->SetInsertPoint(releaseCurrent);
     indices[1] = b->getInt32(mLinear ? MallocedAddress : BaseAddress);
     Value * const baseAddressField = b->CreateInBoundsGEP(handle, indices);
     Value * const baseAddress = b->CreateLoad(baseAddressField);
-    b->CreateFree(subtractUnderflow(b, baseAddress, mUnderflow));
+    indices[1] = b->getInt32(InternalCapacity);
+    Value * const capacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    b->CreateMUnmap(subtractUnderflow(b, baseAddress, mUnderflow), getAllocationSize(b, capacity, additionalCapacity));
     b->CreateStore(nullPtr, baseAddressField);
 }
 
+void DynamicBuffer::resetBuffer(BuilderPtr b) const {
+    // Keep any capacity gained by expansion up to the retention limit and return the rest (along with
+    // the prior buffer, which no other thread can be reading from now) to the OS.
+    Value * const handle = getHandle();
+    FixedArray<Value *, 2> indices;
+    indices[0] = b->getInt32(0);
+    Constant * const additionalCapacity = b->getSize(mUnderflow + mOverflow);
+
+    BasicBlock * const releasePrior = b->CreateBasicBlock("releasePriorDynamicBuffer");
+    BasicBlock * const checkRetainedCapacity = b->CreateBasicBlock("checkRetainedDynamicBufferCapacity");
+    BasicBlock * const shrinkBuffer = b->CreateBasicBlock("shrinkDynamicBuffer");
+    BasicBlock * const resetCapacity = b->CreateBasicBlock("resetDynamicBufferCapacity");
+
+    indices[1] = b->getInt32(PriorAddress);
+    Value * const priorAddressField = b->CreateInBoundsGEP(handle, indices);
+    Value * const priorAddress = b->CreateLoad(priorAddressField);
+    Constant * const nullPtr = nullPointerFor(b, priorAddress, mUnderflow);
+    b->CreateCondBr(b->CreateICmpNE(priorAddress, nullPtr), releasePrior, checkRetainedCapacity);
+
+    b->SetInsertPoint(releasePrior);
+    indices[1] = b->getInt32(PriorCapacity);
+    Value * const priorCapacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    b->CreateMUnmap(subtractUnderflow(b, priorAddress, mUnderflow), getAllocationSize(b, priorCapacity, additionalCapacity));
+    b->CreateStore(nullPtr, priorAddressField);
+    b->CreateBr(checkRetainedCapacity);
+
+    b->SetInsertPoint(checkRetainedCapacity);
+    indices[1] = b->getInt32(mLinear ? MallocedAddress : BaseAddress);
+    Value * const baseAddress = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    indices[1] = b->getInt32(InternalCapacity);
+    Value * const capacityField = b->CreateInBoundsGEP(handle, indices);
+    Value * const capacity = b->CreateLoad(capacityField);
+    // never shrink below the initial capacity; modByCapacity relies on it
+    Constant * const CHUNK_SIZE = ConstantExpr::getSizeOf(mType);
+    Constant * const retainedBytes = b->getSize(static_cast<size_t>(codegen::MaxRetainedBufferSize) * 1024);
+    Value * const retainedCapacity = b->CreateUMax(b->CreateUDiv(retainedBytes, CHUNK_SIZE), b->getSize(mInitialCapacity));
+    Value * const mappedSize = getAllocationSize(b, capacity, additionalCapacity);
+    Value * const retainedSize = getAllocationSize(b, retainedCapacity, additionalCapacity);
+    b->CreateCondBr(b->CreateICmpUGT(mappedSize, retainedSize), shrinkBuffer, resetCapacity);
+
+    b->SetInsertPoint(shrinkBuffer);
+    Value * const unmappedAddress = b->CreateGEP(b->CreatePointerCast(subtractUnderflow(b, baseAddress, mUnderflow), b->getInt8PtrTy()), retainedSize);
+    b->CreateMUnmap(unmappedAddress, b->CreateSub(mappedSize, retainedSize));
+    b->CreateStore(retainedCapacity, capacityField);
+    BasicBlock * const shrinkBufferExit = b->GetInsertBlock();
+    b->CreateBr(resetCapacity);
+
+    b->SetInsertPoint(resetCapacity);
+    // a linear buffer must also have its virtual base address rewound
+    if (mLinear) {
+        PHINode * const newCapacity = b->CreatePHI(b->getSizeTy(), 2);
+        newCapacity->addIncoming(capacity, checkRetainedCapacity);
+        newCapacity->addIncoming(retainedCapacity, shrinkBufferExit);
+        indices[1] = b->getInt32(BaseAddress);
+        b->CreateStore(baseAddress, b->CreateInBoundsGEP(handle, indices));
+        indices[1] = b->getInt32(EffectiveCapacity);
+        b->CreateStore(newCapacity, b->CreateInBoundsGEP(handle, indices));
+    }
+}
+
 void DynamicBuffer::setBaseAddress(BuilderPtr /* b */, Value * /* addr */) const {
     unsupported("setBaseAddress", "Dynamic");
 }
@@ -853,6 +989,26 @@ void DynamicBuffer::copyBackLinearOutputBuffer(BuilderPtr /* b */, llvm::Value *
     /* do nothing */
 }
 
+
+Value * DynamicBuffer::getExpansionCopiedBytes(BuilderPtr b) const {
+    assert (codegen::DebugOptionIsSet(codegen::TraceDynamicBuffers));
+    Value * const ptr = b->CreateInBoundsGEP(getHandle(), {b->getInt32(0), b->getInt32(ExpansionCopiedBytes)});
+    return b->CreateLoad(ptr);
+}
+
+Value * DynamicBuffer::getExpansionSavedBytes(BuilderPtr b) const {
+    assert (codegen::DebugOptionIsSet(codegen::TraceDynamicBuffers));
+    Value * const ptr = b->CreateInBoundsGEP(getHandle(), {b->getInt32(0), b->getInt32(ExpansionSavedBytes)});
+    return b->CreateLoad(ptr);
+}
+
+void DynamicBuffer::recordExpansion(BuilderPtr b, Value * const handle, Value * const copied, Value * const saved) const {
+    if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::TraceDynamicBuffers))) {
+        b->CreateStore(copied, b->CreateInBoundsGEP(handle, {b->getInt32(0), b->getInt32(ExpansionCopiedBytes)}));
+        b->CreateStore(saved, b->CreateInBoundsGEP(handle, {b->getInt32(0), b->getInt32(ExpansionSavedBytes)}));
+    }
+}
+
 void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value * const consumed, Value * const required, Value * overflowItems) const {
 
     SmallVector<char, 200> buf;
@@ -920,6 +1076,7 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
 
         ConstantInt * const BLOCK_WIDTH = b->getSize(blockWidth);
         Constant * const CHUNK_SIZE = ConstantExpr::getSizeOf(mType);
+        Constant * const SZ_ZERO = b->getSize(0);
 
         FixedArray<Value *, 2> indices;
         indices[0] = b->getInt32(0);
@@ -932,25 +1089,62 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
         Value * const requiredCapacity = b->CreateAdd(produced, required);
         Value * const requiredChunks = b->CreateCeilUDiv(requiredCapacity, BLOCK_WIDTH);
         Value * const unconsumedChunks = b->CreateSub(producedChunks, consumedChunks);
+        Value * const additionalCapacity = b->CreateAdd(underflow, overflow);
 
         indices[1] = b->getInt32(BaseAddress);
         Value * const virtualBaseField = b->CreateInBoundsGEP(handle, indices);
         Value * const virtualBase = b->CreateLoad(virtualBaseField);
         assert (virtualBase->getType()->getPointerElementType() == mType);
 
-        DataLayout DL(b->getModule());
-        Type * const intPtrTy = DL.getIntPtrType(virtualBase->getType());
+        indices[1] = b->getInt32(PriorAddress);
+        Value * const priorBufferField = b->CreateInBoundsGEP(handle, indices);
+        indices[1] = b->getInt32(PriorCapacity);
+        Value * const priorCapacityField = b->CreateInBoundsGEP(handle, indices);
+
+        Function * const growInPlaceFn = b->LinkFunction("__dynamic_buffer_grow_in_place", __dynamic_buffer_grow_in_place);
+
+        auto tryToGrowInPlace = [&](Value * const baseAddress, Value * const newCapacity) {
+            FixedArray<Value *, 3> args;
+            args[0] = b->CreatePointerCast(b->CreateInBoundsGEP(baseAddress, b->CreateNeg(underflow)), b->getVoidPtrTy());
+            args[1] = getAllocationSize(b, capacity, additionalCapacity);
+            args[2] = getAllocationSize(b, newCapacity, additionalCapacity);
+            return b->CreateIsNotNull(b->CreateCall(growInPlaceFn, args));
+        };
+
+        // other threads may still be reading from the current buffer; keep it until the next expansion
+        auto replaceBuffer = [&](Value * const currentBuffer, Value * const newCapacity) {
+            Value * const newBuffer = b->CreatePointerCast(b->CreateAnonymousMMap(getAllocationSize(b, newCapacity, additionalCapacity)), getPointerType());
+            Value * const priorBuffer = b->CreateLoad(priorBufferField);
+            BasicBlock * const releasePrior = BasicBlock::Create(C, "releasePrior", func);
+            BasicBlock * const replace = BasicBlock::Create(C, "replaceBuffer", func);
+            b->CreateCondBr(b->CreateICmpNE(priorBuffer, nullPointerFor(b, priorBuffer, mUnderflow)), releasePrior, replace);
+
+            b->SetInsertPoint(releasePrior);
+            Value * const priorCapacity = b->CreateLoad(priorCapacityField);
+            b->CreateMUnmap(b->CreateInBoundsGEP(priorBuffer, b->CreateNeg(underflow)), getAllocationSize(b, priorCapacity, additionalCapacity));
+            b->CreateBr(replace);
+
+            b->SetInsertPoint(replace);
+            b->CreateStore(currentBuffer, priorBufferField);
+            b->CreateStore(capacity, priorCapacityField);
+            return b->CreateInBoundsGEP(newBuffer, underflow);
+        };
 
         if (mLinear) {
 
             indices[1] = b->getInt32(MallocedAddress);
             Value * const mallocAddrField = b->CreateInBoundsGEP(handle, indices);
             Value * const mallocAddress = b->CreateLoad(mallocAddrField);
+            indices[1] = b->getInt32(EffectiveCapacity);
+            Value * const effCapacityField = b->CreateInBoundsGEP(handle, indices);
+            Value * const effCapacity = b->CreateLoad(effCapacityField);
 
             Value * const bytesToCopy = b->CreateMul(unconsumedChunks, CHUNK_SIZE);
 
-
             BasicBlock * const copyBack = BasicBlock::Create(C, "copyBack", func);
+            BasicBlock * const checkGrowInPlace = BasicBlock::Create(C, "checkGrowInPlace", func);
+            BasicBlock * const growInPlace = BasicBlock::Create(C, "growInPlace", func);
+            BasicBlock * const grownInPlace = BasicBlock::Create(C, "grownInPlace", func);
             BasicBlock * const expandAndCopyBack = BasicBlock::Create(C, "expandAndCopyBack", func);
             BasicBlock * const updateBaseAddress = BasicBlock::Create(C, "updateBaseAddress", func);
 
@@ -960,31 +1154,41 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
             Value * const overwriteUpToPtr = b->CreateInBoundsGEP(mallocAddress, chunksToOverwrite);
             Value * const canCopy = b->CreateICmpULE(overwriteUpToPtr, unreadDataPtr);
 
-            indices[1] = b->getInt32(InternalCapacity);
-            Value * const intCapacityField = b->CreateInBoundsGEP(getHandle(), indices);
-            Value * const bufferCapacity = b->CreateLoad(intCapacityField);
-            b->CreateLikelyCondBr(canCopy, copyBack, expandAndCopyBack);
+            b->CreateLikelyCondBr(canCopy, copyBack, checkGrowInPlace);
 
             b->SetInsertPoint(copyBack);
             b->CreateMemCpy(mallocAddress, unreadDataPtr, bytesToCopy, blockSize);
+            recordExpansion(b, handle, bytesToCopy, SZ_ZERO);
             BasicBlock * const copyBackExit = b->GetInsertBlock();
             b->CreateBr(updateBaseAddress);
 
+            // Extending the buffer in place leaves the unconsumed data where it is but also keeps the consumed
+            // chunks in front of it. Only do so if they take no more space than the data we would otherwise copy.
+            b->SetInsertPoint(checkGrowInPlace);
+            Value * const rebasedChunks = b->CreateSub(effCapacity, capacity);
+            Value * const retainedChunks = b->CreateSub(consumedChunks, rebasedChunks);
+            Value * const grownCapacity = b->CreateRoundUp(b->CreateSub(requiredChunks, rebasedChunks), capacity);
+            Value * const worthGrowing = b->CreateICmpULE(retainedChunks, unconsumedChunks);
+            b->CreateCondBr(worthGrowing, growInPlace, expandAndCopyBack);
+
+            b->SetInsertPoint(growInPlace);
+            b->CreateCondBr(tryToGrowInPlace(mallocAddress, grownCapacity), grownInPlace, expandAndCopyBack);
+
+            b->SetInsertPoint(grownInPlace);
+            b->CreateStore(grownCapacity, capacityField);
+            b->CreateStore(b->CreateAdd(rebasedChunks, grownCapacity), effCapacityField);
+            recordExpansion(b, handle, SZ_ZERO, bytesToCopy);
+            b->CreateRetVoid();
+
+            // the unconsumed data is copied to the start of the new buffer so it only needs to hold it
+            // and the required items rather than everything up to the required position.
             b->SetInsertPoint(expandAndCopyBack);
-            Value * const newBufferCapacity = b->CreateRoundUp(requiredChunks, capacity);
-            Value * const additionalCapacity = b->CreateAdd(underflow, overflow);
-            Value * const requiredCapacity = b->CreateAdd(newBufferCapacity, additionalCapacity);
-            Value * expandedBuffer = b->CreatePageAlignedMalloc(mType, requiredCapacity, mAddressSpace);
-            expandedBuffer = b->CreateInBoundsGEP(expandedBuffer, underflow);
-            b->CreateStore(newBufferCapacity, intCapacityField);
-
-            indices[1] = b->getInt32(PriorAddress);
-            Value * const priorBufferField = b->CreateInBoundsGEP(handle, indices);
-            Value * priorBuffer = b->CreateLoad(priorBufferField);
-            b->CreateFree(b->CreateInBoundsGEP(priorBuffer, b->CreateNeg(underflow)));
-            b->CreateStore(mallocAddress, priorBufferField);
-            b->CreateStore(expandedBuffer, mallocAddrField);
+            Value * const newBufferCapacity = b->CreateRoundUp(chunksToOverwrite, capacity);
+            Value * const expandedBuffer = replaceBuffer(mallocAddress, newBufferCapacity);
             b->CreateMemCpy(expandedBuffer, unreadDataPtr, bytesToCopy, blockSize);
+            b->CreateStore(newBufferCapacity, capacityField);
+            b->CreateStore(expandedBuffer, mallocAddrField);
+            recordExpansion(b, handle, bytesToCopy, SZ_ZERO);
             BasicBlock * const expandAndCopyBackExit = b->GetInsertBlock();
             b->CreateBr(updateBaseAddress);
 
@@ -993,13 +1197,11 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
             newBaseBuffer->addIncoming(mallocAddress, copyBackExit);
             newBaseBuffer->addIncoming(expandedBuffer, expandAndCopyBackExit);
             PHINode * const bufferCapacityPhi = b->CreatePHI(sizeTy, 2);
-            bufferCapacityPhi->addIncoming(bufferCapacity, copyBackExit);
+            bufferCapacityPhi->addIncoming(capacity, copyBackExit);
             bufferCapacityPhi->addIncoming(newBufferCapacity, expandAndCopyBackExit);
             Value * const newBaseAddress = b->CreateGEP(newBaseBuffer, b->CreateNeg(consumedChunks));
             b->CreateStore(newBaseAddress, virtualBaseField);
             Value * const effectiveCapacity = b->CreateAdd(consumedChunks, bufferCapacityPhi);
-            indices[1] = b->getInt32(EffectiveCapacity);
-            Value * const effCapacityField = b->CreateInBoundsGEP(handle, indices);
             b->CreateStore(effectiveCapacity, effCapacityField);
             b->CreateRetVoid();
 
@@ -1008,18 +1210,41 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
             // make sure the new capacity is at least 2x the current capacity and a multiple of it
             if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableAsserts))) {
                 Value * const check = b->CreateICmpUGE(requiredChunks, capacity);
-                b->CreateAssert(check, "unnecessary buffer expansion occurred");                
+                b->CreateAssert(check, "unnecessary buffer expansion occurred");
             }
-            Value * const newCapacity = b->CreateRoundUp(requiredChunks, capacity);
-            Value * const additionalCapacity = b->CreateAdd(underflow, overflow);
-            Value * const requiredCapacity = b->CreateAdd(newCapacity, additionalCapacity);
+            Value * const neededChunks = b->CreateSub(requiredChunks, consumedChunks);
+            Value * const newCapacity = b->CreateUMax(b->CreateRoundUp(neededChunks, capacity), b->CreateShl(capacity, 1));
 
             Value * const totalBytesToCopy = b->CreateMul(unconsumedChunks, CHUNK_SIZE);
+            Value * const consumedOffset = b->CreateURem(consumedChunks, capacity);
+            Value * const consumedOffsetPtr = b->CreateInBoundsGEP(virtualBase, consumedOffset);
 
-            Value * newBuffer = b->CreatePageAlignedMalloc(mType, requiredCapacity, mAddressSpace);
-            newBuffer = b->CreateInBoundsGEP(newBuffer, { underflow });
+            BasicBlock * const relocateInPlace = BasicBlock::Create(C, "relocateInPlace", func);
+            BasicBlock * const copyToNewBuffer = BasicBlock::Create(C, "copyToNewBuffer", func);
+            b->CreateCondBr(tryToGrowInPlace(virtualBase, newCapacity), relocateInPlace, copyToNewBuffer);
+
+            // Chunk i moves from (i mod capacity) to (i mod newCapacity). Since the new capacity is a multiple of
+            // the old one, the unconsumed chunks form at most two runs, each of which either stays where it is or
+            // moves into the newly mapped memory (which no reader of the old capacity will access.)
+            b->SetInsertPoint(relocateInPlace);
+            Value * const firstRun = b->CreateUDiv(consumedChunks, capacity);
+            Value * const numOfRuns = b->CreateUDiv(newCapacity, capacity);
+            Value * const firstRunShift = b->CreateMul(b->CreateURem(firstRun, numOfRuns), capacity);
+            Value * const secondRunShift = b->CreateMul(b->CreateURem(b->CreateAdd(firstRun, b->getSize(1)), numOfRuns), capacity);
+            Value * const firstRunLength = b->CreateUMin(unconsumedChunks, b->CreateSub(capacity, consumedOffset));
+            Value * const secondRunLength = b->CreateSub(unconsumedChunks, firstRunLength);
+            Value * const firstRunBytes = b->CreateSelect(b->CreateIsNull(firstRunShift), SZ_ZERO, b->CreateMul(firstRunLength, CHUNK_SIZE));
+            Value * const secondRunBytes = b->CreateSelect(b->CreateIsNull(secondRunShift), SZ_ZERO, b->CreateMul(secondRunLength, CHUNK_SIZE));
+            b->CreateMemCpy(b->CreateInBoundsGEP(consumedOffsetPtr, firstRunShift), consumedOffsetPtr, firstRunBytes, blockSize);
+            b->CreateMemCpy(b->CreateInBoundsGEP(virtualBase, secondRunShift), virtualBase, secondRunBytes, blockSize);
+            b->CreateStore(newCapacity, capacityField);
+            Value * const copiedBytes = b->CreateAdd(firstRunBytes, secondRunBytes);
+            recordExpansion(b, handle, copiedBytes, b->CreateSub(totalBytesToCopy, copiedBytes));
+            b->CreateRetVoid();
+
+            b->SetInsertPoint(copyToNewBuffer);
+            Value * const newBuffer = replaceBuffer(virtualBase, newCapacity);
 
-            Value * const consumedOffset = b->CreateURem(consumedChunks, capacity);
             Value * const producedOffset = b->CreateURem(producedChunks, capacity);
             Value * const newConsumedOffset = b->CreateURem(consumedChunks, newCapacity);
             Value * const newProducedOffset = b->CreateURem(producedChunks, newCapacity);
@@ -1029,7 +1254,6 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
             Value * const targetLinear = b->CreateICmpULE(newConsumedOffsetEnd, newProducedOffset);
             Value * const linearCopy = b->CreateAnd(sourceLinear, targetLinear);
 
-            Value * const consumedOffsetPtr = b->CreateInBoundsGEP(virtualBase, consumedOffset);
             Value * const newConsumedOffsetPtr = b->CreateInBoundsGEP(newBuffer, newConsumedOffset);
 
             BasicBlock * const copyLinear = BasicBlock::Create(C, "copyLinear", func);
@@ -1044,11 +1268,8 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
             b->SetInsertPoint(copyNonLinear);
             Value * const bufferLength1 = b->CreateSub(capacity, consumedOffset);
             Value * const newBufferLength1 = b->CreateSub(newCapacity, newConsumedOffset);
-            Value * const partialLength1 = b->CreateUMin(bufferLength1, newBufferLength1);
-            Value * const copyEndPtr = b->CreateInBoundsGEP(virtualBase, b->CreateAdd(consumedOffset, partialLength1));
-            Value * const copyEndPtrInt = b->CreatePtrToInt(copyEndPtr, intPtrTy);
-            Value * const consumedOffsetPtrInt = b->CreatePtrToInt(consumedOffsetPtr, intPtrTy);
-            Value * const bytesToCopy1 = b->CreateSub(copyEndPtrInt, consumedOffsetPtrInt);
+            Value * const partialLength1 = b->CreateUMin(b->CreateUMin(bufferLength1, newBufferLength1), unconsumedChunks);
+            Value * const bytesToCopy1 = b->CreateMul(partialLength1, CHUNK_SIZE);
             b->CreateMemCpy(newConsumedOffsetPtr, consumedOffsetPtr, bytesToCopy1, blockSize);
             Value * const sourceOffset = b->CreateURem(b->CreateAdd(consumedOffset, partialLength1), capacity);
             Value * const sourcePtr = b->CreateInBoundsGEP(virtualBase, sourceOffset);
@@ -1059,14 +1280,9 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
             b->CreateBr(storeNewBuffer);
 
             b->SetInsertPoint(storeNewBuffer);
-            indices[1] = b->getInt32(PriorAddress);
-            Value * const priorBufferField = b->CreateInBoundsGEP(handle, indices);
-            Value * const priorBuffer = b->CreateLoad(priorBufferField);
             b->CreateStore(newCapacity, capacityField);
-            b->CreateStore(virtualBase, priorBufferField);
             b->CreateStore(newBuffer, virtualBaseField);
-            b->CreateFree(b->CreateInBoundsGEP(priorBuffer, { b->CreateNeg(underflow) }));
-
+            recordExpansion(b, handle, totalBytesToCopy, SZ_ZERO);
             b->CreateRetVoid();
         }
 
@@ -1080,6 +1296,358 @@ void DynamicBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value
     b->CreateCall(funcTy, func, { myHandle, produced, consumed, required, b->getSize(mUnderflow), b->getSize(mOverflow) });
 }
 
+// Mirrored Buffer
+
+// The pages of a mirrored buffer are mapped once before its base address (for lookbehind/delay) and twice
+// after it: a window of up to one capacity may begin anywhere within the first copy after the base address
+// and the overflow written beyond it extends into the second.
+const size_t MirroredBufferMappingsBeforeBase = 1;
+const size_t MirroredBufferMappings = 4;
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1U
+#endif
+
+[[noreturn]] void reportMirroredBufferError(const char * const action) {
+    report_fatal_error(StringRef{"Cannot "} + action + " a mirrored stream set buffer: " + std::strerror(errno));
+}
+
+int createMirroredBufferFile(const size_t size) {
+    int fd = -1;
+    #if defined(__linux__) && defined(SYS_memfd_create)
+    fd = static_cast<int>(syscall(SYS_memfd_create, "parabix-streamset", MFD_CLOEXEC));
+    #endif
+    if (LLVM_UNLIKELY(fd == -1)) {
+        // an unlinked temporary file provides the same shared pages where memfd_create is unavailable
+        FILE * const file = std::tmpfile();
+        if (file) {
+            fd = dup(fileno(file));
+            std::fclose(file);
+        }
+    }
+    if (LLVM_UNLIKELY(fd == -1)) {
+        reportMirroredBufferError("create the backing file of");
+    }
+    if (LLVM_UNLIKELY(ftruncate(fd, size) != 0)) {
+        reportMirroredBufferError("size the backing file of");
+    }
+    return fd;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __mirrored_buffer_round_capacity
+ *
+ * Round a capacity (in blocks) up so that the buffer is a whole number of pages.
+ ** ------------------------------------------------------------------------------------------------------------- */
+size_t __mirrored_buffer_round_capacity(const size_t blockSize, const size_t capacity) {
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t a = pageSize, b = blockSize;
+    while (b) {
+        const auto r = a % b;
+        a = b;
+        b = r;
+    }
+    const auto blocksPerUnit = pageSize / a;
+    return ((capacity + blocksPerUnit - 1) / blocksPerUnit) * blocksPerUnit;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __mirrored_buffer_map
+ ** ------------------------------------------------------------------------------------------------------------- */
+void * __mirrored_buffer_map(const size_t size) {
+    const int fd = createMirroredBufferFile(size);
+    // reserve the address range first so that the mappings are guaranteed to be adjacent
+    void * const reserved = mmap(nullptr, size * MirroredBufferMappings, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (LLVM_UNLIKELY(reserved == MAP_FAILED)) {
+        reportMirroredBufferError("reserve the address space of");
+    }
+    char * const region = static_cast<char *>(reserved);
+    for (size_t i = 0; i < MirroredBufferMappings; ++i) {
+        void * const mirror = mmap(region + (i * size), size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if (LLVM_UNLIKELY(mirror == MAP_FAILED)) {
+            reportMirroredBufferError("map");
+        }
+    }
+    close(fd);
+    return region + (MirroredBufferMappingsBeforeBase * size);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __mirrored_buffer_unmap
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __mirrored_buffer_unmap(void * const baseAddress, const size_t size) {
+    if (baseAddress) {
+        char * const region = static_cast<char *>(baseAddress) - (MirroredBufferMappingsBeforeBase * size);
+        munmap(region, size * MirroredBufferMappings);
+    }
+}
+
+void MirroredBuffer::linkFunctions(BuilderPtr b) {
+    b->LinkFunction("__mirrored_buffer_round_capacity", __mirrored_buffer_round_capacity);
+    b->LinkFunction("__mirrored_buffer_map", __mirrored_buffer_map);
+    b->LinkFunction("__mirrored_buffer_unmap", __mirrored_buffer_unmap);
+}
+
+Type * MirroredBuffer::getHandleType(BuilderPtr b) const {
+    auto & C = b->getContext();
+    PointerType * const typePtr = getPointerType();
+    IntegerType * const sizeTy = b->getSizeTy();
+    FixedArray<Type *, 4> types;
+    types[BaseAddress] = typePtr;
+    types[InternalCapacity] = sizeTy;
+    types[PriorAddress] = typePtr;
+    types[PriorCapacity] = sizeTy;
+    return StructType::get(C, types);
+}
+
+Value * MirroredBuffer::mapBuffer(BuilderPtr b, Value * const capacity) const {
+    Function * const mapFn = b->LinkFunction("__mirrored_buffer_map", __mirrored_buffer_map);
+    Constant * const CHUNK_SIZE = ConstantExpr::getSizeOf(mType);
+    Value * const address = b->CreateCall(mapFn, b->CreateMul(capacity, CHUNK_SIZE));
+    return b->CreatePointerCast(address, getPointerType());
+}
+
+void MirroredBuffer::unmapBuffer(BuilderPtr b, Value * const baseAddress, Value * const capacity) const {
+    Function * const unmapFn = b->LinkFunction("__mirrored_buffer_unmap", __mirrored_buffer_unmap);
+    Constant * const CHUNK_SIZE = ConstantExpr::getSizeOf(mType);
+    FixedArray<Value *, 2> args;
+    args[0] = b->CreatePointerCast(baseAddress, b->getVoidPtrTy());
+    args[1] = b->CreateMul(capacity, CHUNK_SIZE);
+    b->CreateCall(unmapFn, args);
+}
+
+void MirroredBuffer::allocateBuffer(BuilderPtr b, Value * const capacityMultiplier) {
+    assert (mHandle && "has not been set prior to calling allocateBuffer");
+    FixedArray<Value *, 2> indices;
+    indices[0] = b->getInt32(0);
+
+    Value * const handle = getHandle();
+    Value * capacity = b->CreateMul(capacityMultiplier, b->getSize(mInitialCapacity));
+
+    if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableAsserts))) {
+        b->CreateAssert(capacity, "Mirrored buffer capacity cannot be 0.");
+    }
+
+    Function * const roundFn = b->LinkFunction("__mirrored_buffer_round_capacity", __mirrored_buffer_round_capacity);
+    FixedArray<Value *, 2> args;
+    args[0] = ConstantExpr::getSizeOf(mType);
+    args[1] = capacity;
+    capacity = b->CreateCall(roundFn, args);
+
+    indices[1] = b->getInt32(InternalCapacity);
+    b->CreateStore(capacity, b->CreateInBoundsGEP(handle, indices));
+    indices[1] = b->getInt32(BaseAddress);
+    b->CreateStore(mapBuffer(b, capacity), b->CreateInBoundsGEP(handle, indices));
+    indices[1] = b->getInt32(PriorAddress);
+    b->CreateStore(ConstantPointerNull::get(getPointerType()), b->CreateInBoundsGEP(handle, indices));
+    indices[1] = b->getInt32(PriorCapacity);
+    b->CreateStore(b->getSize(0), b->CreateInBoundsGEP(handle, indices));
+}
+
+void MirroredBuffer::releaseBuffer(BuilderPtr b) const {
+    Value * const handle = getHandle();
+    FixedArray<Value *, 2> indices;
+    indices[0] = b->getInt32(0);
+    indices[1] = b->getInt32(PriorAddress);
+    Value * const priorAddressField = b->CreateInBoundsGEP(handle, indices);
+    indices[1] = b->getInt32(PriorCapacity);
+    Value * const priorCapacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    unmapBuffer(b, b->CreateLoad(priorAddressField), priorCapacity);
+    Constant * const nullPtr = ConstantPointerNull::get(getPointerType());
+    b->CreateStore(nullPtr, priorAddressField);
+    indices[1] = b->getInt32(BaseAddress);
+    Value * const baseAddressField = b->CreateInBoundsGEP(handle, indices);
+    indices[1] = b->getInt32(InternalCapacity);
+    Value * const capacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    unmapBuffer(b, b->CreateLoad(baseAddressField), capacity);
+    b->CreateStore(nullPtr, baseAddressField);
+}
+
+void MirroredBuffer::resetBuffer(BuilderPtr /* b */) const {
+    // a circular buffer can be rewritten from any position; keep any capacity gained by expansion
+}
+
+Value * MirroredBuffer::getLinearlyAccessibleItems(BuilderPtr b, Value * const processedItems, Value * const totalItems, Value * /* overflowItems */) const {
+    // every unconsumed item is contiguous in the mirrored memory
+    return b->CreateSub(totalItems, processedItems);
+}
+
+Value * MirroredBuffer::getLinearlyWritableItems(BuilderPtr b, Value * const producedItems, Value * const consumedItems, Value * /* overflowItems */) const {
+    Value * const capacity = getCapacity(b);
+    Value * const unconsumedItems = b->CreateSub(producedItems, consumedItems);
+    Value * const full = b->CreateICmpUGE(unconsumedItems, capacity);
+    Value * const remaining = b->CreateSub(capacity, unconsumedItems);
+    return b->CreateSelect(full, b->getSize(0), remaining);
+}
+
+Value * MirroredBuffer::getBaseAddress(BuilderPtr b) const {
+    assert (getHandle());
+    Value * const ptr = b->CreateInBoundsGEP(getHandle(), {b->getInt32(0), b->getInt32(BaseAddress)});
+    return b->CreateLoad(ptr);
+}
+
+void MirroredBuffer::setBaseAddress(BuilderPtr /* b */, Value * /* addr */) const {
+    unsupported("setBaseAddress", "Mirrored");
+}
+
+Value * MirroredBuffer::getMallocAddress(BuilderPtr b) const {
+    return getBaseAddress(b);
+}
+
+Value * MirroredBuffer::getOverflowAddress(BuilderPtr b) const {
+    FixedArray<Value *, 2> indices;
+    indices[0] = b->getInt32(0);
+    indices[1] = b->getInt32(BaseAddress);
+    Value * const handle = getHandle(); assert (handle);
+    Value * const base = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    indices[1] = b->getInt32(InternalCapacity);
+    Value * const capacity = b->CreateLoad(b->CreateInBoundsGEP(handle, indices));
+    return b->CreateInBoundsGEP(base, capacity);
+}
+
+Value * MirroredBuffer::modByCapacity(BuilderPtr b, Value * const offset) const {
+    assert (offset->getType()->isIntegerTy());
+    if (isCapacityGuaranteed(offset, mInitialCapacity)) {
+        return offset;
+    } else {
+        assert (getHandle());
+        FixedArray<Value *, 2> indices;
+        indices[0] = b->getInt32(0);
+        indices[1] = b->getInt32(InternalCapacity);
+        Value * const capacity = b->CreateLoad(b->CreateInBoundsGEP(getHandle(), indices));
+        return b->CreateURem(offset, capacity);
+    }
+}
+
+Value * MirroredBuffer::getCapacity(BuilderPtr b) const {
+    assert (getHandle());
+    FixedArray<Value *, 2> indices;
+    indices[0] = b->getInt32(0);
+    indices[1] = b->getInt32(InternalCapacity);
+    ConstantInt * const BLOCK_WIDTH = b->getSize(b->getBitBlockWidth());
+    Value * const capacity = b->CreateLoad(b->CreateInBoundsGEP(getHandle(), indices));
+    return b->CreateMul(capacity, BLOCK_WIDTH, "capacity");
+}
+
+Value * MirroredBuffer::getInternalCapacity(BuilderPtr b) const {
+    return getCapacity(b);
+}
+
+void MirroredBuffer::setCapacity(BuilderPtr /* b */, Value * /* capacity */) const {
+    unsupported("setCapacity", "Mirrored");
+}
+
+void MirroredBuffer::copyBackLinearOutputBuffer(BuilderPtr /* b */, llvm::Value * /* consumed */) const {
+    /* do nothing */
+}
+
+void MirroredBuffer::reserveCapacity(BuilderPtr b, Value * const produced, Value * const consumed, Value * const required, Value * /* overflowItems */) const {
+
+    SmallVector<char, 200> buf;
+    raw_svector_ostream name(buf);
+
+    assert ("unspecified module" && b.get() && b->getModule());
+
+    name << "__MirroredBuffer_reserveCapacity_";
+
+    Type * ty = getBaseType();
+    const auto streamCount = ty->getArrayNumElements();
+    name << streamCount << 'x';
+    ty = ty->getArrayElementType();
+    ty = ty->getVectorElementType();
+    const auto itemWidth = ty->getIntegerBitWidth();
+    name << itemWidth << '_' << mAddressSpace;
+
+    Value * const myHandle = getHandle();
+
+    Module * const m = b->getModule();
+    IntegerType * const sizeTy = b->getSizeTy();
+    FunctionType * funcTy = FunctionType::get(b->getVoidTy(), {myHandle->getType(), sizeTy, sizeTy, sizeTy}, false);
+    Function * func = m->getFunction(name.str());
+    if (func == nullptr) {
+
+        const auto ip = b->saveIP();
+
+        LLVMContext & C = m->getContext();
+        func = Function::Create(funcTy, Function::InternalLinkage, name.str(), m);
+
+        b->SetInsertPoint(BasicBlock::Create(C, "entry", func));
+
+        auto arg = func->arg_begin();
+        auto nextArg = [&]() {
+            assert (arg != func->arg_end());
+            Value * const v = &*arg;
+            std::advance(arg, 1);
+            return v;
+        };
+
+        Value * const handle = nextArg();
+        handle->setName("handle");
+        Value * const produced = nextArg();
+        produced->setName("produced");
+        Value * const consumed = nextArg();
+        consumed->setName("consumed");
+        Value * const required = nextArg();
+        required->setName("required");
+        assert (arg == func->arg_end());
+
+        setHandle(handle);
+
+        const auto blockWidth = b->getBitBlockWidth();
+        assert (is_pow2(blockWidth));
+        const auto blockSize = blockWidth / 8;
+
+        ConstantInt * const BLOCK_WIDTH = b->getSize(blockWidth);
+        Constant * const CHUNK_SIZE = ConstantExpr::getSizeOf(mType);
+
+        FixedArray<Value *, 2> indices;
+        indices[0] = b->getInt32(0);
+        indices[1] = b->getInt32(InternalCapacity);
+        Value * const capacityField = b->CreateInBoundsGEP(handle, indices);
+        Value * const capacity = b->CreateLoad(capacityField);
+        indices[1] = b->getInt32(BaseAddress);
+        Value * const baseAddressField = b->CreateInBoundsGEP(handle, indices);
+        Value * const baseAddress = b->CreateLoad(baseAddressField);
+
+        Value * const consumedChunks = b->CreateUDiv(consumed, BLOCK_WIDTH);
+        Value * const producedChunks = b->CreateCeilUDiv(produced, BLOCK_WIDTH);
+        Value * const unconsumedChunks = b->CreateSub(producedChunks, consumedChunks);
+        Value * const requiredChunks = b->CreateCeilUDiv(b->CreateAdd(produced, required), BLOCK_WIDTH);
+        Value * const neededChunks = b->CreateSub(requiredChunks, consumedChunks);
+
+        // grow by at least 2x; the new capacity need not be a multiple of the old one since the
+        // unconsumed data is contiguous in both the old and new mirrored memory
+        Value * newCapacity = b->CreateUMax(b->CreateRoundUp(neededChunks, capacity), b->CreateShl(capacity, 1));
+        Function * const roundFn = b->LinkFunction("__mirrored_buffer_round_capacity", __mirrored_buffer_round_capacity);
+        FixedArray<Value *, 2> args;
+        args[0] = CHUNK_SIZE;
+        args[1] = newCapacity;
+        newCapacity = b->CreateCall(roundFn, args);
+        Value * const newBaseAddress = mapBuffer(b, newCapacity);
+
+        Value * const source = b->CreateInBoundsGEP(baseAddress, b->CreateURem(consumedChunks, capacity));
+        Value * const target = b->CreateInBoundsGEP(newBaseAddress, b->CreateURem(consumedChunks, newCapacity));
+        b->CreateMemCpy(target, source, b->CreateMul(unconsumedChunks, CHUNK_SIZE), blockSize);
+
+        // other threads may still be reading from the current buffer; keep it until the next expansion
+        indices[1] = b->getInt32(PriorAddress);
+        Value * const priorAddressField = b->CreateInBoundsGEP(handle, indices);
+        indices[1] = b->getInt32(PriorCapacity);
+        Value * const priorCapacityField = b->CreateInBoundsGEP(handle, indices);
+        unmapBuffer(b, b->CreateLoad(priorAddressField), b->CreateLoad(priorCapacityField));
+        b->CreateStore(baseAddress, priorAddressField);
+        b->CreateStore(capacity, priorCapacityField);
+        b->CreateStore(newBaseAddress, baseAddressField);
+        b->CreateStore(newCapacity, capacityField);
+        b->CreateRetVoid();
+
+        b->restoreIP(ip);
+        setHandle(myHandle);
+    }
+
+    b->CreateCall(funcTy, func, { myHandle, produced, consumed, required });
+}
+
 // Constructors
 
 ExternalBuffer::ExternalBuffer(const unsigned id, BuilderPtr b, Type * const type,
@@ -1113,6 +1681,18 @@ DynamicBuffer::DynamicBuffer(const unsigned id, BuilderPtr b, Type * const type,
     #endif
 }
 
+MirroredBuffer::MirroredBuffer(const unsigned id, BuilderPtr b, Type * const type,
+                               const size_t initialCapacity, const size_t overflowSize, const size_t underflowSize,
+                               const unsigned AddressSpace)
+: InternalBuffer(id, BufferKind::MirroredBuffer, b, type, overflowSize, underflowSize, false, AddressSpace)
+, mInitialCapacity(initialCapacity) {
+    #ifndef NDEBUG
+    assert ("mirrored buffer cannot have 0 initial capacity" && initialCapacity);
+    assert ("mirrored buffer initial capacity must be at least twice its max(underflow, overflow)"
+            && (initialCapacity >= (std::max(underflowSize, overflowSize) * 2)));
+    #endif
+}
+
 inline InternalBuffer::InternalBuffer(const unsigned id, const BufferKind k, BuilderPtr b, Type * const baseType,
                                       const size_t overflowSize, const size_t underflowSize,
                                       const bool linear, const unsigned AddressSpace)
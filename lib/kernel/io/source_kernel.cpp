@@ -10,8 +10,15 @@
 #include <llvm/IR/Module.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #include <toolchain/toolchain.h>
 #include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
 using namespace llvm;
 
@@ -27,6 +34,198 @@ extern "C" uint64_t file_size(const uint32_t fd) {
     return st.st_size;
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief AsyncReader
+ *
+ * Reads a pipe (or any other input that cannot be memory mapped) on a dedicated I/O thread into a ring buffer
+ * while the pipeline processes the prior segment. The read source kernel copies its data out of the ring rather
+ * than blocking in read. The ring holds at least two of the kernel's buffers so that the next region can be read
+ * while the current one is copied out and processed.
+ ** ------------------------------------------------------------------------------------------------------------- */
+class AsyncReader {
+public:
+
+    static AsyncReader * open(const int fd, const size_t bufferBytes) noexcept {
+        // reading ahead only pays when the I/O thread can run alongside the pipeline
+        if (!codegen::AsyncRead || std::thread::hardware_concurrency() < 2) {
+            return nullptr;
+        }
+        int wake[2];
+        if (pipe(wake) != 0) {
+            return nullptr;
+        }
+        const auto capacity = std::max<size_t>(2 * bufferBytes, MINIMUM_CAPACITY);
+        #ifdef F_SETPIPE_SZ
+        // let the writer of a pipe run further ahead of us; this fails harmlessly for anything but a pipe
+        fcntl(fd, F_SETPIPE_SZ, static_cast<int>(std::min<size_t>(capacity, MAXIMUM_PIPE_SIZE)));
+        #endif
+        char * const buffer = reinterpret_cast<char *>(malloc(capacity));
+        AsyncReader * reader = nullptr;
+        if (LLVM_LIKELY(buffer != nullptr)) {
+            reader = new AsyncReader(fd, buffer, capacity, wake);
+            try {
+                reader->mThread = std::thread(&AsyncReader::run, reader);
+            } catch (...) {
+                delete reader;
+                return nullptr;
+            }
+        } else {
+            ::close(wake[0]);
+            ::close(wake[1]);
+        }
+        return reader;
+    }
+
+    int64_t read(char * const buffer, const size_t bytes) noexcept {
+        // The kernel keeps reading until it has a full segment so wait until the ring can satisfy the whole
+        // request rather than waking for each chunk the I/O thread reads.
+        const size_t required = std::min(bytes, mCapacity);
+        std::unique_lock<std::mutex> lock(mLock);
+        mDataAvailable.wait(lock, [&] { return (mTail - mHead) >= required || mEOF || mError; });
+        const size_t available = mTail - mHead;
+        if (available == 0) {
+            if (mError) {
+                errno = mError;
+                return -1;
+            }
+            return 0;
+        }
+        // the I/O thread never writes to the unconsumed region of the ring so it can be copied out unlocked
+        lock.unlock();
+        const size_t n = std::min(bytes, available);
+        const size_t offset = mHead % mCapacity;
+        const size_t first = std::min(n, mCapacity - offset);
+        std::memcpy(buffer, mBuffer + offset, first);
+        std::memcpy(buffer + first, mBuffer, n - first);
+        lock.lock();
+        mHead += n;
+        lock.unlock();
+        mSpaceAvailable.notify_one();
+        return static_cast<int64_t>(n);
+    }
+
+    ~AsyncReader() {
+        if (mThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                mStop = true;
+            }
+            // wake the I/O thread if it is waiting on input
+            const char c = 0;
+            while (::write(mWakeWrite, &c, 1) < 0 && errno == EINTR);
+            mSpaceAvailable.notify_one();
+            mThread.join();
+        }
+        ::close(mWakeRead);
+        ::close(mWakeWrite);
+        free(mBuffer);
+    }
+
+private:
+
+    AsyncReader(const int fd, char * const buffer, const size_t capacity, const int wake[2])
+    : mFd(fd), mBuffer(buffer), mCapacity(capacity), mWakeRead(wake[0]), mWakeWrite(wake[1]) {
+
+    }
+
+    void run() noexcept {
+        for (;;) {
+            size_t offset, space;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mSpaceAvailable.wait(lock, [&] { return mStop || (mTail - mHead) < mCapacity; });
+                if (mStop) {
+                    return;
+                }
+                offset = mTail % mCapacity;
+                space = std::min(mCapacity - (mTail - mHead), mCapacity - offset);
+            }
+            // wait for input (or a request to stop) before reading so that a pipeline that ends early
+            // never waits on a blocked read.
+            struct pollfd fds[2];
+            fds[0].fd = mFd;
+            fds[0].events = POLLIN;
+            fds[1].fd = mWakeRead;
+            fds[1].events = POLLIN;
+            if (LLVM_UNLIKELY(poll(fds, 2, -1) < 0)) {
+                if (errno == EINTR) continue;
+                finish(false, errno);
+                return;
+            }
+            if (LLVM_UNLIKELY(fds[1].revents != 0)) {
+                return;
+            }
+            const auto n = ::read(mFd, mBuffer + offset, space);
+            if (LLVM_LIKELY(n > 0)) {
+                {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    mTail += n;
+                }
+                mDataAvailable.notify_one();
+            } else if (n == 0) {
+                finish(true, 0);
+                return;
+            } else if (errno != EINTR && errno != EAGAIN) {
+                finish(false, errno);
+                return;
+            }
+        }
+    }
+
+    void finish(const bool eof, const int error) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mEOF = eof;
+            mError = error;
+        }
+        mDataAvailable.notify_one();
+    }
+
+private:
+
+    static constexpr size_t MINIMUM_CAPACITY = 4 * 1024 * 1024;
+
+    // the default limit of /proc/sys/fs/pipe-max-size for unprivileged processes
+    static constexpr size_t MAXIMUM_PIPE_SIZE = 1024 * 1024;
+
+    const int                   mFd;
+    char * const                mBuffer;
+    const size_t                mCapacity;
+    const int                   mWakeRead;
+    const int                   mWakeWrite;
+    std::mutex                  mLock;
+    std::condition_variable     mDataAvailable;
+    std::condition_variable     mSpaceAvailable;
+    // total number of bytes copied out of and read into the ring
+    size_t                      mHead = 0;
+    size_t                      mTail = 0;
+    bool                        mEOF = false;
+    int                         mError = 0;
+    bool                        mStop = false;
+    std::thread                 mThread;
+};
+
+extern "C" void * async_reader_open(const uint32_t fd, const uint64_t bufferBytes) {
+    return AsyncReader::open(fd, bufferBytes);
+}
+
+// Falls back to a plain read when no reader could be started (or -async-read=0)
+extern "C" int64_t async_reader_read(void * const reader, const uint32_t fd, void * const buffer, const uint64_t bytes) {
+    if (LLVM_LIKELY(reader != nullptr)) {
+        return reinterpret_cast<AsyncReader *>(reader)->read(reinterpret_cast<char *>(buffer), bytes);
+    }
+    for (;;) {
+        const auto n = ::read(fd, buffer, bytes);
+        if (LLVM_LIKELY(n >= 0 || errno != EINTR)) {
+            return n;
+        }
+    }
+}
+
+extern "C" void async_reader_close(void * const reader) {
+    delete reinterpret_cast<AsyncReader *>(reader);
+}
+
 namespace kernel {
 
 /// MMAP SOURCE KERNEL
@@ -175,6 +374,9 @@ void ReadSourceKernel::generateInitializeMethod(const unsigned codeUnitWidth, co
     b->setScalarField("ancillaryBuffer", ConstantPointerNull::get(codeUnitPtrTy));
     b->setScalarField("effectiveCapacity", bufferItems);
     b->setCapacity("sourceBuffer", bufferItems);
+    Function * const openFn = b->getModule()->getFunction("async_reader_open"); assert (openFn);
+    Value * const fd = b->getScalarField("fileDescriptor");
+    b->setScalarField("asyncReader", b->CreateCall(openFn->getFunctionType(), openFn, {fd, bufferBytes}));
 }
 
 void ReadSourceKernel::generateDoSegmentMethod(const unsigned codeUnitWidth, const unsigned stride, BuilderRef b) {
@@ -295,7 +497,13 @@ void ReadSourceKernel::generateDoSegmentMethod(const unsigned codeUnitWidth, con
     producedSoFar->addIncoming(produced, entryBB);
     producedSoFar->addIncoming(produced, prepareBuffer);
     Value * const sourceBuffer = b->getRawOutputPointer("sourceBuffer", producedSoFar);
-    Value * const bytesRead = b->CreateReadCall(fd, sourceBuffer, bytesToRead);
+    Function * const readFn = b->getModule()->getFunction("async_reader_read"); assert (readFn);
+    Value * const reader = b->getScalarField("asyncReader");
+    if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableAsserts))) {
+        b->CheckAddress(sourceBuffer, bytesToRead, "ReadSource");
+    }
+    Value * const bytesRead = b->CreateCall(readFn->getFunctionType(), readFn,
+                                            {reader, fd, b->CreatePointerCast(sourceBuffer, b->getVoidPtrTy()), bytesToRead});
     // There are 4 possibile results from read:
     // bytesRead == -1: an error occurred
     // bytesRead == 0: EOF, no bytes read
@@ -325,7 +533,19 @@ void ReadSourceKernel::generateDoSegmentMethod(const unsigned codeUnitWidth, con
     b->SetInsertPoint(readExit);
 }
 
+void ReadSourceKernel::generatLinkExternalFunctions(BuilderRef b) {
+    b->LinkFunction("async_reader_open", async_reader_open);
+    b->LinkFunction("async_reader_read", async_reader_read);
+    b->LinkFunction("async_reader_close", async_reader_close);
+}
+
+void ReadSourceKernel::linkExternalMethods(BuilderRef b) {
+    ReadSourceKernel::generatLinkExternalFunctions(b);
+}
+
 void ReadSourceKernel::freeBuffer(BuilderRef b) {
+    Function * const closeFn = b->getModule()->getFunction("async_reader_close"); assert (closeFn);
+    b->CreateCall(closeFn->getFunctionType(), closeFn, b->getScalarField("asyncReader"));
     b->CreateFree(b->getScalarField("ancillaryBuffer"));
     b->CreateFree(b->getScalarField("buffer"));
 }
@@ -496,6 +716,7 @@ void MemorySourceKernel::generateDoSegmentMethod(BuilderRef b) {
 
 void FDSourceKernel::linkExternalMethods(BuilderRef b) {
     MMapSourceKernel::generatLinkExternalFunctions(b);
+    ReadSourceKernel::generatLinkExternalFunctions(b);
 }
 
 void MemorySourceKernel::generateFinalizeMethod(BuilderRef b) {
@@ -541,6 +762,7 @@ ReadSourceKernel::ReadSourceKernel(BuilderRef b, Scalar * const fd, StreamSet *
     addInternalScalar(codeUnitPtrTy, "ancillaryBuffer");
     IntegerType * const sizeTy = b->getSizeTy();
     addInternalScalar(sizeTy, "effectiveCapacity");
+    addInternalScalar(b->getVoidPtrTy(), "asyncReader");
     addAttribute(MustExplicitlyTerminate());
     setStride(codegen::SegmentSize);
 }
@@ -565,6 +787,7 @@ FDSourceKernel::FDSourceKernel(BuilderRef b, Scalar * const useMMap, Scalar * co
     addInternalScalar(codeUnitPtrTy, "ancillaryBuffer");
     IntegerType * const sizeTy = b->getSizeTy();
     addInternalScalar(sizeTy, "effectiveCapacity");
+    addInternalScalar(b->getVoidPtrTy(), "asyncReader");
     addAttribute(MustExplicitlyTerminate());
     setStride(codegen::SegmentSize);
 }
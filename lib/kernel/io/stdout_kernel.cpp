@@ -9,40 +9,387 @@
 #include <kernel/core/kernel_builder.h>
 #include <toolchain/toolchain.h>
 #include <kernel/core/streamset.h>
+#include <boost/interprocess/mapped_region.hpp>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <time.h>
 
 namespace llvm { class Type; }
 
 using namespace llvm;
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief OutputWriter
+ *
+ * Writes the output of a sink kernel to a pipe or regular file without writing each segment through write.
+ *
+ * With -splice-pipe-output, bulk output to a pipe is mapped into the pipe with vmsplice rather than copied into it.
+ * This is not the default because it is only safe for a reader that consumes the pipe with read. The pipe refers to
+ * the pages of the kernel's input buffer until the reader has read them, so the kernel defers its processed item
+ * count and this writer only releases the bytes that the reader has consumed: those that are no longer counted
+ * by FIONREAD on the pipe. Before returning, the writer waits until at most maxPending bytes remain unread (none
+ * on the final segment) so that the buffer never lags behind the pipeline by more than a stride, and only whole
+ * pages are spliced until then so that every pipe slot holds a full page. (A dynamic buffer that is expanded in
+ * the meantime is unmapped rather than reused, which leaves the pages the pipe refers to intact.) A reader that
+ * splices or tees the pages into another pipe or a file removes them from FIONREAD while still referring to them,
+ * and would see them overwritten once they are released. SPLICE_F_GIFT would not help unless the pages were never
+ * reused, which a circular buffer cannot promise. Without the option, output to a pipe is written as usual.
+ *
+ * Output to a regular file is written with pwrite in batches that end on a page-aligned file offset. The partial
+ * page at the end of each segment is normally held back until the next one, which saves the file system from
+ * updating the same page twice.
+ ** ------------------------------------------------------------------------------------------------------------- */
+class OutputWriter {
+public:
+
+    static OutputWriter * open(const int fd, const size_t maxPending) noexcept {
+        if (!codegen::ZeroCopyOutput) {
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            return nullptr;
+        }
+        #ifdef __linux__
+        if (S_ISFIFO(st.st_mode)) {
+            if (!codegen::SplicePipeOutput) {
+                return nullptr;
+            }
+            int unread = 0;
+            if (ioctl(fd, FIONREAD, &unread) != 0) {
+                return nullptr;
+            }
+            return new OutputWriter(fd, Pipe, 0, maxPending);
+        }
+        #endif
+        if (S_ISREG(st.st_mode)) {
+            // pwrite ignores the offset of a file opened for appending
+            const auto flags = fcntl(fd, F_GETFL);
+            if (flags == -1 || (flags & O_APPEND)) {
+                return nullptr;
+            }
+            const auto offset = lseek(fd, 0, SEEK_CUR);
+            if (offset < 0) {
+                return nullptr;
+            }
+            return new OutputWriter(fd, File, offset, maxPending);
+        }
+        return nullptr;
+    }
+
+    // Writes what it can of the bytes [position, position + bytes) of the output, which the given buffer holds,
+    // and returns the number of bytes of the output the kernel may release. The bytes from position up to those
+    // written by earlier calls are still in the buffer (unreleased) and are not written again.
+    uint64_t write(const char * const buffer, const uint64_t position, const uint64_t bytes, const bool final) noexcept {
+        assert (position <= mReleased && mReleased <= mSent && mSent <= position + bytes);
+        const char * const start = buffer + (mSent - position);
+        const char * const end = buffer + bytes;
+        if (mMode == File) {
+            const char * batchEnd = end;
+            if (!final) {
+                const auto endOffset = mFileOffset + position + bytes;
+                batchEnd -= endOffset & static_cast<uint64_t>(mPageSize - 1);
+            }
+            writeToFile(start, getLength(start, batchEnd, end));
+            mReleased = mSent;
+        } else {
+            // Small outputs are copied in as before: vmsplice only pays for bulk output and a reader that never
+            // consumes the last page of its input (e.g., a pager) should not keep us from finishing.
+            if (mSplice && mSent >= SPLICE_THRESHOLD) {
+                const char * batchEnd = end;
+                if (!final) {
+                    batchEnd = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(end) & ~static_cast<uintptr_t>(mPageSize - 1));
+                }
+                spliceToPipe(start, getLength(start, batchEnd, end));
+            } else {
+                writeToPipe(start, end - start);
+            }
+            waitForReader(final ? 0 : mMaxPending);
+        }
+        return mReleased;
+    }
+
+    ~OutputWriter() {
+        if (mMode == Pipe) {
+            // the pipeline frees its buffers after this so the reader must be done with every page we spliced
+            waitForReader(0);
+        } else {
+            // leave the file offset after the output as write would have
+            lseek(mFd, mFileOffset + mSent, SEEK_SET);
+        }
+    }
+
+private:
+
+    enum Mode { Pipe, File };
+
+    OutputWriter(const int fd, const Mode mode, const uint64_t fileOffset, const size_t maxPending)
+    : mFd(fd), mMode(mode), mFileOffset(fileOffset), mMaxPending(maxPending)
+    , mPageSize(boost::interprocess::mapped_region::get_page_size()) {
+
+    }
+
+    // The partial page at the end is held back unless nothing else is left: the segment may end at the end of a
+    // circular buffer, in which case the next one begins with the same (still partial) page.
+    static size_t getLength(const char * const start, const char * const batchEnd, const char * const end) noexcept {
+        return (batchEnd > start) ? (batchEnd - start) : (end - start);
+    }
+
+    bool waitUntilWritable() noexcept {
+        struct pollfd pfd;
+        pfd.fd = mFd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        while (poll(&pfd, 1, -1) < 0) {
+            if (errno != EINTR) return false;
+        }
+        return (pfd.revents & POLLOUT) != 0;
+    }
+
+    void writeToFile(const char * buffer, size_t bytes) noexcept {
+        while (bytes) {
+            const auto n = pwrite(mFd, buffer, bytes, mFileOffset + mSent);
+            if (LLVM_LIKELY(n > 0)) {
+                buffer += n;
+                bytes -= n;
+                mSent += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                // as with write, the output is lost on an error
+                mSent += bytes;
+                return;
+            }
+        }
+    }
+
+    void writeToPipe(const char * buffer, size_t bytes) noexcept {
+        while (bytes) {
+            const auto n = ::write(mFd, buffer, bytes);
+            if (LLVM_LIKELY(n > 0)) {
+                buffer += n;
+                bytes -= n;
+                mSent += n;
+            } else if (n < 0 && (errno == EINTR || (errno == EAGAIN && waitUntilWritable()))) {
+                continue;
+            } else {
+                mSent += bytes;
+                return;
+            }
+        }
+    }
+
+    void spliceToPipe(const char * buffer, size_t bytes) noexcept {
+        #ifdef __linux__
+        while (bytes) {
+            struct iovec iov;
+            iov.iov_base = const_cast<char *>(buffer);
+            iov.iov_len = bytes;
+            const auto n = vmsplice(mFd, &iov, 1, 0);
+            if (LLVM_LIKELY(n > 0)) {
+                buffer += n;
+                bytes -= n;
+                mSent += n;
+                mSpliced = mSent;
+            } else if (n < 0 && (errno == EINTR || (errno == EAGAIN && waitUntilWritable()))) {
+                continue;
+            } else if (n < 0 && errno == EPIPE) {
+                // the reader is gone; nothing will read what is left
+                mSent += bytes;
+                return;
+            } else {
+                mSplice = false;
+                break;
+            }
+        }
+        #else
+        mSplice = false;
+        #endif
+        writeToPipe(buffer, bytes);
+    }
+
+    // Release the bytes the reader has consumed, waiting until at most maxPending remain unread. The pipe holds
+    // the bytes that were sent last so everything sent before the unread bytes has been read; bytes that were
+    // copied into the pipe after the last spliced page can be released once that page has been read.
+    void waitForReader(const size_t maxPending) noexcept {
+        long delay = MINIMUM_DELAY;
+        for (;;) {
+            int n = 0;
+            if (LLVM_UNLIKELY(ioctl(mFd, FIONREAD, &n) != 0)) {
+                // open checked that FIONREAD works on this pipe, so the descriptor has been closed or replaced by
+                // another thread; nothing further will be spliced and the remaining bytes are treated as read
+                mSplice = false;
+                mReleased = mSent;
+                return;
+            }
+            const auto unread = std::min<uint64_t>(n, mSent - mReleased);
+            const auto consumed = mSent - unread;
+            mReleased = (consumed >= mSpliced) ? mSent : consumed;
+            if ((mSent - mReleased) <= maxPending) {
+                return;
+            }
+            // sleep briefly; a pipe whose reader closed it reports an error and will never be read
+            struct pollfd pfd;
+            pfd.fd = mFd;
+            pfd.events = 0;
+            pfd.revents = 0;
+            #ifdef __linux__
+            struct timespec timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_nsec = delay;
+            const auto ready = ppoll(&pfd, 1, &timeout, nullptr);
+            #else
+            const auto ready = poll(&pfd, 1, std::max<int>(delay / 1000000, 1));
+            #endif
+            if (ready > 0 && (pfd.revents & (POLLERR | POLLHUP))) {
+                mReleased = mSent;
+                return;
+            }
+            delay = std::min(delay * 2, MAXIMUM_DELAY);
+        }
+    }
+
+private:
+
+    // bytes written to a pipe before we start to splice pages into it
+    static constexpr uint64_t SPLICE_THRESHOLD = 1024 * 1024;
+
+    // ns to wait for the reader of the pipe between checks
+    static constexpr long MINIMUM_DELAY = 20 * 1000;
+    static constexpr long MAXIMUM_DELAY = 1000 * 1000;
+
+    const int                   mFd;
+    const Mode                  mMode;
+    const uint64_t              mFileOffset;
+    const size_t                mMaxPending;
+    const size_t                mPageSize;
+    bool                        mSplice = true;
+    // number of bytes of the output written (or spliced), the end of the last spliced page and the number
+    // the reader has consumed
+    uint64_t                    mSent = 0;
+    uint64_t                    mSpliced = 0;
+    uint64_t                    mReleased = 0;
+};
+
+extern "C" void * output_writer_open(const uint32_t fd, const uint64_t maxPendingBytes) {
+    return OutputWriter::open(fd, maxPendingBytes);
+}
+
+// Falls back to plain writes when the output is neither a pipe nor a regular file (or -zero-copy-output=0)
+extern "C" uint64_t output_writer_write(void * const writer, const uint32_t fd, const void * const buffer,
+                                        const uint64_t position, const uint64_t bytes, const uint32_t final) {
+    if (LLVM_LIKELY(writer != nullptr)) {
+        return reinterpret_cast<OutputWriter *>(writer)->write(reinterpret_cast<const char *>(buffer), position, bytes, final != 0);
+    }
+    ::write(fd, buffer, bytes);
+    return position + bytes;
+}
+
+extern "C" void output_writer_close(void * const writer) {
+    delete reinterpret_cast<OutputWriter *>(writer);
+}
+
 namespace kernel {
 
-void StdOutKernel::generateDoSegmentMethod(BuilderRef b) {
-    Value * codeUnitBuffer = b->getInputStreamBlockPtr("codeUnitBuffer", b->getInt32(0));
-    codeUnitBuffer = b->CreatePointerCast(codeUnitBuffer, b->getInt8PtrTy());
-    Value * length = b->getAccessibleItemCount("codeUnitBuffer");
+using BuilderRef = Kernel::BuilderRef;
 
-    if (LLVM_UNLIKELY(mCodeUnitWidth > 8)) {
-        Constant * const scale = b->getSize(mCodeUnitWidth / 8);
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief linkOutputWriterFunctions
+ ** ------------------------------------------------------------------------------------------------------------- */
+static void linkOutputWriterFunctions(BuilderRef b) {
+    b->LinkFunction("output_writer_open", output_writer_open);
+    b->LinkFunction("output_writer_write", output_writer_write);
+    b->LinkFunction("output_writer_close", output_writer_close);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief openOutputWriter
+ ** ------------------------------------------------------------------------------------------------------------- */
+static void openOutputWriter(BuilderRef b, Value * const fileDescriptor, const unsigned stride, const unsigned codeUnitWidth) {
+    Function * const openFn = b->getModule()->getFunction("output_writer_open"); assert (openFn);
+    // let the writer keep up to one stride of the buffer pending in a pipe
+    Constant * const maxPendingBytes = b->getSize((stride * codeUnitWidth) / 8);
+    b->setScalarField("outputWriter", b->CreateCall(openFn->getFunctionType(), openFn, {fileDescriptor, maxPendingBytes}));
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief writeSegment
+ *
+ * The code unit buffer is deferred: its processed item count is that of the first code unit the output writer has
+ * yet to release and every code unit from there on is accessible. The writer reports how much of the output it has
+ * released, which becomes the new processed item count.
+ ** ------------------------------------------------------------------------------------------------------------- */
+static void writeSegment(BuilderRef b, Value * const fileDescriptor, const unsigned codeUnitWidth) {
+    Value * const processed = b->getProcessedItemCount("codeUnitBuffer");
+    Value * const codeUnitBuffer = b->getRawInputPointer("codeUnitBuffer", processed);
+    Value * position = processed;
+    Value * length = b->getAccessibleItemCount("codeUnitBuffer");
+    if (LLVM_UNLIKELY(codeUnitWidth > 8)) {
+        Constant * const scale = b->getSize(codeUnitWidth / 8);
+        position = b->CreateMul(position, scale);
         length = b->CreateMul(length, scale);
-    } else if (LLVM_UNLIKELY(mCodeUnitWidth < 8)) {
-        Constant * const scale = b->getSize(8 / mCodeUnitWidth);
+    } else if (LLVM_UNLIKELY(codeUnitWidth < 8)) {
+        Constant * const scale = b->getSize(8 / codeUnitWidth);
+        position = b->CreateUDiv(position, scale);
         length = b->CreateUDiv(length, scale);
     }
-    Constant * const stdOutFd = b->getInt32(STDOUT_FILENO);
-    b->CreateWriteCall(stdOutFd, codeUnitBuffer, length);
+    Function * const writeFn = b->getModule()->getFunction("output_writer_write"); assert (writeFn);
+    Value * const writer = b->getScalarField("outputWriter");
+    Value * const isFinal = b->CreateZExt(b->isFinal(), b->getInt32Ty());
+    Value * released = b->CreateCall(writeFn->getFunctionType(), writeFn,
+        {writer, fileDescriptor, b->CreatePointerCast(codeUnitBuffer, b->getVoidPtrTy()), position, length, isFinal});
+    if (LLVM_UNLIKELY(codeUnitWidth > 8)) {
+        released = b->CreateUDiv(released, b->getSize(codeUnitWidth / 8));
+    } else if (LLVM_UNLIKELY(codeUnitWidth < 8)) {
+        released = b->CreateMul(released, b->getSize(8 / codeUnitWidth));
+    }
+    b->setProcessedItemCount("codeUnitBuffer", released);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief closeOutputWriter
+ ** ------------------------------------------------------------------------------------------------------------- */
+static void closeOutputWriter(BuilderRef b) {
+    Function * const closeFn = b->getModule()->getFunction("output_writer_close"); assert (closeFn);
+    b->CreateCall(closeFn->getFunctionType(), closeFn, b->getScalarField("outputWriter"));
+}
+
+void StdOutKernel::linkExternalMethods(BuilderRef b) {
+    linkOutputWriterFunctions(b);
+}
+
+void StdOutKernel::generateInitializeMethod(BuilderRef b) {
+    openOutputWriter(b, b->getInt32(STDOUT_FILENO), getStride(), mCodeUnitWidth);
+}
+
+void StdOutKernel::generateDoSegmentMethod(BuilderRef b) {
+    writeSegment(b, b->getInt32(STDOUT_FILENO), mCodeUnitWidth);
+}
+
+void StdOutKernel::generateFinalizeMethod(BuilderRef b) {
+    closeOutputWriter(b);
 }
 
 StdOutKernel::StdOutKernel(BuilderRef b, StreamSet *codeUnitBuffer)
 : SegmentOrientedKernel(b, "stdout" + std::to_string(codeUnitBuffer->getFieldWidth()),
 // input
-{Binding{"codeUnitBuffer", codeUnitBuffer}}
+{Binding{"codeUnitBuffer", codeUnitBuffer, FixedRate(), Deferred()}}
 // output & scalars
-, {}, {}, {}, {})
+, {}, {}, {}, {InternalScalar{b->getVoidPtrTy(), "outputWriter"}})
 , mCodeUnitWidth(codeUnitBuffer->getFieldWidth()) {
     setStride((8 * BUFSIZ) / mCodeUnitWidth);
     addAttribute(SideEffecting());
 }
 
+void FileSink::linkExternalMethods(BuilderRef b) {
+    linkOutputWriterFunctions(b);
+}
+
 void FileSink::generateInitializeMethod(BuilderRef b) {
     BasicBlock * const nonNullFileName = b->CreateBasicBlock("nonNullFileName");
     BasicBlock * const nonEmptyFileName = b->CreateBasicBlock("nonEmptyFileName");
@@ -96,24 +443,17 @@ void FileSink::generateInitializeMethod(BuilderRef b) {
 
     b->setScalarField("temporaryFileName", temporaryFileNamePhi);
     b->setScalarField("fileDescriptor", fileDescriptorPhi);
+    openOutputWriter(b, fileDescriptorPhi, getStride(), mCodeUnitWidth);
 }
 
 void FileSink::generateDoSegmentMethod(BuilderRef b) {
-    Value * codeUnitBuffer = b->getInputStreamBlockPtr("codeUnitBuffer", b->getInt32(0));
-    codeUnitBuffer = b->CreatePointerCast(codeUnitBuffer, b->getInt8PtrTy());
-    Value * bytesToDo = b->getAccessibleItemCount("codeUnitBuffer");
-    if (LLVM_UNLIKELY(mCodeUnitWidth > 8)) {
-        bytesToDo = b->CreateMul(bytesToDo, b->getSize(mCodeUnitWidth / 8));
-    } else if (LLVM_UNLIKELY(mCodeUnitWidth < 8)) {
-        bytesToDo = b->CreateUDiv(bytesToDo, b->getSize(8 / mCodeUnitWidth));
-    }
-    Value * const fileDescriptor = b->getScalarField("fileDescriptor");
-    b->CreateWriteCall(fileDescriptor, codeUnitBuffer, bytesToDo);
+    writeSegment(b, b->getScalarField("fileDescriptor"), mCodeUnitWidth);
 }
 
 void FileSink::generateFinalizeMethod(BuilderRef b) {
     BasicBlock * const hasTemporaryFile = b->CreateBasicBlock("hasTemporaryFile");
     BasicBlock * const exit = b->CreateBasicBlock("exit");
+    closeOutputWriter(b);
     Value * const fileDescriptor = b->getScalarField("fileDescriptor");
     Value * const temporaryFileName = b->getScalarField("temporaryFileName");
     b->CreateLikelyCondBr(b->CreateIsNotNull(temporaryFileName), hasTemporaryFile, exit);
@@ -131,7 +471,7 @@ void FileSink::generateFinalizeMethod(BuilderRef b) {
 FileSink::FileSink(BuilderRef b, Scalar * outputFileName, StreamSet * codeUnitBuffer)
 : SegmentOrientedKernel(b, "filesink" + std::to_string(codeUnitBuffer->getFieldWidth()),
 // input
-{Binding{"codeUnitBuffer", codeUnitBuffer}},
+{Binding{"codeUnitBuffer", codeUnitBuffer, FixedRate(), Deferred()}},
 // output
 {},
 // input scalars
@@ -140,7 +480,8 @@ FileSink::FileSink(BuilderRef b, Scalar * outputFileName, StreamSet * codeUnitBu
 {},
 // internal scalars
 {InternalScalar{b->getInt8PtrTy(), "temporaryFileName"},
- InternalScalar{b->getInt32Ty(), "fileDescriptor"}})
+ InternalScalar{b->getInt32Ty(), "fileDescriptor"},
+ InternalScalar{b->getVoidPtrTy(), "outputWriter"}})
 , mCodeUnitWidth(codeUnitBuffer->getFieldWidth()) {
     setStride((8 * BUFSIZ) / mCodeUnitWidth);
     addAttribute(SideEffecting());
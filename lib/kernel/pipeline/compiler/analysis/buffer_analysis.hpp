@@ -705,6 +705,12 @@ void PipelineAnalysis::determineBufferSize(BuilderRef b) {
         // streamset is consumed at a variable rate, it also requires an overflow but the
         // first block of the buffer must be
 
+        // A mirrored buffer maps its memory immediately before and after itself so any unconsumed data,
+        // including look behind and delayed items, is already contiguous. It cannot replace a thread local
+        // buffer (which is carved out of a single shared allocation) or one that is shared across threads.
+        const auto canMirror = (bn.Locality != BufferLocality::ThreadLocal) && !bn.isShared()
+                && !codegen::DebugOptionIsSet(codegen::DisableMirroredBuffers);
+
         if (bn.IsLinear) {
             bn.CopyBack = 0;
             bn.CopyForwards = 0;
@@ -725,7 +731,12 @@ void PipelineAnalysis::determineBufferSize(BuilderRef b) {
                 const auto cf = (cpl * StrideStepLength[kernel]) + consumerRate.LookAhead;
                 copyForwards = std::max(copyForwards, cf);
             }
-            if (copyForwards > blockWidth || copyBack > blockWidth) {
+            if (canMirror && (copyForwards || copyBack || underflow0)) {
+                bn.IsMirrored = true;
+                bn.CopyBack = 0;
+                bn.CopyForwards = 0;
+                bn.LookBehind = 0;
+            } else if (copyForwards > blockWidth || copyBack > blockWidth) {
                 bn.IsLinear = true;
                 bn.CopyBack = 0;
                 bn.CopyForwards = 0;
@@ -784,7 +795,11 @@ void PipelineAnalysis::addStreamSetsToBufferGraph(BuilderRef b) {
             // external consumers.  Similarly if any internal consumer has a deferred rate, we cannot
             // analyze any consumption rates.
 
-            if (bn.Locality == BufferLocality::GloballyShared) {
+            if (bn.IsMirrored) {
+                const auto bufferSize = bn.RequiredCapacity * mNumOfThreads;
+                assert (bufferSize > 0);
+                buffer = new MirroredBuffer(id++, b, output.getType(), bufferSize, bn.OverflowCapacity, bn.UnderflowCapacity, 0U);
+            } else if (bn.Locality == BufferLocality::GloballyShared) {
                 // TODO: we can make some buffers static despite crossing a partition but only if we can guarantee
                 // an upper bound to the buffer size for all potential inputs. Build a dataflow analysis to
                 // determine this.
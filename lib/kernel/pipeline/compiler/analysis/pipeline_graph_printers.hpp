@@ -251,6 +251,8 @@ void PipelineAnalysis::printBufferGraph(raw_ostream & out) const {
                     out << 'S'; break;
                 case BufferId::DynamicBuffer:
                     out << 'D'; break;
+                case BufferId::MirroredBuffer:
+                    out << 'M'; break;
                 case BufferId::ExternalBuffer:
                     out << 'E'; break;
                 default: llvm_unreachable("unknown streamset type");
@@ -288,6 +290,9 @@ void PipelineAnalysis::printBufferGraph(raw_ostream & out) const {
                 case BufferId::DynamicBuffer:
                     out << cast<DynamicBuffer>(buffer)->getInitialCapacity();
                     break;
+                case BufferId::MirroredBuffer:
+                    out << cast<MirroredBuffer>(buffer)->getInitialCapacity();
+                    break;
                 default: llvm_unreachable("unknown buffer type");
             }
         }
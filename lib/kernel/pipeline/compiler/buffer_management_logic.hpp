@@ -164,6 +164,18 @@ void PipelineCompiler::allocateOwnedBuffers(BuilderRef b, Value * const expected
 
             buffer->allocateBuffer(b, expectedNumOfStrides);
 
+            // every segment thread accesses the shared buffers so interleave their pages across the NUMA nodes
+            if (nonLocal && mNumOfThreads > 1) {
+                Function * const interleaveFn = b->getModule()->getFunction("__pipeline_interleave_memory");
+                Value * const mallocAddr = b->CreatePointerCast(buffer->getMallocAddress(b), b->getVoidPtrTy());
+                Value * const overflowAddr = b->CreatePointerCast(buffer->getOverflowAddress(b), b->getVoidPtrTy());
+                FixedArray<Value *, 3> interleaveArgs;
+                interleaveArgs[0] = mallocAddr;
+                interleaveArgs[1] = b->CreatePtrDiff(overflowAddr, mallocAddr);
+                interleaveArgs[2] = b->getInt32(mNumOfThreads);
+                b->CreateCall(interleaveFn->getFunctionType(), interleaveFn, interleaveArgs);
+            }
+
             #ifdef PRINT_DEBUG_MESSAGES
             const BufferPort & rd = mBufferGraph[e];
             const auto prefix = makeBufferName(i, rd.Port);
@@ -234,6 +246,49 @@ void PipelineCompiler::releaseOwnedBuffers(BuilderRef b, const bool nonLocal) {
     }
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief resetOwnedBuffers
+ *
+ * Rewind the owned buffers of a rearmed instance. A nested kernel constructed by this pipeline released its
+ * internal stream sets when it was finalized so those are allocated again; a family kernel kept its own and
+ * rewound them when it was rearmed. The buffers owned by this pipeline keep their memory (including any capacity
+ * gained by expansion in a prior run).
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::resetOwnedBuffers(BuilderRef b) {
+    Value * const expectedNumOfStrides = b->getScalarField(EXPECTED_NUM_OF_STRIDES_MULTIPLIER);
+    for (auto i = FirstKernel; i <= LastKernel; ++i) {
+        const Kernel * const kernelObj = getKernel(i);
+        if (LLVM_UNLIKELY(kernelObj->allocatesInternalStreamSets() && !(kernelObj->externallyInitialized() && kernelObj->isStateful()))) {
+            setActiveKernel(b, i, false);
+            assert (mKernel == kernelObj);
+            SmallVector<Value *, 2> params;
+            if (LLVM_LIKELY(mKernelSharedHandle)) {
+                params.push_back(mKernelSharedHandle);
+            }
+            Value * const func = getKernelAllocateSharedInternalStreamSetsFunction(b);
+            const auto scale = MaximumNumOfStrides[i] * Rational{mNumOfThreads};
+            params.push_back(b->CreateCeilUMulRational(expectedNumOfStrides, scale));
+            FunctionType * const funcType = cast<FunctionType>(func->getType()->getPointerElementType());
+            b->CreateCall(funcType, func, params);
+        }
+        for (const auto e : make_iterator_range(out_edges(i, mBufferGraph))) {
+            const auto streamSet = target(e, mBufferGraph);
+            const BufferNode & bn = mBufferGraph[streamSet];
+            if (bn.isUnowned() || bn.isShared() || !bn.isNonThreadLocal() || !bn.isInternal()) {
+                continue;
+            }
+            if (bn.Locality == BufferLocality::ThreadLocal) {
+                continue;
+            }
+            const BufferPort & rd = mBufferGraph[e];
+            StreamSetBuffer * const buffer = bn.Buffer;
+            buffer->setHandle(b->getScalarFieldPtr(makeBufferName(i, rd.Port)));
+            buffer->resetBuffer(b);
+        }
+    }
+    resetInternalBufferHandles();
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief resetInternalBufferHandles
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -521,9 +576,10 @@ void PipelineCompiler::writeLookBehindLogic(BuilderRef b) {
 void PipelineCompiler::writeDelayReflectionLogic(BuilderRef b) {
     for (const auto e : make_iterator_range(out_edges(mKernelId, mBufferGraph))) {
         const BufferPort & br = mBufferGraph[e];
-        if (br.Delay) {
-            const auto streamSet = target(e, mBufferGraph);
-            const BufferNode & bn = mBufferGraph[streamSet];
+        const auto streamSet = target(e, mBufferGraph);
+        const BufferNode & bn = mBufferGraph[streamSet];
+        // the memory preceding a mirrored buffer already reflects its end
+        if (br.Delay && !bn.IsMirrored) {
             const StreamSetBuffer * const buffer = bn.Buffer;
             Value * const capacity = buffer->getCapacity(b);
             Value * const produced = mAlreadyProducedPhi[br.Port];
@@ -694,7 +750,7 @@ void PipelineCompiler::copy(BuilderRef b, const CopyMode mode, Value * cond,
     if (copyLoop) {
 
         BasicBlock * recordCopyCycleCount = nullptr;
-        if (EnableCycleCounter || EnablePAPICounters) {
+        if (MeasureCycleCounts || EnablePAPICounters) {
             recordCopyCycleCount = b->CreateBasicBlock(prefix + "RecordCycleCount", copyExit);
         }
 
@@ -717,10 +773,10 @@ void PipelineCompiler::copy(BuilderRef b, const CopyMode mode, Value * cond,
         idx->addIncoming(nextIdx, copyLoop);
         Value * const done = b->CreateICmpEQ(nextIdx, numOfStreams);
 
-        BasicBlock * const loopExit = EnableCycleCounter ? recordCopyCycleCount : copyExit;
+        BasicBlock * const loopExit = MeasureCycleCounts ? recordCopyCycleCount : copyExit;
         b->CreateCondBr(done, loopExit, copyLoop);
 
-        if (EnableCycleCounter || EnablePAPICounters) {
+        if (MeasureCycleCounts || EnablePAPICounters) {
             b->SetInsertPoint(recordCopyCycleCount);
             updateCycleCounter(b, mKernelId, beforeCopy, CycleCounter::BUFFER_COPY);
             #ifdef ENABLE_PAPI
@@ -738,7 +794,7 @@ void PipelineCompiler::copy(BuilderRef b, const CopyMode mode, Value * cond,
         #endif
 
         b->CreateMemCpy(target, source, totalBytesPerStreamSetBlock, align);
-        if (EnableCycleCounter || EnablePAPICounters) {
+        if (MeasureCycleCounts || EnablePAPICounters) {
             updateCycleCounter(b, mKernelId, beforeCopy, CycleCounter::BUFFER_COPY);
             #ifdef ENABLE_PAPI
             accumPAPIMeasurementWithoutReset(b, PAPIReadBeforeMeasurementArray, mKernelId, PAPIKernelCounter::PAPI_BUFFER_COPY);
@@ -255,6 +255,7 @@ struct BufferNode {
     StreamSetBuffer * Buffer = nullptr;
     unsigned Type = 0;
     bool IsLinear = false;
+    bool IsMirrored = false;
 
     BufferLocality Locality = BufferLocality::ThreadLocal;
 
@@ -81,7 +81,7 @@ void PipelineCompiler::addCycleCounterProperties(BuilderRef b, const unsigned ke
  ** ------------------------------------------------------------------------------------------------------------- */
 Value * PipelineCompiler::startCycleCounter(BuilderRef b) {
     Value * counter = nullptr;
-    if (LLVM_UNLIKELY(EnableCycleCounter)) {
+    if (LLVM_UNLIKELY(MeasureCycleCounts)) {
         counter = b->CreateReadCycleCounter();
     }
     return counter;
@@ -90,16 +90,20 @@ Value * PipelineCompiler::startCycleCounter(BuilderRef b) {
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief updateOptionalCycleCounter
  ** ------------------------------------------------------------------------------------------------------------- */
-void PipelineCompiler::updateCycleCounter(BuilderRef b, const unsigned kernelId, Value * const start, const CycleCounter type) const {
-    if (LLVM_UNLIKELY(EnableCycleCounter)) {
+void PipelineCompiler::updateCycleCounter(BuilderRef b, const unsigned kernelId, Value * const start, const CycleCounter type,
+                                          Value * const processed, Value * const produced) const {
+    if (LLVM_UNLIKELY(MeasureCycleCounts)) {
         Value * const end = b->CreateReadCycleCounter();
-        Value * const duration = b->CreateSub(end, start);
-        const auto prefix = makeKernelName(kernelId);
-        const auto field = prefix + STATISTICS_CYCLE_COUNT_SUFFIX + std::to_string(type);
-        Value * const counterPtr = b->getScalarFieldPtr(field);
-        Value * const runningCount = b->CreateLoad(counterPtr);
-        Value * const updatedCount = b->CreateAdd(runningCount, duration); // , out.str()
-        b->CreateStore(updatedCount, counterPtr);
+        if (EnableCycleCounter) {
+            Value * const duration = b->CreateSub(end, start);
+            const auto prefix = makeKernelName(kernelId);
+            const auto field = prefix + STATISTICS_CYCLE_COUNT_SUFFIX + std::to_string(type);
+            Value * const counterPtr = b->getScalarFieldPtr(field);
+            Value * const runningCount = b->CreateLoad(counterPtr);
+            Value * const updatedCount = b->CreateAdd(runningCount, duration); // , out.str()
+            b->CreateStore(updatedCount, counterPtr);
+        }
+        recordKernelTimelineEvent(b, kernelId, type, start, end, processed, produced);
     }
 }
 
@@ -755,7 +759,7 @@ void PipelineCompiler::initializeBufferExpansionHistory(BuilderRef b) const {
                     // then the initial record
                     b->CreateStore(SZ_ZERO, b->CreateGEP(entryData, {ZERO, ZERO}));
                     b->CreateStore(buffer->getCapacity(b), b->CreateGEP(entryData, {ZERO, ONE}));
-                    const auto n = entryTy->getArrayNumElements(); assert (n > 3);
+                    const auto n = entryTy->getArrayNumElements(); assert (n > 5);
                     unsigned sizeTyWidth = b->getSizeTy()->getIntegerBitWidth() / 8;
                     Constant * const length = b->getSize(sizeTyWidth * (n - 2));
                     b->CreateMemZero(b->CreateGEP(entryData, {ZERO, TWO}), length, sizeTyWidth);
@@ -784,6 +788,8 @@ void PipelineCompiler::recordBufferExpansionHistory(BuilderRef b, const StreamSe
         Constant * const ONE = b->getInt32(1);
         Constant * const TWO = b->getInt32(2);
         Constant * const THREE = b->getInt32(3);
+        Constant * const FOUR = b->getInt32(4);
+        Constant * const FIVE = b->getInt32(5);
 
         Value * const traceLogArrayField = b->CreateGEP(traceData, {ZERO, ZERO});
         Value * entryArray = b->CreateLoad(traceLogArrayField);
@@ -802,17 +808,22 @@ void PipelineCompiler::recordBufferExpansionHistory(BuilderRef b, const StreamSe
         // produced item count 2
         Value * const produced = mAlreadyProducedPhi[outputPort];
         b->CreateStore(produced, b->CreateGEP(entryArray, {traceIndex, TWO}));
+        // bytes copied 3
+        const DynamicBuffer * const dynamicBuffer = cast<DynamicBuffer>(buffer);
+        b->CreateStore(dynamicBuffer->getExpansionCopiedBytes(b), b->CreateGEP(entryArray, {traceIndex, THREE}));
+        // bytes not copied due to in-place growth 4
+        b->CreateStore(dynamicBuffer->getExpansionSavedBytes(b), b->CreateGEP(entryArray, {traceIndex, FOUR}));
 
-        // consumer processed item count [3,n)
+        // consumer processed item count [5,n)
         Value * const consumerDataPtr = b->getScalarFieldPtr(prefix + CONSUMED_ITEM_COUNT_SUFFIX);
 
-        const auto n = entryTy->getArrayNumElements(); assert (n > 3);
-        assert ((n - 3) == (consumerDataPtr->getType()->getPointerElementType()->getArrayNumElements() - 1));
+        const auto n = entryTy->getArrayNumElements(); assert (n > 5);
+        assert ((n - 5) == (consumerDataPtr->getType()->getPointerElementType()->getArrayNumElements() - 1));
 
         Value * const processedPtr = b->CreateGEP(consumerDataPtr, { ZERO, ONE });
-        Value * const logPtr = b->CreateGEP(entryArray, {traceIndex, THREE});
+        Value * const logPtr = b->CreateGEP(entryArray, {traceIndex, FIVE});
         unsigned sizeTyWidth = b->getSizeTy()->getIntegerBitWidth() / 8;
-        Constant * const length = b->getSize(sizeTyWidth * (n - 3));
+        Constant * const length = b->getSize(sizeTyWidth * (n - 5));
         b->CreateMemCpy(logPtr, processedPtr, length, sizeTyWidth);
 
     }
@@ -860,7 +871,9 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
         format.indent(5 + maxBindingLength - 4); // I/O Type (e.g., input port 3 = I3), Port Name
         format << " BUFFER " // buffer ID #
                   "        SEG # "
-                  "     ITEM CAPACITY\n";
+                  "     ITEM CAPACITY"
+                  "      BYTES COPIED"
+                  "       BYTES SAVED\n";
 
         Constant * const STDERR = b->getInt32(STDERR_FILENO);
         FixedArray<Value *, 2> constantArgs;
@@ -868,7 +881,7 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
         constantArgs[1] = b->GetString(format.str());
         b->CreateCall(fTy, Dprintf, constantArgs);
 
-        const auto totalLength = 4 + maxKernelLength + 4 + maxBindingLength + 7 + 15 + 18 + 2;
+        const auto totalLength = 4 + maxKernelLength + 4 + maxBindingLength + 7 + 15 + 18 + 18 + 18 + 2;
 
         // generate a single-line (-) bar
         buffer.clear();
@@ -906,7 +919,9 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
                   "%-" << maxBindingLength << "s" // port name
                   "%7" PRIu32 // buffer ID #
                   "%14" PRIu64 " " // segment #
-                  "%18" PRIu64 "\n"; // item capacity
+                  "%18" PRIu64 // item capacity
+                  "%18" PRIu64 // bytes copied
+                  "%18" PRIu64 "\n"; // bytes not copied due to in-place growth
         Constant * const expansionFormat = b->GetString(format.str());
 
         // Generate the item count history format string
@@ -915,11 +930,11 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
                   "%-" << maxKernelLength << "s" // kernel name
                   "%c%-3" PRIu32 " " // I/O type
                   "%-" << maxBindingLength << "s" // port name
-                  "%40" PRIu64 "\n"; // produced/processed item count
+                  "%76" PRIu64 "\n"; // produced/processed item count
         Constant * const itemCountFormat = b->GetString(format.str());
 
         // Print each kernel line
-        FixedArray<Value *, 9> expansionArgs;
+        FixedArray<Value *, 11> expansionArgs;
         expansionArgs[0] = STDERR;
         expansionArgs[1] = expansionFormat;
 
@@ -930,6 +945,8 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
         Constant * const ZERO = b->getInt32(0);
         Constant * const ONE = b->getInt32(1);
         Constant * const TWO = b->getInt32(2);
+        Constant * const THREE = b->getInt32(3);
+        Constant * const FOUR = b->getInt32(4);
 
         Constant * const SZ_ZERO = b->getSize(0);
         Constant * const SZ_ONE = b->getSize(1);
@@ -942,7 +959,7 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
                 const BufferNode & bn = mBufferGraph[buffer];
                 if (isa<DynamicBuffer>(bn.Buffer)) {
 
-                    //  # KERNEL                      PORT                      BUFFER         SEG #      ITEM CAPACITY
+                    //  # KERNEL                      PORT                      BUFFER         SEG #      ITEM CAPACITY      BYTES COPIED       BYTES SAVED
 
                     expansionArgs[2] = b->getInt32(i);
                     expansionArgs[3] = b->GetString(getKernel(i)->getName());
@@ -988,6 +1005,8 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
                     Value * const newBufferSizeField = b->CreateGEP(entryArray, {index, ONE});
                     Value * const newBufferSize = b->CreateLoad(newBufferSizeField);
                     expansionArgs[8] = newBufferSize;
+                    expansionArgs[9] = b->CreateLoad(b->CreateGEP(entryArray, {index, THREE}));
+                    expansionArgs[10] = b->CreateLoad(b->CreateGEP(entryArray, {index, FOUR}));
 
                     b->CreateCall(fTy, Dprintf, expansionArgs);
 
@@ -1023,7 +1042,7 @@ void PipelineCompiler::printOptionalBufferExpansionHistory(BuilderRef b) {
                         itemCountArgs[5] = b->getInt32(c.Port);
                         const Binding & binding = getBinding(consumer, StreamSetPort{PortType::Input, c.Port});
                         itemCountArgs[6] = b->GetString(binding.getName());
-                        const auto k = c.Index + 2; assert (k > 2);
+                        const auto k = c.Index + 4; assert (k > 4);
                         Value * const processedField = b->CreateGEP(entryArray, {index, b->getInt32(k)});
                         itemCountArgs[7] = b->CreateLoad(processedField);
                         b->CreateCall(fTy, Dprintf, itemCountArgs);
@@ -32,6 +32,11 @@ void PipelineCompiler::addFamilyKernelProperties(BuilderRef b, const unsigned ke
             mTarget->addInternalScalar(voidPtrTy, prefix + FINALIZE_THREAD_LOCAL_FUNCTION_POINTER_SUFFIX, groupId);
         }
         mTarget->addInternalScalar(voidPtrTy, prefix + FINALIZE_FUNCTION_POINTER_SUFFIX, groupId);
+        if (kernel->hasReusableInstance()) {
+            mTarget->addInternalScalar(voidPtrTy, prefix + REARM_FUNCTION_POINTER_SUFFIX, groupId);
+            mTarget->addInternalScalar(voidPtrTy, prefix + FINALIZE_RUN_FUNCTION_POINTER_SUFFIX, groupId);
+            mTarget->addInternalScalar(voidPtrTy, prefix + RELEASE_FUNCTION_POINTER_SUFFIX, groupId);
+        }
     }
 }
 
@@ -98,6 +103,11 @@ void PipelineCompiler::bindFamilyInitializationArguments(BuilderRef b, ArgIterat
                         nextArg();
                     }
                     nextArg();
+                    if (kernel->hasReusableInstance()) {
+                        nextArg();
+                        nextArg();
+                        nextArg();
+                    }
                 }
 
             } else {
@@ -134,6 +144,11 @@ void PipelineCompiler::bindFamilyInitializationArguments(BuilderRef b, ArgIterat
                         readNextScalar(prefix + FINALIZE_THREAD_LOCAL_FUNCTION_POINTER_SUFFIX);
                     }
                     readNextScalar(prefix + FINALIZE_FUNCTION_POINTER_SUFFIX);
+                    if (kernel->hasReusableInstance()) {
+                        readNextScalar(prefix + REARM_FUNCTION_POINTER_SUFFIX);
+                        readNextScalar(prefix + FINALIZE_RUN_FUNCTION_POINTER_SUFFIX);
+                        readNextScalar(prefix + RELEASE_FUNCTION_POINTER_SUFFIX);
+                    }
                 }
             }
 
@@ -198,6 +213,9 @@ Value * PipelineCompiler::getKernelDoSegmentFunction(BuilderRef b) const {
     if (mKernel->hasFamilyName()) {
         return getFamilyFunctionFromKernelState(b, doSegment->getType(), DO_SEGMENT_FUNCTION_POINTER_SUFFIX);
     }
+    if (LLVM_UNLIKELY(isTieredKernel(mKernelId))) {
+        return getTieredKernelDoSegmentFunction(b, doSegment->getType());
+    }
     return doSegment;
 }
 
@@ -225,6 +243,42 @@ Value * PipelineCompiler::callKernelFinalizeFunction(BuilderRef b, const SmallVe
     return b->CreateCall(term->getFunctionType(), func, args);
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief callKernelRearmFunction
+ ** ------------------------------------------------------------------------------------------------------------- */
+Value * PipelineCompiler::callKernelRearmFunction(BuilderRef b, const ArgVec & args) const {
+    Function * const rearm = mKernel->getRearmFunction(b);
+    Value * func = rearm;
+    if (mKernel->hasFamilyName()) {
+        func = getFamilyFunctionFromKernelState(b, rearm->getType(), REARM_FUNCTION_POINTER_SUFFIX);
+    }
+    return b->CreateCall(rearm->getFunctionType(), func, args);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief callKernelFinalizeRunFunction
+ ** ------------------------------------------------------------------------------------------------------------- */
+Value * PipelineCompiler::callKernelFinalizeRunFunction(BuilderRef b, const SmallVector<Value *, 1> & args) const {
+    Function * const term = mKernel->getFinalizeRunFunction(b);
+    Value * func = term;
+    if (mKernel->hasFamilyName()) {
+        func = getFamilyFunctionFromKernelState(b, term->getType(), FINALIZE_RUN_FUNCTION_POINTER_SUFFIX);
+    }
+    return b->CreateCall(term->getFunctionType(), func, args);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief callKernelReleaseFunction
+ ** ------------------------------------------------------------------------------------------------------------- */
+Value * PipelineCompiler::callKernelReleaseFunction(BuilderRef b, const SmallVector<Value *, 1> & args) const {
+    Function * const release = mKernel->getReleaseFunction(b);
+    Value * func = release;
+    if (mKernel->hasFamilyName()) {
+        func = getFamilyFunctionFromKernelState(b, release->getType(), RELEASE_FUNCTION_POINTER_SUFFIX);
+    }
+    return b->CreateCall(release->getFunctionType(), func, args);
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief getFamilyFunctionFromKernelState
  ** ------------------------------------------------------------------------------------------------------------- */
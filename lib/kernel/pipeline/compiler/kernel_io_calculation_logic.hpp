@@ -473,6 +473,8 @@ void PipelineCompiler::checkForSufficientInputData(BuilderRef b, const BufferPor
     debugPrint(b, prefix + "_hasInputData = %" PRIu8, test);
     #endif
 
+    recordKernelTimelineBlockedPort(b, inputPort, sufficientInput);
+
 
     if (mExhaustedPipelineInputPhi && !TraceIO) {
         Value * exhausted = mExhaustedInput;
@@ -808,7 +810,7 @@ void PipelineCompiler::ensureSufficientOutputSpace(BuilderRef b, const BufferPor
     readPAPIMeasurement(b, mKernelId, PAPIReadBeforeMeasurementArray);
     #endif
     Value * cycleCounterStart = nullptr;
-    if (LLVM_UNLIKELY(EnableCycleCounter)) {
+    if (LLVM_UNLIKELY(MeasureCycleCounts)) {
         cycleCounterStart = b->CreateReadCycleCounter();
     }
 
@@ -180,6 +180,7 @@ inline void PipelineCompiler::executeKernel(BuilderRef b) {
     /// -------------------------------------------------------------------------------------
 
     verifyCurrentSynchronizationLock(b);
+    clearKernelTimelineBlockedPort(b);
     checkIfKernelIsAlreadyTerminated(b);
     readProcessedItemCounts(b);
     readProducedItemCounts(b);
@@ -362,7 +363,10 @@ inline void PipelineCompiler::executeKernel(BuilderRef b) {
         mFinalPartitionSegment = mFinalPartitionSegmentAtExitPhi;
     }
 
-    updateCycleCounter(b, mKernelId, mKernelStartTime, CycleCounter::TOTAL_TIME);
+    Value * processed = nullptr;
+    Value * produced = nullptr;
+    getKernelTimelineItemCounts(b, processed, produced);
+    updateCycleCounter(b, mKernelId, mKernelStartTime, CycleCounter::TOTAL_TIME, processed, produced);
     #ifdef ENABLE_PAPI
     accumPAPIMeasurementWithoutReset(b, PAPIReadInitialMeasurementArray, mKernelId, PAPIKernelCounter::PAPI_KERNEL_TOTAL);
     #endif
@@ -0,0 +1,373 @@
+#ifndef KERNEL_TIMELINE_LOGIC_HPP
+#define KERNEL_TIMELINE_LOGIC_HPP
+
+#include "pipeline_compiler.hpp"
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// The cycle counters only report the total time each kernel spent in each activity. With the
+// -kernel-timeline option, each thread instead records an event for every interval the cycle
+// counters measure: the kernel and segment number, the start and end cycle counts and, for the
+// interval spanning a kernel's entire segment, the number of items it processed and produced and
+// the last input port (if any) that did not have enough data. The events are kept in a ring
+// buffer per thread, so recording needs no synchronization, and when the last pipeline closes its
+// timeline, they are written as a Chrome trace (which chrome://tracing and Perfetto can display)
+// with one process per pipeline and one thread per pipeline thread.
+
+namespace kernel {
+
+namespace {
+
+const size_t KernelTimelineEventsPerThread = 1 << 16;
+
+const char * const KernelTimelineEventName[NUM_OF_CYCLE_COUNTERS] = {
+    "synchronization", "partition jump", "buffer expansion", "buffer copy", "execution", "segment"
+};
+
+struct KernelTimelineEvent {
+    uint64_t Start;
+    uint64_t End;
+    uint64_t SegNo;
+    uint64_t Processed;
+    uint64_t Produced;
+    uint32_t Pipeline;
+    uint32_t Kernel;
+    uint32_t Kind;
+    int32_t  BlockedPort;
+};
+
+struct KernelTimelineThreadLog {
+    KernelTimelineThreadLog(const unsigned id)
+    : Id(id)
+    , Count(0)
+    , Events(new KernelTimelineEvent[KernelTimelineEventsPerThread]) {
+
+    }
+    const unsigned Id;
+    uint64_t Count;
+    std::unique_ptr<KernelTimelineEvent[]> Events;
+};
+
+struct KernelTimelinePipeline {
+    std::string Name;
+    std::vector<std::string> KernelNames;
+    bool IsOpen;
+};
+
+struct KernelTimeline {
+    std::mutex Lock;
+    unsigned OpenCount = 0;
+    // Incremented whenever the timeline is written; a thread log from an earlier generation is stale.
+    std::atomic<unsigned> Generation{1};
+    uint64_t StartCycles = 0;
+    std::chrono::steady_clock::time_point StartTime;
+    std::vector<KernelTimelinePipeline> Pipelines;
+    std::vector<std::unique_ptr<KernelTimelineThreadLog>> Threads;
+};
+
+KernelTimeline & getKernelTimeline() {
+    static KernelTimeline timeline;
+    return timeline;
+}
+
+thread_local KernelTimelineThreadLog * CurrentKernelTimelineLog = nullptr;
+thread_local unsigned CurrentKernelTimelineGeneration = 0;
+
+inline uint64_t readKernelTimelineCycleCounter() {
+    #if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+    #else
+    return 0;
+    #endif
+}
+
+void writeKernelTimelineString(raw_ostream & out, const StringRef str) {
+    out << '"';
+    for (const char c : str) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << format("\\u%04x", static_cast<unsigned>(c));
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+void writeKernelTimeline(KernelTimeline & T) {
+    const auto & fileName = codegen::KernelTimelineOption.empty() ? std::string("kernel-timeline.json") : codegen::KernelTimelineOption;
+    std::error_code EC;
+    raw_fd_ostream out(fileName, EC, sys::fs::F_None);
+    if (LLVM_UNLIKELY(EC)) {
+        errs() << "Cannot write the kernel timeline to " << fileName << ": " << EC.message() << "\n";
+        return;
+    }
+    // Convert cycle counts to microseconds with the rate at which the cycle counter advanced
+    // while the timeline was open. Without a usable counter, the trace is in cycles instead.
+    const auto elapsedCycles = readKernelTimelineCycleCounter() - T.StartCycles;
+    const std::chrono::duration<double, std::micro> elapsedTime = std::chrono::steady_clock::now() - T.StartTime;
+    double cyclesPerMicrosecond = 1.0;
+    if (elapsedCycles > 0 && elapsedTime.count() > 0) {
+        cyclesPerMicrosecond = static_cast<double>(elapsedCycles) / elapsedTime.count();
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    auto beginEvent = [&]() {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+    };
+    for (unsigned i = 0; i < T.Pipelines.size(); ++i) {
+        beginEvent();
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << i << ",\"args\":{\"name\":";
+        writeKernelTimelineString(out, T.Pipelines[i].Name);
+        out << "}}";
+        for (const auto & log : T.Threads) {
+            beginEvent();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << i << ",\"tid\":" << log->Id
+                << ",\"args\":{\"name\":\"thread " << log->Id << "\"}}";
+        }
+    }
+    for (const auto & log : T.Threads) {
+        const auto n = std::min<uint64_t>(log->Count, KernelTimelineEventsPerThread);
+        if (LLVM_UNLIKELY(n < log->Count)) {
+            errs() << "Kernel timeline: thread " << log->Id << " dropped its " << (log->Count - n) << " earliest events\n";
+        }
+        for (uint64_t k = log->Count - n; k < log->Count; ++k) {
+            const KernelTimelineEvent & e = log->Events[k % KernelTimelineEventsPerThread];
+            const KernelTimelinePipeline & P = T.Pipelines[e.Pipeline];
+            const StringRef kernelName = P.KernelNames[e.Kernel];
+            const auto start = static_cast<double>(e.Start - T.StartCycles) / cyclesPerMicrosecond;
+            const auto duration = static_cast<double>(e.End - e.Start) / cyclesPerMicrosecond;
+            beginEvent();
+            out << "{\"name\":";
+            writeKernelTimelineString(out, (e.Kind == TOTAL_TIME) ? kernelName : StringRef(KernelTimelineEventName[e.Kind]));
+            out << ",\"cat\":\"" << KernelTimelineEventName[e.Kind] << "\",\"ph\":\"X\""
+                << ",\"pid\":" << e.Pipeline << ",\"tid\":" << log->Id
+                << ",\"ts\":" << format("%.3f", start) << ",\"dur\":" << format("%.3f", duration)
+                << ",\"args\":{\"kernel\":";
+            writeKernelTimelineString(out, kernelName);
+            out << ",\"segment\":" << e.SegNo;
+            if (e.Kind == TOTAL_TIME) {
+                out << ",\"processed\":" << e.Processed << ",\"produced\":" << e.Produced;
+                if (e.BlockedPort >= 0) {
+                    out << ",\"blocked on input\":" << e.BlockedPort;
+                }
+            }
+            out << "}}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_timeline_open
+ ** ------------------------------------------------------------------------------------------------------------- */
+uint32_t __pipeline_timeline_open(const char * const name, const uint32_t numOfKernels) {
+    auto & T = getKernelTimeline();
+    std::lock_guard<std::mutex> lock(T.Lock);
+    if (T.Pipelines.empty()) {
+        T.StartCycles = readKernelTimelineCycleCounter();
+        T.StartTime = std::chrono::steady_clock::now();
+    }
+    ++T.OpenCount;
+    // A nested pipeline is reopened for every run of a reusable instance; keep it on one timeline row.
+    for (unsigned i = 0; i < T.Pipelines.size(); ++i) {
+        KernelTimelinePipeline & P = T.Pipelines[i];
+        if (!P.IsOpen && P.Name == name && P.KernelNames.size() == numOfKernels) {
+            P.IsOpen = true;
+            return i;
+        }
+    }
+    T.Pipelines.emplace_back(KernelTimelinePipeline{name, std::vector<std::string>(numOfKernels), true});
+    return T.Pipelines.size() - 1;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_timeline_name_kernel
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_timeline_name_kernel(const uint32_t pipeline, const uint32_t kernel, const char * const name) {
+    auto & T = getKernelTimeline();
+    std::lock_guard<std::mutex> lock(T.Lock);
+    T.Pipelines[pipeline].KernelNames[kernel] = name;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_timeline_record
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_timeline_record(const uint32_t pipeline, const uint32_t kernel, const uint32_t kind, const uint64_t segNo,
+                                const uint64_t start, const uint64_t end, const uint64_t processed, const uint64_t produced,
+                                const int32_t blockedPort) {
+    auto & T = getKernelTimeline();
+    auto log = CurrentKernelTimelineLog;
+    const auto generation = T.Generation.load(std::memory_order_relaxed);
+    if (LLVM_UNLIKELY(log == nullptr || CurrentKernelTimelineGeneration != generation)) {
+        std::lock_guard<std::mutex> lock(T.Lock);
+        T.Threads.emplace_back(new KernelTimelineThreadLog(T.Threads.size()));
+        log = T.Threads.back().get();
+        CurrentKernelTimelineLog = log;
+        CurrentKernelTimelineGeneration = generation;
+    }
+    log->Events[log->Count++ % KernelTimelineEventsPerThread] =
+        KernelTimelineEvent{start, end, segNo, processed, produced, pipeline, kernel, kind, blockedPort};
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_timeline_close
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_timeline_close(const uint32_t pipeline) {
+    auto & T = getKernelTimeline();
+    std::lock_guard<std::mutex> lock(T.Lock);
+    T.Pipelines[pipeline].IsOpen = false;
+    if (--T.OpenCount == 0) {
+        writeKernelTimeline(T);
+        T.Pipelines.clear();
+        T.Threads.clear();
+        T.Generation.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief linkKernelTimelineLibrary
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::linkKernelTimelineLibrary(BuilderRef b) {
+    b->LinkFunction("__pipeline_timeline_open", __pipeline_timeline_open);
+    b->LinkFunction("__pipeline_timeline_name_kernel", __pipeline_timeline_name_kernel);
+    b->LinkFunction("__pipeline_timeline_record", __pipeline_timeline_record);
+    b->LinkFunction("__pipeline_timeline_close", __pipeline_timeline_close);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addKernelTimelineProperties
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::addKernelTimelineProperties(BuilderRef b) {
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        IntegerType * const int32Ty = b->getInt32Ty();
+        mTarget->addInternalScalar(int32Ty, KERNEL_TIMELINE_ID, 0);
+        mTarget->addThreadLocalScalar(int32Ty, KERNEL_TIMELINE_BLOCKED_PORT);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief openKernelTimeline
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::openKernelTimeline(BuilderRef b) {
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        Module * const m = b->getModule();
+        Function * const openFn = m->getFunction("__pipeline_timeline_open"); assert (openFn);
+        FixedArray<Value *, 2> openArgs;
+        openArgs[0] = b->GetString(mTarget->getName());
+        openArgs[1] = b->getInt32(LastKernel + 1);
+        Value * const id = b->CreateCall(openFn, openArgs);
+        b->setScalarField(KERNEL_TIMELINE_ID, id);
+        Function * const nameFn = m->getFunction("__pipeline_timeline_name_kernel"); assert (nameFn);
+        FixedArray<Value *, 3> nameArgs;
+        nameArgs[0] = id;
+        for (auto i = FirstKernel; i <= LastKernel; ++i) {
+            nameArgs[1] = b->getInt32(i);
+            nameArgs[2] = b->GetString(getKernel(i)->getName());
+            b->CreateCall(nameFn, nameArgs);
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief closeKernelTimeline
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::closeKernelTimeline(BuilderRef b) {
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        Function * const closeFn = b->getModule()->getFunction("__pipeline_timeline_close"); assert (closeFn);
+        b->CreateCall(closeFn, b->getScalarField(KERNEL_TIMELINE_ID));
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief recordKernelTimelineEvent
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::recordKernelTimelineEvent(BuilderRef b, const unsigned kernelId, const CycleCounter type,
+                                                 Value * const start, Value * const end,
+                                                 Value * const processed, Value * const produced) const {
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        Function * const recordFn = b->getModule()->getFunction("__pipeline_timeline_record"); assert (recordFn);
+        IntegerType * const int64Ty = b->getInt64Ty();
+        Constant * const ZERO = b->getInt64(0);
+        FixedArray<Value *, 9> args;
+        args[0] = b->getScalarField(KERNEL_TIMELINE_ID);
+        args[1] = b->getInt32(kernelId);
+        args[2] = b->getInt32(type);
+        args[3] = b->CreateZExtOrTrunc(mSegNo, int64Ty);
+        args[4] = start;
+        args[5] = end;
+        args[6] = processed ? b->CreateZExtOrTrunc(processed, int64Ty) : ZERO;
+        args[7] = produced ? b->CreateZExtOrTrunc(produced, int64Ty) : ZERO;
+        if (type == CycleCounter::TOTAL_TIME && kernelId == mKernelId) {
+            args[8] = b->getScalarField(KERNEL_TIMELINE_BLOCKED_PORT);
+        } else {
+            args[8] = b->getInt32(-1);
+        }
+        b->CreateCall(recordFn, args);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief clearKernelTimelineBlockedPort
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::clearKernelTimelineBlockedPort(BuilderRef b) const {
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        b->setScalarField(KERNEL_TIMELINE_BLOCKED_PORT, b->getInt32(-1));
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief recordKernelTimelineBlockedPort
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::recordKernelTimelineBlockedPort(BuilderRef b, const StreamSetPort port, Value * const sufficient) const {
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        Value * const ptr = b->getScalarFieldPtr(KERNEL_TIMELINE_BLOCKED_PORT);
+        Value * const blockedPort = b->CreateSelect(sufficient, b->CreateLoad(ptr), b->getInt32(port.Number));
+        b->CreateStore(blockedPort, ptr);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getKernelTimelineItemCounts
+ *
+ * Determine the number of items the current kernel processed from its principal input and produced on its first
+ * output during this segment. Must be called at the kernel exit.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::getKernelTimelineItemCounts(BuilderRef b, Value *& processed, Value *& produced) const {
+    processed = nullptr;
+    produced = nullptr;
+    if (LLVM_UNLIKELY(EnableKernelTimeline)) {
+        if (in_degree(mKernelId, mBufferGraph) > 0) {
+            const auto port = selectPrincipleCycleCountBinding(mKernelId);
+            Value * const current = b->CreateLoad(mProcessedItemCountPtr[port]);
+            processed = b->CreateSub(current, mInitiallyProcessedItemCount[port]);
+        }
+        if (out_degree(mKernelId, mBufferGraph) > 0) {
+            const StreamSetPort port(PortType::Output, 0);
+            const auto streamSet = getOutputBufferVertex(port);
+            produced = b->CreateSub(mFullyProducedItemCount[port], mInitiallyProducedItemCount[streamSet]);
+        }
+    }
+}
+
+}
+
+#endif // KERNEL_TIMELINE_LOGIC_HPP
@@ -28,7 +28,7 @@ inline void PipelineCompiler::makePartitionEntryPoints(BuilderRef b) {
         const auto prefix = std::to_string(i);
         mPartitionPipelineProgressPhi[i] = b->CreatePHI(boolTy, PartitionCount, prefix + ".pipelineProgress");
         mExhaustedPipelineInputAtPartitionEntry[i] = b->CreatePHI(boolTy, PartitionCount, prefix + ".exhaustedInput");
-        if (LLVM_UNLIKELY(EnableCycleCounter)) {
+        if (LLVM_UNLIKELY(MeasureCycleCounts)) {
             mPartitionStartTimePhi[i] = b->CreatePHI(sizeTy, PartitionCount, prefix + ".startTimeCycleCounter");
         }
     }
@@ -410,7 +410,7 @@ void PipelineCompiler::writeInitiallyTerminatedPartitionExit(BuilderRef b) {
             Value * const startTime = acquireAndReleaseAllSynchronizationLocksUntil(b, nextPartitionId);
             mKernelInitiallyTerminatedExit = b->GetInsertBlock();
 
-            if (LLVM_UNLIKELY(EnableCycleCounter)) {
+            if (LLVM_UNLIKELY(MeasureCycleCounts)) {
                 mPartitionStartTimePhi[nextPartitionId]->addIncoming(startTime, mKernelInitiallyTerminatedExit);
             }
 
@@ -466,7 +466,7 @@ void PipelineCompiler::writeJumpToNextPartition(BuilderRef b) {
 
     Value * const startTime = acquireAndReleaseAllSynchronizationLocksUntil(b, nextPartitionId);
     BasicBlock * const exitBlock = b->GetInsertBlock();
-    if (LLVM_UNLIKELY(EnableCycleCounter)) {
+    if (LLVM_UNLIKELY(MeasureCycleCounts)) {
         mPartitionStartTimePhi[nextPartitionId]->addIncoming(startTime, exitBlock);
     }
 
@@ -541,7 +541,7 @@ inline void PipelineCompiler::checkForPartitionExit(BuilderRef b) {
         mPipelineProgress = progressPhi;
         // Since there may be multiple paths into this kernel, phi out the start time
         // for each path.
-        if (LLVM_UNLIKELY(EnableCycleCounter)) {
+        if (LLVM_UNLIKELY(MeasureCycleCounts)) {
             mPartitionStartTimePhi[nextPartitionId]->addIncoming(mKernelStartTime, exitBlock);
             mKernelStartTime = mPartitionStartTimePhi[nextPartitionId];
         }
@@ -65,6 +65,7 @@ const static std::string KERNEL_THREAD_LOCAL_SUFFIX = ".KTL";
 const static std::string NEXT_LOGICAL_SEGMENT_NUMBER = "@NLSN";
 #endif
 const static std::string LOGICAL_SEGMENT_SUFFIX = ".LSN";
+const static std::string LOGICAL_SEGMENT_WAITERS_SUFFIX = ".LSW";
 
 const static std::string DEBUG_FD = ".DFd";
 
@@ -93,6 +94,11 @@ const static std::string STATISTICS_UNCONSUMED_ITEM_COUNT_SUFFIX = ".SUIC";
 
 const static std::string LAST_GOOD_VIRTUAL_BASE_ADDRESS = ".LGA";
 
+const static std::string KERNEL_TIMELINE_ID = "@KTI";
+const static std::string KERNEL_TIMELINE_BLOCKED_PORT = "tKTB";
+
+const static std::string TIERED_KERNEL_SLOT_SUFFIX = ".TKS";
+
 using ArgVec = Vec<Value *, 64>;
 
 using BufferPortMap = flat_set<std::pair<unsigned, unsigned>>;
@@ -119,13 +125,19 @@ public:
     void generateAllocateSharedInternalStreamSetsMethod(BuilderRef b, Value * const expectedNumOfStrides);
     void generateInitializeThreadLocalMethod(BuilderRef b);
     void generateAllocateThreadLocalInternalStreamSetsMethod(BuilderRef b, Value * expectedNumOfStrides);
+    Value * getThreadLocalStreamSetMemorySize(BuilderRef b, Value * const expectedNumOfStrides) const;
     void generateKernelMethod(BuilderRef b);
     void generateFinalizeMethod(BuilderRef b);
     void generateFinalizeThreadLocalMethod(BuilderRef b);
+    void generateRearmMethod(BuilderRef b);
+    void generateFinalizeRunMethod(BuilderRef b);
+    void generateReleaseMethod(BuilderRef b);
     std::vector<Value *> getFinalOutputScalars(BuilderRef b) override;
     void runOptimizationPasses(BuilderRef b);
 
     static void linkPThreadLibrary(BuilderRef b);
+    static void linkBlockingSynchronizationLibrary(BuilderRef b);
+    static void linkKernelTimelineLibrary(BuilderRef b);
     #ifdef ENABLE_PAPI
     static void linkPAPILibrary(BuilderRef b);
     #endif
@@ -149,6 +161,11 @@ public:
 
     void addPipelinePriorItemCountProperties(BuilderRef b);
     void addInternalKernelProperties(BuilderRef b, const unsigned kernelId);
+    void initializeInternalKernels(BuilderRef b);
+    void clearRunState(BuilderRef b);
+    void rearmExternallyInitializedKernels(BuilderRef b);
+    void finalizeInternalKernels(BuilderRef b, const bool retainExternallyInitialized = false);
+    void releaseExternallyInitializedKernels(BuilderRef b);
     void generateSingleThreadKernelMethod(BuilderRef b);
     void generateMultiThreadKernelMethod(BuilderRef b);
 
@@ -339,6 +356,7 @@ public:
     void loadExternalStreamSetHandles(BuilderRef b);
     void loadInternalStreamSetHandles(BuilderRef b, const bool nonLocal);
     void releaseOwnedBuffers(BuilderRef b, const bool nonLocal);
+    void resetOwnedBuffers(BuilderRef b);
     void resetInternalBufferHandles();
     void loadLastGoodVirtualBaseAddressesOfUnownedBuffers(BuilderRef b, const size_t kernelId) const;
 
@@ -351,7 +369,8 @@ public:
 
     void addCycleCounterProperties(BuilderRef b, const unsigned kernel, const bool isRoot);
     Value * startCycleCounter(BuilderRef b);
-    void updateCycleCounter(BuilderRef b, const unsigned kernelId, Value * const start, const CycleCounter type) const;
+    void updateCycleCounter(BuilderRef b, const unsigned kernelId, Value * const start, const CycleCounter type,
+                            Value * const processed = nullptr, Value * const produced = nullptr) const;
 
 
     void incrementNumberOfSegmentsCounter(BuilderRef b) const;
@@ -359,6 +378,17 @@ public:
 
     void printOptionalCycleCounter(BuilderRef b);
     StreamSetPort selectPrincipleCycleCountBinding(const unsigned kernel) const;
+
+// kernel timeline functions
+
+    void addKernelTimelineProperties(BuilderRef b);
+    void openKernelTimeline(BuilderRef b);
+    void closeKernelTimeline(BuilderRef b);
+    void recordKernelTimelineEvent(BuilderRef b, const unsigned kernelId, const CycleCounter type, Value * const start, Value * const end,
+                                   Value * const processed, Value * const produced) const;
+    void clearKernelTimelineBlockedPort(BuilderRef b) const;
+    void recordKernelTimelineBlockedPort(BuilderRef b, const StreamSetPort port, Value * const sufficient) const;
+    void getKernelTimelineItemCounts(BuilderRef b, Value *& processed, Value *& produced) const;
     void printOptionalBlockingIOStatistics(BuilderRef b);
 
 
@@ -415,6 +445,13 @@ public:
 
     void bindFamilyInitializationArguments(BuilderRef b, ArgIterator & arg, const ArgIterator & arg_end) const override;
 
+// tiered compilation functions
+
+    bool isTieredKernel(const unsigned kernelId) const;
+    void addTieredCompilationProperties(BuilderRef b, const unsigned kernelId) const;
+    void initializeTieredKernelSlots(BuilderRef b) const;
+    Value * getTieredKernelDoSegmentFunction(BuilderRef b, Type * const type) const;
+
 // thread local functions
 
     Value * getThreadLocalHandlePtr(BuilderRef b, const unsigned kernelIndex) const;
@@ -458,6 +495,9 @@ public:
     Value * getKernelDoSegmentFunction(BuilderRef b) const;
     Value * callKernelFinalizeThreadLocalFunction(BuilderRef b, const SmallVector<Value *, 2> & args) const;
     Value * callKernelFinalizeFunction(BuilderRef b, const SmallVector<Value *, 1> & args) const;
+    Value * callKernelRearmFunction(BuilderRef b, const ArgVec & args) const;
+    Value * callKernelFinalizeRunFunction(BuilderRef b, const SmallVector<Value *, 1> & args) const;
+    Value * callKernelReleaseFunction(BuilderRef b, const SmallVector<Value *, 1> & args) const;
 
     LLVM_READNONE std::string makeKernelName(const size_t kernelIndex) const;
     LLVM_READNONE std::string makeBufferName(const size_t kernelIndex, const StreamSetPort port) const;
@@ -523,9 +563,13 @@ protected:
     const size_t                                RequiredThreadLocalStreamSetMemory;
 
     const bool                                  ExternallySynchronized;
+    const bool                                  BlockingSynchronization;
     const bool                                  PipelineHasTerminationSignal;
     const bool                                  HasZeroExtendedStream;
     const bool                                  EnableCycleCounter;
+    const bool                                  EnableKernelTimeline;
+    const bool                                  MeasureCycleCounts;
+    const bool                                  EnableTieredCompilation;
     #ifdef ENABLE_PAPI
     const bool                                  EnablePAPICounters;
     #else
@@ -780,9 +824,13 @@ PipelineCompiler::PipelineCompiler(PipelineKernel * const pipelineKernel, Pipeli
 , RequiredThreadLocalStreamSetMemory(P.RequiredThreadLocalStreamSetMemory)
 
 , ExternallySynchronized(pipelineKernel->hasAttribute(AttrId::InternallySynchronized))
+, BlockingSynchronization(pipelineKernel->hasAttribute(AttrId::BlockingSynchronization))
 , PipelineHasTerminationSignal(pipelineKernel->canSetTerminateSignal())
 , HasZeroExtendedStream(P.HasZeroExtendedStream)
 , EnableCycleCounter(DebugOptionIsSet(codegen::EnableCycleCounter))
+, EnableKernelTimeline(codegen::KernelTimelineOption != codegen::OmittedOption)
+, MeasureCycleCounts(EnableCycleCounter || EnableKernelTimeline)
+, EnableTieredCompilation(codegen::TieredCompilation)
 #ifdef ENABLE_PAPI
 , EnablePAPICounters(codegen::PapiCounterOptions.compare(codegen::OmittedOption) != 0)
 #endif
@@ -925,6 +973,8 @@ LLVM_READNONE inline unsigned getItemWidth(const Type * ty ) {
 #include "partition_processing_logic.hpp"
 #include "kernel_segment_processing_logic.hpp"
 #include "cycle_counter_logic.hpp"
+#include "kernel_timeline_logic.hpp"
+#include "tiered_compilation_logic.hpp"
 #include "pipeline_logic.hpp"
 #include "scalar_logic.hpp"
 #include "synchronization_logic.hpp"
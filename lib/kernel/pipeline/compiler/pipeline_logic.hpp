@@ -6,6 +6,16 @@
 
 #if BOOST_OS_LINUX
 #include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <toolchain/toolchain.h>
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <fstream>
+#include <thread>
 #endif
 
 #if BOOST_OS_MACOS
@@ -127,7 +137,7 @@ inline void PipelineCompiler::addPipelineKernelProperties(BuilderRef b) {
     #ifdef ENABLE_PAPI
     addPAPIEventCounterPipelineProperties(b);
     #endif
-
+    addKernelTimelineProperties(b);
 }
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -178,6 +188,9 @@ void PipelineCompiler::addInternalKernelProperties(BuilderRef b, const unsigned
 
     const auto name = makeKernelName(kernelId);
     mTarget->addInternalScalar(sizeTy, name + LOGICAL_SEGMENT_SUFFIX, groupId);
+    if (LLVM_UNLIKELY(BlockingSynchronization)) {
+        mTarget->addInternalScalar(b->getInt32Ty(), name + LOGICAL_SEGMENT_WAITERS_SUFFIX, groupId);
+    }
 
     for (const auto e : make_iterator_range(in_edges(kernelId, mBufferGraph))) {
         const BufferPort & br = mBufferGraph[e];
@@ -203,6 +216,8 @@ void PipelineCompiler::addInternalKernelProperties(BuilderRef b, const unsigned
 
     addFamilyKernelProperties(b, kernelId);
 
+    addTieredCompilationProperties(b, kernelId);
+
     if (LLVM_LIKELY(kernel->isStateful())) {
         PointerType * sharedStateTy = nullptr;
         if (LLVM_UNLIKELY(kernel->externallyInitialized())) {
@@ -238,8 +253,10 @@ void PipelineCompiler::addInternalKernelProperties(BuilderRef b, const unsigned
                 // segment num  0
                 // new capacity 1
                 // produced item count 2
-                // consumer processed item count [3,n)
-                Type * const traceStructTy = ArrayType::get(sizeTy, numOfConsumers + 3);
+                // bytes copied 3
+                // bytes not copied due to in-place growth 4
+                // consumer processed item count [5,n)
+                Type * const traceStructTy = ArrayType::get(sizeTy, numOfConsumers + 5);
 
                 FixedArray<Type *, 2> traceStruct;
                 traceStruct[0] = traceStructTy->getPointerTo(); // pointer to trace log
@@ -283,6 +300,116 @@ void PipelineCompiler::generateInitializeMethod(BuilderRef b) {
         initializePAPI(b);
     }
     #endif
+    openKernelTimeline(b);
+    initializeTieredKernelSlots(b);
+    initializeInternalKernels(b);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generateRearmMethod
+ *
+ * Prepare an instance that has completed a run for another one. The per-run state of the pipeline is cleared
+ * and every kernel is reinitialized but the owned stream sets keep their memory. The instances of kernels that
+ * the pipeline constructs itself were freed when the run was finalized and are created anew; those of family
+ * kernels, which the host constructs, were kept and are rearmed in place.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::generateRearmMethod(BuilderRef b) {
+    clearRunState(b);
+    rearmExternallyInitializedKernels(b);
+    initializeInternalKernels(b);
+    resetOwnedBuffers(b);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief rearmExternallyInitializedKernels
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::rearmExternallyInitializedKernels(BuilderRef b) {
+    mScalarValue.reset(FirstKernel, LastScalar);
+    for (unsigned i = FirstKernel; i <= LastKernel; ++i) {
+        const Kernel * const kernel = getKernel(i);
+        if (LLVM_UNLIKELY(kernel->externallyInitialized() && kernel->isStateful())) {
+            setActiveKernel(b, i, false);
+            ArgVec args;
+            args.push_back(mKernelSharedHandle);
+            for (const auto e : make_iterator_range(in_edges(i, mScalarGraph))) {
+                assert (mScalarGraph[e].Type == PortType::Input);
+                args.push_back(getScalar(b, source(e, mScalarGraph)));
+            }
+            callKernelRearmFunction(b, args);
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief clearRunState
+ *
+ * Zero the segment numbers, item counts and termination signals that a fresh instance begins with.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::clearRunState(BuilderRef b) {
+
+    auto clear = [&](const std::string & name) {
+        Value * const ptr = b->getScalarFieldPtr(name);
+        b->CreateStore(Constant::getNullValue(ptr->getType()->getPointerElementType()), ptr);
+    };
+
+    auto clearConsumedItemCounts = [&](const unsigned kernelId) {
+        for (const auto e : make_iterator_range(out_edges(kernelId, mBufferGraph))) {
+            const auto streamSet = target(e, mBufferGraph);
+            const BufferNode & bn = mBufferGraph[streamSet];
+            if (LLVM_UNLIKELY(out_degree(streamSet, mConsumerGraph) != 0)) {
+                if (LLVM_LIKELY(bn.isOwned() || bn.isInternal() || mTraceIndividualConsumedItemCounts)) {
+                    const BufferPort & rd = mBufferGraph[e];
+                    clear(makeBufferName(kernelId, rd.Port) + CONSUMED_ITEM_COUNT_SUFFIX);
+                }
+            }
+        }
+    };
+
+    #ifndef USE_FIXED_SEGMENT_NUMBER_INCREMENTS
+    if (!ExternallySynchronized) {
+        clear(NEXT_LOGICAL_SEGMENT_NUMBER);
+    }
+    #endif
+
+    if (LLVM_UNLIKELY(mTraceIndividualConsumedItemCounts)) {
+        clearConsumedItemCounts(PipelineInput);
+    }
+
+    auto currentPartitionId = -1U;
+    for (unsigned i = FirstKernel; i <= LastKernel; ++i) {
+        const auto partitionId = KernelPartitionId[i];
+        if (partitionId != currentPartitionId) {
+            clear(TERMINATION_PREFIX + std::to_string(partitionId));
+            if (in_degree(partitionId, mTerminationPropagationGraph) > 0) {
+                clear(CONSUMER_TERMINATION_COUNT_PREFIX + std::to_string(partitionId));
+            }
+            currentPartitionId = partitionId;
+        }
+        clear(makeKernelName(i) + LOGICAL_SEGMENT_SUFFIX);
+        for (const auto e : make_iterator_range(in_edges(i, mBufferGraph))) {
+            const BufferPort & br = mBufferGraph[e];
+            const auto prefix = makeBufferName(i, br.Port);
+            if (LLVM_UNLIKELY(br.IsDeferred)) {
+                clear(prefix + DEFERRED_ITEM_COUNT_SUFFIX);
+            }
+            clear(prefix + ITEM_COUNT_SUFFIX);
+        }
+        for (const auto e : make_iterator_range(out_edges(i, mBufferGraph))) {
+            const BufferPort & br = mBufferGraph[e];
+            const auto prefix = makeBufferName(i, br.Port);
+            if (LLVM_UNLIKELY(br.IsDeferred)) {
+                clear(prefix + DEFERRED_ITEM_COUNT_SUFFIX);
+            }
+            clear(prefix + ITEM_COUNT_SUFFIX);
+        }
+        clearConsumedItemCounts(i);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief initializeInternalKernels
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::initializeInternalKernels(BuilderRef b) {
 
     mScalarValue.reset(FirstKernel, LastScalar);
 
@@ -384,8 +511,7 @@ void PipelineCompiler::generateInitializeThreadLocalMethod(BuilderRef b) {
 void PipelineCompiler::generateAllocateThreadLocalInternalStreamSetsMethod(BuilderRef b, Value * const expectedNumOfStrides) {
     assert (mTarget->hasThreadLocal());
     if (LLVM_LIKELY(RequiredThreadLocalStreamSetMemory > 0)) {
-        ConstantInt * const reqMemory = b->getSize(RequiredThreadLocalStreamSetMemory);
-        Value * const memorySize = b->CreateMul(reqMemory, expectedNumOfStrides);
+        Value * const memorySize = getThreadLocalStreamSetMemorySize(b, expectedNumOfStrides);
         Value * const base = b->CreatePageAlignedMalloc(memorySize);
         PointerType * const int8PtrTy = b->getInt8PtrTy();
         b->setScalarField(BASE_THREAD_LOCAL_STREAMSET_MEMORY, b->CreatePointerCast(base, int8PtrTy));
@@ -394,6 +520,18 @@ void PipelineCompiler::generateAllocateThreadLocalInternalStreamSetsMethod(Build
     resetInternalBufferHandles();
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getThreadLocalStreamSetMemorySize
+ *
+ * The thread local stream set memory of each thread is a whole number of pages so that it can be bound to the
+ * NUMA node of its thread without moving anything else.
+ ** ------------------------------------------------------------------------------------------------------------- */
+Value * PipelineCompiler::getThreadLocalStreamSetMemorySize(BuilderRef b, Value * const expectedNumOfStrides) const {
+    ConstantInt * const reqMemory = b->getSize(RequiredThreadLocalStreamSetMemory);
+    ConstantInt * const pageSize = b->getSize(b->getPageSize());
+    return b->CreateRoundUp(b->CreateMul(reqMemory, expectedNumOfStrides), pageSize);
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief generateKernelMethod
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -484,15 +622,136 @@ void __pipeline_pthread_create_on_cpu(pthread_t * pthread, void *(*start_routine
     thread_resume(mthread);
 }
 
+void __pipeline_bind_to_local_node(void * const /* addr */, const size_t /* size */) {
+
+}
+
+void __pipeline_interleave_memory(void * const /* addr */, const size_t /* size */, const int32_t /* numOfThreads */) {
+
+}
+
 #elif BOOST_OS_LINUX
 
+struct NumaNode {
+    unsigned Id;
+    std::vector<unsigned> CPUs;
+};
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_numa_topology
+ *
+ * Read the NUMA nodes of this machine and their CPUs from sysfs, restricted to the CPUs this process may run on.
+ * If the topology is not available, every usable CPU is considered part of node 0.
+ ** ------------------------------------------------------------------------------------------------------------- */
+const std::vector<NumaNode> & __pipeline_numa_topology() {
+    static const std::vector<NumaNode> topology = [] {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (LLVM_UNLIKELY(sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)) {
+            for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency() && cpu < CPU_SETSIZE; ++cpu) {
+                CPU_SET(cpu, &allowed);
+            }
+        }
+        std::vector<NumaNode> nodes;
+        if (DIR * const dir = opendir("/sys/devices/system/node")) {
+            while (const struct dirent * const entry = readdir(dir)) {
+                unsigned id = 0;
+                char tail = 0;
+                if (std::sscanf(entry->d_name, "node%u%c", &id, &tail) != 1) {
+                    continue;
+                }
+                // cpulist is a comma separated list of CPU numbers and ranges, e.g., "0-7,16-23"
+                std::ifstream in(std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+                NumaNode node{id, {}};
+                unsigned first = 0;
+                while (in >> first) {
+                    unsigned last = first;
+                    if (in.peek() == '-') {
+                        in.get();
+                        in >> last;
+                    }
+                    for (unsigned cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+                        if (CPU_ISSET(cpu, &allowed)) {
+                            node.CPUs.push_back(cpu);
+                        }
+                    }
+                    if (in.peek() != ',') {
+                        break;
+                    }
+                    in.get();
+                }
+                if (!node.CPUs.empty()) {
+                    nodes.emplace_back(std::move(node));
+                }
+            }
+            closedir(dir);
+        }
+        if (LLVM_UNLIKELY(nodes.empty())) {
+            NumaNode node{0, {}};
+            for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed)) {
+                    node.CPUs.push_back(cpu);
+                }
+            }
+            if (LLVM_UNLIKELY(node.CPUs.empty())) {
+                node.CPUs.push_back(0);
+            }
+            nodes.emplace_back(std::move(node));
+        }
+        std::sort(nodes.begin(), nodes.end(), [](const NumaNode & a, const NumaNode & b) { return a.Id < b.Id; });
+        return nodes;
+    }();
+    return topology;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_thread_cpu_set
+ *
+ * Determine the CPUs that the given pipeline thread (where 0 is the process thread) may run on.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_thread_cpu_set(const unsigned thread, cpu_set_t & cpu_set) {
+    CPU_ZERO(&cpu_set);
+    const auto & nodes = __pipeline_numa_topology();
+    switch (codegen::ThreadPlacement) {
+        case codegen::LinearPlacement:
+            CPU_SET(thread % CPU_SETSIZE, &cpu_set);
+            break;
+        case codegen::CompactPlacement:
+            BEGIN_SCOPED_REGION
+            size_t numOfCPUs = 0;
+            for (const NumaNode & node : nodes) {
+                numOfCPUs += node.CPUs.size();
+            }
+            auto k = thread % numOfCPUs;
+            for (const NumaNode & node : nodes) {
+                if (k < node.CPUs.size()) {
+                    CPU_SET(node.CPUs[k], &cpu_set);
+                    break;
+                }
+                k -= node.CPUs.size();
+            }
+            END_SCOPED_REGION
+            break;
+        case codegen::ScatterPlacement:
+            BEGIN_SCOPED_REGION
+            const NumaNode & node = nodes[thread % nodes.size()];
+            CPU_SET(node.CPUs[(thread / nodes.size()) % node.CPUs.size()], &cpu_set);
+            END_SCOPED_REGION
+            break;
+        case codegen::NodePlacement:
+            for (const auto cpu : nodes[thread % nodes.size()].CPUs) {
+                CPU_SET(cpu, &cpu_set);
+            }
+            break;
+    }
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief __pipeline_pin_current_thread_to_cpu
  ** ------------------------------------------------------------------------------------------------------------- */
 void __pipeline_pin_current_thread_to_cpu(const int32_t cpu) {
     cpu_set_t cpu_set;
-    CPU_ZERO(&cpu_set);
-    CPU_SET(cpu, &cpu_set);
+    __pipeline_thread_cpu_set(cpu, cpu_set);
     pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
 }
 
@@ -501,7 +760,7 @@ void __pipeline_pin_current_thread_to_cpu(const int32_t cpu) {
  ** ------------------------------------------------------------------------------------------------------------- */
 void __pipeline_pthread_create_on_cpu(pthread_t * pthread, void *(*start_routine)(void *), void * arg, const int32_t cpu) {
     cpu_set_t cpu_set;
-    CPU_SET(cpu, &cpu_set);
+    __pipeline_thread_cpu_set(cpu, cpu_set);
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpu_set);
@@ -513,6 +772,93 @@ void __pipeline_pthread_create_on_cpu(pthread_t * pthread, void *(*start_routine
     }
 }
 
+// mbind and set_mempolicy expect maxnode to be one more than the number of bits in the node mask
+constexpr unsigned MAX_NUMA_NODES = 1024;
+using NumaNodeMask = std::bitset<MAX_NUMA_NODES>;
+
+inline unsigned long * __pipeline_node_mask_words(const NumaNodeMask & mask, std::vector<unsigned long> & words) {
+    constexpr auto bitsPerWord = sizeof(unsigned long) * CHAR_BIT;
+    words.assign(MAX_NUMA_NODES / bitsPerWord, 0);
+    for (unsigned i = 0; i < MAX_NUMA_NODES; ++i) {
+        if (mask[i]) {
+            words[i / bitsPerWord] |= (1UL << (i % bitsPerWord));
+        }
+    }
+    return words.data();
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_mbind_whole_pages
+ *
+ * Apply the given policy to, and migrate, only the pages that lie entirely within [addr, addr + size). Moving the
+ * pages the range shares with its neighbours would move whatever other heap objects lie on them as well.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_mbind_whole_pages(void * const addr, const size_t size, const int mode, const NumaNodeMask & mask) {
+    const auto pageSize = static_cast<uintptr_t>(getpagesize());
+    const auto start = (reinterpret_cast<uintptr_t>(addr) + pageSize - 1) & ~(pageSize - 1);
+    const auto end = (reinterpret_cast<uintptr_t>(addr) + size) & ~(pageSize - 1);
+    if (start < end) {
+        std::vector<unsigned long> words;
+        // binding is only a performance hint; ignore the result
+        syscall(SYS_mbind, start, end - start, mode, __pipeline_node_mask_words(mask, words), MAX_NUMA_NODES + 1, MPOL_MF_MOVE);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_bind_to_local_node
+ *
+ * Move the given memory to the NUMA node of the CPU the calling thread is running on and place any page it
+ * touches for the first time there too. Thread local stream sets are allocated by the process thread before
+ * the thread that uses them is created so first-touch alone would leave them on the node of the process thread.
+ * The memory is page aligned and a whole number of pages long so nothing else is moved with it.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_bind_to_local_node(void * const addr, const size_t size) {
+    const auto & nodes = __pipeline_numa_topology();
+    if (codegen::ThreadPlacement == codegen::LinearPlacement || nodes.size() < 2 || addr == nullptr || size == 0) {
+        return;
+    }
+    const auto cpu = sched_getcpu();
+    for (const NumaNode & node : nodes) {
+        if (std::find(node.CPUs.begin(), node.CPUs.end(), static_cast<unsigned>(cpu)) != node.CPUs.end()) {
+            NumaNodeMask mask;
+            mask.set(node.Id);
+            __pipeline_mbind_whole_pages(addr, size, MPOL_PREFERRED, mask);
+            return;
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_interleave_memory
+ *
+ * Shared stream sets are written and read by every segment thread so there is no single node they belong to.
+ * Interleave the pages of the given buffer across the NUMA nodes of the first numOfThreads pipeline threads
+ * rather than leaving them all on the node of the process thread that allocated (and zeroed) them. The policy
+ * belongs to the buffer alone; the memory policy of the process, e.g., one set by numactl, is left untouched.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_interleave_memory(void * const addr, const size_t size, const int32_t numOfThreads) {
+    const auto & nodes = __pipeline_numa_topology();
+    if (codegen::ThreadPlacement == codegen::LinearPlacement || nodes.size() < 2 || addr == nullptr || numOfThreads < 2) {
+        return;
+    }
+    NumaNodeMask mask;
+    for (int32_t i = 0; i < numOfThreads; ++i) {
+        cpu_set_t cpu_set;
+        __pipeline_thread_cpu_set(i, cpu_set);
+        for (const NumaNode & node : nodes) {
+            for (const auto cpu : node.CPUs) {
+                if (CPU_ISSET(cpu, &cpu_set)) {
+                    mask.set(node.Id);
+                    break;
+                }
+            }
+        }
+    }
+    if (mask.count() > 1) {
+        __pipeline_mbind_whole_pages(addr, size, MPOL_INTERLEAVE, mask);
+    }
+}
+
 #endif
 
 }
@@ -631,6 +977,14 @@ void PipelineCompiler::generateMultiThreadKernelMethod(BuilderRef b) {
     readThreadStuctObject(b, threadStruct);
     assert (isFromCurrentFunction(b, getHandle()));
     assert (isFromCurrentFunction(b, getThreadLocalHandle()));
+    // each spawned thread has RequiredThreadLocalStreamSetMemory bytes of thread local stream set memory
+    if (LLVM_LIKELY(RequiredThreadLocalStreamSetMemory > 0)) {
+        Function * const bindFn = m->getFunction("__pipeline_bind_to_local_node");
+        FixedArray<Value *, 2> bindArgs;
+        bindArgs[0] = b->CreatePointerCast(b->getScalarField(BASE_THREAD_LOCAL_STREAMSET_MEMORY), voidPtrTy);
+        bindArgs[1] = getThreadLocalStreamSetMemorySize(b, b->getScalarField(EXPECTED_NUM_OF_STRIDES_MULTIPLIER));
+        b->CreateCall(bindFn->getFunctionType(), bindFn, bindArgs);
+    }
 
     // generate the pipeline logic for this thread
     start(b);
@@ -714,6 +1068,47 @@ void PipelineCompiler::generateMultiThreadKernelMethod(BuilderRef b) {
  * @brief generateFinalizeMethod
  ** ------------------------------------------------------------------------------------------------------------- */
 void PipelineCompiler::generateFinalizeMethod(BuilderRef b) {
+    finalizeInternalKernels(b);
+    closeKernelTimeline(b);
+    releaseOwnedBuffers(b, true);
+    resetInternalBufferHandles();
+    #ifdef ENABLE_PAPI
+    if (!ExternallySynchronized) {
+        shutdownPAPI(b);
+    }
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generateFinalizeRunMethod
+ *
+ * Finalize the kernels of a reusable instance but keep its owned stream sets and the instances of its family
+ * kernels for the next run.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::generateFinalizeRunMethod(BuilderRef b) {
+    finalizeInternalKernels(b, true);
+    resetInternalBufferHandles();
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generateReleaseMethod
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::generateReleaseMethod(BuilderRef b) {
+    releaseExternallyInitializedKernels(b);
+    closeKernelTimeline(b);
+    releaseOwnedBuffers(b, true);
+    resetInternalBufferHandles();
+    #ifdef ENABLE_PAPI
+    if (!ExternallySynchronized) {
+        shutdownPAPI(b);
+    }
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief finalizeInternalKernels
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::finalizeInternalKernels(BuilderRef b, const bool retainExternallyInitialized) {
     mScalarValue.reset(FirstKernel, LastScalar);
     // calculate the last segment # used by any kernel in case any reports require it.
     mSegNo = nullptr;
@@ -739,15 +1134,27 @@ void PipelineCompiler::generateFinalizeMethod(BuilderRef b) {
         if (LLVM_LIKELY(mKernel->isStateful())) {
             params.push_back(mKernelSharedHandle);
         }
-        mScalarValue[i] = callKernelFinalizeFunction(b, params);
+        if (retainExternallyInitialized && mKernel->externallyInitialized() && mKernel->isStateful()) {
+            mScalarValue[i] = callKernelFinalizeRunFunction(b, params);
+        } else {
+            mScalarValue[i] = callKernelFinalizeFunction(b, params);
+        }
     }
-    releaseOwnedBuffers(b, true);
-    resetInternalBufferHandles();
-    #ifdef ENABLE_PAPI
-    if (!ExternallySynchronized) {
-        shutdownPAPI(b);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief releaseExternallyInitializedKernels
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::releaseExternallyInitializedKernels(BuilderRef b) {
+    for (unsigned i = FirstKernel; i <= LastKernel; ++i) {
+        const Kernel * const kernel = getKernel(i);
+        if (LLVM_UNLIKELY(kernel->externallyInitialized() && kernel->isStateful())) {
+            setActiveKernel(b, i, false);
+            SmallVector<Value *, 1> params;
+            params.push_back(mKernelSharedHandle);
+            callKernelReleaseFunction(b, params);
+        }
     }
-    #endif
 }
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -930,6 +1337,10 @@ void PipelineCompiler::linkPThreadLibrary(BuilderRef b) {
                     __pipeline_pthread_create_on_cpu);
     b->LinkFunction("__pipeline_pin_current_thread_to_cpu",
                     __pipeline_pin_current_thread_to_cpu);
+    b->LinkFunction("__pipeline_bind_to_local_node",
+                    __pipeline_bind_to_local_node);
+    b->LinkFunction("__pipeline_interleave_memory",
+                    __pipeline_interleave_memory);
 }
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -2,6 +2,13 @@
 #define SYNCHRONIZATION_LOGIC_HPP
 
 #include "pipeline_compiler.hpp"
+#include <climits>
+#include <sched.h>
+#if BOOST_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 // Suppose T1 and T2 are two pipeline threads where all segment processing
 // of kernel Ki in T1 logically happens before Ki in T2.
@@ -34,8 +41,91 @@
 
 // TODO: Fix cycle counter and serialize option for nested pipelines
 
+// When the threads outnumber the available cores, a thread spinning on a lock can
+// prevent the thread that holds it from running. A pipeline with the BlockingSynchronization
+// attribute therefore falls back to __pipeline_wait_on_segment_lock whenever a lock is
+// not immediately available. It spins for an adaptive period, which grows when
+// spinning succeeds and shrinks when it does not, and then sleeps on a futex on the
+// low 32 bits of the logical segment number. Each lock counts its sleeping threads so
+// that releasing a lock only enters the kernel when some thread is waiting on it.
+
 namespace kernel {
 
+namespace {
+
+const unsigned MinimumSegmentLockSpins = 16;
+const unsigned MaximumSegmentLockSpins = 16384;
+
+thread_local unsigned SegmentLockSpinLimit = 1024;
+
+inline void __pipeline_cpu_relax() {
+    #if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+    #endif
+}
+
+#if BOOST_OS_LINUX
+inline int * __pipeline_futex_word(size_t * const lock) {
+    #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return reinterpret_cast<int *>(lock) + (sizeof(size_t) / sizeof(int)) - 1;
+    #else
+    return reinterpret_cast<int *>(lock);
+    #endif
+}
+#endif
+
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_wait_on_segment_lock
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_wait_on_segment_lock(size_t * const lock, uint32_t * const waiters, const size_t segNo) {
+    auto spinLimit = SegmentLockSpinLimit;
+    for (unsigned i = 0; i < spinLimit; ++i) {
+        if (__atomic_load_n(lock, __ATOMIC_ACQUIRE) == segNo) {
+            SegmentLockSpinLimit = std::min(spinLimit * 2, MaximumSegmentLockSpins);
+            return;
+        }
+        __pipeline_cpu_relax();
+    }
+    SegmentLockSpinLimit = std::max(spinLimit / 2, MinimumSegmentLockSpins);
+    // The waiter count must be visible before the lock is checked again; the releasing thread
+    // stores the lock before checking the count, so at least one of them sees the other.
+    __atomic_fetch_add(waiters, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        const auto current = __atomic_load_n(lock, __ATOMIC_SEQ_CST);
+        if (current == segNo) {
+            break;
+        }
+        #if BOOST_OS_LINUX
+        // The kernel only puts this thread to sleep if the low word of the lock is still the
+        // value we just read, so a release between the load and the wait cannot be missed.
+        syscall(SYS_futex, __pipeline_futex_word(lock), FUTEX_WAIT_PRIVATE, static_cast<int>(current), nullptr, nullptr, 0);
+        #else
+        sched_yield();
+        #endif
+    }
+    __atomic_fetch_sub(waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __pipeline_wake_segment_lock_waiters
+ ** ------------------------------------------------------------------------------------------------------------- */
+void __pipeline_wake_segment_lock_waiters(size_t * const lock) {
+    #if BOOST_OS_LINUX
+    // Threads waiting on different segment numbers share the futex, so wake all of them.
+    syscall(SYS_futex, __pipeline_futex_word(lock), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief linkBlockingSynchronizationLibrary
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::linkBlockingSynchronizationLibrary(BuilderRef b) {
+    b->LinkFunction("__pipeline_wait_on_segment_lock", __pipeline_wait_on_segment_lock);
+    b->LinkFunction("__pipeline_wake_segment_lock_waiters", __pipeline_wake_segment_lock_waiters);
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief identifyAllInternallySynchronizedKernels
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -135,7 +225,22 @@ void PipelineCompiler::acquireSynchronizationLock(BuilderRef b, const unsigned k
             b->CreateAssert(pendingOrReady, out.str(), mCurrentKernelName, currentSegNo, mSegNo);
         }
         Value * const ready = b->CreateICmpEQ(mSegNo, currentSegNo);
-        b->CreateLikelyCondBr(ready, acquired, acquire);
+        if (LLVM_UNLIKELY(BlockingSynchronization)) {
+            BasicBlock * const wait = b->CreateBasicBlock(prefix + "_wait" + LOGICAL_SEGMENT_SUFFIX, acquired);
+            b->CreateLikelyCondBr(ready, acquired, wait);
+
+            b->SetInsertPoint(wait);
+            Value * const waitersPtr = getScalarFieldPtr(b.get(), waitingOn + LOGICAL_SEGMENT_WAITERS_SUFFIX);
+            Function * const waitFn = b->getModule()->getFunction("__pipeline_wait_on_segment_lock"); assert (waitFn);
+            FixedArray<Value *, 3> args;
+            args[0] = waitingOnPtr;
+            args[1] = waitersPtr;
+            args[2] = mSegNo;
+            b->CreateCall(waitFn, args);
+            b->CreateBr(acquired);
+        } else {
+            b->CreateLikelyCondBr(ready, acquired, acquire);
+        }
 
         b->SetInsertPoint(acquired);
 
@@ -160,6 +265,23 @@ void PipelineCompiler::releaseSynchronizationLock(BuilderRef b, const unsigned k
             currentSegNo = b->CreateLoad(waitingOnPtr);
         }
         b->CreateAtomicStoreRelease(mNextSegNo, waitingOnPtr);
+        if (LLVM_UNLIKELY(BlockingSynchronization && required)) {
+            // Order the release of the lock before reading its waiter count; see __pipeline_wait_on_segment_lock.
+            b->CreateFence(AtomicOrdering::SequentiallyConsistent);
+            Value * const waitersPtr = getScalarFieldPtr(b.get(), prefix + LOGICAL_SEGMENT_WAITERS_SUFFIX);
+            Value * const waiters = b->CreateAtomicLoadAcquire(waitersPtr);
+            BasicBlock * const nextNode = b->GetInsertBlock()->getNextNode();
+            BasicBlock * const wake = b->CreateBasicBlock(prefix + "_wake" + LOGICAL_SEGMENT_SUFFIX, nextNode);
+            BasicBlock * const released = b->CreateBasicBlock(prefix + "_released" + LOGICAL_SEGMENT_SUFFIX, nextNode);
+            b->CreateUnlikelyCondBr(b->CreateIsNotNull(waiters), wake, released);
+
+            b->SetInsertPoint(wake);
+            Function * const wakeFn = b->getModule()->getFunction("__pipeline_wake_segment_lock_waiters"); assert (wakeFn);
+            b->CreateCall(wakeFn, waitingOnPtr);
+            b->CreateBr(released);
+
+            b->SetInsertPoint(released);
+        }
         #ifdef PRINT_DEBUG_MESSAGES
         debugPrint(b, prefix + ": released %" PRIu64, mSegNo);
         #endif
@@ -0,0 +1,90 @@
+#ifndef TIERED_COMPILATION_LOGIC_HPP
+#define TIERED_COMPILATION_LOGIC_HPP
+
+#include "pipeline_compiler.hpp"
+
+// With -tiered-compilation, the driver first compiles kernels with as little optimization as possible and
+// the pipeline calls each of them through a "slot" that the driver owns: the address of the kernel's current
+// DoSegment method and the number of times it has been called. Once a kernel is hot, the driver compiles it
+// at full optimization in the background and replaces the address in its slot. A DoSegment call reads the slot
+// once so every segment is processed entirely by one version of the kernel; both versions are compiled from
+// the same IR and share the same kernel state so the result does not depend on when the switch occurs.
+
+namespace kernel {
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief isTieredKernel
+ *
+ * Pipelines and optimization branches are compiled at full optimization immediately and family kernels are
+ * already called through the function pointers they were initialized with.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool PipelineCompiler::isTieredKernel(const unsigned kernelId) const {
+    if (LLVM_LIKELY(!EnableTieredCompilation)) {
+        return false;
+    }
+    const Kernel * const kernel = getKernel(kernelId);
+    return !kernel->hasFamilyName()
+        && !isa<PipelineKernel>(kernel)
+        && kernel->getTypeId() != Kernel::TypeId::OptimizationBranch
+        && !kernel->hasAttribute(AttrId::InfrequentlyUsed);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addTieredCompilationProperties
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::addTieredCompilationProperties(BuilderRef b, const unsigned kernelId) const {
+    if (LLVM_UNLIKELY(isTieredKernel(kernelId))) {
+        const auto groupId = getCacheLineGroupId(kernelId);
+        mTarget->addInternalScalar(b->getVoidPtrTy(), makeKernelName(kernelId) + TIERED_KERNEL_SLOT_SUFFIX, groupId);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief initializeTieredKernelSlots
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineCompiler::initializeTieredKernelSlots(BuilderRef b) const {
+    if (LLVM_UNLIKELY(EnableTieredCompilation)) {
+        Module * const m = b->getModule();
+        Function * const slotFn = m->getFunction("__tiered_compilation_slot"); assert (slotFn);
+        // the driver maps this symbol to its own slot table
+        Constant * const table = m->getOrInsertGlobal("__tiered_compilation_slots", b->getInt8Ty());
+        FixedArray<Value *, 3> args;
+        args[0] = b->CreatePointerCast(table, b->getVoidPtrTy());
+        for (auto i = FirstKernel; i <= LastKernel; ++i) {
+            if (isTieredKernel(i)) {
+                Function * const doSegment = getKernel(i)->getDoSegmentFunction(b, true);
+                args[1] = b->GetString(doSegment->getName());
+                args[2] = b->CreatePtrToInt(doSegment, b->getSizeTy());
+                Value * const slot = b->CreateCall(slotFn, args);
+                b->setScalarField(makeKernelName(i) + TIERED_KERNEL_SLOT_SUFFIX, slot);
+            }
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getTieredKernelDoSegmentFunction
+ *
+ * Count this call and return the current DoSegment method of the kernel. The count only needs to be approximate
+ * so the update is not atomic.
+ ** ------------------------------------------------------------------------------------------------------------- */
+Value * PipelineCompiler::getTieredKernelDoSegmentFunction(BuilderRef b, Type * const type) const {
+    IntegerType * const sizeTy = b->getSizeTy();
+    StructType * const slotTy = StructType::get(b->getContext(), {sizeTy, sizeTy});
+    Value * const slotPtr = b->getScalarField(makeKernelName(mKernelId) + TIERED_KERNEL_SLOT_SUFFIX);
+    Value * const slot = b->CreatePointerCast(slotPtr, slotTy->getPointerTo());
+    Constant * const ZERO = b->getInt32(0);
+    Constant * const ONE = b->getInt32(1);
+    Value * const callsPtr = b->CreateGEP(slot, {ZERO, ONE});
+    Value * const calls = b->CreateAtomicLoadAcquire(callsPtr);
+    b->CreateAtomicStoreRelease(b->CreateAdd(calls, b->getSize(1)), callsPtr);
+    Value * const funcPtr = b->CreateAtomicLoadAcquire(b->CreateGEP(slot, {ZERO, ZERO}));
+    if (LLVM_UNLIKELY(CheckAssertions)) {
+        b->CreateAssert(funcPtr, makeKernelName(mKernelId) + " has no DoSegment method in its tiered compilation slot");
+    }
+    return b->CreateIntToPtr(funcPtr, type);
+}
+
+}
+
+#endif // TIERED_COMPILATION_LOGIC_HPP
@@ -38,6 +38,24 @@
 #include <llvm/ExecutionEngine/MCJIT.h>
 #endif
 #include <llvm/ADT/Statistic.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/MemoryBuffer.h>
+#if LLVM_VERSION_INTEGER < LLVM_VERSION_CODE(4, 0, 0)
+#include <llvm/Bitcode/ReaderWriter.h>
+#else
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#endif
+#if LLVM_VERSION_INTEGER < LLVM_VERSION_CODE(14, 0, 0)
+#include <llvm/Support/TargetRegistry.h>
+#else
+#include <llvm/MC/TargetRegistry.h>
+#endif
+#include <kernel/pipeline/optimizationbranch.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <pthread.h>
 #if LLVM_VERSION_INTEGER < LLVM_VERSION_CODE(8, 0, 0)
 #include <llvm/IR/LegacyPassManager.h>
 #else
@@ -82,10 +100,11 @@ CPUDriver::CPUDriver(std::string && moduleName)
     builder.setTargetOptions(codegen::target_Options);
     builder.setOptLevel(codegen::BackEndOptLevel);
 
-    StringMap<bool> HostCPUFeatures;
-    if (sys::getHostCPUFeatures(HostCPUFeatures)) {
+    // compile for the features of the ISA tier rather than the host so that the cached objects are portable
+    const auto & TargetCPUFeatures = codegen::getTargetCPUFeatures();
+    if (!TargetCPUFeatures.empty()) {
         std::vector<std::string> attrs;
-        for (auto &flag : HostCPUFeatures) {
+        for (auto &flag : TargetCPUFeatures) {
             if (flag.second) {
                 attrs.push_back("+" + flag.first().str());
                 //llvm::errs() << flag.first().str() << "\n";
@@ -113,6 +132,9 @@ CPUDriver::CPUDriver(std::string && moduleName)
     const DataLayout DL(mTarget->createDataLayout());
     mMainModule->setTargetTriple(triple);
     mMainModule->setDataLayout(DL);
+    if (LLVM_UNLIKELY(codegen::TieredCompilation)) {
+        mapTieredKernelSlots();
+    }
     mBuilder.reset(IDISA::GetIDISA_Builder(*mContext));
     mBuilder->setDriver(*this);
     mBuilder->setModule(mMainModule);
@@ -128,12 +150,32 @@ Function * CPUDriver::addLinkFunction(Module * mod, llvm::StringRef name, Functi
         #ifndef ORCJIT
         mEngine->updateGlobalMapping(f, functionPtr);
         #endif
+        mLinkedFunctions[name] = functionPtr;
     } else if (LLVM_UNLIKELY(f->getType() != type->getPointerTo())) {
         report_fatal_error("Cannot link " + name + ": a function with a different signature already exists with that name in " + mod->getName());
     }
     return f;
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addOptimizationPasses
+ ** ------------------------------------------------------------------------------------------------------------- */
+static void addOptimizationPasses(legacy::PassManager & PM) {
+    PM.add(createPromoteMemoryToRegisterPass());    // Promote stack variables to constants or PHI nodes
+    #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(6, 0, 0)
+    PM.add(createSROAPass());                       // Promote elements of aggregate allocas whose addresses are not taken to registers.
+    #endif
+    PM.add(createCFGSimplificationPass());          // Remove dead basic blocks and unnecessary branch statements / phi nodes
+    PM.add(createEarlyCSEPass());                   // Simple common subexpression elimination pass
+    PM.add(createInstructionCombiningPass());       // Simple peephole optimizations and bit-twiddling.
+    PM.add(createReassociatePass());                // Canonicalizes commutative expressions
+    PM.add(createGVNPass());                        // Global value numbering redundant expression elimination pass
+    PM.add(createCFGSimplificationPass());          // Repeat CFG Simplification to "clean up" any newly found redundant phi nodes
+    if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableAsserts))) {
+        PM.add(createRemoveRedundantAssertionsPass());
+    }
+}
+
 inline void CPUDriver::preparePassManager() {
 
     if (mPassManager) return;
@@ -172,19 +214,7 @@ inline void CPUDriver::preparePassManager() {
         }
         mPassManager->add(createPrintModulePass(*mIROutputStream));
     }
-    mPassManager->add(createPromoteMemoryToRegisterPass());    // Promote stack variables to constants or PHI nodes
-    #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(6, 0, 0)
-    mPassManager->add(createSROAPass());                       // Promote elements of aggregate allocas whose addresses are not taken to registers.
-    #endif
-    mPassManager->add(createCFGSimplificationPass());          // Remove dead basic blocks and unnecessary branch statements / phi nodes
-    mPassManager->add(createEarlyCSEPass());                   // Simple common subexpression elimination pass
-    mPassManager->add(createInstructionCombiningPass());       // Simple peephole optimizations and bit-twiddling.
-    mPassManager->add(createReassociatePass());                // Canonicalizes commutative expressions
-    mPassManager->add(createGVNPass());                        // Global value numbering redundant expression elimination pass
-    mPassManager->add(createCFGSimplificationPass());          // Repeat CFG Simplification to "clean up" any newly found redundant phi nodes    
-    if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableAsserts))) {
-        mPassManager->add(createRemoveRedundantAssertionsPass());
-    }
+    addOptimizationPasses(*mPassManager);
     #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(3, 7, 0)
     if (LLVM_UNLIKELY(codegen::ShowASMOption != codegen::OmittedOption)) {
         if (!codegen::ShowASMOption.empty()) {
@@ -213,7 +243,25 @@ void CPUDriver::generateUncachedKernels() {
     // mappings made by the base KernelCompiler. That could be done in a more focused manner, however, as each
     // mapping is known.
 
-    preparePassManager();
+    // Generating the IR of a kernel requires the shared context and builder so is done serially. Optimizing and
+    // compiling the resulting modules into object code is independent work that can be done concurrently.
+    const bool compileInParallel = canCompileKernelsInParallel();
+    // an optimization branch calls its kernels directly so they cannot be replaced by tiered compilation
+    for (const auto & kernel : mUncachedKernel) {
+        if (LLVM_UNLIKELY(isa<OptimizationBranch>(kernel.get()))) {
+            const OptimizationBranch * const br = cast<OptimizationBranch>(kernel.get());
+            mDirectlyCalledKernels.insert(br->getAllZeroKernel());
+            mDirectlyCalledKernels.insert(br->getNonZeroKernel());
+        }
+    }
+    std::vector<Module *> modules;
+    std::vector<CodeGenOpt::Level> levels;
+    if (compileInParallel) {
+        modules.reserve(mUncachedKernel.size());
+        levels.reserve(mUncachedKernel.size());
+    } else {
+        preparePassManager();
+    }
     mCachedKernel.reserve(mUncachedKernel.size());
     for (auto & kernel : mUncachedKernel) {
         {
@@ -229,23 +277,631 @@ void CPUDriver::generateUncachedKernels() {
             Module * const module = kernel->getModule(); assert (module);
             module->setTargetTriple(mMainModule->getTargetTriple());
             module->setDataLayout(mMainModule->getDataLayout());
-            mPassManager->run(*module);
+            if (LLVM_UNLIKELY(isTieredKernel(kernel.get()))) {
+                compileTierZeroKernel(kernel.get(), module);
+            } else if (compileInParallel) {
+                modules.push_back(module);
+                // must match the optimization level finalizeObject would compile this module with
+                const auto infrequent = kernel->hasAttribute(AttrId::InfrequentlyUsed);
+                levels.push_back(infrequent ? codegen::BackEndOptLevel : CodeGenOpt::Default);
+            } else {
+                mPassManager->run(*module);
+            }
             mCachedKernel.emplace_back(kernel.release());
         }
     }
     mUncachedKernel.clear();
+    if (compileInParallel && !modules.empty()) {
+#if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
+        NamedRegionTimer T("compile", "Kernel Compilation",
+                           "kernel", "Kernel Generation",
+                           codegen::TimeKernelsIsEnabled);
+#else
+        NamedRegionTimer T("Kernel Compilation", "Kernel Generation",
+                           codegen::TimeKernelsIsEnabled);
+#endif
+        compileKernelObjects(modules, levels);
+    }
     #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(5, 0, 0)
     llvm::reportAndResetTimings();
     #endif
     llvm::PrintStatistics();
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief canCompileKernelsInParallel
+ *
+ * Any option that prints or instruments the IR as it is optimized or compiled requires the serial path.
+ ** ------------------------------------------------------------------------------------------------------------- */
+static bool isKernelCompilationObserved() {
+    return codegen::ShowUnoptimizedIROption != codegen::OmittedOption
+        || codegen::ShowIROption != codegen::OmittedOption
+        || codegen::ShowASMOption != codegen::OmittedOption
+        || !codegen::TraceOption.empty();
+}
+
+bool CPUDriver::canCompileKernelsInParallel() const {
+    if (codegen::CompileThreads < 2 || mUncachedKernel.size() < 2) {
+        return false;
+    }
+    return !isKernelCompilationObserved();
+}
+
+namespace {
+
+struct KernelObjectCompilation {
+
+    struct Job {
+        std::string ModuleId;
+        SmallVector<char, 0> Bitcode;
+        CodeGenOpt::Level Level;
+        std::unique_ptr<MemoryBuffer> Object;
+        std::string Error;
+    };
+
+    KernelObjectCompilation(const TargetMachine * const target, const unsigned numOfJobs)
+    : Target(target)
+    , Jobs(numOfJobs)
+    , NextJob(0) {
+
+    }
+
+    void compile(Job & job) const;
+
+    const TargetMachine * const Target;
+    std::vector<Job> Jobs;
+    std::atomic<unsigned> NextJob;
+};
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief writeKernelBitcode
+ ** ------------------------------------------------------------------------------------------------------------- */
+void writeKernelBitcode(const Module * const M, SmallVector<char, 0> & bitcode) {
+    raw_svector_ostream out(bitcode);
+    #if LLVM_VERSION_INTEGER < LLVM_VERSION_CODE(7, 0, 0)
+    WriteBitcodeToFile(M, out);
+    #else
+    WriteBitcodeToFile(*M, out);
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief parseKernelBitcode
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::unique_ptr<Module> parseKernelBitcode(const std::string & moduleId, const SmallVector<char, 0> & bitcode, LLVMContext & C) {
+    auto loaded = parseBitcodeFile(MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), moduleId), C);
+    if (LLVM_UNLIKELY(!loaded)) {
+        #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
+        consumeError(loaded.takeError());
+        #endif
+        return nullptr;
+    }
+    return std::move(loaded.get());
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief compileKernelModule
+ *
+ * Optimize a kernel module that was parsed into a private context and emit it as an object file with a private
+ * copy of the engine's target machine. This produces the same object MCJIT would have.
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::unique_ptr<MemoryBuffer> compileKernelModule(const TargetMachine * const target, Module & M, const CodeGenOpt::Level level, std::string & error) {
+    std::unique_ptr<TargetMachine> TM(target->getTarget().createTargetMachine(
+        target->getTargetTriple().getTriple(), target->getTargetCPU(), target->getTargetFeatureString(),
+        target->Options, target->getRelocationModel(), target->getCodeModel(), level
+        #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(6, 0, 0)
+        , true
+        #endif
+        ));
+    if (LLVM_UNLIKELY(TM == nullptr)) {
+        error = "could not create a target machine for " + M.getModuleIdentifier();
+        return nullptr;
+    }
+    legacy::PassManager PM;
+    if (IN_DEBUG_MODE || LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::VerifyIR))) {
+        PM.add(createVerifierPass());
+    }
+    addOptimizationPasses(PM);
+    SmallVector<char, 0> object;
+    raw_svector_ostream out(object);
+    MCContext * ctx = nullptr;
+    if (LLVM_UNLIKELY(TM->addPassesToEmitMC(PM, ctx, out, !IN_DEBUG_MODE))) {
+        error = "could not add the passes to emit object code for " + M.getModuleIdentifier();
+        return nullptr;
+    }
+    PM.run(M);
+    return MemoryBuffer::getMemBufferCopy(StringRef(object.data(), object.size()), M.getModuleIdentifier());
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief compile
+ ** ------------------------------------------------------------------------------------------------------------- */
+void KernelObjectCompilation::compile(Job & job) const {
+    LLVMContext C;
+    auto M = parseKernelBitcode(job.ModuleId, job.Bitcode, C);
+    if (LLVM_UNLIKELY(M == nullptr)) {
+        job.Error = "could not parse the bitcode of " + job.ModuleId;
+        return;
+    }
+    job.Object = compileKernelModule(Target, *M, job.Level, job.Error);
+}
+
+void * CompileKernelObjectsThreadFunction(void * args) {
+    assert (args);
+    auto & compilation = *reinterpret_cast<KernelObjectCompilation *>(args);
+    const auto n = compilation.Jobs.size();
+    for (;;) {
+        const auto i = compilation.NextJob.fetch_add(1);
+        if (i >= n) break;
+        compilation.compile(compilation.Jobs[i]);
+    }
+    return nullptr;
+}
+
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief compileKernelObjects
+ *
+ * Compile the given modules into object files with a pool of threads; finalizeObject hands the objects to the
+ * execution engine in place of the modules.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::compileKernelObjects(const std::vector<Module *> & modules, const std::vector<CodeGenOpt::Level> & levels) {
+    assert (modules.size() == levels.size());
+    const unsigned n = modules.size();
+    KernelObjectCompilation compilation(mTarget, n);
+    // the shared context is not thread safe so serialize every module before starting any thread
+    for (unsigned i = 0; i < n; ++i) {
+        auto & job = compilation.Jobs[i];
+        Module * const M = modules[i];
+        job.ModuleId = M->getModuleIdentifier();
+        job.Level = levels[i];
+        writeKernelBitcode(M, job.Bitcode);
+    }
+
+    const auto numOfThreads = std::min(std::max(codegen::CompileThreads, 1u), n);
+    std::vector<pthread_t> threads(numOfThreads);
+    for (unsigned i = 1; i < numOfThreads; ++i) {
+        const int rc = pthread_create(&threads[i], nullptr, CompileKernelObjectsThreadFunction, &compilation);
+        if (rc) {
+            report_fatal_error("Failed to create kernel compilation thread: code " + std::to_string(rc));
+        }
+    }
+    // Main thread also does the work;
+    CompileKernelObjectsThreadFunction(&compilation);
+    for (unsigned i = 1; i < numOfThreads; ++i) {
+        void * status = nullptr;
+        const int rc = pthread_join(threads[i], &status);
+        if (rc) {
+            report_fatal_error("Failed to join kernel compilation thread: code " + std::to_string(rc));
+        }
+    }
+
+    for (auto & job : compilation.Jobs) {
+        if (LLVM_UNLIKELY(!job.Error.empty())) {
+            report_fatal_error("Kernel compilation failed: " + job.Error);
+        }
+        mCompiledKernelObjects[job.ModuleId] = std::move(job.Object);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief addCompiledKernelObject
+ *
+ * Add the object compiled for this module by compileKernelObjects (if any) to the execution engine. The object is
+ * reported to the object cache exactly as if the engine itself had compiled the module.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool CPUDriver::addCompiledKernelObject(Module * const module) {
+    const auto f = mCompiledKernelObjects.find(module->getModuleIdentifier());
+    if (f == mCompiledKernelObjects.end()) {
+        return false;
+    }
+    std::unique_ptr<MemoryBuffer> buffer(std::move(f->second));
+    mCompiledKernelObjects.erase(f);
+    if (mObjectCache) {
+        mObjectCache->notifyObjectCompiled(module, buffer->getMemBufferRef());
+    }
+    auto object = object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+    if (LLVM_UNLIKELY(!object)) {
+        report_fatal_error("Compiled kernel " + module->getModuleIdentifier() + " is not a valid object file");
+    }
+    mEngine->addObjectFile(object::OwningBinary<object::ObjectFile>(std::move(object.get()), std::move(buffer)));
+    return true;
+}
+
+namespace {
+
+struct TieredKernelSlot {
+    std::atomic<size_t> Function;
+    std::atomic<size_t> Calls;
+};
+
+// Appended to every symbol a fully optimized kernel object defines so that it can be loaded alongside the
+// quickly compiled one without conflict.
+const auto TIER_ONE_SUFFIX = ".tier1";
+
+// How often the background thread looks for kernels that have become hot.
+const auto TIERED_COMPILATION_POLL_INTERVAL = std::chrono::milliseconds(5);
+
+// The pipelines of each driver receive the slot table of that driver through this symbol, which every engine
+// maps to the table of its own driver.
+const auto TIERED_COMPILATION_SLOTS = "__tiered_compilation_slots";
+
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief TieredKernelSlots
+ *
+ * A slot holds the address of code in the engine of one driver so every driver has its own table. Drivers that
+ * compile the same kernel never share a slot and a driver frees its slots only along with its engine.
+ ** ------------------------------------------------------------------------------------------------------------- */
+struct CPUDriver::TieredKernelSlots {
+
+    TieredKernelSlot * find(const StringRef name) {
+        std::lock_guard<std::mutex> lock(Lock);
+        const auto f = Slots.find(name);
+        return (f == Slots.end()) ? nullptr : f->second.get();
+    }
+
+    std::mutex Lock;
+    StringMap<std::unique_ptr<TieredKernelSlot>> Slots;
+};
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief __tiered_compilation_slot
+ *
+ * Return the slot through which pipelines call the given DoSegment method. The first pipeline to ask for a slot
+ * provides the address of the quickly compiled method; any later one receives the slot as it currently is.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void * __tiered_compilation_slot(void * const table, const char * const name, const size_t function) {
+    assert (table);
+    auto & S = *reinterpret_cast<CPUDriver::TieredKernelSlots *>(table);
+    std::lock_guard<std::mutex> lock(S.Lock);
+    auto & slot = S.Slots[name];
+    if (slot == nullptr) {
+        slot.reset(new TieredKernelSlot);
+        slot->Function.store(function, std::memory_order_release);
+        slot->Calls.store(0, std::memory_order_relaxed);
+    }
+    return slot.get();
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief linkTieredCompilationLibrary
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::linkTieredCompilationLibrary(BuilderRef b) {
+    b->LinkFunction("__tiered_compilation_slot", __tiered_compilation_slot);
+    Module * const m = b->getModule();
+    if (m->getGlobalVariable(TIERED_COMPILATION_SLOTS) == nullptr) {
+        new GlobalVariable(*m, b->getInt8Ty(), false, GlobalValue::ExternalLinkage, nullptr, TIERED_COMPILATION_SLOTS);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief mapTieredKernelSlots
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::mapTieredKernelSlots() {
+    mTieredKernelSlots.reset(new TieredKernelSlots);
+    SmallString<64> mangled;
+    Mangler::getNameWithPrefix(mangled, TIERED_COMPILATION_SLOTS, mMainModule->getDataLayout());
+    mEngine->addGlobalMapping(mangled, reinterpret_cast<uint64_t>(mTieredKernelSlots.get()));
+}
+
+struct CPUDriver::TieredCompilation {
+
+    struct TieredKernel {
+        std::string ModuleId;
+        std::string DoSegmentName;
+        SmallVector<char, 0> Bitcode;
+        bool Promoted;
+        bool Cached;
+    };
+
+    // A program whose manifest is saved once every quickly compiled kernel it depends on has been promoted and
+    // its optimized object is in the object cache. A program with a kernel that never became hot is not saved.
+    struct PendingProgram {
+        std::string Key;
+        std::vector<std::string> ObjectIds;
+        ParabixObjectCache::LinkedFunctions Functions;
+        std::string MainFunctionName;
+    };
+
+    TieredCompilation(CPUDriver & driver)
+    : Driver(driver)
+    , Pending(0)
+    , Stop(false)
+    , HasThread(false) {
+        TierZeroPassManager.add(createPromoteMemoryToRegisterPass());
+        TierZeroPassManager.add(createCFGSimplificationPass());
+        if (LLVM_UNLIKELY(codegen::DebugOptionIsSet(codegen::EnableAsserts))) {
+            TierZeroPassManager.add(createRemoveRedundantAssertionsPass());
+        }
+    }
+
+    static void * threadFunction(void * args);
+
+    void start();
+
+    void stop();
+
+    void run();
+
+    void promote(TieredKernel & kernel, TieredKernelSlot * const slot);
+
+    void cacheObject(TieredKernel & kernel);
+
+    void saveCompletedPrograms();
+
+    CPUDriver & Driver;
+    legacy::PassManager TierZeroPassManager;
+    StringSet<> TierZeroModules;
+    std::vector<std::unique_ptr<TieredKernel>> Kernels;
+    // tier zero modules whose optimized object has yet to be written to the object cache
+    StringSet<> UncachedModules;
+    std::vector<PendingProgram> Programs;
+    std::mutex Lock;
+    std::condition_variable Signal;
+    unsigned Pending;
+    bool Stop;
+    bool HasThread;
+    pthread_t Thread;
+};
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief isTieredKernel
+ *
+ * Must agree with PipelineCompiler::isTieredKernel, except that this driver also knows which kernels are called
+ * directly by an optimization branch rather than through a slot.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool CPUDriver::isTieredKernel(const Kernel * const kernel) const {
+    if (LLVM_LIKELY(!codegen::TieredCompilation) || isKernelCompilationObserved()) {
+        return false;
+    }
+    return !kernel->hasFamilyName()
+        && !isa<PipelineKernel>(kernel)
+        && !isa<OptimizationBranch>(kernel)
+        && !kernel->hasAttribute(AttrId::InfrequentlyUsed)
+        && mDirectlyCalledKernels.count(kernel) == 0;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief compileTierZeroKernel
+ *
+ * Keep the unoptimized IR of the kernel for the background thread and do only the work the kernel requires to be
+ * correct. finalizeObject compiles the module without optimization and without storing it in the object cache;
+ * the background thread stores the optimized object in its place if the kernel is promoted.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::compileTierZeroKernel(const Kernel * const kernel, Module * const module) {
+    if (mTieredCompilation == nullptr) {
+        mTieredCompilation.reset(new TieredCompilation(*this));
+    }
+    std::unique_ptr<TieredCompilation::TieredKernel> tk(new TieredCompilation::TieredKernel);
+    tk->ModuleId = module->getModuleIdentifier();
+    mBuilder->setModule(module);
+    tk->DoSegmentName = kernel->getDoSegmentFunction(mBuilder)->getName().str();
+    mBuilder->setModule(mMainModule);
+    writeKernelBitcode(module, tk->Bitcode);
+    tk->Promoted = false;
+    tk->Cached = (mObjectCache == nullptr);
+    mTieredCompilation->TierZeroPassManager.run(*module);
+    mTieredCompilation->TierZeroModules.insert(tk->ModuleId);
+    std::lock_guard<std::mutex> lock(mTieredCompilation->Lock);
+    if (!tk->Cached) {
+        mTieredCompilation->UncachedModules.insert(tk->ModuleId);
+    }
+    mTieredCompilation->Kernels.emplace_back(std::move(tk));
+    mTieredCompilation->Pending++;
+}
+
+void * CPUDriver::TieredCompilation::threadFunction(void * args) {
+    assert (args);
+    reinterpret_cast<TieredCompilation *>(args)->run();
+    return nullptr;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief start
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::TieredCompilation::start() {
+    std::lock_guard<std::mutex> lock(Lock);
+    if (HasThread) {
+        Signal.notify_all();
+        return;
+    }
+    if (Pending == 0) {
+        return;
+    }
+    const int rc = pthread_create(&Thread, nullptr, threadFunction, this);
+    if (rc) {
+        report_fatal_error("Failed to create tiered compilation thread: code " + std::to_string(rc));
+    }
+    HasThread = true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief stop
+ *
+ * Drop every kernel that has not been promoted so that exiting waits for at most the promotion already under way.
+ * Kernels that never became hot are not written to the object cache; cachewarm, which runs its tools with
+ * -tiered-compilation=0, is the way to fill a cache with the fully optimized objects of a set of pipelines.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::TieredCompilation::stop() {
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+        Stop = true;
+        Pending = 0;
+    }
+    Signal.notify_all();
+    if (HasThread) {
+        void * status = nullptr;
+        const int rc = pthread_join(Thread, &status);
+        if (rc) {
+            report_fatal_error("Failed to join tiered compilation thread: code " + std::to_string(rc));
+        }
+        HasThread = false;
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief run
+ *
+ * Periodically promote the hottest kernel whose slot has recorded at least -tiered-compilation-threshold calls
+ * until every kernel has been promoted or the driver is destroyed.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::TieredCompilation::run() {
+    TieredKernelSlots & slots = *Driver.mTieredKernelSlots;
+    for (;;) {
+        TieredKernel * hottest = nullptr;
+        TieredKernelSlot * hottestSlot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(Lock);
+            if (Pending == 0) {
+                Signal.wait(lock, [this] { return Stop || Pending > 0; });
+            } else {
+                Signal.wait_for(lock, TIERED_COMPILATION_POLL_INTERVAL, [this] { return Stop; });
+            }
+            if (Stop) {
+                break;
+            }
+            size_t maxCalls = std::max(codegen::TieredCompilationThreshold, 1U) - 1;
+            for (const auto & tk : Kernels) {
+                if (tk->Promoted) continue;
+                TieredKernelSlot * const slot = slots.find(tk->DoSegmentName);
+                if (slot == nullptr) continue;
+                const auto calls = slot->Calls.load(std::memory_order_relaxed);
+                if (calls > maxCalls) {
+                    maxCalls = calls;
+                    hottest = tk.get();
+                    hottestSlot = slot;
+                }
+            }
+            if (hottest) {
+                hottest->Promoted = true;
+                Pending--;
+            }
+        }
+        if (hottest) {
+            promote(*hottest, hottestSlot);
+            saveCompletedPrograms();
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief promote
+ *
+ * Compile the kernel at the optimization level it would have had without tiered compilation and switch its slot
+ * to the result. The symbols the new object defines are renamed and its global variables become references to
+ * those of the quickly compiled object so that both versions share any state. The object cache receives an
+ * object compiled from the unmodified module so later runs can load the optimized kernel directly.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::TieredCompilation::promote(TieredKernel & kernel, TieredKernelSlot * const slot) {
+    std::string error;
+    std::unique_ptr<MemoryBuffer> buffer;
+    {
+        LLVMContext C;
+        auto M = parseKernelBitcode(kernel.ModuleId, kernel.Bitcode, C);
+        if (LLVM_UNLIKELY(M == nullptr)) {
+            return;
+        }
+        M->setModuleIdentifier(kernel.ModuleId + TIER_ONE_SUFFIX);
+        for (Function & f : M->functions()) {
+            if (!f.isDeclaration() && !f.hasLocalLinkage()) {
+                f.setName(f.getName() + TIER_ONE_SUFFIX);
+            }
+        }
+        for (GlobalVariable & g : M->globals()) {
+            if (!g.isDeclaration() && !g.hasLocalLinkage() && !g.hasAppendingLinkage()) {
+                g.setInitializer(nullptr);
+                g.setLinkage(GlobalValue::ExternalLinkage);
+                g.setComdat(nullptr);
+            }
+        }
+        buffer = compileKernelModule(Driver.mTarget, *M, CodeGenOpt::Default, error);
+    }
+    if (LLVM_UNLIKELY(buffer == nullptr)) {
+        return;
+    }
+    auto object = object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+    if (LLVM_UNLIKELY(!object)) {
+        #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
+        consumeError(object.takeError());
+        #endif
+        return;
+    }
+    uint64_t doSegment = 0;
+    {
+        std::lock_guard<std::mutex> lock(Driver.mEngineLock);
+        Driver.mEngine->addObjectFile(object::OwningBinary<object::ObjectFile>(std::move(object.get()), std::move(buffer)));
+        Driver.mEngine->finalizeObject();
+        doSegment = Driver.mEngine->getFunctionAddress(kernel.DoSegmentName + TIER_ONE_SUFFIX);
+    }
+    if (LLVM_LIKELY(doSegment != 0)) {
+        slot->Function.store(static_cast<size_t>(doSegment), std::memory_order_release);
+    }
+    cacheObject(kernel);
+    SmallVector<char, 0>().swap(kernel.Bitcode);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief cacheObject
+ *
+ * Write the object the kernel would have had without tiered compilation to the object cache.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::TieredCompilation::cacheObject(TieredKernel & kernel) {
+    if (kernel.Cached) {
+        return;
+    }
+    kernel.Cached = true;
+    if (Driver.mObjectCache) {
+        LLVMContext C;
+        auto M = parseKernelBitcode(kernel.ModuleId, kernel.Bitcode, C);
+        if (LLVM_LIKELY(M != nullptr)) {
+            std::string error;
+            auto cached = compileKernelModule(Driver.mTarget, *M, CodeGenOpt::Default, error);
+            if (LLVM_LIKELY(cached != nullptr)) {
+                Driver.mObjectCache->notifyObjectCompiled(M.get(), cached->getMemBufferRef());
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(Lock);
+    UncachedModules.erase(kernel.ModuleId);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief saveCompletedPrograms
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::TieredCompilation::saveCompletedPrograms() {
+    std::vector<PendingProgram> completed;
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+        for (auto i = Programs.begin(); i != Programs.end(); ) {
+            const auto & ids = i->ObjectIds;
+            const auto uncached = std::find_if(ids.begin(), ids.end(), [this](const std::string & id) {
+                return UncachedModules.count(id) != 0;
+            });
+            if (uncached == ids.end()) {
+                completed.emplace_back(std::move(*i));
+                i = Programs.erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+    for (const auto & program : completed) {
+        Driver.mObjectCache->saveCachedProgram(program.Key, program.ObjectIds, program.Functions, program.MainFunctionName);
+    }
+}
+
 void * CPUDriver::finalizeObject(kernel::Kernel * const pipeline) {
 
     using ModuleSet = llvm::SmallVector<Module *, 32>;
 
+    std::lock_guard<std::mutex> lock(mEngineLock);
+
     ModuleSet Infrequent;
     ModuleSet Normal;
+    ModuleSet TierZero;
 
     for (const auto & kernel : mCompiledKernel) {
         kernel->ensureLoaded();
@@ -257,7 +913,9 @@ void * CPUDriver::finalizeObject(kernel::Kernel * const pipeline) {
         }
         Module * const m = kernel->getModule();
         assert ("cached kernel has no module?" && m);
-        if (LLVM_UNLIKELY(kernel->hasAttribute(AttrId::InfrequentlyUsed))) {
+        if (LLVM_UNLIKELY(mTieredCompilation && mTieredCompilation->TierZeroModules.count(m->getModuleIdentifier()))) {
+            TierZero.emplace_back(m);
+        } else if (LLVM_UNLIKELY(kernel->hasAttribute(AttrId::InfrequentlyUsed))) {
             assert ("pipeline cannot be infrequently compiled" && !isa<PipelineKernel>(kernel));
             Infrequent.emplace_back(m);
         } else {
@@ -265,11 +923,47 @@ void * CPUDriver::finalizeObject(kernel::Kernel * const pipeline) {
         }
     }
 
+    // if this program is to be cached, record every object and linked function it depends on
+    const bool cacheProgram = mObjectCache && codegen::EnableProgramCache && !mProgramCacheKey.empty();
+    std::vector<std::string> programObjects;
+    ParabixObjectCache::LinkedFunctions programFunctions;
+    auto recordProgramModule = [&](const Module * const m) {
+        const auto & moduleId = m->getModuleIdentifier();
+        if (std::find(programObjects.begin(), programObjects.end(), moduleId) != programObjects.end()) {
+            return;
+        }
+        programObjects.emplace_back(moduleId);
+        for (const Function & f : m->getFunctionList()) {
+            if (f.isDeclaration()) {
+                const auto linked = mLinkedFunctions.find(f.getName());
+                if (linked != mLinkedFunctions.end()) {
+                    const auto name = linked->getKey().str();
+                    const auto known = std::find_if(programFunctions.begin(), programFunctions.end(),
+                                                    [&](const ParabixObjectCache::LinkedFunctions::value_type & e) { return e.first == name; });
+                    if (known == programFunctions.end()) {
+                        programFunctions.emplace_back(name, linked->getValue());
+                    }
+                }
+            }
+        }
+    };
+    if (cacheProgram) {
+        for (const auto & kernel : mCompiledKernel) {
+            recordProgramModule(kernel->getModule());
+        }
+        for (const Module * m : TierZero) recordProgramModule(m);
+        for (const Module * m : Infrequent) recordProgramModule(m);
+        for (const Module * m : Normal) recordProgramModule(m);
+    }
+
     auto addModules = [&](const ModuleSet & S, const CodeGenOpt::Level level) {
         if (S.empty()) return;
         mEngine->getTargetMachine()->setOptLevel(level);
         for (Module * M : S) {
-            mEngine->addModule(std::unique_ptr<Module>(M));
+            mLoadedProgramObjects.insert(M->getModuleIdentifier());
+            if (!addCompiledKernelObject(M)) {
+                mEngine->addModule(std::unique_ptr<Module>(M));
+            }
         }
         mEngine->finalizeObject();
     };
@@ -280,7 +974,14 @@ void * CPUDriver::finalizeObject(kernel::Kernel * const pipeline) {
         }
     };
 
-    // compile any uncompiled kernels
+    // compile any uncompiled kernels; a quickly compiled kernel must never be mistaken for the cached one
+    if (LLVM_UNLIKELY(!TierZero.empty())) {
+        mEngine->setObjectCache(nullptr);
+        addModules(TierZero, CodeGenOpt::None);
+        if (mObjectCache) {
+            mEngine->setObjectCache(mObjectCache.get());
+        }
+    }
     addModules(Infrequent, codegen::BackEndOptLevel);
     addModules(Normal, CodeGenOpt::Default);
 
@@ -288,11 +989,20 @@ void * CPUDriver::finalizeObject(kernel::Kernel * const pipeline) {
     auto mainModule = std::make_unique<Module>("main", *mContext);
     mainModule->setTargetTriple(mMainModule->getTargetTriple());
     mainModule->setDataLayout(mMainModule->getDataLayout());
+    if (cacheProgram) {
+        mObjectCache->prepareProgramModule(mainModule.get(), mProgramCacheKey);
+    }
     mBuilder->setModule(mainModule.get());
     pipeline->addKernelDeclarations(mBuilder);
     const auto method = pipeline->externallyInitialized() ? Kernel::AddInternal : Kernel::DeclareExternal;
     Function * const main = pipeline->addOrDeclareMainFunction(mBuilder, method);
+    if (method == Kernel::AddInternal && pipeline->hasReusableInstance()) {
+        pipeline->addInstanceFunctions(mBuilder, method);
+    }
     mBuilder->setModule(mMainModule);
+    if (cacheProgram) {
+        recordProgramModule(mainModule.get());
+    }
 
     // NOTE: the pipeline kernel is destructed after calling clear unless this driver preserves kernels!
     if (getPreservesKernels()) {
@@ -309,20 +1019,135 @@ void * CPUDriver::finalizeObject(kernel::Kernel * const pipeline) {
     mCompiledKernel.clear();
 
     // return the compiled main method
+    const std::string mainName = main->getName().str();
     mEngine->getTargetMachine()->setOptLevel(CodeGenOpt::None);
     mEngine->addModule(std::move(mainModule));
     mEngine->finalizeObject();
-    auto mainFnPtr = mEngine->getFunctionAddress(main->getName());
+    auto mainFnPtr = mEngine->getFunctionAddress(mainName);
+    recordInstanceMethods(mainName, reinterpret_cast<void *>(mainFnPtr));
     removeModules(Normal);
     removeModules(Infrequent);
+    removeModules(TierZero);
+    if (cacheProgram) {
+        // a program that depends on a quickly compiled kernel is saved once that kernel is promoted and cached
+        bool deferred = false;
+        if (LLVM_UNLIKELY(mTieredCompilation != nullptr)) {
+            std::lock_guard<std::mutex> lock(mTieredCompilation->Lock);
+            const auto & uncached = mTieredCompilation->UncachedModules;
+            for (const auto & id : programObjects) {
+                if (uncached.count(id)) {
+                    deferred = true;
+                    break;
+                }
+            }
+            if (deferred) {
+                TieredCompilation::PendingProgram program;
+                program.Key = mProgramCacheKey;
+                program.ObjectIds = std::move(programObjects);
+                program.Functions = std::move(programFunctions);
+                program.MainFunctionName = mainName;
+                mTieredCompilation->Programs.emplace_back(std::move(program));
+            }
+        }
+        if (!deferred) {
+            mObjectCache->saveCachedProgram(mProgramCacheKey, programObjects, programFunctions, mainName);
+        }
+    }
+    if (LLVM_UNLIKELY(mTieredCompilation != nullptr)) {
+        mTieredCompilation->start();
+    }
+    mProgramCacheKey.clear();
     return reinterpret_cast<void *>(mainFnPtr);
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief loadCachedProgram
+ *
+ * Load every object of a cached program directly into the execution engine. Objects already loaded by an earlier
+ * program of this driver are shared rather than loaded twice.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void * CPUDriver::loadCachedProgram(const llvm::StringRef programKey) {
+    if (LLVM_UNLIKELY(mObjectCache == nullptr || !codegen::EnableProgramCache)) {
+        return nullptr;
+    }
+    const auto key = makeProgramCacheKey(programKey);
+    std::lock_guard<std::mutex> lock(mEngineLock);
+    ParabixObjectCache::CachedProgram program;
+    if (!mObjectCache->loadCachedProgram(key, program)) {
+        return nullptr;
+    }
+    // parse every object before touching the engine so that a corrupt cache entry is simply a cache miss
+    std::vector<object::OwningBinary<object::ObjectFile>> objects;
+    objects.reserve(program.Objects.size());
+    for (unsigned i = 0; i < program.Objects.size(); ++i) {
+        if (mLoadedProgramObjects.count(program.ObjectIds[i])) {
+            continue;
+        }
+        auto & buffer = program.Objects[i];
+        auto object = object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+        if (LLVM_UNLIKELY(!object)) {
+            #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
+            consumeError(object.takeError());
+            #endif
+            if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+                errs() << "Cached object " << program.ObjectIds[i] << " is not a valid object file\n";
+            }
+            return nullptr;
+        }
+        objects.emplace_back(std::move(object.get()), std::move(buffer));
+    }
+    const DataLayout DL(mMainModule->getDataLayout());
+    for (const auto & linked : program.Functions) {
+        SmallString<64> mangled;
+        Mangler::getNameWithPrefix(mangled, linked.first, DL);
+        mEngine->addGlobalMapping(mangled, reinterpret_cast<uint64_t>(linked.second));
+        mLinkedFunctions[linked.first] = linked.second;
+    }
+    for (const auto & objectId : program.ObjectIds) {
+        mLoadedProgramObjects.insert(objectId);
+    }
+    for (auto & object : objects) {
+        mEngine->addObjectFile(std::move(object));
+    }
+    mEngine->getTargetMachine()->setOptLevel(CodeGenOpt::None);
+    mEngine->finalizeObject();
+    void * const mainFnPtr = reinterpret_cast<void *>(mEngine->getFunctionAddress(program.MainFunctionName));
+    recordInstanceMethods(program.MainFunctionName, mainFnPtr);
+    return mainFnPtr;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief recordInstanceMethods
+ *
+ * Look up the instance functions that accompany the given main method, if any, so that they can be returned by
+ * getInstanceMethods. A program cached before they existed simply has none.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void CPUDriver::recordInstanceMethods(const StringRef mainName, void * const mainMethod) {
+    if (LLVM_UNLIKELY(mainMethod == nullptr || !mainName.endswith("_main"))) {
+        return;
+    }
+    const auto prefix = mainName.drop_back(5).str();
+    auto lookup = [&](const char * suffix) {
+        return reinterpret_cast<void *>(mEngine->getFunctionAddress(prefix + suffix));
+    };
+    InstanceMethods methods;
+    methods.Create = lookup("_create");
+    methods.Reset = lookup("_reset");
+    methods.Run = lookup("_run");
+    methods.Destroy = lookup("_destroy");
+    if (methods.Create && methods.Reset && methods.Run && methods.Destroy) {
+        mInstanceMethods[mainMethod] = methods;
+    }
+}
+
 bool CPUDriver::hasExternalFunction(llvm::StringRef functionName) const {
     return RTDyldMemoryManager::getSymbolAddressInProcess(functionName);
 }
 
 CPUDriver::~CPUDriver() {
+    if (mTieredCompilation) {
+        mTieredCompilation->stop();
+    }
     #ifndef ORCJIT
     delete mEngine;
     #endif
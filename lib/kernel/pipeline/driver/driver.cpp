@@ -4,8 +4,15 @@
 #include <kernel/pipeline/pipeline_builder.h>
 #include <llvm/IR/Module.h>
 #include <toolchain/toolchain.h>
+#include <toolchain/pablo_toolchain.h>
+#include <re/toolchain/toolchain.h>
 #include <objcache/object_cache.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/Host.h>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
 
 using namespace kernel;
 
@@ -102,6 +109,229 @@ void BaseDriver::addKernel(not_null<Kernel *> kernel) {
 
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief removeKernel
+ ** ------------------------------------------------------------------------------------------------------------- */
+void BaseDriver::removeKernel(not_null<Kernel *> kernel) {
+    for (KernelSet * const set : {&mUncachedKernel, &mCachedKernel, &mCompiledKernel}) {
+        for (auto i = set->begin(); i != set->end(); ++i) {
+            if (i->get() == kernel.get()) {
+                mPreservedKernel.emplace_back(i->release());
+                set->erase(i);
+                return;
+            }
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief loadCachedProgram
+ *
+ * Return the main method of a previously compiled program with the given key or nullptr if none is available.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void * BaseDriver::loadCachedProgram(const llvm::StringRef /* programKey */) {
+    return nullptr;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getInstanceMethods
+ ** ------------------------------------------------------------------------------------------------------------- */
+BaseDriver::InstanceMethods BaseDriver::getInstanceMethods(const void * const mainMethod) const {
+    const auto f = mInstanceMethods.find(mainMethod);
+    if (f == mInstanceMethods.end()) {
+        return InstanceMethods{};
+    }
+    return f->second;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief makeProgramCacheKey
+ *
+ * A program key supplied by the client only describes what the program computes; any code generation option that
+ * could change the resulting objects must be added to it as well.
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::string BaseDriver::makeProgramCacheKey(const llvm::StringRef programKey) const {
+    std::string key;
+    llvm::raw_string_ostream out(key);
+    out << programKey
+        << "|" << mBuilder->getBuilderUniqueName()
+        << "|I" << codegen::getISATargetName()
+        << "|O" << codegen::OptLevel << codegen::BackEndOptLevel
+        << "|S" << codegen::SegmentSize
+        << "|B" << codegen::BufferSegments
+        << "|R" << codegen::MaxRetainedBufferSize
+        << "|T" << codegen::SegmentThreads
+        << "|W" << codegen::BlockingSynchronization
+        << "|L" << (codegen::KernelTimelineOption != codegen::OmittedOption)
+        << "|F" << codegen::KernelFusion
+        << "|N" << codegen::ScanBlocks
+        << "|C" << codegen::CCCOption
+        << "|D";
+    for (unsigned i = 0; i < codegen::DebugFlagSentinel; ++i) {
+        out << (codegen::DebugOptionIsSet(static_cast<codegen::DebugFlags>(i)) ? '1' : '0');
+    }
+    // pablo and regular expression compilation options change the kernels built by any tool that uses them
+    out << "|P";
+    for (unsigned i = pablo::Flatten; i <= pablo::EnableTernaryOpt; ++i) {
+        out << (pablo::CompileOptionIsSet(static_cast<pablo::PabloCompilationFlags>(i)) ? '1' : '0');
+    }
+    out << (pablo::DebugOptionIsSet(pablo::DumpTrace) ? '1' : '0')
+        << static_cast<unsigned>(pablo::CarryMode)
+        << "|X";
+    for (unsigned i = re::DisableLog2BoundedRepetition; i <= re::DisableMatchStar; ++i) {
+        out << (re::AlgorithmOptionIsSet(static_cast<re::RE_AlgorithmFlags>(i)) ? '1' : '0');
+    }
+    out << re::UnicodeLevel2IsSet() << "," << re::IfInsertionGap;
+    out.flush();
+    return key;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getCacheSizes
+ *
+ * Read the size of the L2 and last level data caches of the first CPU from sysfs.
+ ** ------------------------------------------------------------------------------------------------------------- */
+inline void getCacheSizes(size_t & l2CacheSize, size_t & lastLevelCacheSize) {
+    l2CacheSize = 256 * 1024;
+    lastLevelCacheSize = 8 * 1024 * 1024;
+    unsigned lastLevel = 0;
+    for (unsigned i = 0; ; ++i) {
+        const std::string index = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i) + "/";
+        std::ifstream levelFile(index + "level");
+        if (!levelFile) {
+            break;
+        }
+        unsigned level = 0;
+        std::string type;
+        size_t size = 0;
+        char unit = 0;
+        levelFile >> level;
+        std::ifstream(index + "type") >> type;
+        std::ifstream(index + "size") >> size >> unit;
+        if (unit == 'K') {
+            size *= 1024;
+        } else if (unit == 'M') {
+            size *= 1024 * 1024;
+        }
+        if (type == "Instruction" || size == 0) {
+            continue;
+        }
+        if (level == 2) {
+            l2CacheSize = size;
+        }
+        if (level >= lastLevel) {
+            lastLevel = level;
+            lastLevelCacheSize = size;
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief tuneSegmentSize
+ *
+ * A segment of a pipeline keeps many streams live at once, each a fraction of the segment size, so the candidate
+ * segment sizes are powers of two between 1/64th and 1/8th of the L2 cache, limited so that the segments of every
+ * segment thread still fit in the last level cache. The number of buffer segments is then tuned at the fastest
+ * segment size. The choice is recorded per program, code generation options and host. A sample that does not
+ * fill MinCalibrationSegments of the largest candidate per segment thread would mostly time the start up and
+ * termination of the pipeline, so no setting is chosen or recorded for it.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool BaseDriver::tuneSegmentSize(const llvm::StringRef programKey, const size_t sampleSize, const std::function<double ()> & calibrate) {
+
+    std::string key;
+    llvm::raw_string_ostream out(key);
+    char hostName[256] = {0};
+    gethostname(hostName, sizeof(hostName) - 1);
+    out << "tune:" << programKey
+        << "|" << mBuilder->getBuilderUniqueName()
+        << "|I" << codegen::getISATargetName()
+        << "|O" << codegen::OptLevel << codegen::BackEndOptLevel
+        << "|T" << codegen::SegmentThreads
+        << "|F" << codegen::KernelFusion
+        << "|H" << hostName << "," << llvm::sys::getHostCPUName() << "," << std::thread::hardware_concurrency();
+    out.flush();
+
+    unsigned segmentSize = 0, bufferSegments = 0;
+    if (mObjectCache && mObjectCache->loadSegmentTuning(key, segmentSize, bufferSegments)) {
+        codegen::SegmentSize = segmentSize;
+        codegen::BufferSegments = bufferSegments;
+        return true;
+    }
+
+    size_t l2CacheSize = 0, lastLevelCacheSize = 0;
+    getCacheSizes(l2CacheSize, lastLevelCacheSize);
+    const size_t MinSegmentSize = 4096;
+    const size_t maxSegmentSize = std::max<size_t>(MinSegmentSize, lastLevelCacheSize / (8 * std::max(codegen::SegmentThreads, 1u)));
+    std::vector<unsigned> segmentSizes;
+    for (size_t divisor = 64; divisor >= 8; divisor /= 2) {
+        size_t size = MinSegmentSize;
+        while (size * 2 <= std::min(l2CacheSize / divisor, maxSegmentSize)) {
+            size *= 2;
+        }
+        segmentSizes.push_back(size);
+    }
+    segmentSizes.push_back(codegen::SegmentSize);
+    std::sort(segmentSizes.begin(), segmentSizes.end());
+    segmentSizes.erase(std::unique(segmentSizes.begin(), segmentSizes.end()), segmentSizes.end());
+
+    const size_t MinCalibrationSegments = 4;
+    if (sampleSize < MinCalibrationSegments * segmentSizes.back() * std::max(codegen::SegmentThreads, 1u)) {
+        if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+            llvm::errs() << "Segment tuning: " << sampleSize << " byte sample is too small\n";
+        }
+        return false;
+    }
+
+    const auto initialSegmentSize = codegen::SegmentSize;
+    const auto initialBufferSegments = codegen::BufferSegments;
+    auto restore = [&]() {
+        codegen::SegmentSize = initialSegmentSize;
+        codegen::BufferSegments = initialBufferSegments;
+        return false;
+    };
+
+    double bestTime = 0;
+    unsigned bestSegmentSize = initialSegmentSize;
+    unsigned bestBufferSegments = initialBufferSegments;
+    auto measure = [&](const unsigned segmentSize, const unsigned bufferSegments) {
+        codegen::SegmentSize = segmentSize;
+        codegen::BufferSegments = bufferSegments;
+        const auto elapsed = calibrate();
+        if (LLVM_UNLIKELY(elapsed < 0)) {
+            return false;
+        }
+        if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+            llvm::errs() << "Segment tuning: segment-size=" << segmentSize << " buffer-segments=" << bufferSegments
+                         << " " << elapsed << "s\n";
+        }
+        if (bestTime == 0 || elapsed < bestTime) {
+            bestTime = elapsed;
+            bestSegmentSize = segmentSize;
+            bestBufferSegments = bufferSegments;
+        }
+        return true;
+    };
+
+    for (const auto size : segmentSizes) {
+        if (LLVM_UNLIKELY(!measure(size, initialBufferSegments))) {
+            return restore();
+        }
+    }
+    const auto tunedSegmentSize = bestSegmentSize;
+    for (const unsigned segments : {1u, 2u, 4u}) {
+        if (segments != initialBufferSegments && LLVM_UNLIKELY(!measure(tunedSegmentSize, segments))) {
+            return restore();
+        }
+    }
+
+    codegen::SegmentSize = bestSegmentSize;
+    codegen::BufferSegments = bestBufferSegments;
+    if (mObjectCache) {
+        mObjectCache->saveSegmentTuning(key, bestSegmentSize, bestBufferSegments);
+    }
+    return true;
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief constructor
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -2,6 +2,7 @@
 #include <kernel/pipeline/optimizationbranch.h>
 #include <kernel/core/kernel_builder.h>
 #include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
 #include <boost/function_output_iterator.hpp>
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/topological_sort.hpp>
@@ -53,6 +54,9 @@ void * ProgramBuilder::compile() {
 void * ProgramBuilder::compileKernel(Kernel * const kernel) {
     mDriver.addKernel(kernel);
     mDriver.generateUncachedKernels();
+    if (!mProgramCacheKey.empty()) {
+        mDriver.mProgramCacheKey = mDriver.makeProgramCacheKey(mProgramCacheKey);
+    }
     return mDriver.finalizeObject(kernel);
 }
 
@@ -143,11 +147,149 @@ void addKernelProperties(const std::vector<Kernel *> & kernels, Kernel * const o
     output->setStride(stride);
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief fuseKernels
+ *
+ * Replace each run of adjacent fusable kernels, in which every kernel after the first consumes a stream set
+ * produced by an earlier one, with a single fused kernel. A kernel is only fused if every stream set it consumes
+ * is produced by a prior kernel or is an input to the pipeline; since the run is contiguous, no kernel outside of
+ * it can both depend on a kernel in the run and produce an input of one. A stream set produced within the run is
+ * only an output of the fused kernel if it is consumed outside of the run or is an output of the pipeline.
+ * The kernels of a run are withdrawn from the driver so that only the fused kernel is compiled.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void fuseKernels(BaseDriver & driver, Kernels & kernels, const Bindings & pipelineOutputs) {
+
+    const auto n = kernels.size();
+
+    flat_map<const Relationship *, unsigned> producer;
+    flat_map<const Relationship *, std::vector<unsigned>> consumers;
+    for (unsigned i = 0; i < n; ++i) {
+        const Kernel * const kernel = kernels[i];
+        for (const Binding & output : kernel->getOutputStreamSetBindings()) {
+            producer.emplace(output.getRelationship(), i);
+        }
+        for (const Binding & input : kernel->getInputStreamSetBindings()) {
+            consumers[input.getRelationship()].push_back(i);
+        }
+        if (LLVM_UNLIKELY(isa<OptimizationBranch>(kernel))) {
+            consumers[cast<OptimizationBranch>(kernel)->getCondition()].push_back(i);
+        }
+    }
+
+    auto isFusable = [&](const unsigned i) {
+        const Kernel * const kernel = kernels[i];
+        if (!kernel->isFusable()) {
+            return false;
+        }
+        for (const Binding & input : kernel->getInputStreamSetBindings()) {
+            const auto f = producer.find(input.getRelationship());
+            if (f != producer.end() && f->second >= i) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto consumesFrom = [&](const unsigned i, const unsigned first) {
+        for (const Binding & input : kernels[i]->getInputStreamSetBindings()) {
+            const auto f = producer.find(input.getRelationship());
+            if (f != producer.end() && f->second >= first) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto isUsedOutside = [&](const Relationship * const rel, const unsigned first, const unsigned last) {
+        for (const Binding & output : pipelineOutputs) {
+            if (output.getRelationship() == rel) {
+                return true;
+            }
+        }
+        const auto f = consumers.find(rel);
+        if (f != consumers.end()) {
+            for (const auto i : f->second) {
+                if (i < first || i > last) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    auto makeFusedName = [](const unsigned j, const Binding & binding) {
+        return "K" + std::to_string(j) + "_" + binding.getName();
+    };
+
+    Kernels fused;
+    fused.reserve(n);
+    std::vector<Kernel *> run;
+    unsigned first = 0;
+
+    auto fuseRun = [&]() {
+        if (run.size() > 1) {
+            const auto last = first + run.size() - 1;
+            Bindings inputs;
+            Bindings outputs;
+            flat_set<const Relationship *> added;
+            for (unsigned j = 0; j < run.size(); ++j) {
+                for (const Binding & input : run[j]->getInputStreamSetBindings()) {
+                    Relationship * const rel = input.getRelationship();
+                    const auto f = producer.find(rel);
+                    if ((f == producer.end() || f->second < first) && added.insert(rel).second) {
+                        inputs.emplace_back(makeFusedName(j, input), rel);
+                    }
+                }
+            }
+            for (unsigned j = 0; j < run.size(); ++j) {
+                for (const Binding & output : run[j]->getOutputStreamSetBindings()) {
+                    Relationship * const rel = output.getRelationship();
+                    if (isUsedOutside(rel, first, last)) {
+                        outputs.emplace_back(makeFusedName(j, output), rel);
+                    }
+                }
+            }
+            Kernel * const kernel = run.front()->makeFusedKernel(driver.getBuilder(), std::vector<Kernel *>(run),
+                                                                 std::move(inputs), std::move(outputs));
+            for (Kernel * const replaced : run) {
+                driver.removeKernel(replaced);
+            }
+            driver.addKernel(kernel);
+            fused.push_back(kernel);
+        } else {
+            fused.insert(fused.end(), run.begin(), run.end());
+        }
+        run.clear();
+    };
+
+    for (unsigned i = 0; i < n; ++i) {
+        Kernel * const kernel = kernels[i];
+        if (isFusable(i)) {
+            if (!run.empty() && (kernel->getStride() != run.front()->getStride() || !consumesFrom(i, first))) {
+                fuseRun();
+            }
+            if (run.empty()) {
+                first = i;
+            }
+            run.push_back(kernel);
+        } else {
+            fuseRun();
+            fused.push_back(kernel);
+        }
+    }
+    fuseRun();
+
+    kernels.swap(fused);
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief makeKernel
  ** ------------------------------------------------------------------------------------------------------------- */
 Kernel * PipelineBuilder::makeKernel() {
 
+    if (LLVM_UNLIKELY(codegen::KernelFusion)) {
+        fuseKernels(mDriver, mKernels, mOutputStreamSets);
+    }
     mDriver.generateUncachedKernels();
     for (const auto & builder : mNestedBuilders) {
         Kernel * const kernel = builder->makeKernel();
@@ -313,9 +455,19 @@ Kernel * PipelineBuilder::makeKernel() {
     if (mExternallySynchronized) {
         out << 'E';
     }
+    out << 'R' << codegen::MaxRetainedBufferSize;
+    if (mBlockingSynchronization && (mNumOfThreads > 1 || mExternallySynchronized)) {
+        out << 'W';
+    }
     if (LLVM_UNLIKELY(DebugOptionIsSet(codegen::EnableCycleCounter))) {
         out << "+CYC";
     }
+    if (LLVM_UNLIKELY(codegen::KernelTimelineOption != codegen::OmittedOption)) {
+        out << "+TL";
+    }
+    if (LLVM_UNLIKELY(codegen::TieredCompilation)) {
+        out << "+TC";
+    }
     if (LLVM_UNLIKELY(DebugOptionIsSet(codegen::EnableBlockingIOCounter))) {
         out << "+BIC";
     }
@@ -325,6 +477,9 @@ Kernel * PipelineBuilder::makeKernel() {
     if (LLVM_UNLIKELY(DebugOptionIsSet(codegen::TraceStridesPerSegment))) {
         out << "+SS";
     }
+    if (LLVM_UNLIKELY(DebugOptionIsSet(codegen::DisableMirroredBuffers))) {
+        out << "+NMB";
+    }
     #ifdef ENABLE_PAPI
     if (LLVM_UNLIKELY(codegen::PapiCounterOptions != codegen::OmittedOption)) {
         out << "+PAPI:" << codegen::PapiCounterOptions;
@@ -362,6 +517,9 @@ Kernel * PipelineBuilder::makeKernel() {
     if (mExternallySynchronized) {
         pipeline->addAttribute(InternallySynchronized());
     }
+    if (mBlockingSynchronization && (mNumOfThreads > 1 || mExternallySynchronized)) {
+        pipeline->addAttribute(BlockingSynchronization());
+    }
 
     addKernelProperties(pipeline->getKernels(), pipeline);
 
@@ -480,6 +638,7 @@ PipelineBuilder::PipelineBuilder(BaseDriver & driver,
     const unsigned numOfThreads)
 : mDriver(driver)
 , mNumOfThreads(numOfThreads)
+, mBlockingSynchronization(codegen::BlockingSynchronization)
 , mInputStreamSets(stream_inputs)
 , mOutputStreamSets(stream_outputs)
 , mInputScalars(scalar_inputs)
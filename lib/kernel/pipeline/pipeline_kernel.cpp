@@ -1,4 +1,5 @@
 #include <kernel/pipeline/pipeline_kernel.h>
+#include <kernel/pipeline/driver/cpudriver.h>
 
 // #define USE_2020_PIPELINE_COMPILER
 
@@ -60,6 +61,53 @@ void PipelineKernel::generateFinalizeThreadLocalMethod(BuilderRef b) {
     COMPILER->generateFinalizeThreadLocalMethod(b);
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief hasReusableInstance
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool PipelineKernel::hasReusableInstance() const {
+    #ifdef USE_2020_PIPELINE_COMPILER
+    return false;
+    #else
+    if (!isStateful() || hasAttribute(AttrId::InternallySynchronized)) {
+        return false;
+    }
+    // the instances of any nested kernels constructed by the host are kept from one run to the next
+    for (const Kernel * const kernel : mKernels) {
+        if (kernel->externallyInitialized() && kernel->isStateful() && !kernel->hasReusableInstance()) {
+            return false;
+        }
+    }
+    return true;
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generateRearmMethod
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineKernel::generateRearmMethod(BuilderRef b) {
+    #ifndef USE_2020_PIPELINE_COMPILER
+    COMPILER->generateRearmMethod(b);
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generateFinalizeRunMethod
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineKernel::generateFinalizeRunMethod(BuilderRef b) {
+    #ifndef USE_2020_PIPELINE_COMPILER
+    COMPILER->generateFinalizeRunMethod(b);
+    #endif
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generateReleaseMethod
+ ** ------------------------------------------------------------------------------------------------------------- */
+void PipelineKernel::generateReleaseMethod(BuilderRef b) {
+    #ifndef USE_2020_PIPELINE_COMPILER
+    COMPILER->generateReleaseMethod(b);
+    #endif
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief addKernelDeclarations
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -100,6 +148,19 @@ void PipelineKernel::generateAllocateThreadLocalInternalStreamSetsMethod(Builder
  ** ------------------------------------------------------------------------------------------------------------- */
 void PipelineKernel::linkExternalMethods(BuilderRef b) {
     PipelineCompiler::linkPThreadLibrary(b);
+    DynamicBuffer::linkFunctions(b);
+    MirroredBuffer::linkFunctions(b);
+    #ifndef USE_2020_PIPELINE_COMPILER
+    if (LLVM_UNLIKELY(hasAttribute(AttrId::BlockingSynchronization))) {
+        PipelineCompiler::linkBlockingSynchronizationLibrary(b);
+    }
+    if (LLVM_UNLIKELY(codegen::KernelTimelineOption != codegen::OmittedOption)) {
+        PipelineCompiler::linkKernelTimelineLibrary(b);
+    }
+    if (LLVM_UNLIKELY(codegen::TieredCompilation)) {
+        CPUDriver::linkTieredCompilationLibrary(b);
+    }
+    #endif
     for (const auto & k : mKernels) {
         k->linkExternalMethods(b);
     }
@@ -121,6 +182,9 @@ void PipelineKernel::addAdditionalFunctions(BuilderRef b) {
         return;
     }
     addOrDeclareMainFunction(b, Kernel::AddExternal);
+    if (hasReusableInstance()) {
+        addInstanceFunctions(b, Kernel::AddExternal);
+    }
 }
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -154,6 +218,9 @@ void PipelineKernel::addFamilyInitializationArgTypes(BuilderRef b, InitArgTypes
                 const auto tl = kernel->hasThreadLocal();
                 const auto k2 = tl ? (k1 * 2U) : k1;
                 n += k2;
+                if (kernel->hasReusableInstance()) {
+                    n += 3;
+                }
             }
         }
     }
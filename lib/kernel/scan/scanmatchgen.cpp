@@ -691,14 +691,28 @@ ScanBatchKernel::ScanBatchKernel(BuilderRef b, StreamSet * const Matches, Stream
 
 
 
-enum MatchCoordinatesEnum {LINE_STARTS = 0, LINE_ENDS = 1, LINE_NUMBERS = 2};
+enum MatchCoordinatesEnum {LINE_STARTS = 0, LINE_ENDS = 1, LINE_NUMBERS = 2, LINE_OFFSETS = 3};
+
+Bindings makeCoordinateInputBindings(StreamSet * const Matches, StreamSet * const LineBreakStream, StreamSet * const CRLF_LineFeeds) {
+    Bindings inputs{Binding{"matchResult", Matches}, Binding{"lineBreak", LineBreakStream, FixedRate(1), ZeroExtended()}};
+    if (CRLF_LineFeeds) {
+        inputs.emplace_back("CRLF", CRLF_LineFeeds, FixedRate(1), ZeroExtended());
+    }
+    return inputs;
+}
+
+std::string CoordinatesAnnotation(StreamSet * const Coordinates, StreamSet * const CRLF_LineFeeds) {
+    if (Coordinates->getNumElements() == 3) return "";
+    return CRLF_LineFeeds ? "offsetU" : "offset";
+}
 
 MatchCoordinatesKernel::MatchCoordinatesKernel(BuilderRef b,
                                                StreamSet * const Matches, StreamSet * const LineBreakStream,
-                                               StreamSet * const Coordinates, unsigned strideBlocks)
-: MultiBlockKernel(b, "matchCoordinates" + std::to_string(strideBlocks),
+                                               StreamSet * const Coordinates, unsigned strideBlocks,
+                                               StreamSet * const CRLF_LineFeeds)
+: MultiBlockKernel(b, "matchCoordinates" + std::to_string(strideBlocks) + CoordinatesAnnotation(Coordinates, CRLF_LineFeeds),
 // inputs
-{Binding{"matchResult", Matches}, Binding{"lineBreak", LineBreakStream, FixedRate(1), ZeroExtended()}},
+makeCoordinateInputBindings(Matches, LineBreakStream, CRLF_LineFeeds),
 // outputs
 {Binding{"Coordinates", Coordinates, PopcountOf("matchResult")}},
 // input scalars
@@ -707,12 +721,16 @@ MatchCoordinatesKernel::MatchCoordinatesKernel(BuilderRef b,
 {},
 // kernel state
 {InternalScalar{b->getSizeTy(), "LineNum"},
- InternalScalar{b->getSizeTy(), "LineStart"}}) {
+ InternalScalar{b->getSizeTy(), "LineStart"},
+ InternalScalar{b->getSizeTy(), "CRLFCount"}})
+, mLineOffsets(Coordinates->getNumElements() == 4)
+, mAdjustCRLF(mLineOffsets && (CRLF_LineFeeds != nullptr)) {
      // The stride size must be limited so that the scanword mask is a single size_t value.
      setStride(std::min(b->getBitBlockWidth() * strideBlocks, SIZE_T_BITS * SIZE_T_BITS));
      assert (Matches->getNumElements() == 1);
      assert (LineBreakStream->getNumElements() == 1);
-     assert (Coordinates->getNumElements() == 3);
+     assert ((Coordinates->getNumElements() == 3) || (Coordinates->getNumElements() == 4));
+     assert ((CRLF_LineFeeds == nullptr) || (CRLF_LineFeeds->getNumElements() == 1));
 }
 
 void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const numOfStrides) {
@@ -751,6 +769,18 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         // Bitcast the lineNumberArrayptr to access by scanWord number
         lineCountArrayWordPtr = b->CreateBitCast(lineCountArrayBlockPtr, sw.pointerTy);
     }
+    // The CRs of CRLF line ends preceding a line start are counted in the same
+    // way as line breaks, so that they may be excluded from the line offset.
+    Value * initialCRLFCount = nullptr;
+    Value * crlfCountArrayBlockPtr = nullptr;
+    Value * crlfCountArrayWordPtr = nullptr;
+    if (mAdjustCRLF) {
+        initialCRLFCount = b->getScalarField("CRLFCount");
+        crlfCountArrayBlockPtr = b->CreateAlignedAlloca(b->getBitBlockType(),
+                                                        b->getBitBlockWidth()/BITS_PER_BYTE,
+                                                        sz_BLOCKS_PER_STRIDE);
+        crlfCountArrayWordPtr = b->CreateBitCast(crlfCountArrayBlockPtr, sw.pointerTy);
+    }
     Value * const initialMatchCount = b->getProducedItemCount("Coordinates");
     b->CreateBr(stridePrologue);
 
@@ -767,6 +797,11 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         pendingLineNum = b->CreatePHI(sizeTy, 2);
         pendingLineNum->addIncoming(initialLineNum, entryBlock);
     }
+    PHINode * pendingCRLFCount = nullptr;
+    if (mAdjustCRLF) {
+        pendingCRLFCount = b->CreatePHI(sizeTy, 2);
+        pendingCRLFCount->addIncoming(initialCRLFCount, entryBlock);
+    }
     Value * stridePos = b->CreateAdd(initialPos, b->CreateMul(strideNo, sz_STRIDE));
     Value * strideBlockOffset = b->CreateMul(strideNo, sz_BLOCKS_PER_STRIDE);
     Value * nextStrideNo = b->CreateAdd(strideNo, sz_ONE);
@@ -785,6 +820,11 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         baseCounts = b->CreatePHI(b->getBitBlockType(), 2);
         baseCounts->addIncoming(b->allZeroes(), stridePrologue);
     }
+    PHINode * crlfBaseCounts = nullptr;
+    if (mAdjustCRLF) {
+        crlfBaseCounts = b->CreatePHI(b->getBitBlockType(), 2);
+        crlfBaseCounts->addIncoming(b->allZeroes(), stridePrologue);
+    }
     Value * strideBlockIndex = b->CreateAdd(strideBlockOffset, blockNo);
     Value * matchBitBlock = b->loadInputStreamBlock("matchResult", sz_ZERO, strideBlockIndex);
     Value * breakBitBlock = b->loadInputStreamBlock("lineBreak", sz_ZERO, strideBlockIndex);
@@ -797,6 +837,14 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         Value * baseCountsNext = b->bitCast(b->simd_fill(sw.width, b->mvmd_extract(sw.width, breakCounts, b->getBitBlockWidth()/sw.width - 1)));
         baseCounts->addIncoming(baseCountsNext, stridePrecomputation);
     }
+    if (mAdjustCRLF) {
+        Value * crlfBitBlock = b->loadInputStreamBlock("CRLF", sz_ZERO, strideBlockIndex);
+        Value * crlfCounts = b->hsimd_partial_sum(sw.width, b->simd_popcount(sw.width, crlfBitBlock));
+        crlfCounts = b->simd_add(sw.width, crlfCounts, crlfBaseCounts);
+        b->CreateBlockAlignedStore(b->bitCast(crlfCounts), b->CreateGEP(crlfCountArrayBlockPtr, blockNo));
+        Value * crlfBaseCountsNext = b->bitCast(b->simd_fill(sw.width, b->mvmd_extract(sw.width, crlfCounts, b->getBitBlockWidth()/sw.width - 1)));
+        crlfBaseCounts->addIncoming(crlfBaseCountsNext, stridePrecomputation);
+    }
     Value * matchWordMask = b->CreateZExtOrTrunc(b->hsimd_signmask(sw.width, anyMatch), sizeTy);
     Value * breakWordMask = b->CreateZExtOrTrunc(b->hsimd_signmask(sw.width, anyBreak), sizeTy);
     Value * matchMask = b->CreateOr(matchMaskAccum, b->CreateShl(matchWordMask, b->CreateMul(blockNo, sw.WORDS_PER_BLOCK)), "matchMask");
@@ -831,6 +879,15 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         Value * strideLineCount = b->CreateLoad(b->CreateGEP(lineCountArrayWordPtr, sw.ix_MAXBIT));
         strideFinalLineNum = b->CreateAdd(pendingLineNum, b->CreateZExtOrTrunc(strideLineCount, sizeTy));
    }
+    // Every CRLF is also a line break, so a stride without breaks leaves the count unchanged.
+    Value * crlfWordBasePtr = nullptr;
+    Value * strideFinalCRLFCount = nullptr;
+    if (mAdjustCRLF) {
+        crlfWordBasePtr = b->getInputStreamBlockPtr("CRLF", sz_ZERO, strideBlockOffset);
+        crlfWordBasePtr = b->CreateBitCast(crlfWordBasePtr, sw.pointerTy);
+        Value * strideCRLFCount = b->CreateLoad(b->CreateGEP(crlfCountArrayWordPtr, sw.ix_MAXBIT));
+        strideFinalCRLFCount = b->CreateAdd(pendingCRLFCount, b->CreateZExtOrTrunc(strideCRLFCount, sizeTy));
+    }
     // Now check whether there are any matches at all in the stride.   If not, we
     // can immediately move on to the next stride.
     // We optimize for the case of no matches; the cost of the branch penalty
@@ -889,6 +946,19 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         Value * lineNum = b->CreateAdd(pendingLineNum, lineCountInStride);
         b->CreateStore(lineNum, b->getRawOutputPointer("Coordinates", b->getInt32(LINE_NUMBERS), matchNumPhi));
     }
+    if (mLineOffsets) {
+        Value * lineOffset = matchStart;
+        if (mAdjustCRLF) {
+            // The CRLFs prior to the match end are exactly those prior to the line start,
+            // as the LF of a CRLF is a line break.
+            Value * crlfCountInStride = b->CreateZExtOrTrunc(b->CreateLoad(b->CreateGEP(crlfCountArrayWordPtr, matchWordIdx)), sizeTy);
+            Value * matchCRLFWord = b->CreateZExtOrTrunc(b->CreateLoad(b->CreateGEP(crlfWordBasePtr, matchWordIdx)), sizeTy);
+            Value * extraCRLFs = b->CreateXor(matchCRLFWord, b->CreateZeroHiBitsFrom(matchCRLFWord, matchEndPosInWord));
+            crlfCountInStride = b->CreateSub(crlfCountInStride, b->CreatePopcount(extraCRLFs));
+            lineOffset = b->CreateSub(lineOffset, b->CreateAdd(pendingCRLFCount, crlfCountInStride));
+        }
+        b->CreateStore(lineOffset, b->getRawOutputPointer("Coordinates", b->getInt32(LINE_OFFSETS), matchNumPhi));
+    }
     //  We've dealt with the match, now prepare for the next one, if any.
     // There may be more matches in the current word.
     Value * dropMatch = b->CreateResetLowestBit(theMatchWord);
@@ -918,12 +988,22 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
         strideFinalLineNumPhi->addIncoming(strideFinalLineNum, updateLineInfo);
         strideFinalLineNumPhi->addIncoming(strideFinalLineNum, currentBB);
     }
+    PHINode * strideFinalCRLFCountPhi = nullptr;
+    if (mAdjustCRLF) {
+        strideFinalCRLFCountPhi = b->CreatePHI(sizeTy, 3);
+        strideFinalCRLFCountPhi->addIncoming(pendingCRLFCount, strideMasksReady);
+        strideFinalCRLFCountPhi->addIncoming(strideFinalCRLFCount, updateLineInfo);
+        strideFinalCRLFCountPhi->addIncoming(strideFinalCRLFCount, currentBB);
+    }
     strideNo->addIncoming(nextStrideNo, strideCoordinatesDone);
     currenMatchCount->addIncoming(finalStrideMatchCount, strideCoordinatesDone);
     pendingLineStart->addIncoming(strideFinalLineStart, strideCoordinatesDone);
     if (mLineNumbering) {
         pendingLineNum->addIncoming(strideFinalLineNumPhi, strideCoordinatesDone);
     }
+    if (mAdjustCRLF) {
+        pendingCRLFCount->addIncoming(strideFinalCRLFCountPhi, strideCoordinatesDone);
+    }
     b->CreateCondBr(b->CreateICmpNE(nextStrideNo, numOfStrides), stridePrologue, stridesDone);
 
     b->SetInsertPoint(stridesDone);
@@ -931,6 +1011,9 @@ void MatchCoordinatesKernel::generateMultiBlockLogic(BuilderRef b, Value * const
     if (mLineNumbering) {
         b->setScalarField("LineNum", strideFinalLineNumPhi);
     }
+    if (mAdjustCRLF) {
+        b->setScalarField("CRLFCount", strideFinalCRLFCountPhi);
+    }
     // b->setProducedItemCount("Coordinates", finalStrideMatchCount);
 }
 
@@ -1296,7 +1379,7 @@ MatchReporter::MatchReporter(BuilderRef b, StreamSet * ByteStream, StreamSet * c
 // output scalars
 {},
 // kernel state
-{}) {
+{}), mLineOffsets(Coordinates->getNumElements() == 4) {
     setStride(1);
     addAttribute(SideEffecting());
 }
@@ -1340,6 +1423,12 @@ void MatchReporter::generateDoSegmentMethod(BuilderRef b) {
     b->CreateCondBr(b->CreateICmpULT(matchRecordStart, avail), dispatch, callFinalizeScan);
 
     b->SetInsertPoint(dispatch);
+    if (mLineOffsets) {
+        // The byte offset of the line is passed on ahead of the match itself.
+        Value * const lineOffset = b->CreateLoad(b->getRawInputPointer("Coordinates", b->getInt32(LINE_OFFSETS), phiMatchNum), "lineOffsetLoad");
+        Function * const setLineOffset = m->getFunction("set_line_offset_wrapper"); assert (setLineOffset);
+        b->CreateCall(setLineOffset->getFunctionType(), setLineOffset, {accumulator, lineOffset});
+    }
     Function * const dispatcher = m->getFunction("accumulate_match_wrapper"); assert (dispatcher);
     Value * const startPtr = b->getRawInputPointer("InputStream", matchRecordStart);
     Value * const endPtr = b->getRawInputPointer("InputStream", matchRecordEnd);
@@ -1366,6 +1455,92 @@ void MatchReporter::generateDoSegmentMethod(BuilderRef b) {
 
 }
 
+MatchSpanReporter::MatchSpanReporter(BuilderRef b, StreamSet * ByteStream, StreamSet * const Coordinates, Scalar * const callbackObject)
+: SegmentOrientedKernel(b, "matchSpanReporter" + std::to_string(Coordinates->getNumElements()),
+// inputs
+{Binding{"InputStream", ByteStream, GreedyRate(), Deferred()},
+ Binding{"Coordinates", Coordinates, GreedyRate(1)}},
+// outputs
+{},
+// input scalars
+{Binding{"accumulator_address", callbackObject}},
+// output scalars
+{},
+// kernel state
+{}) {
+    setStride(1);
+    addAttribute(SideEffecting());
+    assert (Coordinates->getNumElements() == 4);
+}
+
+void MatchSpanReporter::generateDoSegmentMethod(BuilderRef b) {
+    Module * const m = b->getModule();
+    BasicBlock * const getBatch = b->CreateBasicBlock("getBatch");
+    BasicBlock * const storeCoordinates = b->CreateBasicBlock("storeCoordinates");
+    BasicBlock * const dispatch = b->CreateBasicBlock("dispatch");
+    BasicBlock * const coordinatesDone = b->CreateBasicBlock("coordinatesDone");
+    BasicBlock * const callFinalizeScan = b->CreateBasicBlock("callFinalizeScan");
+    BasicBlock * const scanReturn = b->CreateBasicBlock("scanReturn");
+
+    Value * accumulator = b->getScalarField("accumulator_address");
+    Value * const avail = b->getAvailableItemCount("InputStream");
+    Value * matchesProcessed = b->getProcessedItemCount("Coordinates");
+    Value * matchesAvail = b->getAvailableItemCount("Coordinates");
+    Value * const bufferLimit = b->getRawInputPointer("InputStream", avail);
+
+    Constant * const sz_ZERO = b->getSize(0);
+    Constant * const sz_ONE = b->getSize(1);
+    Type * const sizeTy = b->getSizeTy();
+
+    b->CreateCondBr(b->CreateICmpNE(matchesProcessed, matchesAvail), getBatch, coordinatesDone);
+
+    b->SetInsertPoint(getBatch);
+    Value * const numOfMatches = b->CreateSub(matchesAvail, matchesProcessed);
+    Function * const getSpanBatch = m->getFunction("get_span_batch_wrapper"); assert (getSpanBatch);
+    Value * batch = b->CreateCall(getSpanBatch->getFunctionType(), getSpanBatch, {accumulator, numOfMatches});
+    batch = b->CreatePointerCast(batch, sizeTy->getPointerTo());
+    b->CreateBr(storeCoordinates);
+
+    // Each match is recorded as its line number, line start pointer, match end pointer
+    // and line offset.
+    b->SetInsertPoint(storeCoordinates);
+    PHINode * const phiBatchIdx = b->CreatePHI(sizeTy, 2, "batchIdx");
+    phiBatchIdx->addIncoming(sz_ZERO, getBatch);
+    Value * const matchNum = b->CreateAdd(matchesProcessed, phiBatchIdx);
+    Value * const lineStart = b->CreateLoad(b->getRawInputPointer("Coordinates", b->getInt32(LINE_STARTS), matchNum), "lineStartLoad");
+    Value * matchEnd = b->CreateLoad(b->getRawInputPointer("Coordinates", b->getInt32(LINE_ENDS), matchNum), "matchEndLoad");
+    Value * const lineNum = b->CreateLoad(b->getRawInputPointer("Coordinates", b->getInt32(LINE_NUMBERS), matchNum), "lineNumLoad");
+    Value * const lineOffset = b->CreateLoad(b->getRawInputPointer("Coordinates", b->getInt32(LINE_OFFSETS), matchNum), "lineOffsetLoad");
+    // A match at EOF may end one past the available data.
+    matchEnd = b->CreateUMin(matchEnd, avail);
+    Value * const lineStartPtr = b->getRawInputPointer("InputStream", lineStart);
+    Value * const matchEndPtr = b->getRawInputPointer("InputStream", matchEnd);
+    Value * const recordBase = b->CreateMul(phiBatchIdx, b->getSize(4));
+    b->CreateStore(b->CreateZExtOrTrunc(lineNum, sizeTy), b->CreateGEP(batch, recordBase));
+    b->CreateStore(b->CreatePtrToInt(lineStartPtr, sizeTy), b->CreateGEP(batch, b->CreateAdd(recordBase, sz_ONE)));
+    b->CreateStore(b->CreatePtrToInt(matchEndPtr, sizeTy), b->CreateGEP(batch, b->CreateAdd(recordBase, b->getSize(2))));
+    b->CreateStore(b->CreateZExtOrTrunc(lineOffset, sizeTy), b->CreateGEP(batch, b->CreateAdd(recordBase, b->getSize(3))));
+    Value * const nextBatchIdx = b->CreateAdd(phiBatchIdx, sz_ONE);
+    phiBatchIdx->addIncoming(nextBatchIdx, b->GetInsertBlock());
+    b->CreateCondBr(b->CreateICmpNE(nextBatchIdx, numOfMatches), storeCoordinates, dispatch);
+
+    b->SetInsertPoint(dispatch);
+    Function * const dispatcher = m->getFunction("accumulate_spans_wrapper"); assert (dispatcher);
+    b->CreateCall(dispatcher->getFunctionType(), dispatcher, {accumulator, numOfMatches, bufferLimit});
+    b->CreateBr(coordinatesDone);
+
+    b->SetInsertPoint(coordinatesDone);
+    b->CreateCondBr(b->isFinal(), callFinalizeScan, scanReturn);
+
+    b->SetInsertPoint(callFinalizeScan);
+    b->setProcessedItemCount("InputStream", avail);
+    Function * finalizer = m->getFunction("finalize_match_wrapper"); assert (finalizer);
+    b->CreateCall(finalizer->getFunctionType(), finalizer, {accumulator, bufferLimit});
+    b->CreateBr(scanReturn);
+
+    b->SetInsertPoint(scanReturn);
+}
+
 MatchFilterKernel::MatchFilterKernel(BuilderRef b,
                                      StreamSet * const MatchStarts, StreamSet * const LineBreakStream,
                                      StreamSet * const InputStream, StreamSet * Output, unsigned strideBlocks)
@@ -1600,7 +1775,8 @@ ColorizedReporter::ColorizedReporter(BuilderRef b, StreamSet * ByteStream, Strea
                         // output scalars
 {},
                         // kernel state
-{}), mColorizedLineNumberIndex(SourceCoords->getNumElements() == 3 ? LINE_NUMBERS : BATCH_LINE_NUMBERS) {
+{}), mColorizedLineNumberIndex(SourceCoords->getNumElements() >= 3 ? LINE_NUMBERS : BATCH_LINE_NUMBERS)
+, mLineOffsets(SourceCoords->getNumElements() == 4) {
     setStride(1);
     addAttribute(SideEffecting());
 }
@@ -1647,6 +1823,12 @@ void ColorizedReporter::generateDoSegmentMethod(BuilderRef b) {
     b->CreateCondBr(b->CreateICmpULT(matchRecordStart, avail), dispatch, callFinalizeScan);
 
     b->SetInsertPoint(dispatch);
+    if (mLineOffsets) {
+        // Offsets are those of the source, rather than the colorized, lines.
+        Value * const lineOffset = b->CreateLoad(b->getRawInputPointer("SourceCoords", b->getInt32(LINE_OFFSETS), phiMatchNum), "lineOffsetLoad");
+        Function * const setLineOffset = m->getFunction("set_line_offset_wrapper"); assert (setLineOffset);
+        b->CreateCall(setLineOffset->getFunctionType(), setLineOffset, {accumulator, lineOffset});
+    }
     Function * const dispatcher = m->getFunction("accumulate_match_wrapper"); assert (dispatcher);
     Value * const startPtr = b->getRawInputPointer("InputStream", matchRecordStart);
     Value * const endPtr = b->getRawInputPointer("InputStream", matchRecordEnd);
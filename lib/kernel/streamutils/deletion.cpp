@@ -30,10 +30,17 @@ void FilterByMask(const std::unique_ptr<ProgramBuilder> & P,
                   StreamSet * mask, StreamSet * inputs, StreamSet * outputs,
                   unsigned streamOffset,
                   unsigned extractionFieldWidth) {
-    StreamSet * const compressed = P->CreateStreamSet(outputs->getNumElements());
+    FilterByMask(*P, mask, inputs, outputs, streamOffset, extractionFieldWidth);
+}
+
+void FilterByMask(PipelineBuilder & P,
+                  StreamSet * mask, StreamSet * inputs, StreamSet * outputs,
+                  unsigned streamOffset,
+                  unsigned extractionFieldWidth) {
+    StreamSet * const compressed = P.CreateStreamSet(outputs->getNumElements());
     std::vector<uint32_t> output_indices = streamutils::Range(streamOffset, streamOffset + outputs->getNumElements());
-    P->CreateKernelCall<FieldCompressKernel>(Select(mask, {0}), SelectOperationList { Select(inputs, output_indices)}, compressed, extractionFieldWidth);
-    P->CreateKernelCall<StreamCompressKernel>(mask, compressed, outputs, extractionFieldWidth);
+    P.CreateKernelCall<FieldCompressKernel>(Select(mask, {0}), SelectOperationList { Select(inputs, output_indices)}, compressed, extractionFieldWidth);
+    P.CreateKernelCall<StreamCompressKernel>(mask, compressed, outputs, extractionFieldWidth);
 }
 
 inline std::vector<Value *> parallel_prefix_deletion_masks(BuilderRef kb, const unsigned fw, Value * del_mask) {
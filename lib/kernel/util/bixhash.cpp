@@ -50,4 +50,68 @@ void BixHash::generatePabloMethod() {
         pb.createAssign(pb.createExtract(hashVar, pb.getInteger(i)), hash[i]);
     }
 }
+
+// Bit i of the initial hash value of a byte is bit i of the byte, for i < 8;
+// each further bit is the xor of two bits of the byte.
+static unsigned secondBit(const unsigned i) {
+    return (3 * i + 1) % 8;
+}
+
+// In step j, each hash bit i is mixed with the bit (i + rotation) of the hash
+// value (1<<j) positions earlier.
+static unsigned stepRotation(const unsigned j, const unsigned hashBits) {
+    return (2 * j + 3) % hashBits;
+}
+
+void WindowHash::generatePabloMethod() {
+    PabloBuilder pb(getEntryScope());
+    std::vector<PabloAST *> basis = getInputStreamSet("basis");
+    assert (basis.size() == 8 && mHashBits <= 16);
+    std::vector<PabloAST *> hash(mHashBits);
+    for (unsigned i = 0; i < mHashBits; i++) {
+        hash[i] = (i < 8) ? basis[i] : pb.createXor(basis[i % 8], basis[secondBit(i)]);
+    }
+    for (unsigned j = 0; j < mHashSteps; j++) {
+        const unsigned rotation = stepRotation(j, mHashBits);
+        std::vector<PabloAST *> mixed(mHashBits);
+        for (unsigned i = 0; i < mHashBits; i++) {
+            PabloAST * priorBits = pb.createAdvance(hash[(i + rotation) % mHashBits], 1 << j);
+            mixed[i] = pb.createXor(hash[i], priorBits);
+        }
+        hash.swap(mixed);
+    }
+    Var * hashVar = getOutputStreamVar("hashes");
+    for (unsigned i = 0; i < mHashBits; i++) {
+        pb.createAssign(pb.createExtract(hashVar, pb.getInteger(i)), hash[i]);
+    }
+}
+
+unsigned windowHash(const unsigned char * window, const unsigned hashBits, const unsigned steps) {
+    const unsigned lgth = 1 << steps;
+    const unsigned mask = (1 << hashBits) - 1;
+    std::vector<unsigned> hash(lgth);
+    for (unsigned q = 0; q < lgth; q++) {
+        unsigned value = 0;
+        for (unsigned i = 0; i < hashBits; i++) {
+            unsigned bit = (window[q] >> (i % 8)) & 1;
+            if (i >= 8) {
+                bit ^= (window[q] >> secondBit(i)) & 1;
+            }
+            value |= bit << i;
+        }
+        hash[q] = value;
+    }
+    // The hash value at the last position depends only on the bytes of the window.
+    // Positions are updated from the last, so that each step mixes in the values
+    // of the preceding step.
+    for (unsigned j = 0; j < steps; j++) {
+        const unsigned shft = 1 << j;
+        const unsigned rotation = stepRotation(j, hashBits);
+        for (unsigned q = lgth - 1; q >= shft; q--) {
+            const unsigned prior = hash[q - shft];
+            hash[q] ^= ((prior >> rotation) | (prior << (hashBits - rotation))) & mask;
+        }
+    }
+    return hash[lgth - 1];
+}
 }
@@ -330,6 +330,24 @@ void NullDelimiterKernel::generatePabloMethod() {
     pb.createAssign(pb.createExtract(getOutput(0), 0), NUL);
 }
 
+CRLFKernel::CRLFKernel(BuilderRef b, StreamSet * Source, StreamSet * CRLF_LineFeeds)
+: PabloKernel(b, "CRLF" + sourceShape(Source),
+              {Binding{"basis", Source}},
+              {Binding{"CRLF_LF", CRLF_LineFeeds}}) {}
+
+void CRLFKernel::generatePabloMethod() {
+    PabloBuilder pb(getEntryScope());
+    std::unique_ptr<CC_Compiler> ccc;
+    if (getInputStreamSet("basis").size() == 1) {
+        ccc = std::make_unique<cc::Direct_CC_Compiler>(getEntryScope(), pb.createExtract(getInput(0), pb.getInteger(0)));
+    } else {
+        ccc = std::make_unique<cc::Parabix_CC_Compiler_Builder>(getEntryScope(), getInputStreamSet("basis"));
+    }
+    PabloAST * const CR = ccc->compileCC(makeByte(0x0D));
+    PabloAST * const LF = ccc->compileCC(makeByte(0x0A));
+    pb.createAssign(pb.createExtract(getOutput(0), 0), pb.createAnd(LF, pb.createAdvance(CR, 1), "CRLF_LF"));
+}
+
 LineStartsKernel::LineStartsKernel(BuilderRef b, StreamSet * LineEnds, StreamSet * LineStarts)
 : PabloKernel(b, "LineStarts",
               {Binding{"LineEnds", LineEnds}},
@@ -1,6 +1,7 @@
 #include <objcache/object_cache.h>
 
 #include <objcache/object_cache_util.hpp>
+#include <objcache/object_cache_store.h>
 #include <kernel/core/kernel.h>
 #include <kernel/core/kernel_builder.h>
 #include <llvm/Support/raw_ostream.h>
@@ -18,6 +19,9 @@
 #include <llvm/Bitcode/BitcodeWriter.h>
 #endif
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/MD5.h>
+#include <algorithm>
+#include <link.h>
 #include <system_error>
 
 using namespace llvm;
@@ -113,17 +117,15 @@ CacheObjectResult ParabixObjectCache::loadCachedObjectFile(BuilderRef b, kernel:
     }
 
     if (LLVM_LIKELY(kernel->isCachable())) {
-        Path fileName(mCachePath);
         const auto moduleId = kernel->makeCacheName(b);
-        sys::path::append(fileName, CACHE_PREFIX);
-        fileName.append(moduleId);
-        fileName.append(KERNEL_FILE_EXTENSION);
-        auto kernelBuffer = MemoryBuffer::getFile(fileName, -1, false);
-        if (kernelBuffer) {
+        ObjectCacheStore::Entry entry;
+        if (mStore->lookup(moduleId, entry)) {
+            // both the stub and object refer directly to the memory mapped store
+            auto kernelBuffer = MemoryBuffer::getMemBuffer(entry.Stub, moduleId, false);
             #if LLVM_VERSION_INTEGER < LLVM_VERSION_CODE(4, 0, 0)
-            auto loadedFile = getLazyBitcodeModule(std::move(kernelBuffer.get()), b->getContext());
+            auto loadedFile = getLazyBitcodeModule(std::move(kernelBuffer), b->getContext());
             #else
-            auto loadedFile = getOwningLazyBitcodeModule(std::move(kernelBuffer.get()), b->getContext());
+            auto loadedFile = getOwningLazyBitcodeModule(std::move(kernelBuffer), b->getContext());
             #endif
             // if there was no error when parsing the bitcode
             if (LLVM_LIKELY(loadedFile)) {
@@ -140,27 +142,18 @@ CacheObjectResult ParabixObjectCache::loadCachedObjectFile(BuilderRef b, kernel:
                         goto invalid;
                     }
                 }
-                sys::path::replace_extension(fileName, OBJECT_FILE_EXTENSION);
-                auto objectBuffer = MemoryBuffer::getFile(fileName.c_str(), -1, false);
-                if (LLVM_LIKELY(objectBuffer)) {
-                    Module * const m = M.release();
-                    assert ("object cache file returned null module?" && m);
-                    // defaults to <path>/<moduleId>.kernel
-                    m->setModuleIdentifier(moduleId);
-                    b->setModule(m);
-                    kernel->loadCachedKernel(b);
-                    mCachedObject.emplace(moduleId, std::move(objectBuffer.get()));
-                    mKnownSignatures.emplace(signature, m);
-                    // update the modified time of the .o and .kernel files
-                    const auto access_time = currentTime();
-                    fs::last_write_time(fileName.c_str(), access_time);
-                    sys::path::replace_extension(fileName, KERNEL_FILE_EXTENSION);
-                    fs::last_write_time(fileName.c_str(), access_time);
-                    if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
-                        errs() << "Read cache file: " << moduleId << KERNEL_FILE_EXTENSION << "\n";
-                    }
-                    return CacheObjectResult::CACHED;
+                Module * const m = M.release();
+                assert ("object cache file returned null module?" && m);
+                m->setModuleIdentifier(moduleId);
+                b->setModule(m);
+                kernel->loadCachedKernel(b);
+                mCachedObject.emplace(moduleId, MemoryBuffer::getMemBuffer(entry.Object, moduleId, false));
+                mKnownSignatures.emplace(signature, m);
+                if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+                    errs() << "Read cache file: " << moduleId << KERNEL_FILE_EXTENSION << "\n";
                 }
+                ++mNumOfCacheHits;
+                return CacheObjectResult::CACHED;
             } else if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
                 errs() << "Failed to load cache file: " << moduleId << KERNEL_FILE_EXTENSION << "\n";
             }
@@ -169,6 +162,7 @@ CacheObjectResult ParabixObjectCache::loadCachedObjectFile(BuilderRef b, kernel:
 
 invalid:
 
+        mCacheMisses.push_back(moduleId);
         kernel->makeModule(b);
         Module * const module = kernel->getModule();
         // mark this module as cachable
@@ -200,42 +194,7 @@ void ParabixObjectCache::notifyObjectCompiled(const Module * M, MemoryBufferRef
 
         const StringRef moduleId(M->getModuleIdentifier());
 
-        Path objectName(mCachePath);
-        sys::path::append(objectName, CACHE_PREFIX);
-        objectName.append(moduleId);
-        objectName.append(OBJECT_FILE_EXTENSION);
-
-        // Write the object code
-        std::error_code EC;
-        raw_fd_ostream objFile(objectName, EC, sys::fs::F_None);
-        if (LLVM_UNLIKELY(EC)) {
-            SmallVector<char, 512> tmp;
-            llvm::raw_svector_ostream msg(tmp);
-            msg << "Could not write to \""
-                << objectName.str()
-                << "\" in object cache directory.\n\n"
-                "Reason: " << EC.message() << "\n\n"
-                "Rerun " << codegen::ProgramName << " with --enable-object-cache=0";
-            report_fatal_error(msg.str());
-        }
-        objFile.write(Obj.getBufferStart(), Obj.getBufferSize());
-        objFile.close();
-
-        sys::path::replace_extension(objectName, KERNEL_FILE_EXTENSION);
-        raw_fd_ostream kernelFile(objectName.str(), EC, sys::fs::F_None);
-
-        if (LLVM_UNLIKELY(EC)) {
-            SmallVector<char, 512> tmp;
-            llvm::raw_svector_ostream msg(tmp);
-            msg << "Could not write to \""
-                << objectName.str()
-                << "\" in object cache directory.\n\n"
-                "Reason: " << EC.message() << "\n\n"
-                "Rerun " << codegen::ProgramName << " with --enable-object-cache=0";
-            report_fatal_error(msg.str());
-        }
-
-        // Clone the function prototypes and metadata to minimize the size of the stored .kernel file.
+        // Clone the function prototypes and metadata to minimize the size of the stored kernel stub.
         std::unique_ptr<Module> H(new Module(moduleId, M->getContext()));
         for (const Function & f : M->getFunctionList()) {
             if (f.hasExternalLinkage() && !f.empty()) {
@@ -250,19 +209,338 @@ void ParabixObjectCache::notifyObjectCompiled(const Module * M, MemoryBufferRef
             md->addOperand(MDNode::get(H->getContext(), {sigCopy}));
         }
 
+        SmallVector<char, 4096> stub;
+        raw_svector_ostream stubStream(stub);
         #if LLVM_VERSION_INTEGER < LLVM_VERSION_CODE(7, 0, 0)
-        WriteBitcodeToFile(H.get(), kernelFile);
+        WriteBitcodeToFile(H.get(), stubStream);
         #else
-        WriteBitcodeToFile(*H, kernelFile);
+        WriteBitcodeToFile(*H, stubStream);
         #endif
-        kernelFile.close();
 
+        // a full store (or one that cannot be written) only costs a recompilation in a later process
+        const auto written = mStore->insert(moduleId, Obj.getBuffer(), StringRef(stub.data(), stub.size()));
         if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
-            errs() << "Wrote cache file: " << moduleId << KERNEL_FILE_EXTENSION << "\n";
+            if (written) {
+                errs() << "Wrote cache file: " << moduleId << KERNEL_FILE_EXTENSION << "\n";
+            } else {
+                errs() << "Could not write cache file: " << moduleId << KERNEL_FILE_EXTENSION << "\n";
+            }
         }
     }
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getProgramModuleId
+ *
+ * Program keys are arbitrary strings (e.g., a canonical regular expression) so the cache files of a program are
+ * named after the MD5 of its key; the key itself is stored in the manifest to detect collisions.
+ ** ------------------------------------------------------------------------------------------------------------- */
+inline std::string getKeyDigest(const StringRef key) {
+    MD5 hash;
+    hash.update(key);
+    MD5::MD5Result result;
+    hash.final(result);
+    SmallString<32> digest;
+    MD5::stringifyResult(result, digest);
+    return digest.str().str();
+}
+
+inline std::string getProgramModuleId(const StringRef programKey) {
+    return "program_" + getKeyDigest(programKey);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief LoadedImage
+ *
+ * The external functions linked into a program are process addresses, which are not stable across runs. They are
+ * recorded relative to the load address of the executable or shared library that contains them, along with the
+ * size and modification time of that file so that a rebuilt binary invalidates the program.
+ ** ------------------------------------------------------------------------------------------------------------- */
+struct LoadedImage {
+    std::string Path;
+    uintptr_t Base = 0;
+    uintptr_t Address = 0;
+    bool Found = false;
+};
+
+inline std::string getImagePath(const char * const name) {
+    if (name == nullptr || *name == '\0') {
+        // the main executable is reported without a name
+        return sys::fs::getMainExecutable(nullptr, nullptr);
+    }
+    return name;
+}
+
+static int findImageContaining(struct dl_phdr_info * info, size_t, void * data) {
+    LoadedImage & image = *reinterpret_cast<LoadedImage *>(data);
+    for (unsigned i = 0; i < info->dlpi_phnum; ++i) {
+        const auto & phdr = info->dlpi_phdr[i];
+        if (phdr.p_type == PT_LOAD) {
+            const uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+            if (image.Address >= start && image.Address < (start + phdr.p_memsz)) {
+                image.Path = getImagePath(info->dlpi_name);
+                image.Base = info->dlpi_addr;
+                image.Found = true;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int findImageNamed(struct dl_phdr_info * info, size_t, void * data) {
+    LoadedImage & image = *reinterpret_cast<LoadedImage *>(data);
+    if (getImagePath(info->dlpi_name) == image.Path) {
+        image.Base = info->dlpi_addr;
+        image.Found = true;
+        return 1;
+    }
+    return 0;
+}
+
+inline bool getImageStamp(const std::string & path, uint64_t & size, uint64_t & mtime) {
+    struct stat st;
+    if (LLVM_UNLIKELY(stat(path.c_str(), &st) != 0)) {
+        return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+inline StringRef nextLine(StringRef & text) {
+    const auto split = text.split('\n');
+    text = split.second;
+    return split.first;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief loadCachedProgram
+ *
+ * A program manifest has the following line-oriented format:
+ *
+ *   key <length>
+ *   <program key>
+ *   image <size> <mtime> <path>
+ *   link <image #> <offset> <function name>
+ *   object <module id>
+ *   main <function name>
+ *
+ * A program is only loaded if every image is still present and unchanged and every object it names is still in
+ * the cache; otherwise the program is treated as uncached and the caller is expected to rebuild it.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool ParabixObjectCache::loadCachedProgram(const StringRef programKey, CachedProgram & program) noexcept {
+
+    const auto programId = getProgramModuleId(programKey);
+    ObjectCacheStore::Entry manifest;
+    if (!mStore->lookup(programId + PROGRAM_FILE_EXTENSION, manifest)) {
+        return false;
+    }
+
+    auto invalid = [&](const StringRef reason) {
+        if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+            errs() << "Cannot load cached program " << programId << PROGRAM_FILE_EXTENSION << ": " << reason << "\n";
+        }
+        program.ObjectIds.clear();
+        program.Objects.clear();
+        program.Functions.clear();
+        program.MainFunctionName.clear();
+        return false;
+    };
+
+    StringRef text = manifest.Object;
+    size_t keyLength = 0;
+    if (LLVM_UNLIKELY(nextLine(text).split(' ').second.getAsInteger(10, keyLength) || text.size() < keyLength)) {
+        return invalid("malformed manifest");
+    }
+    if (LLVM_UNLIKELY(!text.startswith(programKey) || keyLength != programKey.size())) {
+        return invalid("program key mismatch");
+    }
+    text = text.drop_front(keyLength + 1);
+
+    std::vector<uintptr_t> images;
+    while (!text.empty()) {
+        const auto line = nextLine(text);
+        const auto entry = line.split(' ');
+        if (entry.first == "image") {
+            const auto size = entry.second.split(' ');
+            const auto mtime = size.second.split(' ');
+            LoadedImage image;
+            image.Path = mtime.second.str();
+            uint64_t expectedSize = 0, expectedTime = 0, actualSize = 0, actualTime = 0;
+            if (LLVM_UNLIKELY(size.first.getAsInteger(10, expectedSize) || mtime.first.getAsInteger(10, expectedTime))) {
+                return invalid("malformed manifest");
+            }
+            if (LLVM_UNLIKELY(!getImageStamp(image.Path, actualSize, actualTime) || actualSize != expectedSize || actualTime != expectedTime)) {
+                return invalid(image.Path + " has changed");
+            }
+            dl_iterate_phdr(findImageNamed, &image);
+            if (LLVM_UNLIKELY(!image.Found)) {
+                return invalid(image.Path + " is not loaded");
+            }
+            images.push_back(image.Base);
+        } else if (entry.first == "link") {
+            const auto index = entry.second.split(' ');
+            const auto offset = index.second.split(' ');
+            unsigned i = 0;
+            uint64_t delta = 0;
+            if (LLVM_UNLIKELY(index.first.getAsInteger(10, i) || offset.first.getAsInteger(10, delta) || i >= images.size())) {
+                return invalid("malformed manifest");
+            }
+            program.Functions.emplace_back(offset.second.str(), reinterpret_cast<void *>(images[i] + delta));
+        } else if (entry.first == "object") {
+            ObjectCacheStore::Entry object;
+            if (LLVM_UNLIKELY(!mStore->lookup(entry.second, object))) {
+                return invalid(entry.second.str() + OBJECT_FILE_EXTENSION " is no longer cached");
+            }
+            program.ObjectIds.push_back(entry.second.str());
+            program.Objects.emplace_back(MemoryBuffer::getMemBuffer(object.Object, entry.second, false));
+        } else if (entry.first == "main") {
+            program.MainFunctionName = entry.second.str();
+        } else if (LLVM_UNLIKELY(!line.empty())) {
+            return invalid("malformed manifest");
+        }
+    }
+    if (LLVM_UNLIKELY(program.MainFunctionName.empty() || program.Objects.empty())) {
+        return invalid("malformed manifest");
+    }
+
+    if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+        errs() << "Read cached program: " << programId << PROGRAM_FILE_EXTENSION << "\n";
+    }
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief prepareProgramModule
+ *
+ * Name the main module of a program after its key and mark it as cachable so that notifyObjectCompiled will store
+ * its object alongside the kernel objects.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void ParabixObjectCache::prepareProgramModule(Module * const main, const StringRef programKey) noexcept {
+    main->setModuleIdentifier(getProgramModuleId(programKey));
+    main->getOrInsertNamedMetadata(CACHEABLE);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief saveCachedProgram
+ ** ------------------------------------------------------------------------------------------------------------- */
+void ParabixObjectCache::saveCachedProgram(const StringRef programKey, const std::vector<std::string> & objectIds,
+                                           const LinkedFunctions & functions, const StringRef mainFunctionName) noexcept {
+
+    const auto programId = getProgramModuleId(programKey);
+
+    auto uncachable = [&](const StringRef reason) {
+        if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+            errs() << "Cannot cache program " << programId << PROGRAM_FILE_EXTENSION << ": " << reason << "\n";
+        }
+    };
+
+    // every object must have been written to the cache; an uncachable kernel makes the whole program uncachable
+    for (const auto & objectId : objectIds) {
+        ObjectCacheStore::Entry object;
+        if (LLVM_UNLIKELY(!mStore->lookup(objectId, object))) {
+            return uncachable(objectId + " is not cached");
+        }
+    }
+
+    std::string manifest;
+    raw_string_ostream out(manifest);
+    out << "key " << programKey.size() << "\n" << programKey << "\n";
+    std::vector<std::string> images;
+    for (const auto & function : functions) {
+        LoadedImage image;
+        image.Address = reinterpret_cast<uintptr_t>(function.second);
+        dl_iterate_phdr(findImageContaining, &image);
+        if (LLVM_UNLIKELY(!image.Found)) {
+            return uncachable("cannot locate " + function.first);
+        }
+        const auto f = std::find(images.begin(), images.end(), image.Path);
+        const auto index = std::distance(images.begin(), f);
+        if (f == images.end()) {
+            uint64_t size = 0, mtime = 0;
+            if (LLVM_UNLIKELY(!getImageStamp(image.Path, size, mtime))) {
+                return uncachable("cannot stat " + image.Path);
+            }
+            out << "image " << size << " " << mtime << " " << image.Path << "\n";
+            images.push_back(image.Path);
+        }
+        out << "link " << index << " " << (image.Address - image.Base) << " " << function.first << "\n";
+    }
+    for (const auto & objectId : objectIds) {
+        out << "object " << objectId << "\n";
+    }
+    out << "main " << mainFunctionName << "\n";
+    out.flush();
+
+    if (LLVM_UNLIKELY(!mStore->insert(programId + PROGRAM_FILE_EXTENSION, manifest))) {
+        return uncachable("could not write manifest");
+    }
+    if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+        errs() << "Wrote cached program: " << programId << PROGRAM_FILE_EXTENSION << "\n";
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief loadSegmentTuning
+ *
+ * A tuning entry has the following line-oriented format:
+ *
+ *   key <length>
+ *   <tuning key>
+ *   segment-size <bytes>
+ *   buffer-segments <count>
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool ParabixObjectCache::loadSegmentTuning(const StringRef tuningKey, unsigned & segmentSize, unsigned & bufferSegments) noexcept {
+    ObjectCacheStore::Entry tuning;
+    if (!mStore->lookup("tuning_" + getKeyDigest(tuningKey) + TUNING_FILE_EXTENSION, tuning)) {
+        return false;
+    }
+    StringRef text = tuning.Object;
+    size_t keyLength = 0;
+    if (LLVM_UNLIKELY(nextLine(text).split(' ').second.getAsInteger(10, keyLength) || text.size() < keyLength)) {
+        return false;
+    }
+    if (LLVM_UNLIKELY(!text.startswith(tuningKey) || keyLength != tuningKey.size())) {
+        return false;
+    }
+    text = text.drop_front(keyLength + 1);
+    unsigned size = 0, segments = 0;
+    while (!text.empty()) {
+        const auto entry = nextLine(text).split(' ');
+        if (entry.first == "segment-size") {
+            entry.second.getAsInteger(10, size);
+        } else if (entry.first == "buffer-segments") {
+            entry.second.getAsInteger(10, segments);
+        }
+    }
+    if (LLVM_UNLIKELY(size == 0 || segments == 0)) {
+        return false;
+    }
+    segmentSize = size;
+    bufferSegments = segments;
+    if (LLVM_UNLIKELY(codegen::TraceObjectCache)) {
+        errs() << "Read segment tuning: segment-size=" << size << " buffer-segments=" << segments << "\n";
+    }
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief saveSegmentTuning
+ ** ------------------------------------------------------------------------------------------------------------- */
+void ParabixObjectCache::saveSegmentTuning(const StringRef tuningKey, const unsigned segmentSize, const unsigned bufferSegments) noexcept {
+    std::string tuning;
+    raw_string_ostream out(tuning);
+    out << "key " << tuningKey.size() << "\n" << tuningKey << "\n"
+        << "segment-size " << segmentSize << "\n"
+        << "buffer-segments " << bufferSegments << "\n";
+    out.flush();
+    const auto written = mStore->insert("tuning_" + getKeyDigest(tuningKey) + TUNING_FILE_EXTENSION, tuning);
+    if (LLVM_UNLIKELY(codegen::TraceObjectCache && written)) {
+        errs() << "Wrote segment tuning: segment-size=" << segmentSize << " buffer-segments=" << bufferSegments << "\n";
+    }
+}
+
 /** ------------------------------------------------------------------------------------------------------------- *
  * @brief getObject
  ** ------------------------------------------------------------------------------------------------------------- */
@@ -373,7 +651,11 @@ inline size_t parseInt(const StringRef & str, const StringRef & label) {
  * @brief loadCacheSettings
  ** ------------------------------------------------------------------------------------------------------------- */
 inline void ParabixObjectCache::loadCacheSettings() noexcept {
-    getDefaultCachePath(mCachePath);
+    if (codegen::ObjectCacheDir) {
+        mCachePath.assign(codegen::ObjectCacheDir);
+    } else {
+        getDefaultCachePath(mCachePath);
+    }
     #if 0
 
     const auto configPath = getConfigPath();
@@ -426,6 +708,7 @@ inline void ParabixObjectCache::loadCacheSettings() noexcept {
         report_fatal_error(msg.str());
     }
 
+    mStore.reset(new ObjectCacheStore(mCachePath, CACHE_PREFIX, static_cast<uint64_t>(codegen::ObjectCacheSize) << 20));
 }
 
 /** ------------------------------------------------------------------------------------------------------------- *
@@ -444,4 +727,11 @@ ParabixObjectCache::ParabixObjectCache() {
 /** ------------------------------------------------------------------------------------------------------------- *
 +* @brief destructor
 +** ------------------------------------------------------------------------------------------------------------- */
-ParabixObjectCache::~ParabixObjectCache() { }
\ No newline at end of file
+ParabixObjectCache::~ParabixObjectCache() {
+    if (LLVM_UNLIKELY(codegen::ReportObjectCacheMisses)) {
+        errs() << "Object cache: " << mNumOfCacheHits << " kernels loaded, " << mCacheMisses.size() << " compiled\n";
+        for (const auto & moduleId : mCacheMisses) {
+            errs() << "  missed: " << moduleId << "\n";
+        }
+    }
+}
\ No newline at end of file
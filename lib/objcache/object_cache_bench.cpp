@@ -0,0 +1,169 @@
+/*
+ *  Copyright (c) 2020 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ */
+
+// objcachebench - startup latency of the object cache as the number of cached entries grows.
+//
+// For each entry count, a temporary cache directory is populated with synthetic kernels both in the
+// ObjectCacheStore and in the former layout of an object file and a stub file per kernel. The time taken
+// to open the cache and look up a fixed set of kernels, as a program does at startup, is then reported
+// for both. Each measurement is the fastest of several runs.
+
+#include <objcache/object_cache_store.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <utime.h>
+
+using namespace llvm;
+
+constexpr unsigned ENTRY_COUNTS[] = {1000, 10000, 50000};
+
+constexpr unsigned LOOKUPS = 200;
+
+constexpr unsigned REPETITIONS = 5;
+
+constexpr size_t OBJECT_SIZE = 8 * 1024;
+
+constexpr size_t STUB_SIZE = 1024;
+
+constexpr uint64_t STORE_CAPACITY = 1ULL << 30;
+
+inline std::string getKernelName(const unsigned i) {
+    return "PabloKernel_" + std::to_string(i) + "_0123456789abcdef0123456789abcdef";
+}
+
+inline double seconds(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline bool writeFile(const Twine & path, StringRef contents) {
+    std::error_code EC;
+    raw_fd_ostream out(path.str(), EC, sys::fs::F_None);
+    if (EC) {
+        return false;
+    }
+    out << contents;
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief openStore
+ *
+ * Open the store and look up the given kernels, touching the first byte of each object.
+ ** ------------------------------------------------------------------------------------------------------------- */
+double openStore(StringRef dir, const std::vector<unsigned> & lookups, unsigned & found) {
+    const auto start = std::chrono::steady_clock::now();
+    ObjectCacheStore store(dir, "", STORE_CAPACITY);
+    found = 0;
+    volatile char sink = 0;
+    for (const auto i : lookups) {
+        ObjectCacheStore::Entry entry;
+        if (store.lookup(getKernelName(i), entry)) {
+            sink = sink + entry.Object.front();
+            ++found;
+        }
+    }
+    return seconds(start);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief openLooseFiles
+ *
+ * Look up the given kernels as the former cache did: read the stub and object file of each kernel and update
+ * their modification times.
+ ** ------------------------------------------------------------------------------------------------------------- */
+double openLooseFiles(StringRef dir, const std::vector<unsigned> & lookups, unsigned & found) {
+    const auto start = std::chrono::steady_clock::now();
+    found = 0;
+    volatile char sink = 0;
+    for (const auto i : lookups) {
+        SmallString<256> path(dir);
+        sys::path::append(path, getKernelName(i) + ".kernel");
+        auto stub = MemoryBuffer::getFile(path, -1, false);
+        if (!stub) {
+            continue;
+        }
+        sys::path::replace_extension(path, ".o");
+        auto object = MemoryBuffer::getFile(path, -1, false);
+        if (!object) {
+            continue;
+        }
+        sink = sink + (*object)->getBufferStart()[0];
+        utime(path.c_str(), nullptr);
+        ++found;
+    }
+    return seconds(start);
+}
+
+int main(int, char **) {
+
+    std::mt19937 rng(275);
+    std::string object(OBJECT_SIZE, '\0');
+    std::string stub(STUB_SIZE, '\0');
+    for (auto & c : object) c = static_cast<char>(rng());
+    for (auto & c : stub) c = static_cast<char>(rng());
+
+    outs() << "entries   lookups   store open+lookup   loose files lookup   speedup\n";
+
+    for (const auto n : ENTRY_COUNTS) {
+
+        SmallString<256> dir;
+        if (sys::fs::createUniqueDirectory("objcachebench", dir)) {
+            errs() << "objcachebench: could not create a temporary directory\n";
+            return 1;
+        }
+
+        {
+            ObjectCacheStore store(dir, "", STORE_CAPACITY);
+            for (unsigned i = 0; i < n; ++i) {
+                const auto name = getKernelName(i);
+                if (!store.insert(name, object, stub)) {
+                    errs() << "objcachebench: could not insert entry " << i << " into the store\n";
+                    return 1;
+                }
+                SmallString<256> path(dir);
+                sys::path::append(path, name + ".kernel");
+                writeFile(path, stub);
+                sys::path::replace_extension(path, ".o");
+                writeFile(path, object);
+            }
+        }
+
+        std::vector<unsigned> lookups(LOOKUPS);
+        std::uniform_int_distribution<unsigned> pick(0, n - 1);
+        for (auto & i : lookups) {
+            i = pick(rng);
+        }
+
+        double bestStore = 0, bestLoose = 0;
+        unsigned foundStore = 0, foundLoose = 0;
+        for (unsigned r = 0; r < REPETITIONS; ++r) {
+            const auto s = openStore(dir, lookups, foundStore);
+            const auto l = openLooseFiles(dir, lookups, foundLoose);
+            if (r == 0 || s < bestStore) bestStore = s;
+            if (r == 0 || l < bestLoose) bestLoose = l;
+        }
+
+        if (foundStore != LOOKUPS || foundLoose != LOOKUPS) {
+            errs() << "objcachebench: only " << foundStore << " (store) and " << foundLoose
+                   << " (loose files) of " << LOOKUPS << " lookups succeeded\n";
+            return 1;
+        }
+
+        outs() << format("%7u   %7u   %15.3f ms   %16.3f ms   %6.2fx\n",
+                         n, LOOKUPS, bestStore * 1e3, bestLoose * 1e3, bestLoose / bestStore);
+
+        sys::fs::remove_directories(dir);
+    }
+
+    return 0;
+}
@@ -27,7 +27,7 @@ inline bool isCachedFile(const fs::path & path) {
     system::error_code ec;
     if (BOOST_UNLIKELY(!fs::is_regular_file(path, ec))) return false;
     const auto ext = path.extension();
-    return (ext.compare(OBJECT_FILE_EXTENSION) == 0 || ext.compare(KERNEL_FILE_EXTENSION)  == 0);
+    return (ext.compare(OBJECT_FILE_EXTENSION) == 0 || ext.compare(KERNEL_FILE_EXTENSION)  == 0 || ext.compare(PROGRAM_FILE_EXTENSION) == 0 || ext.compare(TUNING_FILE_EXTENSION) == 0);
 }
 
 inline void setLowestPriority() {
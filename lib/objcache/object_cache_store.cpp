@@ -0,0 +1,525 @@
+/*
+ *  Copyright (c) 2020 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ */
+
+#include <objcache/object_cache_store.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/MD5.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+namespace {
+
+constexpr uint64_t STORE_MAGIC = 0x3145524F54534350ULL; // "PCSTORE1"
+
+constexpr uint64_t NUM_OF_SLOTS = 1ULL << 18;
+
+// Deleted slots are only reclaimed by compaction so both count towards the load of the index. Eviction keeps the
+// live entries to half of the maximum load so that compaction always leaves room for further insertions.
+constexpr uint64_t MAX_USED_SLOTS = (NUM_OF_SLOTS * 3) / 4;
+
+constexpr uint64_t MAX_LIVE_ENTRIES = MAX_USED_SLOTS / 2;
+
+// records are aligned so that an object can be passed to the execution engine directly from the mapping
+constexpr uint64_t RECORD_ALIGNMENT = 64;
+
+inline uint64_t alignRecord(const uint64_t size) {
+    return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+inline uint64_t hashKey(const StringRef key) {
+    MD5 hash;
+    hash.update(key);
+    MD5::MD5Result result;
+    hash.final(result);
+    uint64_t value = 0;
+    std::memcpy(&value, &result, sizeof(uint64_t));
+    // a hash of 0 marks an empty slot
+    return value ? value : 1;
+}
+
+inline uint64_t newGeneration(const uint64_t current) {
+    const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::max<uint64_t>(now, current + 1);
+}
+
+bool writeAll(const int fd, const char * data, size_t size, off_t offset) {
+    while (size) {
+        const auto n = pwrite(fd, data, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+struct StoreLock {
+    StoreLock(const std::string & path) noexcept
+    : mFd(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666)) {
+        if (mFd >= 0 && flock(mFd, LOCK_EX) != 0) {
+            ::close(mFd);
+            mFd = -1;
+        }
+    }
+    bool locked() const noexcept {
+        return mFd >= 0;
+    }
+    ~StoreLock() noexcept {
+        if (mFd >= 0) {
+            flock(mFd, LOCK_UN);
+            ::close(mFd);
+        }
+    }
+private:
+    int mFd;
+};
+
+}
+
+struct ObjectCacheStore::Header {
+    uint64_t Magic;
+    // the data file of an index is named after its generation, which changes with each compaction
+    uint64_t Generation;
+    std::atomic<uint64_t> DataSize;
+    std::atomic<uint64_t> LiveBytes;
+    std::atomic<uint64_t> LiveEntries;
+    std::atomic<uint64_t> UsedSlots;
+    std::atomic<uint64_t> Clock;
+    uint64_t Reserved;
+};
+
+struct ObjectCacheStore::Slot {
+    std::atomic<uint64_t> Hash;
+    uint64_t Offset;
+    uint32_t KeySize;
+    uint32_t ObjectSize;
+    uint32_t StubSize;
+    std::atomic<uint32_t> Deleted;
+    std::atomic<uint64_t> LastUse;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "the index is shared between processes as plain memory");
+
+#define INDEX_FILE_SIZE (sizeof(Header) + NUM_OF_SLOTS * sizeof(Slot))
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getDataPath
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::string ObjectCacheStore::getDataPath(const uint64_t generation) const {
+    return mDataPrefix + std::to_string(generation) + ".data";
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief openMapping
+ *
+ * Map the current index and its data file. A concurrent compaction may replace the index and remove its data file
+ * between the two so retry a few times before giving up.
+ ** ------------------------------------------------------------------------------------------------------------- */
+ObjectCacheStore::Mapping * ObjectCacheStore::openMapping() const noexcept {
+    for (unsigned attempt = 0; attempt < 3; ++attempt) {
+        const int indexFd = ::open(mIndexPath.c_str(), O_RDWR | O_CLOEXEC);
+        if (indexFd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(indexFd, &st) != 0 || static_cast<uint64_t>(st.st_size) != INDEX_FILE_SIZE) {
+            ::close(indexFd);
+            return nullptr;
+        }
+        void * const index = mmap(nullptr, INDEX_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+        if (index == MAP_FAILED) {
+            ::close(indexFd);
+            return nullptr;
+        }
+        Header * const header = reinterpret_cast<Header *>(index);
+        if (header->Magic != STORE_MAGIC) {
+            munmap(index, INDEX_FILE_SIZE);
+            ::close(indexFd);
+            return nullptr;
+        }
+        const int dataFd = ::open(getDataPath(header->Generation).c_str(), O_RDWR | O_CLOEXEC);
+        if (dataFd < 0) {
+            munmap(index, INDEX_FILE_SIZE);
+            ::close(indexFd);
+            continue;
+        }
+        // reserve the address range of the largest data file up front so that records appended by any process
+        // are readable without remapping; only the part of it written so far is ever accessed.
+        void * const data = mmap(nullptr, mDataReserve, PROT_READ, MAP_SHARED, dataFd, 0);
+        if (data == MAP_FAILED) {
+            munmap(index, INDEX_FILE_SIZE);
+            ::close(indexFd);
+            ::close(dataFd);
+            return nullptr;
+        }
+        Mapping * const mapping = new Mapping();
+        mapping->Index = header;
+        mapping->Slots = reinterpret_cast<Slot *>(header + 1);
+        mapping->Data = reinterpret_cast<const char *>(data);
+        mapping->DataMapSize = mDataReserve;
+        mapping->IndexFd = indexFd;
+        mapping->DataFd = dataFd;
+        return mapping;
+    }
+    return nullptr;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief createIndex
+ *
+ * Create an empty data file of the given generation and an empty index for it. Must be called with the store lock.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool ObjectCacheStore::createIndex(const uint64_t generation) const noexcept {
+    const auto dataPath = getDataPath(generation);
+    const int dataFd = ::open(dataPath.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (dataFd < 0) {
+        return false;
+    }
+    ::close(dataFd);
+    const auto tempPath = mIndexPath + "." + std::to_string(getpid());
+    const int indexFd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    Header header = {};
+    header.Magic = STORE_MAGIC;
+    header.Generation = generation;
+    const bool written = (indexFd >= 0) && ftruncate(indexFd, INDEX_FILE_SIZE) == 0 &&
+                         writeAll(indexFd, reinterpret_cast<const char *>(&header), sizeof(Header), 0);
+    if (indexFd >= 0) {
+        ::close(indexFd);
+    }
+    if (!written || rename(tempPath.c_str(), mIndexPath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        unlink(dataPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief isCurrent
+ *
+ * Is the given mapping still of the index file in the cache directory?
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool ObjectCacheStore::isCurrent(const Mapping * const mapping) const noexcept {
+    struct stat current, mapped;
+    if (stat(mIndexPath.c_str(), &current) != 0 || fstat(mapping->IndexFd, &mapped) != 0) {
+        return false;
+    }
+    return current.st_dev == mapped.st_dev && current.st_ino == mapped.st_ino;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief retire
+ *
+ * A replaced mapping cannot be unmapped until the store is destroyed as entries returned from it may be in use.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void ObjectCacheStore::retire(Mapping * const mapping) noexcept {
+    mRetired.push_back(mapping);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief find
+ ** ------------------------------------------------------------------------------------------------------------- */
+ObjectCacheStore::Slot * ObjectCacheStore::find(const Mapping * const mapping, StringRef key, const uint64_t hash) const noexcept {
+    const uint64_t dataSize = mapping->Index->DataSize.load(std::memory_order_acquire);
+    for (uint64_t i = hash % NUM_OF_SLOTS, probes = 0; probes < NUM_OF_SLOTS; i = (i + 1) % NUM_OF_SLOTS, ++probes) {
+        Slot & slot = mapping->Slots[i];
+        const auto h = slot.Hash.load(std::memory_order_acquire);
+        if (h == 0) {
+            break;
+        }
+        if (h == hash && slot.Deleted.load(std::memory_order_acquire) == 0 && slot.KeySize == key.size()) {
+            const uint64_t end = slot.Offset + slot.KeySize + slot.ObjectSize + slot.StubSize;
+            if (LLVM_LIKELY(end <= dataSize && end <= mapping->DataMapSize) &&
+                std::memcmp(mapping->Data + slot.Offset, key.data(), key.size()) == 0) {
+                return &slot;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief lookup
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool ObjectCacheStore::lookup(StringRef id, Entry & entry) noexcept {
+    const Mapping * const mapping = mMapping.load(std::memory_order_acquire);
+    if (LLVM_UNLIKELY(mapping == nullptr)) {
+        return false;
+    }
+    SmallString<256> key(mKeyPrefix);
+    key.append(id);
+    Slot * const slot = find(mapping, key, hashKey(key));
+    if (slot == nullptr) {
+        return false;
+    }
+    const char * const record = mapping->Data + slot->Offset + slot->KeySize;
+    entry.Object = StringRef(record, slot->ObjectSize);
+    entry.Stub = StringRef(record + slot->ObjectSize, slot->StubSize);
+    slot->LastUse.store(mapping->Index->Clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief remove
+ ** ------------------------------------------------------------------------------------------------------------- */
+void ObjectCacheStore::remove(Mapping * const mapping, Slot * const slot) noexcept {
+    slot->Deleted.store(1, std::memory_order_release);
+    mapping->Index->LiveBytes.fetch_sub(alignRecord(slot->KeySize + slot->ObjectSize + slot->StubSize));
+    mapping->Index->LiveEntries.fetch_sub(1);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief evict
+ *
+ * Delete the least recently used entries until the live entries and a new record of the required size fit within
+ * 7/8ths of the capacity, so that eviction does not occur on every subsequent insertion.
+ ** ------------------------------------------------------------------------------------------------------------- */
+void ObjectCacheStore::evict(Mapping * const mapping, const uint64_t required) noexcept {
+    Header * const header = mapping->Index;
+    std::vector<Slot *> live;
+    live.reserve(header->LiveEntries.load());
+    for (uint64_t i = 0; i < NUM_OF_SLOTS; ++i) {
+        Slot & slot = mapping->Slots[i];
+        if (slot.Hash.load(std::memory_order_relaxed) != 0 && slot.Deleted.load(std::memory_order_relaxed) == 0) {
+            live.push_back(&slot);
+        }
+    }
+    std::sort(live.begin(), live.end(), [](const Slot * a, const Slot * b) {
+        return a->LastUse.load(std::memory_order_relaxed) < b->LastUse.load(std::memory_order_relaxed);
+    });
+    const uint64_t targetBytes = mCapacity - (mCapacity / 8);
+    const uint64_t targetEntries = MAX_LIVE_ENTRIES - (MAX_LIVE_ENTRIES / 8);
+    for (Slot * const slot : live) {
+        if (header->LiveBytes.load() + required <= targetBytes && header->LiveEntries.load() < targetEntries) {
+            break;
+        }
+        remove(mapping, slot);
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief compact
+ *
+ * Copy the live records into the data file of a new generation, build a new index for them and atomically replace
+ * the current index with it. Must be called with the store lock.
+ ** ------------------------------------------------------------------------------------------------------------- */
+ObjectCacheStore::Mapping * ObjectCacheStore::compact(Mapping * const mapping) noexcept {
+    const Header * const header = mapping->Index;
+    const auto generation = newGeneration(header->Generation);
+    const auto dataPath = getDataPath(generation);
+    const auto tempPath = mIndexPath + "." + std::to_string(getpid());
+    const int dataFd = ::open(dataPath.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    const int indexFd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    void * index = MAP_FAILED;
+    if (dataFd >= 0 && indexFd >= 0 && ftruncate(indexFd, INDEX_FILE_SIZE) == 0) {
+        index = mmap(nullptr, INDEX_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+    }
+    bool written = (index != MAP_FAILED);
+    if (written) {
+        Header * const compacted = reinterpret_cast<Header *>(index);
+        Slot * const slots = reinterpret_cast<Slot *>(compacted + 1);
+        uint64_t offset = 0;
+        uint64_t entries = 0;
+        for (uint64_t i = 0; i < NUM_OF_SLOTS && written; ++i) {
+            const Slot & slot = mapping->Slots[i];
+            const auto hash = slot.Hash.load(std::memory_order_acquire);
+            if (hash == 0 || slot.Deleted.load(std::memory_order_relaxed) != 0) {
+                continue;
+            }
+            const uint64_t length = slot.KeySize + slot.ObjectSize + slot.StubSize;
+            written = writeAll(dataFd, mapping->Data + slot.Offset, length, offset);
+            uint64_t j = hash % NUM_OF_SLOTS;
+            while (slots[j].Hash.load(std::memory_order_relaxed) != 0) {
+                j = (j + 1) % NUM_OF_SLOTS;
+            }
+            Slot & target = slots[j];
+            target.Offset = offset;
+            target.KeySize = slot.KeySize;
+            target.ObjectSize = slot.ObjectSize;
+            target.StubSize = slot.StubSize;
+            target.LastUse.store(slot.LastUse.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            target.Hash.store(hash, std::memory_order_relaxed);
+            offset += alignRecord(length);
+            ++entries;
+        }
+        compacted->Magic = STORE_MAGIC;
+        compacted->Generation = generation;
+        compacted->DataSize.store(offset);
+        compacted->LiveBytes.store(offset);
+        compacted->LiveEntries.store(entries);
+        compacted->UsedSlots.store(entries);
+        compacted->Clock.store(header->Clock.load());
+        munmap(index, INDEX_FILE_SIZE);
+    }
+    if (dataFd >= 0) {
+        ::close(dataFd);
+    }
+    if (indexFd >= 0) {
+        ::close(indexFd);
+    }
+    if (!written || rename(tempPath.c_str(), mIndexPath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        unlink(dataPath.c_str());
+        return nullptr;
+    }
+    unlink(getDataPath(header->Generation).c_str());
+    return openMapping();
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief insert
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool ObjectCacheStore::insert(StringRef id, StringRef object, StringRef stub) noexcept {
+    SmallString<256> key(mKeyPrefix);
+    key.append(id);
+    const uint64_t size = alignRecord(key.size() + object.size() + stub.size());
+    if (LLVM_UNLIKELY(size > mCapacity || size > (mDataReserve / 2))) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(mWriteLock);
+    StoreLock lock(mLockPath);
+    if (LLVM_UNLIKELY(!lock.locked())) {
+        return false;
+    }
+
+    // another process may have compacted (or removed) the store since it was mapped
+    Mapping * mapping = mMapping.load(std::memory_order_acquire);
+    if (LLVM_UNLIKELY(mapping == nullptr || !isCurrent(mapping))) {
+        Mapping * current = openMapping();
+        if (current == nullptr && createIndex(newGeneration(0))) {
+            current = openMapping();
+        }
+        if (current == nullptr) {
+            return false;
+        }
+        if (mapping) {
+            retire(mapping);
+        }
+        mMapping.store(current, std::memory_order_release);
+        mapping = current;
+    }
+
+    const auto hash = hashKey(key);
+    if (Slot * const existing = find(mapping, key, hash)) {
+        const char * const record = mapping->Data + existing->Offset + existing->KeySize;
+        if (existing->ObjectSize == object.size() && existing->StubSize == stub.size() &&
+            std::memcmp(record, object.data(), object.size()) == 0 &&
+            std::memcmp(record + existing->ObjectSize, stub.data(), stub.size()) == 0) {
+            return true;
+        }
+        remove(mapping, existing);
+    }
+
+    if (mapping->Index->LiveBytes.load() + size > mCapacity || mapping->Index->LiveEntries.load() >= MAX_LIVE_ENTRIES) {
+        evict(mapping, size);
+    }
+    // reclaim the records of evicted entries once they could make up half of the data file
+    if (mapping->Index->UsedSlots.load() >= MAX_USED_SLOTS || mapping->Index->DataSize.load() + size > 2 * mCapacity) {
+        Mapping * const compacted = compact(mapping);
+        if (LLVM_UNLIKELY(compacted == nullptr)) {
+            return false;
+        }
+        retire(mapping);
+        mMapping.store(compacted, std::memory_order_release);
+        mapping = compacted;
+    }
+
+    Header * const header = mapping->Index;
+    const uint64_t offset = header->DataSize.load(std::memory_order_relaxed);
+    if (LLVM_UNLIKELY(!writeAll(mapping->DataFd, key.data(), key.size(), offset) ||
+                      !writeAll(mapping->DataFd, object.data(), object.size(), offset + key.size()) ||
+                      !writeAll(mapping->DataFd, stub.data(), stub.size(), offset + key.size() + object.size()))) {
+        return false;
+    }
+    // publish the record before the slot that refers to it
+    header->DataSize.store(offset + size, std::memory_order_release);
+    uint64_t i = hash % NUM_OF_SLOTS;
+    while (mapping->Slots[i].Hash.load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) % NUM_OF_SLOTS;
+    }
+    Slot & slot = mapping->Slots[i];
+    slot.Offset = offset;
+    slot.KeySize = key.size();
+    slot.ObjectSize = object.size();
+    slot.StubSize = stub.size();
+    slot.Deleted.store(0, std::memory_order_relaxed);
+    slot.LastUse.store(header->Clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slot.Hash.store(hash, std::memory_order_release);
+    header->LiveBytes.fetch_add(size);
+    header->LiveEntries.fetch_add(1);
+    header->UsedSlots.fetch_add(1);
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getNumOfEntries
+ ** ------------------------------------------------------------------------------------------------------------- */
+uint64_t ObjectCacheStore::getNumOfEntries() const noexcept {
+    const Mapping * const mapping = mMapping.load(std::memory_order_acquire);
+    return mapping ? mapping->Index->LiveEntries.load() : 0;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getLiveBytes
+ ** ------------------------------------------------------------------------------------------------------------- */
+uint64_t ObjectCacheStore::getLiveBytes() const noexcept {
+    const Mapping * const mapping = mMapping.load(std::memory_order_acquire);
+    return mapping ? mapping->Index->LiveBytes.load() : 0;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief constructor
+ ** ------------------------------------------------------------------------------------------------------------- */
+ObjectCacheStore::ObjectCacheStore(StringRef directory, StringRef keyPrefix, const uint64_t capacity) noexcept
+: mIndexPath((directory + "/objects.index").str())
+, mLockPath((directory + "/objects.lock").str())
+, mDataPrefix((directory + "/objects.").str())
+, mKeyPrefix(keyPrefix.str())
+, mCapacity(capacity)
+, mDataReserve(std::max<uint64_t>(capacity * 4, 256ULL << 20))
+, mMapping(nullptr) {
+    Mapping * mapping = openMapping();
+    if (mapping == nullptr) {
+        StoreLock lock(mLockPath);
+        if (lock.locked()) {
+            // another process may have created the store while we waited for the lock
+            mapping = openMapping();
+            if (mapping == nullptr && createIndex(newGeneration(0))) {
+                mapping = openMapping();
+            }
+        }
+    }
+    mMapping.store(mapping, std::memory_order_release);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief destructor
+ ** ------------------------------------------------------------------------------------------------------------- */
+ObjectCacheStore::~ObjectCacheStore() {
+    if (Mapping * const mapping = mMapping.load()) {
+        mRetired.push_back(mapping);
+    }
+    for (Mapping * const mapping : mRetired) {
+        munmap(mapping->Index, INDEX_FILE_SIZE);
+        munmap(const_cast<char *>(mapping->Data), mapping->DataMapSize);
+        ::close(mapping->IndexFd);
+        ::close(mapping->DataFd);
+        delete mapping;
+    }
+}
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2020 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ */
+
+#include <pablo/pablo_fusion.h>
+#include <pablo/builder.hpp>
+#include <pablo/codegenstate.h>
+#include <pablo/pe_integer.h>
+#include <pablo/pe_var.h>
+#include <pablo/pe_zeroes.h>
+#include <kernel/core/kernel_builder.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace kernel;
+using namespace llvm;
+
+namespace pablo {
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief indexOf
+ ** ------------------------------------------------------------------------------------------------------------- */
+inline int indexOf(const Bindings & bindings, const Relationship * const rel) {
+    for (unsigned i = 0; i < bindings.size(); ++i) {
+        if (bindings[i].getRelationship() == rel) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief makeFusedSignature
+ *
+ * Describe each fused kernel and where each of its inputs comes from and its outputs go to.
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::string makeFusedSignature(const std::vector<PabloKernel *> & kernels, const Bindings & inputs, const Bindings & outputs) {
+    std::string tmp;
+    raw_string_ostream out(tmp);
+    for (unsigned i = 0; i < kernels.size(); ++i) {
+        const PabloKernel * const kernel = kernels[i];
+        if (i) {
+            out << ';';
+        }
+        out << (kernel->hasSignature() ? kernel->getSignature() : kernel->getName()) << '(';
+        for (const Binding & input : kernel->getInputStreamSetBindings()) {
+            const Relationship * const rel = input.getRelationship();
+            const auto k = indexOf(inputs, rel);
+            if (k >= 0) {
+                out << 'I' << k;
+            } else {
+                for (unsigned j = 0; j < i; ++j) {
+                    const auto o = indexOf(kernels[j]->getOutputStreamSetBindings(), rel);
+                    if (o >= 0) {
+                        out << 'K' << j << '.' << o;
+                        break;
+                    }
+                }
+            }
+            out << ',';
+        }
+        out << ")(";
+        for (const Binding & output : kernel->getOutputStreamSetBindings()) {
+            const auto k = indexOf(outputs, output.getRelationship());
+            if (k >= 0) {
+                out << 'O' << k;
+            }
+            out << ',';
+        }
+        out << ')';
+    }
+    out.flush();
+    return tmp;
+}
+
+FusedPabloKernelSignature::FusedPabloKernelSignature(const std::vector<PabloKernel *> & kernels, const Bindings & inputs, const Bindings & outputs)
+: mSignature(makeFusedSignature(kernels, inputs, outputs)) {
+
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief isCachable
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool FusedPabloKernel::isCachable() const {
+    for (const PabloKernel * const kernel : mKernels) {
+        if (!kernel->isCachable()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief generatePabloMethod
+ ** ------------------------------------------------------------------------------------------------------------- */
+void FusedPabloKernel::generatePabloMethod() {
+
+    PabloBuilder pb(getEntryScope());
+
+    // Every stream set produced by a fused kernel is represented by a placeholder array Var while the kernels
+    // generate their code. Each of its streams is kept in a zero-initialized local Var.
+    DenseMap<const Relationship *, Var *> arrays;
+    DenseMap<const Var *, std::vector<Var *>> streams;
+    for (unsigned i = 0; i < getNumOfStreamInputs(); ++i) {
+        arrays.insert(std::make_pair(getInputStreamSetBinding(i).getRelationship(), getInput(i)));
+    }
+    for (PabloKernel * const kernel : mKernels) {
+        for (const Binding & output : kernel->getOutputStreamSetBindings()) {
+            Var * const array = makeVariable(makeName(output.getName()), output.getType());
+            std::vector<Var *> local(output.getNumElements());
+            for (unsigned i = 0; i < local.size(); ++i) {
+                local[i] = pb.createVar(output.getName() + std::to_string(i), pb.createZeroes());
+            }
+            arrays.insert(std::make_pair(output.getRelationship(), array));
+            streams.insert(std::make_pair(array, std::move(local)));
+        }
+    }
+
+    for (PabloKernel * const kernel : mKernels) {
+        Vec<Var *, 16> inputs;
+        for (const Binding & input : kernel->getInputStreamSetBindings()) {
+            const auto f = arrays.find(input.getRelationship());
+            assert ("fused kernel input was neither an input of the fused kernel nor produced by a prior kernel" && f != arrays.end());
+            inputs.push_back(f->second);
+        }
+        Vec<Var *, 16> outputs;
+        for (const Binding & output : kernel->getOutputStreamSetBindings()) {
+            outputs.push_back(arrays[output.getRelationship()]);
+        }
+        // Generate the kernel's Pablo code in our entry scope with our symbol table. The kernel may have been
+        // generated (or loaded from the cache) on its own so restore its state afterwards.
+        std::swap(kernel->mInputs, inputs);
+        std::swap(kernel->mOutputs, outputs);
+        PabloBlock * const entryScope = kernel->mEntryScope;
+        SymbolGenerator * const symbolTable = kernel->mSymbolTable.release();
+        IntegerType * const sizeTy = kernel->mSizeTy;
+        VectorType * const streamTy = kernel->mStreamTy;
+        LLVMContext * const context = kernel->mContext;
+        kernel->mEntryScope = getEntryScope();
+        kernel->mSymbolTable.reset(mSymbolTable.get());
+        kernel->mSizeTy = mSizeTy;
+        kernel->mStreamTy = mStreamTy;
+        kernel->mContext = mContext;
+        kernel->generatePabloMethod();
+        kernel->mEntryScope = entryScope;
+        kernel->mSymbolTable.release();
+        kernel->mSymbolTable.reset(symbolTable);
+        kernel->mSizeTy = sizeTy;
+        kernel->mStreamTy = streamTy;
+        kernel->mContext = context;
+        std::swap(kernel->mInputs, inputs);
+        std::swap(kernel->mOutputs, outputs);
+    }
+
+    // Replace every element of a placeholder array with the local Var of that stream.
+    const auto n = getNumOfVariables();
+    for (unsigned i = 0; i < n; ++i) {
+        Var * const var = getVariable(i);
+        if (isa<Extract>(var)) {
+            Extract * const extract = cast<Extract>(var);
+            const auto f = streams.find(extract->getArray());
+            if (f != streams.end()) {
+                const std::vector<Var *> & local = f->second;
+                const PabloAST * const index = extract->getIndex();
+                if (LLVM_UNLIKELY(!isa<Integer>(index) || cast<Integer>(index)->value() >= local.size())) {
+                    report_fatal_error(getName() + ": a fused kernel accesses a stream set with a variable or invalid index");
+                }
+                extract->replaceAllUsesWith(local[cast<Integer>(index)->value()]);
+            }
+        } else if (LLVM_UNLIKELY(streams.count(var) && var->getNumUses() != 0)) {
+            report_fatal_error(getName() + ": a fused kernel accesses a stream set as a whole");
+        }
+    }
+
+    // Write out any stream set that is also used outside of this kernel.
+    for (unsigned i = 0; i < getNumOfStreamOutputs(); ++i) {
+        const auto & local = streams[arrays[getOutputStreamSetBinding(i).getRelationship()]];
+        for (unsigned j = 0; j < local.size(); ++j) {
+            pb.createAssign(pb.createExtract(getOutput(i), pb.getInteger(j)), local[j]);
+        }
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief constructor
+ ** ------------------------------------------------------------------------------------------------------------- */
+FusedPabloKernel::FusedPabloKernel(BuilderRef b, std::vector<PabloKernel *> && kernels, Bindings && inputs, Bindings && outputs)
+: FusedPabloKernelSignature(kernels, inputs, outputs)
+, PabloKernel(b, "PabloFusion" + std::to_string(kernels.size()) + "_" + getStringHash(mSignature), std::move(inputs), std::move(outputs))
+, mKernels(std::move(kernels)) {
+    setStride(mKernels.front()->getStride());
+}
+
+}
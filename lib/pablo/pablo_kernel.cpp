@@ -6,6 +6,7 @@
 #include <pablo/pablo_kernel.h>
 #include <pablo/codegenstate.h>
 #include <pablo/pablo_compiler.h>
+#include <pablo/pablo_fusion.h>
 #include <pablo/pe_var.h>
 #include <pablo/pe_zeroes.h>
 #include <pablo/pe_ones.h>
@@ -35,14 +36,36 @@ std::unique_ptr<KernelCompiler> PabloKernel::instantiateKernelCompiler(BuilderRe
     return std::make_unique<PabloCompiler>(const_cast<PabloKernel *>(this));
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getStreamPort
+ *
+ * A kernel that is part of a FusedPabloKernel generates its method without a compiler of its own.
+ ** ------------------------------------------------------------------------------------------------------------- */
+PabloKernel::StreamSetPort PabloKernel::getStreamPort(const std::string & name) const {
+    if (LLVM_LIKELY(mPabloCompiler != nullptr)) {
+        return mPabloCompiler->getStreamPort(name);
+    }
+    for (unsigned i = 0; i < mInputStreamSets.size(); ++i) {
+        if (mInputStreamSets[i].getName() == name) {
+            return StreamSetPort{PortType::Input, i};
+        }
+    }
+    for (unsigned i = 0; i < mOutputStreamSets.size(); ++i) {
+        if (mOutputStreamSets[i].getName() == name) {
+            return StreamSetPort{PortType::Output, i};
+        }
+    }
+    report_fatal_error(getName() + " does not contain a stream set named " + name);
+}
+
 Var * PabloKernel::getInputStreamVar(const std::string & name) {
-    const auto port = mPabloCompiler->getStreamPort(name);
+    const auto port = getStreamPort(name);
     assert (port.Type == PortType::Input);
     return mInputs[port.Number];
 }
 
 std::vector<PabloAST *> PabloKernel::getInputStreamSet(const std::string & name) {
-    const auto port = mPabloCompiler->getStreamPort(name);
+    const auto port = getStreamPort(name);
     assert (port.Type == PortType::Input);
     const Binding & input = getInputStreamSetBinding(port.Number);
     const auto numOfStreams = IDISA::getNumOfStreams(input.getType());
@@ -54,7 +77,7 @@ std::vector<PabloAST *> PabloKernel::getInputStreamSet(const std::string & name)
 }
 
 Var * PabloKernel::getOutputStreamVar(const std::string & name) {
-    const auto port = mPabloCompiler->getStreamPort(name);
+    const auto port = getStreamPort(name);
     assert (port.Type == PortType::Output);
     return mOutputs[port.Number];
 }
@@ -241,6 +264,41 @@ bool PabloKernel::requiresExplicitPartialFinalStride() const {
     return true;
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief isFusable
+ *
+ * Pablo code can only refer to stream sets; any kernel or binding attribute, processing rate other than
+ * FixedRate(1) or scalar would have to be reconciled with those of the other fused kernels.
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool PabloKernel::isFusable() const {
+    if (!getAttributes().empty() || hasFamilyName() || getNumOfScalarInputs() != 0 || getNumOfScalarOutputs() != 0) {
+        return false;
+    }
+    auto isFixedRateStream = [](const Bindings & bindings) {
+        for (const Binding & binding : bindings) {
+            const ProcessingRate & rate = binding.getRate();
+            if (!rate.isFixed() || rate.getRate() != 1U || !binding.getAttributes().empty() || binding.getFieldWidth() != 1) {
+                return false;
+            }
+        }
+        return true;
+    };
+    return isFixedRateStream(mInputStreamSets) && isFixedRateStream(mOutputStreamSets);
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief makeFusedKernel
+ ** ------------------------------------------------------------------------------------------------------------- */
+Kernel * PabloKernel::makeFusedKernel(BuilderRef b, std::vector<Kernel *> && kernels, Bindings && inputs, Bindings && outputs) const {
+    std::vector<PabloKernel *> members;
+    members.reserve(kernels.size());
+    for (Kernel * const kernel : kernels) {
+        assert ("only Pablo kernels can be fused with a Pablo kernel" && kernel->isFusable());
+        members.push_back(static_cast<PabloKernel *>(kernel));
+    }
+    return new FusedPabloKernel(b, std::move(members), std::move(inputs), std::move(outputs));
+}
+
 String * PabloKernel::makeName(const llvm::StringRef prefix) const {
     return mSymbolTable->makeString(prefix);
 }
@@ -0,0 +1,185 @@
+#include <re/analysis/required_literal.h>
+
+#include <algorithm>
+#include <re/adt/adt.h>
+
+using namespace llvm;
+namespace re {
+
+//  Required literals are computed bottom-up.   For each RE we determine
+//  a prefix that every match begins with, a suffix that every match ends
+//  with and the longest literal found to occur within every match.   An RE
+//  is exact if every match is a string of its prefix (which is then also
+//  its suffix and its required literal).   Zero-length assertions are exact
+//  with an empty literal; anything whose matches cannot be described by a
+//  literal (Any, named properties, ...) has no prefix, suffix or literal.
+
+using Literal = std::vector<CC *>;
+
+// Bound the literals considered, so that long fixed strings or large
+// repetition counts do not produce unbounded sequences.
+const unsigned MaxLiteralLength = 32;
+
+struct LiteralInfo {
+    bool exact;
+    Literal prefix;
+    Literal suffix;
+    Literal required;
+};
+
+static LiteralInfo exactInfo(Literal lit) {
+    if (lit.size() > MaxLiteralLength) {
+        // A truncated literal is still a prefix, suffix or substring of every match,
+        // but no longer the entire match.
+        Literal suffix(lit.end() - MaxLiteralLength, lit.end());
+        lit.resize(MaxLiteralLength);
+        return LiteralInfo{false, lit, suffix, lit};
+    }
+    return LiteralInfo{true, lit, lit, lit};
+}
+
+static LiteralInfo unknownInfo() {
+    return LiteralInfo{false, {}, {}, {}};
+}
+
+static Literal concat(const Literal & a, const Literal & b) {
+    Literal c(a);
+    c.insert(c.end(), b.begin(), b.end());
+    return c;
+}
+
+static const Literal & longest(const Literal & a, const Literal & b) {
+    return (b.size() > a.size()) ? b : a;
+}
+
+static LiteralInfo seqInfo(const LiteralInfo & a, const LiteralInfo & b) {
+    if (a.exact && b.exact) {
+        return exactInfo(concat(a.prefix, b.prefix));
+    }
+    LiteralInfo r;
+    r.exact = false;
+    r.prefix = a.exact ? concat(a.prefix, b.prefix) : a.prefix;
+    if (r.prefix.size() > MaxLiteralLength) {
+        r.prefix.resize(MaxLiteralLength);
+    }
+    r.suffix = b.exact ? concat(a.suffix, b.suffix) : b.suffix;
+    if (r.suffix.size() > MaxLiteralLength) {
+        r.suffix.erase(r.suffix.begin(), r.suffix.end() - MaxLiteralLength);
+    }
+    // The suffix of a is immediately followed by the prefix of b.
+    Literal joined = concat(a.suffix, b.prefix);
+    if (joined.size() > MaxLiteralLength) {
+        joined.resize(MaxLiteralLength);
+    }
+    r.required = longest(longest(a.required, b.required), longest(joined, longest(r.prefix, r.suffix)));
+    return r;
+}
+
+// Form the position-wise union of literals, all of which have at least lgth classes.
+static Literal unionOf(const std::vector<Literal> & lits, const unsigned lgth, const bool fromEnd) {
+    Literal u;
+    for (unsigned i = 0; i < lgth; ++i) {
+        CC * cc = nullptr;
+        for (const Literal & lit : lits) {
+            CC * const c = fromEnd ? lit[lit.size() - lgth + i] : lit[i];
+            cc = (cc == nullptr) ? c : makeCC(cc, c);
+        }
+        u.push_back(cc);
+    }
+    return u;
+}
+
+static LiteralInfo altInfo(const std::vector<LiteralInfo> & alts) {
+    if (alts.empty()) {
+        return unknownInfo();
+    }
+    bool allExact = true;
+    unsigned minPrefix = MaxLiteralLength;
+    unsigned minSuffix = MaxLiteralLength;
+    std::vector<Literal> prefixes;
+    std::vector<Literal> suffixes;
+    for (const LiteralInfo & a : alts) {
+        allExact &= a.exact && (a.prefix.size() == alts[0].prefix.size());
+        minPrefix = std::min<unsigned>(minPrefix, a.prefix.size());
+        minSuffix = std::min<unsigned>(minSuffix, a.suffix.size());
+        prefixes.push_back(a.prefix);
+        suffixes.push_back(a.suffix);
+    }
+    if (allExact) {
+        return exactInfo(unionOf(prefixes, minPrefix, false));
+    }
+    LiteralInfo r;
+    r.exact = false;
+    r.prefix = unionOf(prefixes, minPrefix, false);
+    r.suffix = unionOf(suffixes, minSuffix, true);
+    r.required = longest(r.prefix, r.suffix);
+    return r;
+}
+
+static LiteralInfo repInfo(const LiteralInfo & body, const int lb, const int ub) {
+    if (lb == 0) {
+        return unknownInfo();
+    }
+    if (body.exact) {
+        Literal rpt;
+        for (int i = 0; (i < lb) && (rpt.size() <= MaxLiteralLength); ++i) {
+            rpt = concat(rpt, body.prefix);
+        }
+        LiteralInfo r = exactInfo(rpt);
+        if (lb != ub) {
+            r.exact = false;
+        }
+        return r;
+    }
+    LiteralInfo r = body;
+    if (lb > 1) {
+        // Consecutive repetitions join the suffix of one to the prefix of the next.
+        Literal joined = concat(body.suffix, body.prefix);
+        if (joined.size() > MaxLiteralLength) {
+            joined.resize(MaxLiteralLength);
+        }
+        r.required = longest(r.required, joined);
+    }
+    return r;
+}
+
+static LiteralInfo analyze(RE * re) {
+    if (CC * cc = dyn_cast<CC>(re)) {
+        if ((cc->getAlphabet() == &cc::Unicode) && !cc->empty()) {
+            return exactInfo({cc});
+        }
+        return unknownInfo();
+    } else if (Name * n = dyn_cast<Name>(re)) {
+        if (n->getDefinition()) {
+            return analyze(n->getDefinition());
+        }
+        return unknownInfo();
+    } else if (Capture * c = dyn_cast<Capture>(re)) {
+        return analyze(c->getCapturedRE());
+    } else if (Group * g = dyn_cast<Group>(re)) {
+        return analyze(g->getRE());
+    } else if (Seq * seq = dyn_cast<Seq>(re)) {
+        LiteralInfo r = exactInfo({});
+        for (RE * e : *seq) {
+            r = seqInfo(r, analyze(e));
+        }
+        return r;
+    } else if (Alt * alt = dyn_cast<Alt>(re)) {
+        std::vector<LiteralInfo> alts;
+        for (RE * a : *alt) {
+            alts.push_back(analyze(a));
+        }
+        return altInfo(alts);
+    } else if (Rep * rep = dyn_cast<Rep>(re)) {
+        return repInfo(analyze(rep->getRE()), rep->getLB(), rep->getUB());
+    } else if (isa<Assertion>(re) || isa<Start>(re) || isa<End>(re)) {
+        return exactInfo({});
+    }
+    return unknownInfo();  // Any, Diff, Intersect, Range, Reference
+}
+
+std::vector<CC *> requiredLiteral(RE * re) {
+    return analyze(re).required;
+}
+
+}
@@ -8,6 +8,7 @@
 #include <toolchain/pablo_toolchain.h>
 #include <unicode/core/UCD_Config.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/ErrorHandling.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/raw_ostream.h>
 #include <boost/interprocess/mapped_region.hpp>
@@ -50,7 +51,8 @@ DebugOptions(cl::desc("Debugging Options"), cl::values(clEnumVal(VerifyIR, "Run
                                                            "executions due to insufficient data/space of a "
                                                            "particular stream."),
                         clEnumVal(DisableIndirectBranch, "Disable use of indirect branches in kernel code."),
-                        clEnumVal(PrintPipelineGraph, "Write PipelineKernel graph in dot file format to stderr.")
+                        clEnumVal(PrintPipelineGraph, "Write PipelineKernel graph in dot file format to stderr."),
+                        clEnumVal(DisableMirroredBuffers, "Use copying circular buffers instead of mirrored (multiply mapped) ones.")
                         CL_ENUM_VAL_SENTINEL), cl::cat(CodeGenOptions));
 
 
@@ -95,12 +97,23 @@ BackEndOptOption("backend-optimization-level", cl::location(BackEndOptLevel), cl
 static cl::opt<bool, true> EnableObjectCacheOption("enable-object-cache", cl::location(EnableObjectCache), cl::init(true),
                                                    cl::desc("Enable object caching"), cl::cat(CodeGenOptions));
 
+static cl::opt<bool, true> EnableProgramCacheOption("enable-program-cache", cl::location(EnableProgramCache), cl::init(true),
+                                                    cl::desc("Cache whole programs (pipelines and their main methods) when the object cache is enabled"), cl::cat(CodeGenOptions));
+
 static cl::opt<bool, true> TraceObjectCacheOption("trace-object-cache", cl::location(TraceObjectCache), cl::init(false),
                                                    cl::desc("Trace object cache retrieval."), cl::cat(CodeGenOptions));
 
+static cl::opt<bool, true> ReportObjectCacheMissesOption("report-object-cache-misses", cl::location(ReportObjectCacheMisses), cl::init(false),
+                                                         cl::desc("On exit, report the number of kernels loaded from the object cache and name those that had to be compiled."),
+                                                         cl::cat(CodeGenOptions));
+
 static cl::opt<std::string> ObjectCacheDirOption("object-cache-dir", cl::init(""),
                                                  cl::desc("Path to the object cache diretory"), cl::cat(CodeGenOptions));
 
+static cl::opt<unsigned, true> ObjectCacheSizeOption("object-cache-size", cl::location(ObjectCacheSize), cl::init(1024),
+                                                     cl::desc("Maximum size (in MiB) of the object cache; the least recently used entries are evicted beyond it"),
+                                                     cl::value_desc("positive integer"), cl::cat(CodeGenOptions));
+
 
 static cl::opt<int, true> FreeCallBisectOption("free-bisect-value", cl::location(FreeCallBisectLimit), cl::init(-1),
                                                     cl::desc("The number of free calls to allow in bisecting"), cl::cat(CodeGenOptions));
@@ -117,6 +130,14 @@ static cl::opt<unsigned, true> SegmentSizeOption("segment-size", cl::location(Se
 static cl::opt<unsigned, true> BufferSegmentsOption("buffer-segments", cl::location(BufferSegments), cl::init(1),
                                                cl::desc("Buffer Segments"), cl::value_desc("positive integer"));
 
+static cl::opt<bool, true> AutotuneOption("autotune", cl::location(Autotune), cl::init(false),
+                                          cl::desc("Choose the segment size and buffer segments of each program by timing it on a sample "
+                                                   "of its input and record the choice for this host in the object cache"), cl::cat(CodeGenOptions));
+
+static cl::opt<unsigned, true> MaxRetainedBufferSizeOption("max-retained-buffer-size", cl::location(MaxRetainedBufferSize), cl::init(64 * 1024),
+                                               cl::desc("Maximum size (in KiB) an expanded dynamic buffer keeps when its pipeline is reset; "
+                                                        "any additional memory is returned to the OS."), cl::value_desc("non-negative integer"));
+
 static cl::opt<unsigned, true>
 MaxTaskThreadsOption("max-task-threads", cl::location(TaskThreads),
 #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
@@ -137,6 +158,74 @@ ThreadNumOption("thread-num", cl::location(SegmentThreads),
                 cl::desc("Number of threads used for segment pipeline parallel"),
                 cl::value_desc("positive integer"));
 
+static cl::opt<unsigned, true>
+CompileThreadsOption("compile-threads", cl::location(CompileThreads),
+#if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
+                     cl::init(llvm::sys::getHostNumPhysicalCores()),
+#else
+                     cl::init(2),
+#endif
+                     cl::desc("Number of threads used to compile uncached kernels into object code."),
+                     cl::value_desc("positive integer"), cl::cat(CodeGenOptions));
+
+static cl::opt<bool, true>
+TieredCompilationOption("tiered-compilation", cl::location(TieredCompilation), cl::init(false),
+                        cl::desc("Start with quickly compiled kernels and replace each kernel with a fully optimized "
+                                 "one, compiled in the background, once it becomes hot."), cl::cat(CodeGenOptions));
+
+static cl::opt<unsigned, true>
+TieredCompilationThresholdOption("tiered-compilation-threshold", cl::location(TieredCompilationThreshold), cl::init(64),
+                                 cl::desc("Number of segments a quickly compiled kernel must process before it is "
+                                          "recompiled at full optimization."),
+                                 cl::value_desc("positive integer"), cl::cat(CodeGenOptions));
+
+static cl::opt<bool, true>
+KernelFusionOption("kernel-fusion", cl::location(KernelFusion), cl::init(false),
+                   cl::desc("Fuse chains of adjacent fixed-rate Pablo kernels into single kernels so that the stream "
+                            "sets between them are kept in registers rather than buffers."), cl::cat(CodeGenOptions));
+
+static cl::opt<ThreadPlacementPolicy, true>
+ThreadPlacementOption("thread-placement", cl::location(ThreadPlacement), cl::init(LinearPlacement),
+                      cl::desc("Placement of the segment threads of a pipeline:"),
+                      cl::values(clEnumValN(LinearPlacement, "linear", "pin thread i to CPU i (default)"),
+                                 clEnumValN(CompactPlacement, "compact", "fill the CPUs of each NUMA node before using the next"),
+                                 clEnumValN(ScatterPlacement, "scatter", "pin threads to CPUs of the NUMA nodes in round-robin order"),
+                                 clEnumValN(NodePlacement, "node", "bind threads to all CPUs of the NUMA nodes in round-robin order")
+                      CL_ENUM_VAL_SENTINEL), cl::cat(CodeGenOptions));
+
+static cl::opt<ISATierLevel, true>
+ISATierOption("isa-tier", cl::location(ISATier), cl::init(AutoTier),
+              cl::desc("Instruction set tier that kernels are generated and compiled for:"),
+              cl::values(clEnumValN(AutoTier, "auto", "the widest tier supported by this host (default)"),
+                         clEnumValN(SSE2Tier, "sse2", "x86-64 baseline (SSE2)"),
+                         clEnumValN(AVX2Tier, "avx2", "x86-64-v3 (AVX2, BMI2, FMA)"),
+                         clEnumValN(AVX512Tier, "avx512", "x86-64-v4 (AVX512F/BW/CD/DQ/VL)"),
+                         clEnumValN(NativeTier, "native", "every feature of this host; objects are only shared with hosts of the same CPU")
+              CL_ENUM_VAL_SENTINEL), cl::cat(CodeGenOptions));
+
+static cl::opt<bool, true>
+AsyncReadOption("async-read", cl::location(AsyncRead), cl::init(true),
+                cl::desc("Read pipes and other inputs that cannot be memory mapped on a separate I/O thread, "
+                         "ahead of the pipeline, rather than blocking the pipeline on each read."), cl::cat(CodeGenOptions));
+
+static cl::opt<bool, true>
+ZeroCopyOutputOption("zero-copy-output", cl::location(ZeroCopyOutput), cl::init(true),
+                     cl::desc("Hand bulk output to a pipe by mapping the pages of the output buffer into it (vmsplice) "
+                              "and write output to a file in page-aligned batches, rather than writing each segment."),
+                     cl::cat(CodeGenOptions));
+
+static cl::opt<bool, true>
+SplicePipeOutputOption("splice-pipe-output", cl::location(SplicePipeOutput), cl::init(false),
+                       cl::desc("With -zero-copy-output, map bulk output into a pipe (vmsplice) rather than copying it. "
+                                "Only safe if the reader consumes the pipe with read: a reader that splices or tees the "
+                                "pages onward would see them overwritten."),
+                       cl::cat(CodeGenOptions));
+
+static cl::opt<bool, true>
+BlockingSynchronizationOption("blocking-sync", cl::location(BlockingSynchronization), cl::init(false),
+                              cl::desc("Pipeline threads waiting on a segment spin briefly and then sleep until it is "
+                                       "released, rather than spinning until it is released."));
+
 static cl::opt<unsigned, true> ScanBlocksOption("scan-blocks", cl::location(ScanBlocks), cl::init(4),
                                           cl::desc("Number of blocks per stride for scanning kernels"), cl::value_desc("positive initeger"));
 
@@ -147,6 +236,12 @@ std::string TraceOption = "";
 static cl::opt<std::string, true> TraceValueOption("trace", cl::location(TraceOption),
                                             cl::desc("Trace the values of variables beginning with the given prefix."), cl::value_desc("prefix"), cl::cat(CodeGenOptions));
 
+std::string KernelTimelineOption = OmittedOption;
+static cl::opt<std::string, true> KernelTimelineOutputOption("kernel-timeline", cl::location(KernelTimelineOption), cl::ValueOptional,
+                                                  cl::desc("Record when each thread executes, waits on or expands the buffers of each kernel and "
+                                                           "write the timeline as a Chrome trace (JSON) to kernel-timeline.json or the given file"),
+                                                  cl::value_desc("filename"), cl::cat(CodeGenOptions));
+
 std::string CCCOption = "";
 static cl::opt<std::string, true> CCTypeOption("ccc-type", cl::location(CCCOption), cl::init("binary"),
                                             cl::desc("The character class compiler"), cl::value_desc("[binary, ternary]"));
@@ -159,19 +254,34 @@ CodeGenOpt::Level OptLevel;
 CodeGenOpt::Level BackEndOptLevel;
 
 const char * ObjectCacheDir;
+unsigned ObjectCacheSize;
 
 unsigned BlockSize;
 
 unsigned SegmentSize;
 
 unsigned BufferSegments;
+bool Autotune;
+unsigned MaxRetainedBufferSize;
 unsigned TaskThreads;
 unsigned SegmentThreads;
+ThreadPlacementPolicy ThreadPlacement;
+ISATierLevel ISATier;
+unsigned CompileThreads;
+bool TieredCompilation;
+unsigned TieredCompilationThreshold;
+bool KernelFusion;
+bool BlockingSynchronization;
+bool AsyncRead;
+bool ZeroCopyOutput;
+bool SplicePipeOutput;
 
 unsigned ScanBlocks;
 
 bool EnableObjectCache;
+bool EnableProgramCache;
 bool TraceObjectCache;
+bool ReportObjectCacheMisses;
 
 unsigned CacheDaysLimit;
 
@@ -247,6 +357,99 @@ void AddParabixVersionPrinter() {
     cl::AddExtraVersionPrinter(&printParabixVersion);
 }
 
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getISATierFeatures
+ *
+ * The features of the x86-64 microarchitecture levels 1, 3 and 4 that are reported by the host (the remaining ones
+ * are implied by the generic x86-64 target.)
+ ** ------------------------------------------------------------------------------------------------------------- */
+inline std::vector<StringRef> getISATierFeatures(const ISATierLevel tier) {
+    std::vector<StringRef> features{"sse", "sse2"};
+    if (tier == SSE2Tier) {
+        return features;
+    }
+    features.insert(features.end(), {"cx16", "popcnt", "sse3", "ssse3", "sse4.1", "sse4.2",
+                                     "avx", "avx2", "bmi", "bmi2", "f16c", "fma", "lzcnt", "movbe"});
+    if (tier == AVX2Tier) {
+        return features;
+    }
+    features.insert(features.end(), {"avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl"});
+    return features;
+}
+
+bool isISATierSupported(const ISATierLevel tier) {
+    StringMap<bool> host;
+    if (!sys::getHostCPUFeatures(host)) {
+        return tier == NativeTier;
+    }
+    if (tier == AutoTier || tier == NativeTier) {
+        return true;
+    }
+    for (const auto feature : getISATierFeatures(tier)) {
+        if (!host.lookup(feature)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+StringRef getISATierName(const ISATierLevel tier) {
+    switch (tier) {
+        case AutoTier: return "auto";
+        case SSE2Tier: return "sse2";
+        case AVX2Tier: return "avx2";
+        case AVX512Tier: return "avx512";
+        case NativeTier: return "native";
+    }
+    llvm_unreachable("unknown ISA tier");
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief getSelectedISATier
+ ** ------------------------------------------------------------------------------------------------------------- */
+inline ISATierLevel getSelectedISATier() {
+    if (ISATier == AutoTier) {
+        // hosts without any of the tiers (i.e., other than x86-64) only have their native features
+        for (const auto tier : {AVX512Tier, AVX2Tier, SSE2Tier}) {
+            if (isISATierSupported(tier)) {
+                return tier;
+            }
+        }
+        return NativeTier;
+    }
+    if (LLVM_UNLIKELY(!isISATierSupported(ISATier))) {
+        report_fatal_error("-isa-tier=" + getISATierName(ISATier) + " is not supported by this host");
+    }
+    return ISATier;
+}
+
+const StringMap<bool> & getTargetCPUFeatures() {
+    static const StringMap<bool> features = [] {
+        StringMap<bool> features;
+        const auto tier = getSelectedISATier();
+        if (tier == NativeTier) {
+            sys::getHostCPUFeatures(features);
+        } else {
+            for (const auto feature : getISATierFeatures(tier)) {
+                features[feature] = true;
+            }
+        }
+        return features;
+    }();
+    return features;
+}
+
+const std::string & getISATargetName() {
+    static const std::string name = [] {
+        const auto tier = getSelectedISATier();
+        if (tier == NativeTier) {
+            return "native-" + sys::getHostCPUName().str();
+        }
+        return getISATierName(tier).str();
+    }();
+    return name;
+}
+
 void setTaskThreads(unsigned taskThreads) {
     TaskThreads = std::max(taskThreads, 1u);
 #if LLVM_VERSION_INTEGER >= LLVM_VERSION_CODE(4, 0, 0)
@@ -59,13 +59,13 @@ size_t file_size(const int fd) {
     return st.st_size;
 }
 
-void base64(base64FunctionType fn_ptr, const std::string & fileName) {
+void base64(ProgramInstance<void, uint32_t> & encode, const std::string & fileName) {
     const int fd = open(fileName.c_str(), O_RDONLY);
     if (LLVM_UNLIKELY(fd == -1)) {
         std::cerr << "Error: cannot open " << fileName << " for processing. Skipped.\n";
         return;
     }
-    fn_ptr(fd);
+    encode(fd);
     close(fd);
 }
 
@@ -79,8 +79,11 @@ int main(int argc, char *argv[]) {
     papi::PapiCounter<3> jitExecution{{PAPI_FUL_ICY, PAPI_STL_CCY, PAPI_RES_STL}};
     jitExecution.start();
     #endif
-    for (unsigned i = 0; i != inputFiles.size(); ++i) {
-        base64(fn_ptr, inputFiles[i]);
+    {
+        ProgramInstance<void, uint32_t> encode(pxDriver, fn_ptr);
+        for (unsigned i = 0; i != inputFiles.size(); ++i) {
+            base64(encode, inputFiles[i]);
+        }
     }
     #ifdef REPORT_PAPI_TESTS
     jitExecution.stop();
@@ -157,6 +157,9 @@ bool OnlyMatchingFlag;
 static cl::opt<bool, true> OnlyMatchingOption("o", cl::location(OnlyMatchingFlag), cl::desc("Display only the exact strings that match the pattern, with possibly multiple matches per line."), cl::cat(Output_Options), cl::Grouping);
 static cl::alias OnlyMatchingAlias("only-matching", cl::desc("Alias for -o"), cl::aliasopt(OnlyMatchingOption));
 
+bool PatternIdsFlag;
+static cl::opt<bool, true> PatternIdsOption("pattern-ids", cl::location(PatternIdsFlag), cl::desc("Show the numbers of the patterns matching each line (with -c, the count of each pattern)."), cl::cat(Output_Options));
+
 std::string LabelFlag;
     static cl::opt<std::string, true> LabelOption("label", cl::location(LabelFlag), cl::init("(standard input)"),
                                               cl::desc("Set a label for input lines matched from stdin."), cl::cat(Output_Options));
@@ -230,15 +233,6 @@ void InitializeCommandLineInterface(int argc, char *argv[]) {
     if (BinaryFlag) {
         llvm::report_fatal_error("Sorry, -U is not yet supported.\n");
     }
-    if (ByteOffsetFlag) {
-        llvm::report_fatal_error("Sorry, -b is not yet supported.\n");
-    }
-    if (UnixByteOffsetsFlag) {
-        llvm::report_fatal_error("Sorry, -u is not yet supported.\n");
-    }
-    if (OnlyMatchingFlag) {
-        llvm::report_fatal_error("Sorry, -o is not yet supported.\n");
-    }
     if (LineBufferedFlag) {
         llvm::report_fatal_error("Sorry, -line-buffered is not yet supported.\n");
     }
@@ -249,5 +243,13 @@ void InitializeCommandLineInterface(int argc, char *argv[]) {
     if ((Mode == QuietMode) | (Mode == FilesWithMatch) | (Mode == FilesWithoutMatch)) {
         MaxCountFlag = 1;
     }
+    // Pattern ids are only reported with -c or for the lines that are output.
+    if (PatternIdsFlag && ((Mode == CountOnly) || (Mode == NormalMode))) {
+        const bool onlyMatching = OnlyMatchingFlag && (Mode == NormalMode);
+        if (InvertMatchFlag || onlyMatching || (AfterContext != 0) || (BeforeContext != 0)) {
+            llvm::errs() << "icgrep: --pattern-ids cannot be used with -v, -o or context lines.\n";
+            exit(UsageErrorCode);
+        }
+    }
 }
 }
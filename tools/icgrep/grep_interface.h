@@ -75,6 +75,7 @@ extern bool ByteOffsetFlag; // -b
 extern bool UnixByteOffsetsFlag; // -u
 extern bool InitialTabFlag; // -T
 extern bool OnlyMatchingFlag; // -o
+extern bool PatternIdsFlag; // -pattern-ids
 extern std::string LabelFlag; // -label
 extern bool LineBufferedFlag; // -line-buffered
 extern int AfterContext; // -A or -C
@@ -78,7 +78,8 @@ std::vector<re::RE *> readExpressions() {
 
     // If there are multiple REs, combine them into groups.
     // A separate kernel will be created for each group.
-    if (REs.size() > 1) {
+    // Pattern ids require a separate kernel for each RE.
+    if ((REs.size() > 1) && !argv::PatternIdsFlag) {
         if (REsPerGroup == 0) {
             // If no grouping factor is specified, we use a default formula.
             REsPerGroup = (REs.size() + codegen::SegmentThreads) / (codegen::SegmentThreads + 1);
@@ -135,11 +136,16 @@ int main(int argc, char *argv[]) {
             if (argv::WithFilenameFlag) grep->showFileNames();
             if (argv::LineNumberFlag) grep->showLineNumbers();
             if (argv::InitialTabFlag) grep->setInitialTab();
+            if (argv::OnlyMatchingFlag) grep->setOnlyMatching();
+            if (argv::ByteOffsetFlag) grep->setByteOffsets();
+            if (argv::UnixByteOffsetsFlag) grep->setUnixByteOffsets();
+            if (argv::PatternIdsFlag) grep->setPatternIds();
            break;
         case argv::CountOnly:
             grep = std::make_unique<grep::CountOnlyEngine>(driver);
             if (argv::WithFilenameFlag) grep->showFileNames();
             if (argv::MaxCountFlag) grep->setMaxCount(argv::MaxCountFlag);
+            if (argv::PatternIdsFlag) grep->setPatternIds();
            break;
         case argv::FilesWithMatch:
         case argv::FilesWithoutMatch:
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ *
+ *  icgrepc: submit an icgrep query to a running icgrepd server.
+ *
+ *  Usage: icgrepc [--socket=<path>] [--stats] <icgrep arguments ...>
+ *
+ *  The output of the query is written to stdout/stderr as icgrep would have
+ *  written it and the exit code is that of the query.   With --stats, the time
+ *  the server spent compiling and searching is reported on stderr.
+ */
+
+#include "icgrepd.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace icgrepd;
+
+int main(int argc, char *argv[]) {
+    std::string socketPath = defaultSocketPath();
+    bool showStats = false;
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+        perror("icgrepc: getcwd");
+        return 2;
+    }
+    std::vector<std::string> query{cwd};
+    int i = 1;
+    for (; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg.compare(0, 9, "--socket=") == 0) {
+            socketPath = arg.substr(9);
+        } else if (arg == "--stats") {
+            showStats = true;
+        } else {
+            break;
+        }
+    }
+    for (; i < argc; ++i) {
+        query.emplace_back(argv[i]);
+    }
+
+    struct sockaddr_un addr;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "icgrepc: socket path is too long: %s\n", socketPath.c_str());
+        return 2;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("icgrepc: socket");
+        return 2;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        fprintf(stderr, "icgrepc: cannot connect to icgrepd at %s: %s\n", socketPath.c_str(), strerror(errno));
+        return 2;
+    }
+
+    const auto payload = encodeStrings(query);
+    if (!writeFrame(fd, FrameKind::Query, payload.data(), payload.size())) {
+        perror("icgrepc: sending query");
+        return 2;
+    }
+
+    FrameKind kind;
+    std::string data;
+    while (readFrame(fd, kind, data)) {
+        switch (kind) {
+            case FrameKind::Output:
+                writeAll(STDOUT_FILENO, data.data(), data.size());
+                break;
+            case FrameKind::Error:
+                writeAll(STDERR_FILENO, data.data(), data.size());
+                break;
+            case FrameKind::Done: {
+                QueryResult result;
+                if (data.size() != sizeof(QueryResult)) {
+                    fprintf(stderr, "icgrepc: malformed reply from icgrepd\n");
+                    return 2;
+                }
+                std::memcpy(&result, data.data(), sizeof(QueryResult));
+                if (showStats) {
+                    fprintf(stderr, "icgrepc: %s, compile: %.3f ms, search: %.3f ms\n",
+                            result.cacheHit ? "cached engine" : "new engine",
+                            result.compileTime / 1000.0, result.searchTime / 1000.0);
+                }
+                close(fd);
+                return result.exitCode;
+            }
+            default:
+                fprintf(stderr, "icgrepc: unexpected reply from icgrepd\n");
+                return 2;
+        }
+    }
+    fprintf(stderr, "icgrepc: connection to icgrepd closed unexpectedly\n");
+    return 2;
+}
@@ -0,0 +1,586 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ *
+ *  icgrepd: a persistent icgrep search server.
+ *
+ *  Each icgrep invocation must parse and transform its regular expressions,
+ *  generate the grep pipeline and JIT compile it before a single byte can be
+ *  searched.   For workloads consisting of many short queries, this compile
+ *  time dominates.   icgrepd listens on a local UNIX domain socket and keeps
+ *  the CPUDriver and compiled main/batch methods of recently used queries
+ *  alive, so that a query whose patterns and engine flags match those of an
+ *  earlier query goes straight to the search phase.
+ *
+ *  Queries are submitted with icgrepc; see icgrepd.h for the wire protocol.
+ */
+
+#include "icgrepd.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/ManagedStatic.h>
+#include <llvm/Support/raw_ostream.h>
+#include <re/adt/re_alt.h>
+#include <re/adt/re_seq.h>
+#include <re/adt/re_start.h>
+#include <re/adt/re_end.h>
+#include <re/adt/re_utility.h>
+#include <re/parse/parser.h>
+#include <re/toolchain/toolchain.h>
+#include <grep/grep_engine.h>
+#include "grep_interface.h"
+#include <toolchain/toolchain.h>
+#include <toolchain/pablo_toolchain.h>
+#include <boost/filesystem.hpp>
+#include <kernel/pipeline/driver/cpudriver.h>
+
+using namespace llvm;
+using namespace icgrepd;
+
+static cl::OptionCategory ServerOptions("icgrepd Options", "These options control the icgrep search server.");
+
+static cl::opt<std::string> SocketPath("socket", cl::desc("Path of the UNIX domain socket to listen on."), cl::init(defaultSocketPath()), cl::cat(ServerOptions));
+
+static cl::opt<unsigned> MaxCachedEngines("max-cached-engines", cl::desc("Maximum number of compiled search engines kept alive."), cl::init(64), cl::cat(ServerOptions));
+
+static cl::opt<bool> LogQueries("log-queries", cl::desc("Report the compile and search time of each query to stderr."), cl::init(false), cl::cat(ServerOptions));
+
+//
+// The subset of icgrep options understood by the server.   Every option except the
+// list of input files affects code generation and so forms part of the engine key.
+//
+struct QueryOptions {
+    re::RE_Syntax syntax = re::RE_Syntax::PCRE;
+    bool ignoreCase = false;
+    bool invertMatch = false;
+    bool lineRegexp = false;
+    bool wordRegexp = false;
+    argv::GrepModeType mode = argv::NormalMode;
+    bool withFilename = false;
+    bool noFilename = false;
+    bool lineNumbers = false;
+    bool initialTab = false;
+    bool onlyMatching = false;
+    bool byteOffsets = false;
+    bool unixByteOffsets = false;
+    bool nullData = false;
+    bool unicodeLines = false;
+    int maxCount = 0;
+    int afterContext = 0;
+    int beforeContext = 0;
+    std::vector<std::string> patterns;
+    std::vector<boost::filesystem::path> files;
+
+    std::string engineKey() const;
+};
+
+std::string QueryOptions::engineKey() const {
+    std::string key;
+    raw_string_ostream out(key);
+    out << static_cast<unsigned>(syntax) << ':' << static_cast<unsigned>(mode) << ':'
+        << ignoreCase << invertMatch << lineRegexp << wordRegexp
+        << withFilename << noFilename << lineNumbers << initialTab << onlyMatching
+        << byteOffsets << unixByteOffsets
+        << nullData << unicodeLines << ':'
+        << maxCount << ':' << afterContext << ':' << beforeContext;
+    for (const auto & p : patterns) {
+        out << '\0' << p;
+    }
+    out.flush();
+    return key;
+}
+
+// A raw_ostream that forwards everything written to it to the client as frames
+// of the given kind.
+class FrameStream final : public raw_ostream {
+public:
+    FrameStream(const int fd, const FrameKind kind) : mFD(fd), mKind(kind), mPos(0) { }
+    ~FrameStream() override { flush(); }
+private:
+    void write_impl(const char * ptr, size_t size) override {
+        writeFrame(mFD, mKind, ptr, size);
+        mPos += size;
+    }
+    uint64_t current_pos() const override { return mPos; }
+private:
+    const int mFD;
+    const FrameKind mKind;
+    uint64_t mPos;
+};
+
+// A compiled search engine and the driver that owns its code.   The engine
+// holds a reference to the driver and so is declared last (and destroyed first).
+struct CachedEngine {
+    std::unique_ptr<CPUDriver> driver;
+    std::unique_ptr<grep::GrepEngine> engine;
+};
+
+using EngineList = std::list<std::pair<std::string, std::unique_ptr<CachedEngine>>>;
+static EngineList CachedEngines;
+static std::map<std::string, EngineList::iterator> EngineIndex;
+
+// The socket of the client currently being served, if any.
+static int CurrentClient = -1;
+
+// In the child process that checks a query (see checkQuery), the pipe on which an
+// error in the query is passed back to the server.
+static int QueryCheckPipe = -1;
+
+static unsigned InitialTaskThreads;
+static unsigned InitialSegmentThreads;
+
+static void sendDone(const int fd, const QueryResult & result) {
+    writeFrame(fd, FrameKind::Done, reinterpret_cast<const char *>(&result), sizeof(QueryResult));
+}
+
+static void sendError(const int fd, const std::string & msg) {
+    writeFrame(fd, FrameKind::Error, msg.data(), msg.size());
+}
+
+//
+// Parse, transform and compile errors are reported through llvm::report_fatal_error,
+// which must not return.   Errors in the query itself (a malformed pattern, an unknown
+// property or an unsupported combination of options) are found by checkQuery in a child
+// process, which passes the message back and exits.   Any other error is an internal
+// failure: pass the message on to the client being served before the server exits.
+//
+static void icgrepd_error_handler(void *, const std::string & Message, bool) {
+    if (QueryCheckPipe != -1) {
+        ssize_t written = ::write(QueryCheckPipe, Message.data(), Message.size());
+        (void)written;
+        _exit(argv::UsageErrorCode);
+    }
+    if (CurrentClient != -1) {
+        sendError(CurrentClient, "icgrep ERROR: " + Message + "\n");
+        QueryResult result{argv::InternalFailureCode, 0, 0, 0};
+        sendDone(CurrentClient, result);
+        close(CurrentClient);
+    }
+    errs() << "icgrepd ERROR: " << Message << "\n";
+    unlink(SocketPath.c_str());
+    exit(argv::InternalFailureCode);
+}
+
+static void icgrepd_signal_handler(int) {
+    unlink(SocketPath.c_str());
+    _exit(0);
+}
+
+static bool parseIntArg(const std::string & s, int & value) {
+    char * end = nullptr;
+    const auto v = strtol(s.c_str(), &end, 10);
+    if (s.empty() || *end != '\0' || v < 0) return false;
+    value = static_cast<int>(v);
+    return true;
+}
+
+static bool parseQuery(const std::vector<std::string> & args, QueryOptions & opts, std::string & errmsg) {
+    if (args.empty()) {
+        errmsg = "empty query";
+        return false;
+    }
+    const boost::filesystem::path cwd(args[0]);
+    std::vector<std::string> positional;
+    std::string patternFile;
+    bool optionsEnded = false;
+    for (unsigned i = 1; i < args.size(); ++i) {
+        const std::string & arg = args[i];
+        if (optionsEnded || arg.size() < 2 || arg[0] != '-') {
+            positional.push_back(arg);
+            continue;
+        }
+        if (arg == "--") {
+            optionsEnded = true;
+            continue;
+        }
+        if (arg == "-Unicode-lines") {
+            opts.unicodeLines = true;
+            continue;
+        }
+        // Short options, possibly grouped as in -inH.
+        for (unsigned j = 1; j < arg.size(); ++j) {
+            const char c = arg[j];
+            // Options taking a value accept it either attached (-m5) or as the next argument.
+            auto value = [&](std::string & v) {
+                if (j + 1 < arg.size()) {
+                    v = arg.substr(j + 1);
+                } else if (i + 1 < args.size()) {
+                    v = args[++i];
+                } else {
+                    return false;
+                }
+                j = arg.size();
+                return true;
+            };
+            std::string v;
+            switch (c) {
+                case 'E': opts.syntax = re::RE_Syntax::ERE; break;
+                case 'F': opts.syntax = re::RE_Syntax::FixedStrings; break;
+                case 'G': opts.syntax = re::RE_Syntax::BRE; break;
+                case 'P': opts.syntax = re::RE_Syntax::PCRE; break;
+                case 'i': opts.ignoreCase = true; break;
+                case 'v': opts.invertMatch = true; break;
+                case 'x': opts.lineRegexp = true; break;
+                case 'w': opts.wordRegexp = true; break;
+                case 'c': opts.mode = argv::CountOnly; break;
+                case 'l': opts.mode = argv::FilesWithMatch; break;
+                case 'L': opts.mode = argv::FilesWithoutMatch; break;
+                case 'q': opts.mode = argv::QuietMode; break;
+                case 'H': opts.withFilename = true; break;
+                case 'h': opts.noFilename = true; break;
+                case 'n': opts.lineNumbers = true; break;
+                case 'T': opts.initialTab = true; break;
+                case 'o': opts.onlyMatching = true; break;
+                case 'b': opts.byteOffsets = true; break;
+                case 'u': opts.unixByteOffsets = true; break;
+                case 'z': opts.nullData = true; break;
+                case 'e':
+                    if (!value(v)) { errmsg = "-e requires a pattern"; return false; }
+                    opts.patterns.push_back(v);
+                    break;
+                case 'f':
+                    if (!value(v)) { errmsg = "-f requires a file name"; return false; }
+                    patternFile = (cwd / v).string();
+                    break;
+                case 'm':
+                    if (!value(v) || !parseIntArg(v, opts.maxCount)) { errmsg = "-m requires a count"; return false; }
+                    break;
+                case 'A':
+                    if (!value(v) || !parseIntArg(v, opts.afterContext)) { errmsg = "-A requires a count"; return false; }
+                    break;
+                case 'B':
+                    if (!value(v) || !parseIntArg(v, opts.beforeContext)) { errmsg = "-B requires a count"; return false; }
+                    break;
+                case 'C': {
+                    int context = 0;
+                    if (!value(v) || !parseIntArg(v, context)) { errmsg = "-C requires a count"; return false; }
+                    if (opts.afterContext == 0) opts.afterContext = context;
+                    if (opts.beforeContext == 0) opts.beforeContext = context;
+                    break;
+                }
+                default:
+                    errmsg = "unsupported option: " + arg;
+                    return false;
+            }
+        }
+    }
+    if (!patternFile.empty()) {
+        std::ifstream regexFile(patternFile.c_str());
+        if (!regexFile.is_open()) {
+            errmsg = patternFile + ": No such file.";
+            return false;
+        }
+        std::string r;
+        while (std::getline(regexFile, r)) {
+            opts.patterns.push_back(r);
+        }
+    }
+    auto p = positional.begin();
+    if (opts.patterns.empty()) {
+        if (p == positional.end()) {
+            errmsg = "no pattern given";
+            return false;
+        }
+        opts.patterns.push_back(*p++);
+    }
+    for (; p != positional.end(); ++p) {
+        const boost::filesystem::path f(*p);
+        opts.files.push_back(f.is_absolute() ? f : cwd / f);
+    }
+    if (opts.files.empty()) {
+        errmsg = "icgrepd cannot search stdin; name the files to search";
+        return false;
+    }
+    if ((opts.mode == argv::QuietMode) || (opts.mode == argv::FilesWithMatch) || (opts.mode == argv::FilesWithoutMatch)) {
+        opts.maxCount = 1;
+    }
+    if (opts.files.size() > 1 && !opts.noFilename) {
+        opts.withFilename = true;
+    }
+    return true;
+}
+
+// Mirrors readExpressions in icgrep.cpp.
+static std::vector<re::RE *> parseExpressions(const QueryOptions & opts) {
+    re::ModeFlagSet flags = re::MULTILINE_MODE_FLAG;
+    if (opts.ignoreCase) {
+        flags |= re::CASE_INSENSITIVE_MODE_FLAG;
+    }
+    std::vector<re::RE *> REs;
+    for (const auto & p : opts.patterns) {
+        REs.push_back(re::RE_Parser::parse(p, flags, opts.syntax, false));
+    }
+    if (REs.size() > 1) {
+        const unsigned REsPerGroup = (REs.size() + codegen::SegmentThreads) / (codegen::SegmentThreads + 1);
+        std::vector<re::RE *> groups;
+        auto start = REs.begin();
+        auto end = start + REsPerGroup;
+        while (end < REs.end()) {
+            groups.push_back(re::makeAlt(start, end));
+            start = end;
+            end += REsPerGroup;
+        }
+        if ((REs.end() - start) > 1) {
+            groups.push_back(re::makeAlt(start, REs.end()));
+        } else {
+            groups.push_back(*start);
+        }
+        REs.swap(groups);
+    }
+    for (re::RE *& re_ast : REs) {
+        if (opts.wordRegexp) {
+            re_ast = re::makeSeq({re::makeWordBoundary(), re_ast, re::makeWordBoundary()});
+        }
+        if (opts.lineRegexp) {
+            re_ast = re::makeSeq({re::makeStart(), re_ast, re::makeEnd()});
+        }
+    }
+    return REs;
+}
+
+// Construct a search engine for the given query, up to the point at which code is
+// generated; mirrors main in icgrep.cpp.
+static std::unique_ptr<CachedEngine> prepareEngine(const QueryOptions & opts) {
+    std::unique_ptr<CachedEngine> c(new CachedEngine);
+    c->driver.reset(new CPUDriver("icgrep"));
+    CPUDriver & driver = *c->driver;
+    std::unique_ptr<grep::GrepEngine> grep;
+    switch (opts.mode) {
+        case argv::NormalMode:
+            grep = std::make_unique<grep::EmitMatchesEngine>(driver);
+            if (opts.maxCount) grep->setMaxCount(opts.maxCount);
+            if (opts.withFilename) grep->showFileNames();
+            if (opts.lineNumbers) grep->showLineNumbers();
+            if (opts.initialTab) grep->setInitialTab();
+            if (opts.onlyMatching) grep->setOnlyMatching();
+            if (opts.byteOffsets) grep->setByteOffsets();
+            if (opts.unixByteOffsets) grep->setUnixByteOffsets();
+            break;
+        case argv::CountOnly:
+            grep = std::make_unique<grep::CountOnlyEngine>(driver);
+            if (opts.withFilename) grep->showFileNames();
+            if (opts.maxCount) grep->setMaxCount(opts.maxCount);
+            break;
+        case argv::FilesWithMatch:
+        case argv::FilesWithoutMatch:
+            grep = std::make_unique<grep::MatchOnlyEngine>(driver, opts.mode == argv::FilesWithMatch, false);
+            break;
+        case argv::QuietMode:
+            grep = std::make_unique<grep::QuietModeEngine>(driver);
+            break;
+        default: llvm_unreachable("Invalid grep mode!");
+    }
+    if (opts.ignoreCase) grep->setCaseInsensitive();
+    if (opts.invertMatch) grep->setInvertMatches();
+    if (opts.unicodeLines) {
+        grep->setRecordBreak(grep::GrepRecordBreakKind::Unicode);
+    } else if (opts.nullData) {
+        grep->setRecordBreak(grep::GrepRecordBreakKind::Null);
+    } else {
+        grep->setRecordBreak(grep::GrepRecordBreakKind::LF);
+    }
+    grep->setContextLines(opts.beforeContext, opts.afterContext);
+    grep->setBinaryFilesOption(argv::WithoutMatch);
+    // Compile the batch method as well, if the first query can make use of it.
+    grep->initFileResult(opts.files);
+    auto REs = parseExpressions(opts);
+    grep->initREs(REs);
+    c->engine = std::move(grep);
+    return c;
+}
+
+static std::unique_ptr<CachedEngine> makeEngine(const QueryOptions & opts) {
+    auto c = prepareEngine(opts);
+    c->engine->grepCodeGen();
+    return c;
+}
+
+// Parse the patterns of the query and check them and its options before its engine is compiled.
+// The parser and the engine report errors through llvm::report_fatal_error, which must not return,
+// so the query is prepared in a child process: an error is written back on a pipe and the child
+// exits. Nothing is compiled there and the state of the server is left untouched.
+static bool checkQuery(const QueryOptions & opts, std::string & errmsg) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        errmsg = "could not check the query: " + std::string(strerror(errno));
+        return false;
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        errmsg = "could not check the query: " + std::string(strerror(errno));
+        return false;
+    }
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        close(fds[0]);
+        QueryCheckPipe = fds[1];
+        prepareEngine(opts);
+        _exit(0);
+    }
+    close(fds[1]);
+    std::string msg;
+    char buffer[512];
+    for (;;) {
+        const auto n = read(fds[0], buffer, sizeof(buffer));
+        if (n > 0) {
+            msg.append(buffer, n);
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    close(fds[0]);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        return true;
+    }
+    errmsg = msg.empty() ? "the query could not be checked" : msg;
+    return false;
+}
+
+static grep::GrepEngine * lookupEngine(const QueryOptions & opts, bool & cacheHit, std::string & errmsg) {
+    const auto key = opts.engineKey();
+    const auto f = EngineIndex.find(key);
+    if (f != EngineIndex.end()) {
+        // Move the entry to the front of the LRU list.
+        CachedEngines.splice(CachedEngines.begin(), CachedEngines, f->second);
+        cacheHit = true;
+        return f->second->second->engine.get();
+    }
+    cacheHit = false;
+    // A rejected query must not evict a cached engine.
+    if (!checkQuery(opts, errmsg)) {
+        return nullptr;
+    }
+    auto c = makeEngine(opts);
+    if (MaxCachedEngines > 0) {
+        while (CachedEngines.size() >= MaxCachedEngines) {
+            EngineIndex.erase(CachedEngines.back().first);
+            CachedEngines.pop_back();
+        }
+    }
+    CachedEngines.emplace_front(key, std::move(c));
+    EngineIndex.emplace(key, CachedEngines.begin());
+    return CachedEngines.front().second->engine.get();
+}
+
+static void serveQuery(const int client) {
+    using namespace std::chrono;
+    FrameKind kind;
+    std::string payload;
+    if (!readFrame(client, kind, payload) || kind != FrameKind::Query) {
+        return;
+    }
+    QueryOptions opts;
+    std::string errmsg;
+    if (!parseQuery(decodeStrings(payload), opts, errmsg)) {
+        sendError(client, "icgrepd: " + errmsg + "\n");
+        QueryResult result{argv::UsageErrorCode, 0, 0, 0};
+        sendDone(client, result);
+        return;
+    }
+
+    // Every query starts with the thread budget the server was launched with;
+    // initFileResult narrows it to the number of file groups in the query.
+    codegen::TaskThreads = InitialTaskThreads;
+    codegen::SegmentThreads = InitialSegmentThreads;
+
+    const auto compileStart = steady_clock::now();
+    bool cacheHit = false;
+    grep::GrepEngine * const engine = lookupEngine(opts, cacheHit, errmsg);
+    if (engine == nullptr) {
+        sendError(client, "icgrep: " + errmsg + "\n");
+        QueryResult result{argv::UsageErrorCode, 0, 0, 0};
+        sendDone(client, result);
+        return;
+    }
+    const auto searchStart = steady_clock::now();
+
+    bool matchFound = false;
+    {
+        FrameStream out(client, FrameKind::Output);
+        engine->setOutputStream(out);
+        engine->initFileResult(opts.files);
+        matchFound = engine->searchAllFiles();
+        out.flush();
+        engine->setOutputStream(outs());
+    }
+    const auto searchEnd = steady_clock::now();
+
+    QueryResult result;
+    result.exitCode = matchFound ? argv::MatchFoundExitCode : argv::MatchNotFoundExitCode;
+    result.cacheHit = cacheHit;
+    result.compileTime = duration_cast<microseconds>(searchStart - compileStart).count();
+    result.searchTime = duration_cast<microseconds>(searchEnd - searchStart).count();
+    sendDone(client, result);
+
+    if (LogQueries) {
+        errs() << "icgrepd: " << (cacheHit ? "cached" : "compiled")
+               << " compile: " << result.compileTime << "us"
+               << " search: " << result.searchTime << "us"
+               << " files: " << opts.files.size() << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    llvm_shutdown_obj shutdown;
+    llvm::install_fatal_error_handler(&icgrepd_error_handler);
+    codegen::ParseCommandLineOptions(argc, argv, {&ServerOptions, re::re_toolchain_flags(), pablo::pablo_toolchain_flags(), codegen::codegen_flags()});
+    InitialTaskThreads = codegen::TaskThreads;
+    InitialSegmentThreads = codegen::SegmentThreads;
+
+    struct sockaddr_un addr;
+    if (SocketPath.size() >= sizeof(addr.sun_path)) {
+        report_fatal_error("socket path is too long: " + SocketPath);
+    }
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        report_fatal_error("could not create socket: " + std::string(strerror(errno)));
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, SocketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(SocketPath.c_str());
+    if (bind(server, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        report_fatal_error("could not bind " + SocketPath + ": " + std::string(strerror(errno)));
+    }
+    if (listen(server, 64) < 0) {
+        report_fatal_error("could not listen on " + SocketPath + ": " + std::string(strerror(errno)));
+    }
+    signal(SIGINT, icgrepd_signal_handler);
+    signal(SIGTERM, icgrepd_signal_handler);
+    // A client that disconnects early must not take the server down with it.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Queries are served one at a time: each search already uses up to
+    // codegen::TaskThreads threads and the engines are not reentrant.
+    for (;;) {
+        const int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            report_fatal_error("accept failed: " + std::string(strerror(errno)));
+        }
+        CurrentClient = client;
+        serveQuery(client);
+        CurrentClient = -1;
+        close(client);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2019 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ *  icgrep is a trademark of International Characters.
+ *
+ *  This file defines the wire protocol shared by the icgrep search server
+ *  (icgrepd) and its client (icgrepc).
+ *
+ *  All messages are framed as a one byte frame kind, a four byte payload
+ *  length (host byte order; both ends share a UNIX domain socket) and the
+ *  payload itself.
+ *
+ *  A client sends a single Query frame whose payload is a sequence of
+ *  NUL-terminated strings: the client's working directory followed by the
+ *  icgrep-style arguments of the query.   The server answers with any number
+ *  of Output and Error frames, carrying the data icgrep would have written to
+ *  stdout and stderr, followed by a single Done frame.
+ *
+ */
+#ifndef ICGREPD_H
+#define ICGREPD_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+
+namespace icgrepd {
+
+enum class FrameKind : char {
+    Query = 'Q',
+    Output = 'O',
+    Error = 'E',
+    Done = 'D'
+};
+
+// The payload of a Done frame.
+struct QueryResult {
+    int32_t  exitCode;
+    // true if the compiled engine was reused from an earlier query.
+    uint32_t cacheHit;
+    // microseconds spent in RE processing and code generation.
+    uint64_t compileTime;
+    // microseconds spent searching the files of the query.
+    uint64_t searchTime;
+};
+
+inline std::string defaultSocketPath() {
+    return "/tmp/icgrepd-" + std::to_string(getuid()) + ".sock";
+}
+
+inline bool writeAll(const int fd, const char * data, size_t length) {
+    while (length) {
+        const auto written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+inline bool readAll(const int fd, char * data, size_t length) {
+    while (length) {
+        const auto received = ::read(fd, data, length);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (received == 0) return false;
+        data += received;
+        length -= received;
+    }
+    return true;
+}
+
+inline bool writeFrame(const int fd, const FrameKind kind, const char * data, const uint32_t length) {
+    char header[sizeof(char) + sizeof(uint32_t)];
+    header[0] = static_cast<char>(kind);
+    std::memcpy(header + 1, &length, sizeof(uint32_t));
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, data, length);
+}
+
+inline bool readFrame(const int fd, FrameKind & kind, std::string & payload) {
+    char header[sizeof(char) + sizeof(uint32_t)];
+    if (!readAll(fd, header, sizeof(header))) return false;
+    kind = static_cast<FrameKind>(header[0]);
+    uint32_t length;
+    std::memcpy(&length, header + 1, sizeof(uint32_t));
+    payload.resize(length);
+    return readAll(fd, &payload[0], length);
+}
+
+inline std::string encodeStrings(const std::vector<std::string> & strings) {
+    std::string payload;
+    for (const auto & s : strings) {
+        payload.append(s);
+        payload.push_back('\0');
+    }
+    return payload;
+}
+
+inline std::vector<std::string> decodeStrings(const std::string & payload) {
+    std::vector<std::string> strings;
+    size_t start = 0;
+    while (start < payload.size()) {
+        const auto end = payload.find('\0', start);
+        if (end == std::string::npos) break;
+        strings.emplace_back(payload, start, end - start);
+        start = end + 1;
+    }
+    return strings;
+}
+
+}
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ *  Copyright (c) 2020 International Characters.
+ *  This software is licensed to the public under the Open Software License 3.0.
+ */
+
+//  cachewarm - Precompile the kernels of a declared set of pipelines into an object cache directory.
+//
+//  Each line of the manifest names a Parabix tool in the directory of cachewarm (or -tool-dir) followed by the
+//  arguments of one invocation of it, e.g. the patterns, engine mode and flags of an icgrep query:
+//
+//      # tool     arguments
+//      icgrep     -c -i "(alpha|bravo) [0-9]+"
+//      icgrep     -enable-byte-mode -f patterns.txt
+//      wc         -l -w
+//      u8u16      {input} {output}
+//      csv2json   -headers "a,b,c"
+//
+//  Arguments are separated by whitespace and may be quoted with ' or ". Blank lines and lines starting with #
+//  are ignored. {input} is replaced by the name of a small sample file, which is appended to the arguments when
+//  {input} does not occur, and {output} is replaced by /dev/null.
+//
+//  The invocations are run in parallel with the object cache enabled and directed at the -object-cache-dir, once
+//  for each ISA tier (-isa-tier) supported by this host unless a tier is given. Hosts of any of those tiers then
+//  load the kernels of the widest tier they support.
+//  Every tool builds and compiles its whole pipeline before reading any input, so each run leaves all of its
+//  cachable kernels in the cache. The resulting directory can be shipped with the binaries and passed to them
+//  with -object-cache-dir; -report-object-cache-misses then reports any kernel they still had to compile.
+
+#include <toolchain/toolchain.h>
+#include <objcache/object_cache_store.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <boost/container/flat_map.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::OptionCategory CacheWarmOptions("cachewarm Options", "cachewarm options.");
+
+static cl::opt<std::string> ManifestFile(cl::Positional, cl::desc("<manifest file>"), cl::Required, cl::cat(CacheWarmOptions));
+
+static cl::opt<std::string> ToolDir("tool-dir", cl::desc("Directory of the tools named in the manifest (default: the directory of cachewarm)"),
+                                    cl::init(""), cl::cat(CacheWarmOptions));
+
+static cl::opt<unsigned> Jobs("j", cl::desc("Number of tool invocations to run in parallel (default: number of hardware threads)"),
+                              cl::init(0), cl::value_desc("positive integer"), cl::cat(CacheWarmOptions));
+
+static cl::opt<bool> Verbose("v", cl::desc("Print each invocation as it completes"), cl::init(false), cl::cat(CacheWarmOptions));
+
+struct Invocation {
+    unsigned LineNumber;
+    std::string Line;
+    std::vector<std::string> Args;
+    codegen::ISATierLevel Tier = codegen::AutoTier;
+};
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief tokenize
+ ** ------------------------------------------------------------------------------------------------------------- */
+bool tokenize(StringRef line, std::vector<std::string> & args) {
+    size_t i = 0;
+    const auto n = line.size();
+    for (;;) {
+        while (i < n && isspace(line[i])) ++i;
+        if (i == n) {
+            return true;
+        }
+        std::string arg;
+        while (i < n && !isspace(line[i])) {
+            const char c = line[i++];
+            if (c == '"' || c == '\'') {
+                const auto end = line.find(c, i);
+                if (end == StringRef::npos) {
+                    return false;
+                }
+                arg.append(line.data() + i, end - i);
+                i = end + 1;
+            } else {
+                arg.push_back(c);
+            }
+        }
+        args.push_back(std::move(arg));
+    }
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief parseManifest
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::vector<Invocation> parseManifest(StringRef manifest) {
+    std::vector<Invocation> invocations;
+    unsigned lineNumber = 0;
+    while (!manifest.empty()) {
+        StringRef line;
+        std::tie(line, manifest) = manifest.split('\n');
+        ++lineNumber;
+        line = line.trim();
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        Invocation inv;
+        inv.LineNumber = lineNumber;
+        inv.Line = line.str();
+        if (!tokenize(line, inv.Args)) {
+            errs() << ManifestFile << ":" << lineNumber << ": unterminated quotation\n";
+            exit(1);
+        }
+        invocations.push_back(std::move(inv));
+    }
+    return invocations;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief makeCommandLine
+ *
+ * Direct the tool at the object cache, fully optimize every kernel it compiles and substitute the sample files.
+ ** ------------------------------------------------------------------------------------------------------------- */
+std::vector<std::string> makeCommandLine(const Invocation & inv, StringRef toolDir, StringRef sampleFile) {
+    std::vector<std::string> argv;
+    SmallString<256> tool(toolDir);
+    sys::path::append(tool, inv.Args.front());
+    argv.push_back(tool.str().str());
+    argv.push_back("-enable-object-cache=1");
+    argv.push_back(std::string("-object-cache-dir=") + codegen::ObjectCacheDir);
+    argv.push_back("-object-cache-size=" + std::to_string(codegen::ObjectCacheSize));
+    argv.push_back("-tiered-compilation=0");
+    argv.push_back("-isa-tier=" + codegen::getISATierName(inv.Tier).str());
+    bool hasInput = false;
+    for (unsigned i = 1; i < inv.Args.size(); ++i) {
+        const auto & arg = inv.Args[i];
+        if (arg == "{input}") {
+            argv.push_back(sampleFile.str());
+            hasInput = true;
+        } else if (arg == "{output}") {
+            argv.push_back("/dev/null");
+        } else {
+            argv.push_back(arg);
+        }
+    }
+    if (!hasInput) {
+        argv.push_back(sampleFile.str());
+    }
+    return argv;
+}
+
+/** ------------------------------------------------------------------------------------------------------------- *
+ * @brief spawn
+ ** ------------------------------------------------------------------------------------------------------------- */
+pid_t spawn(const std::vector<std::string> & args) {
+    const auto pid = fork();
+    if (pid == 0) {
+        // the output of a warm-up run is of no interest; keep stderr for diagnostics
+        const int devNull = ::open("/dev/null", O_RDWR);
+        if (devNull >= 0) {
+            dup2(devNull, STDIN_FILENO);
+            dup2(devNull, STDOUT_FILENO);
+            ::close(devNull);
+        }
+        std::vector<char *> argv;
+        for (const auto & arg : args) {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        perror(argv[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+int main(int argc, char *argv[]) {
+    codegen::ParseCommandLineOptions(argc, argv, {&CacheWarmOptions, codegen::codegen_flags()});
+    if (codegen::ObjectCacheDir == nullptr) {
+        errs() << "cachewarm: -object-cache-dir must name the cache directory to populate\n";
+        return 1;
+    }
+
+    auto manifest = MemoryBuffer::getFile(ManifestFile);
+    if (!manifest) {
+        errs() << "cachewarm: cannot read " << ManifestFile << ": " << manifest.getError().message() << "\n";
+        return 1;
+    }
+    const auto lines = parseManifest((*manifest)->getBuffer());
+
+    // Run every line once for each ISA tier this host supports (or only the given -isa-tier) so that hosts of any
+    // of those tiers find their kernels in the cache.
+    std::vector<codegen::ISATierLevel> tiers;
+    if (codegen::ISATier == codegen::AutoTier) {
+        for (const auto tier : {codegen::SSE2Tier, codegen::AVX2Tier, codegen::AVX512Tier}) {
+            if (codegen::isISATierSupported(tier)) {
+                tiers.push_back(tier);
+            }
+        }
+        if (tiers.empty()) {
+            tiers.push_back(codegen::NativeTier);
+        }
+    } else {
+        tiers.push_back(codegen::ISATier);
+    }
+    std::vector<Invocation> invocations;
+    for (const auto tier : tiers) {
+        for (const auto & line : lines) {
+            invocations.push_back(line);
+            invocations.back().Tier = tier;
+        }
+    }
+
+    SmallString<256> toolDir(ToolDir);
+    if (toolDir.empty()) {
+        toolDir = sys::path::parent_path(argv[0]);
+        if (toolDir.empty()) {
+            toolDir = ".";
+        }
+    }
+
+    if (const auto err = sys::fs::create_directories(codegen::ObjectCacheDir, true)) {
+        errs() << "cachewarm: cannot create " << codegen::ObjectCacheDir << ": " << err.message() << "\n";
+        return 1;
+    }
+
+    // a few lines of sample text, which every tool accepts as input
+    SmallString<256> sampleFile;
+    int sampleFd;
+    if (sys::fs::createTemporaryFile("cachewarm", "txt", sampleFd, sampleFile)) {
+        errs() << "cachewarm: cannot create a sample input file\n";
+        return 1;
+    }
+    {
+        raw_fd_ostream sample(sampleFd, true);
+        sample << "a,b,c\nalpha,bravo,charlie\n1,2,3\n";
+    }
+
+    const unsigned jobs = Jobs ? Jobs : std::max(std::thread::hardware_concurrency(), 1u);
+    boost::container::flat_map<pid_t, unsigned> running;
+    unsigned next = 0;
+    unsigned succeeded = 0;
+    while (next < invocations.size() || !running.empty()) {
+        while (next < invocations.size() && running.size() < jobs) {
+            const pid_t pid = spawn(makeCommandLine(invocations[next], toolDir, sampleFile));
+            if (pid < 0) {
+                perror("cachewarm: fork");
+                break;
+            }
+            running.emplace(pid, next++);
+        }
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            perror("cachewarm: waitpid");
+            break;
+        }
+        const auto f = running.find(pid);
+        if (f == running.end()) {
+            continue;
+        }
+        const Invocation & inv = invocations[f->second];
+        running.erase(f);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) > 1) {
+            // grep-like tools exit with 1 when nothing matched
+            errs() << ManifestFile << ":" << inv.LineNumber << ": failed";
+            if (WIFEXITED(status)) {
+                errs() << " with exit status " << WEXITSTATUS(status);
+            } else if (WIFSIGNALED(status)) {
+                errs() << " with signal " << WTERMSIG(status);
+            }
+            errs() << ": [" << codegen::getISATierName(inv.Tier) << "] " << inv.Line << "\n";
+        } else {
+            if (Verbose) {
+                outs() << ManifestFile << ":" << inv.LineNumber << ": [" << codegen::getISATierName(inv.Tier) << "] " << inv.Line << "\n";
+            }
+            ++succeeded;
+        }
+    }
+
+    sys::fs::remove(sampleFile);
+
+    ObjectCacheStore store(codegen::ObjectCacheDir, "", static_cast<uint64_t>(codegen::ObjectCacheSize) << 20);
+    outs() << "cachewarm: " << succeeded << " of " << invocations.size() << " invocations succeeded; "
+           << codegen::ObjectCacheDir << " holds " << store.getNumOfEntries() << " entries ("
+           << format("%.1f", store.getLiveBytes() / (1024.0 * 1024.0)) << " MiB)\n";
+
+    return (succeeded == invocations.size()) ? 0 : 1;
+}
@@ -266,7 +266,7 @@ WordCountFunctionType wcPipelineGen(CPUDriver & pxDriver) {
     return reinterpret_cast<WordCountFunctionType>(P->compile());
 }
 
-void wc(WordCountFunctionType fn_ptr, const uint32_t fileIdx) {
+void wc(ProgramInstance<void, uint32_t, uint32_t> & wordCount, const uint32_t fileIdx) {
     std::string fileName = allFiles[fileIdx].string();
     struct stat sb;
     const int fd = open(fileName.c_str(), O_RDONLY);
@@ -287,7 +287,7 @@ void wc(WordCountFunctionType fn_ptr, const uint32_t fileIdx) {
         close(fd);
         return;
     }
-    fn_ptr(fd, fileIdx);
+    wordCount(fd, fileIdx);
     close(fd);
 }
 
@@ -331,8 +331,11 @@ int main(int argc, char *argv[]) {
     charCount.resize(fileCount);
     byteCount.resize(fileCount);
 
-    for (unsigned i = 0; i < fileCount; ++i) {
-        wc(wordCountFunctionPtr, i);
+    {
+        ProgramInstance<void, uint32_t, uint32_t> wordCount(pxDriver, wordCountFunctionPtr);
+        for (unsigned i = 0; i < fileCount; ++i) {
+            wc(wordCount, i);
+        }
     }
     
     size_t maxCount = 0;